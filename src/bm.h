@@ -30,6 +30,9 @@ For more information please visit:  http://bitmagic.io
 # include <iterator>
 # include <initializer_list>
 # include <stdexcept>
+# ifndef BM_NO_CXX11
+#  include <atomic>
+# endif
 #endif
 
 #include <limits.h>
@@ -92,36 +95,108 @@ namespace bm
 /**
     @brief Rank-Select acceleration index
  
-    Index uses two-level acceleration structure:
-    bcount - running total popcount for all (possible) blocks
-    (missing blocks give duplicate counts as POPCNT(N-1) + 0).
-    subcount - sub-count inside blocks
+    Index uses two-level acceleration structure sized to the populated
+    part of the vector:
+    super-block running counts - running total popcount for each
+    second level array of blocks (bm::set_array_size blocks);
+    block running counts and sub-counts - allocated only for
+    non-empty super-blocks.
+ 
+    Index can be kept in sync with the vector incrementally
+    (bvector<>::set_bit(n, val, rs_idx), bvector<>::update_rs_index())
+    instead of the full rebuild with bvector<>::running_count_blocks().
+
+    Index covers the 32-bit address range of the vector (positions
+    up to bm::id_max32) in both address modes: with BM64ADDR bits above
+    it are not counted, positions passed to rank functions must be below
+    bm::id_max32 (BM_ERR_RANGE otherwise) and select()/find_rank()
+    do not return positions above it.
  
     @ingroup bvector
 */
 struct rs_index
 {
-    unsigned  BM_VECT_ALIGN bcount[bm::set_total_blocks] BM_VECT_ALIGN_ATTR;
-    bm::pair<bm::gap_word_t, bm::gap_word_t> BM_VECT_ALIGN subcount[bm::set_total_blocks] BM_VECT_ALIGN_ATTR;
-    unsigned  total_blocks;
+    typedef bm::pair<bm::gap_word_t, bm::gap_word_t> sb_pair_type;
+
+    /// running counts of one super-block
+    struct sb_counts
+    {
+        unsigned     bcount[bm::set_array_size]; ///< running counts inside super-block
+        sb_pair_type subcount[bm::set_array_size]; ///< sub-counts of blocks
+    };
+
+    unsigned  total_blocks; ///< number of blocks covered by the index
+    
+    rs_index() BMNOEXEPT
+        : total_blocks(0), sb_rcount_(0), sb_(0), sb_size_(0) {}
+    rs_index(const rs_index& rsi);
+    ~rs_index() BMNOEXEPT { init(); }
     
-    rs_index() { total_blocks = 0; }
-    rs_index(const rs_index& rsi) BMNOEXEPT;
+    rs_index& operator=(const rs_index& rsi)
+    {
+        if (this != &rsi)
+            copy_from(rsi);
+        return *this;
+    }
     
-    /// init arrays to zeros
+    /// free index memory, reset to empty
     void init() BMNOEXEPT;
     
     /// copy rs index
-    void copy_from(const rs_index& rsi) BMNOEXEPT;
+    void copy_from(const rs_index& rsi);
     
     /// return bit-count for specified block
     unsigned count(unsigned nb) const;
     
+    /// return total bit-count
+    unsigned count() const { return sb_size_ ? sb_rcount_[sb_size_] : 0; }
+    
+    /// return running bit-count of blocks [0..nb]
+    unsigned rcount(unsigned nb) const;
+    
+    /// return sub-counts of a (non-empty) block
+    const sb_pair_type& sub_count(unsigned nb) const;
+    
+    /// find block with running count >= rank (rank in [1..count()])
+    unsigned find(unsigned rank) const;
+    
     /// determine the sub-range within a bit-block
     unsigned find_sub_range(unsigned block_bit_pos) const;
     
     /// determine block sub-range for rank search
     bm::gap_word_t select_sub_range(unsigned nb, unsigned& rank) const;
+    
+    /// set bit-count and sub-counts of one block, adjust running counts
+    void set_block(unsigned nb, unsigned cnt,
+                   bm::gap_word_t first, bm::gap_word_t second);
+    
+    /// adjust counts after bit nbit of block nb changed its value to val
+    void update_bit(unsigned nb, unsigned nbit, bool val);
+    
+    /// memory consumed by the index
+    size_t memory_used() const;
+    
+    /// set number of super-blocks covered by the index
+    /// @internal
+    void resize(unsigned sb_size);
+    
+    /// get (allocate) counts of super-block i (i < number of super-blocks)
+    /// @internal
+    sb_counts* get_sb(unsigned i);
+    
+    /// compute running counts after per-block counts were placed
+    /// into super-blocks by get_sb()
+    /// @internal
+    void build_running_counts();
+    
+private:
+    /// add delta to running counts starting from block nb
+    void add(unsigned nb, int delta);
+    
+private:
+    unsigned*    sb_rcount_; ///< counts before each super-block [sb_size_+1]
+    sb_counts**  sb_;        ///< super-block counts (NULL if empty)
+    unsigned     sb_size_;   ///< number of super-blocks
 };
 
 
@@ -129,6 +204,12 @@ struct rs_index
 /*!
    @brief Bitvector
    Bit-vector container with runtime compression of bits
+
+   @note When compiled with BM64ADDR the address space is 48-bit
+   (size_type is 64-bit). The top level of the blocks tree is allocated
+   on demand, so small vectors stay cheap. Rank-select index (rs_index)
+   covers the first 2^32 bits and invert() works within the current
+   capacity (or declared size) of the vector.
  
    @ingroup bvector
 */
@@ -139,7 +220,12 @@ public:
     typedef Alloc                                        allocator_type;
     typedef typename allocator_type::allocator_pool_type allocator_pool_type;
     typedef blocks_manager<Alloc>                        blocks_manager_type;
-    typedef bm::id_t                                     size_type; 
+#ifdef BM64ADDR
+    typedef bm::id64_t                                   size_type;
+#else
+    typedef bm::id_t                                     size_type;
+#endif
+    typedef bm::block_idx_type                           block_idx_type;
 
     /** Statistical information about bitset's memory allocation details. */
     struct statistics : public bv_statistics
@@ -155,7 +241,7 @@ public:
     class reference
     {
     public:
-        reference(bvector<Alloc>& bv, bm::id_t position) 
+        reference(bvector<Alloc>& bv, size_type position) 
         : bv_(bv),
           position_(position)
         {}
@@ -234,7 +320,7 @@ public:
 
     private:
         bvector<Alloc>&   bv_;       //!< Reference variable on the parent.
-        bm::id_t          position_; //!< Position in the parent bitvector.
+        size_type         position_; //!< Position in the parent bitvector.
     };
 
     typedef bool const_reference;
@@ -340,7 +426,7 @@ public:
             unsigned char       bits[set_bitscan_wave_size*32]; //!< bit list
             unsigned short      idx;      //!< Current position in the bit list
             unsigned short      cnt;      //!< Number of ON bits
-            bm::id_t            pos;      //!< Last bit position decode before
+            size_type           pos;      //!< Last bit position decode before
         };
 
         /** Information about current DGAP block. */
@@ -352,10 +438,10 @@ public:
 
     protected:
         bm::bvector<Alloc>*     bv_;         //!< Pointer on parent bitvector
-        bm::id_t                position_;   //!< Bit position (bit idx)
+        size_type               position_;   //!< Bit position (bit idx)
         const bm::word_t*       block_;      //!< Block pointer.(NULL-invalid)
         unsigned                block_type_; //!< Type of block. 0-Bit, 1-GAP
-        unsigned                block_idx_;  //!< Block index
+        block_idx_type          block_idx_;  //!< Block index
 
         /*! Block type dependent information for current block. */
         union block_descr
@@ -386,7 +472,7 @@ public:
 #ifndef BM_NO_STL
         typedef std::output_iterator_tag  iterator_category;
 #endif
-        typedef unsigned value_type;
+        typedef size_type value_type;
         typedef void difference_type;
         typedef void pointer;
         typedef void reference;
@@ -414,7 +500,7 @@ public:
             return *this;
         }
 
-        insert_iterator& operator=(bm::id_t n)
+        insert_iterator& operator=(size_type n)
         {
             BM_ASSERT(n < bm::id_max);
             BM_ASSERT_THROW(n < bm::id_max, BM_ERR_RANGE);
@@ -424,7 +510,7 @@ public:
                 max_bit_ = n;
                 if (n >= bvect_->size()) 
                 {
-                    bm::id_t new_size = (n == bm::id_max) ? bm::id_max : n + 1;
+                    size_type new_size = (n == bm::id_max) ? bm::id_max : n + 1;
                     bvect_->resize(new_size);
                 }
             }
@@ -442,7 +528,7 @@ public:
         
     protected:
         bm::bvector<Alloc>*   bvect_;
-        bm::id_t              max_bit_;
+        size_type             max_bit_;
     };
 
 
@@ -455,10 +541,10 @@ public:
 #ifndef BM_NO_STL
         typedef std::input_iterator_tag  iterator_category;
 #endif
-        typedef unsigned   value_type;
-        typedef unsigned   difference_type;
-        typedef unsigned*  pointer;
-        typedef unsigned&  reference;
+        typedef size_type   value_type;
+        typedef size_type   difference_type;
+        typedef size_type*  pointer;
+        typedef size_type&  reference;
 
     public:
         enumerator() : iterator_base()
@@ -480,7 +566,7 @@ public:
                        if position is 0, it finds the next 1 or becomes not valid
                        (en.valid() == false)
         */
-        enumerator(const bvector<Alloc>* bv, bm::id_t pos)
+        enumerator(const bvector<Alloc>* bv, size_type pos)
             : iterator_base()
         { 
             this->bv_ = const_cast<bvector<Alloc>*>(bv);
@@ -488,13 +574,13 @@ public:
         }
 
         /*! \brief Get current position (value) */
-        bm::id_t operator*() const
+        size_type operator*() const
         { 
             return this->position_; 
         }
 
         /*! \brief Get current position (value) */
-        bm::id_t value() const
+        size_type value() const
         {
             return this->position_;
         }
@@ -527,21 +613,17 @@ public:
                 return;
             }
             
-            bm::word_t*** blk_root = bman->top_blocks_root();
-
             this->block_idx_ = this->position_= 0;
             unsigned i, j;
+            unsigned top_size = bman->top_block_size();
 
-            for (i = 0; i < bman->top_block_size(); ++i)
+            // not allocated top blocks are skipped
+            for (i = bman->find_next_nz_top(0); i < top_size;
+                                        i = bman->find_next_nz_top(i + 1))
             {
-                bm::word_t** blk_blk = blk_root[i];
-
-                if (blk_blk == 0) // not allocated
-                {
-                    this->block_idx_ += bm::set_array_size;
-                    this->position_ += bm::bits_in_array;
-                    continue;
-                }
+                bm::word_t** blk_blk = bman->get_topblock(i);
+                this->block_idx_ = block_idx_type(i) << bm::set_array_shift;
+                this->position_ = size_type(this->block_idx_) * bm::bits_in_block;
 
                 for (j = 0; j < bm::set_array_size; ++j,++(this->block_idx_))
                 {
@@ -658,7 +740,7 @@ public:
             @brief Skip to specified relative rank
             @param rank - number of ON bits to go for
         */
-        enumerator& skip_to_rank(bm::id_t rank)
+        enumerator& skip_to_rank(size_type rank)
         {
             --rank;
             if (!rank)
@@ -670,7 +752,7 @@ public:
             @brief Skip specified number of bits from enumeration
             @param rank - number of ON bits to skip
         */
-        enumerator& skip(bm::id_t rank)
+        enumerator& skip(size_type rank)
         {
             if (!this->valid() || !rank)
                 return *this;
@@ -743,7 +825,7 @@ public:
         /*!
             @brief go to a specific position in the bit-vector (or next)
         */
-        enumerator& go_to(bm::id_t pos)
+        enumerator& go_to(size_type pos)
         {
             if (pos == 0)
             {
@@ -759,11 +841,12 @@ public:
             }
             
             this->position_ = pos;
-            unsigned nb = this->block_idx_ = unsigned(pos >>  bm::set_block_shift);
+            block_idx_type nb = this->block_idx_ =
+                                    block_idx_type(pos >>  bm::set_block_shift);
             bm::bvector<Alloc>::blocks_manager_type& bman =
                                                  this->bv_->get_blocks_manager();
-            unsigned i0 = nb >> bm::set_array_shift; // top block address
-            unsigned j0 = nb &  bm::set_array_mask;  // address in sub-block
+            unsigned i0, j0;
+            bman.get_block_coord(nb, i0, j0);
             this->block_ = bman.get_block(i0, j0);
 
             BM_ASSERT(this->block_);
@@ -863,7 +946,7 @@ public:
             return false;
         }
         
-        bool decode_bit_group(block_descr_type* bdescr, bm::id_t& rank)
+        bool decode_bit_group(block_descr_type* bdescr, size_type& rank)
         {
             const word_t* block_end = this->block_ + bm::set_block_size;
             
@@ -941,19 +1024,27 @@ public:
         bool search_in_blocks()
         {
             ++(this->block_idx_);
-            unsigned i = this->block_idx_ >> bm::set_array_shift;
-            unsigned top_block_size = this->bv_->blockman_.top_block_size();
+            unsigned i = unsigned(this->block_idx_ >> bm::set_array_shift);
+            blocks_manager_type& bman = this->bv_->blockman_;
+            unsigned top_block_size = bman.top_block_size();
             for (; i < top_block_size; ++i)
             {
-                bm::word_t** blk_blk = this->bv_->blockman_.top_blocks_root()[i];
+                bm::word_t** blk_blk = bman.get_topblock(i);
                 if (blk_blk == 0)
                 {
-                    this->block_idx_ += bm::set_array_size;
-                    this->position_ += bm::bits_in_array;
+                    // skip to the next allocated top block
+                    unsigned i_next = bman.find_next_nz_top(i);
+                    if (i_next > top_block_size)
+                        i_next = top_block_size;
+                    this->block_idx_ +=
+                        block_idx_type(i_next - i) * bm::set_array_size;
+                    this->position_ +=
+                        size_type(i_next - i) * bm::bits_in_array;
+                    i = i_next - 1;
                     continue;
                 }
 
-                unsigned j = this->block_idx_ & bm::set_array_mask;
+                unsigned j = unsigned(this->block_idx_ & bm::set_array_mask);
 
                 for(; j < bm::set_array_size; ++j, ++(this->block_idx_))
                 {
@@ -1039,204 +1130,742 @@ public:
             Method returns number of ON bits fromn the bit 0 to the current bit 
             For the first bit in bitvector it is 1, for the second 2 
         */
-        bm::id_t count() const { return bit_count_; }
+        size_type count() const { return bit_count_; }
     private:
         /*! Function closed for usage */
-        counted_enumerator& go_to(bm::id_t pos);
+        counted_enumerator& go_to(size_type pos);
 
     private:
-        bm::id_t   bit_count_;
+        size_type  bit_count_;
     };
 
-    /*! 
-        Resource guard for bvector<>::set_allocator_pool()
-        @ingroup bvector
-        @internal
+    /*!
+        @brief Constant iterator designed to enumerate "ON" bits
+        in a closed range [from, to]
+        
+        Enumeration stops (iterator becomes invalid) after the last
+        bit of the range.
+        
+        @ingroup bvit
     */
-    class mem_pool_guard
+    class range_enumerator : public enumerator
     {
     public:
-        mem_pool_guard() : bv_(0)
-        {}
-
-        mem_pool_guard(allocator_pool_type& pool, bvector<Alloc>& bv)
-            : bv_(&bv)
+#ifndef BM_NO_STL
+        typedef std::input_iterator_tag  iterator_category;
+#endif
+        range_enumerator() : enumerator(), to_(0) {}
+        
+        /*! @brief Construct enumerator for the range of bit vector
+            @param bv   bit-vector pointer
+            @param from first position of the range
+            @param to   last position of the range (closed interval)
+        */
+        range_enumerator(const bvector<Alloc>* bv,
+                         size_type from, size_type to)
+            : enumerator(bv), to_(to)
         {
-            bv.set_allocator_pool(&pool);
+            BM_ASSERT(from <= to);
+            go_to(from);
         }
-        ~mem_pool_guard()
+        
+        range_enumerator& operator++()
         {
-            if (bv_)
-                bv_->set_allocator_pool(0);
+            return go_up();
         }
 
-        void assign_if_not_set(allocator_pool_type& pool, bvector<Alloc>& bv)
+        range_enumerator operator++(int)
         {
-            if (bv.get_allocator_pool() == 0) // alloc pool not set yet
+            range_enumerator tmp(*this);
+            go_up();
+            return tmp;
+        }
+        
+        /// advance iterator forward by one
+        void advance() { go_up(); }
+        
+        /*! \brief Advance enumerator to the next available bit of the range */
+        range_enumerator& go_up()
+        {
+            this->enumerator::go_up();
+            check_range();
+            return *this;
+        }
+        
+        /*! \brief Skip specified number of bits from enumeration */
+        range_enumerator& skip(size_type rank)
+        {
+            this->enumerator::skip(rank);
+            check_range();
+            return *this;
+        }
+        
+        /*!
+            @brief go to a specific position in the range (or next)
+        */
+        range_enumerator& go_to(size_type pos)
+        {
+            if (pos > to_)
+                this->invalidate();
+            else
             {
-                BM_ASSERT(!bv_);
-                bv_ = &bv;
-                bv.set_allocator_pool(&pool);
+                this->enumerator::go_to(pos);
+                check_range();
             }
+            return *this;
         }
-
-    private:
-        mem_pool_guard(const mem_pool_guard&) = delete;
-        void operator=(const mem_pool_guard&) = delete;
+        
+        /*! \brief Last position of the range */
+        size_type range_to() const { return to_; }
+        
     private:
-        bvector<Alloc>* bv_; ///< garded object
-    };
-
-
-    friend class iterator_base;
-    friend class enumerator;
-    template<class BV> friend class aggregator;
-
-public:
-    /*! @brief memory allocation policy
-    
-        Defualt memory allocation policy uses BM_BIT, and standard 
-        GAP levels tune-ups
-    */
-    struct allocation_policy
-    {
-        bm::strategy  strat;
-        const         gap_word_t* glevel_len;
+        void check_range()
+        {
+            if (this->position_ > to_) // also true for invalid position
+                this->invalidate();
+        }
         
-        allocation_policy(bm::strategy s=BM_BIT,
-                          const gap_word_t* glevels = bm::gap_len_table<true>::_len)
-        : strat(s), glevel_len(glevels)
-        {}
+        /*! Function closed for usage */
+        void go_first();
+        
+    private:
+        size_type  to_; ///< last position of the range
     };
     
-    
-    
-    typedef rs_index blocks_count;
-    typedef rs_index rs_index_type;
-public:
-    /*! @name Construction, initialization, assignment */
-    //@{
-    
-    /*!
-        \brief Constructs bvector class
-        \param strat - operation mode strategy, 
-                       BM_BIT - default strategy, bvector use plain bitset 
-                       blocks, (performance oriented strategy).
-                       BM_GAP - memory effitent strategy, bvector allocates 
-                       blocks as array of intervals(gaps) and convert blocks 
-                       into plain bitsets only when enthropy grows.
-        \param glevel_len 
-           - pointer on C-style array keeping GAP block sizes. 
-            bm::gap_len_table<true>::_len - default value set
-            (use bm::gap_len_table_min<true>::_len for very sparse vectors)
-            (use bm::gap_len_table_nl<true>::_len non-linear GAP growth)
-        \param bv_size
-          - bvector size (number of bits addressable by bvector), bm::id_max means 
-          "no limits" (recommended). 
-          bit vector allocates this space dynamically on demand.
-        \param alloc - alllocator for this instance
-         
-        \sa bm::gap_len_table bm::gap_len_table_min set_new_blocks_strat
-    */
-    bvector(strategy          strat      = BM_BIT,
-            const gap_word_t* glevel_len = bm::gap_len_table<true>::_len,
-            size_type         bv_size    = bm::id_max,
-            const Alloc&      alloc      = Alloc()) 
-    : blockman_(glevel_len, bv_size, alloc),
-      new_blocks_strat_(strat),
-      size_(bv_size)
-    {}
-
-    /*!
-        \brief Constructs bvector class
-    */
-    bvector(size_type         bv_size,
-            strategy          strat      = BM_BIT,
-            const gap_word_t* glevel_len = bm::gap_len_table<true>::_len,
-            const Alloc&      alloc      = Alloc()) 
-    : blockman_(glevel_len, bv_size, alloc),
-      new_blocks_strat_(strat),
-      size_(bv_size)
-    {}
-
-    /*!
-        \brief Copy constructor
-    */
-    bvector(const bvector<Alloc>& bvect)
-        :  blockman_(bvect.blockman_),
-           new_blocks_strat_(bvect.new_blocks_strat_),
-           size_(bvect.size_)
-    {}
-    
     /*!
-        \brief Copy constructor for range copy [left..right]
-     
-        \sa copy_range
+        @brief Constant iterator designed to enumerate "ON" bits
+        in reverse (descending) order
+        
+        Enumeration can be bounded from below to walk a range [from, pos].
+        Empty blocks are skipped through the blocks tree, GAP blocks are
+        walked back interval by interval, bit blocks are decoded
+        backwards wave by wave (empty waves are skipped), so the cost is
+        proportional to the bits visited.
+        
+        @ingroup bvit
     */
-    bvector(const bvector<Alloc>& bvect, bm::id_t left, bm::id_t right)
-        : blockman_(bvect.blockman_.glevel_len_, bvect.blockman_.max_bits_, bvect.blockman_.alloc_),
-          new_blocks_strat_(bvect.new_blocks_strat_),
-          size_(bvect.size_)
+    class reverse_enumerator : public iterator_base
     {
-        if (!bvect.blockman_.is_init())
-            return;
-        if (left > right)
-            bm::xor_swap(left, right);
-        copy_range_no_check(bvect, left, right);
-    }
-
-    
-    ~bvector() BMNOEXEPT
-    {}
-    /*!
-        \brief Explicit post-construction initialization
-    */
-    void init();
+    public:
+#ifndef BM_NO_STL
+        typedef std::input_iterator_tag  iterator_category;
+#endif
+        typedef size_type   value_type;
+        typedef size_type   difference_type;
+        typedef size_type*  pointer;
+        typedef size_type&  reference;
 
-    /*! 
-        \brief Copy assignment operator
-    */
-    bvector& operator=(const bvector<Alloc>& bvect)
-    {
-        if (this != &bvect)
+    public:
+        reverse_enumerator() : iterator_base(), from_(0)
+        {}
+        
+        /*! @brief Construct enumerator associated with a vector.
+            This construction creates unpositioned iterator with status
+            valid() == false. It can be re-positioned using go_last() or go_to()
+        */
+        reverse_enumerator(const bvector<Alloc>* bv)
+            : iterator_base(), from_(0)
         {
-            blockman_.deinit_tree();
-            blockman_.copy(bvect.blockman_);
-            resize(bvect.size());
+            this->bv_ = const_cast<bvector<Alloc>*>(bv);
+        }
+        
+        /*! @brief Construct reverse enumerator for bit vector
+            @param bv   bit-vector pointer
+            @param pos  bit position to start from (if it is 0
+                        enumerator finds the previous 1 bit)
+            @param from lower bound of enumeration (closed interval)
+        */
+        reverse_enumerator(const bvector<Alloc>* bv,
+                           size_type pos, size_type from = 0)
+            : iterator_base(), from_(from)
+        {
+            this->bv_ = const_cast<bvector<Alloc>*>(bv);
+            this->go_to(pos);
+        }
+        
+        /*! \brief Get current position (value) */
+        size_type operator*() const
+        {
+            return this->position_;
         }
-        return *this;
-    }
-
-#ifndef BM_NO_CXX11
-    /*!
-        \brief Move constructor
-    */
-    bvector(bvector<Alloc>&& bvect) BMNOEXEPT
-    {
-        blockman_.move_from(bvect.blockman_);
-        size_ = bvect.size_;
-        new_blocks_strat_ = bvect.new_blocks_strat_;
-    }
-
 
-    /*!
-        \brief Brace constructor
-    */
-    bvector(std::initializer_list<bm::id_t> il) 
-        : blockman_(bm::gap_len_table<true>::_len, bm::id_max, Alloc()),
-          new_blocks_strat_(BM_BIT),
-          size_(bm::id_max)
-    {
-        init();
-        std::initializer_list<bm::id_t>::const_iterator it_start = il.begin();
-        std::initializer_list<bm::id_t>::const_iterator it_end = il.end();
-        for (; it_start < it_end; ++it_start)
+        /*! \brief Get current position (value) */
+        size_type value() const
         {
-            this->set_bit_no_check(*it_start);
+            return this->position_;
         }
-    }
-    
-    /*! 
+        
+        /*! \brief Advance enumerator backward to the previous available bit */
+        reverse_enumerator& operator++()
+        {
+            return this->go_down();
+        }
+
+        /*! \brief Advance enumerator backward to the previous available bit */
+        reverse_enumerator operator++(int)
+        {
+            reverse_enumerator tmp = *this;
+            this->go_down();
+            return tmp;
+        }
+        
+        /// advance iterator backward by one
+        void advance() { this->go_down(); }
+        
+        /*! \brief Position enumerator to the last available bit */
+        void go_last()
+        {
+            go_to(bm::id_max - 1);
+        }
+        
+        /*!
+            @brief go to a specific position in the bit-vector (or previous)
+        */
+        reverse_enumerator& go_to(size_type pos)
+        {
+            BM_ASSERT(this->bv_);
+            const blocks_manager_type& bman = this->bv_->blockman_;
+            unsigned top_size = bman.top_block_size();
+            if (!bman.is_init() || !top_size || pos < from_)
+            {
+                this->invalidate();
+                return *this;
+            }
+            block_idx_type nb = block_idx_type(pos >> bm::set_block_shift);
+            unsigned nbit = unsigned(pos & bm::set_block_mask);
+            if ((nb >> bm::set_array_shift) >= top_size) // past the tree
+            {
+                nb = (block_idx_type(top_size) << bm::set_array_shift) - 1;
+                nbit = bm::gap_max_bits - 1;
+            }
+            this->block_idx_ = nb;
+            this->block_ = bman.get_block_ptr(nb);
+            if (!(this->block_ && search_in_block(nbit)))
+            {
+                if (!search_in_blocks())
+                {
+                    this->invalidate();
+                    return *this;
+                }
+            }
+            check_range();
+            return *this;
+        }
+        
+        /*! \brief Advance enumerator to the previous available bit */
+        reverse_enumerator& go_down()
+        {
+            BM_ASSERT(this->valid());
+            BM_ASSERT_THROW(this->valid(), BM_ERR_RANGE);
+            
+            block_descr_type* bdescr = &(this->bdescr_);
+            if (this->block_type_) // GAP
+            {
+                if (bdescr->gap_.gap_len) // inside of the 1 interval
+                {
+                    --(bdescr->gap_.gap_len);
+                    --(this->position_);
+                    check_range();
+                    return *this;
+                }
+                const bm::gap_word_t* first = BMGAP_PTR(this->block_) + 1;
+                if (bdescr->gap_.ptr - first >= 2) // previous 1 interval
+                {
+                    bdescr->gap_.ptr -= 2;
+                    set_gap_interval(*(bdescr->gap_.ptr));
+                    check_range();
+                    return *this;
+                }
+            }
+            else // bit block
+            {
+                if (bdescr->bit_.idx) // bits traversal cache
+                {
+                    --(bdescr->bit_.idx);
+                    this->position_ =
+                        bdescr->bit_.pos + bdescr->bit_.bits[bdescr->bit_.idx];
+                    check_range();
+                    return *this;
+                }
+                if (decode_prev_wave())
+                {
+                    check_range();
+                    return *this;
+                }
+            }
+            if (search_in_blocks())
+                check_range();
+            else
+                this->invalidate();
+            return *this;
+        }
+        
+        /*! \brief Lower bound of enumeration */
+        size_type range_from() const { return from_; }
+
+    private:
+        typedef typename iterator_base::block_descr block_descr_type;
+        
+        /// position current GAP interval (gap_.ptr) at bit nbit
+        void set_gap_interval(unsigned nbit)
+        {
+            block_descr_type* bdescr = &(this->bdescr_);
+            const bm::gap_word_t* first = BMGAP_PTR(this->block_) + 1;
+            unsigned start = (bdescr->gap_.ptr == first) ?
+                                            0 : unsigned(bdescr->gap_.ptr[-1]) + 1;
+            BM_ASSERT(nbit >= start);
+            bdescr->gap_.gap_len = bm::gap_word_t(nbit - start);
+            this->position_ =
+                (size_type(this->block_idx_) << bm::set_block_shift) + nbit;
+        }
+        
+        /// search current block for the last 1 bit at or before nbit
+        bool search_in_block(unsigned nbit)
+        {
+            BM_ASSERT(this->block_);
+            unsigned prev;
+            this->block_type_ = BM_IS_GAP(this->block_);
+            if (this->block_type_)
+            {
+                const bm::gap_word_t* gap_blk = BMGAP_PTR(this->block_);
+                unsigned gidx = bm::gap_find_prev(gap_blk, nbit, &prev);
+                if (!gidx)
+                    return false;
+                this->bdescr_.gap_.ptr = gap_blk + gidx;
+                set_gap_interval(prev);
+                return true;
+            }
+            if (this->block_ == FULL_BLOCK_FAKE_ADDR)
+                this->block_ = FULL_BLOCK_REAL_ADDR;
+            
+            // decode the wave of nbit, skip bits after nbit
+            block_descr_type* bdescr = &(this->bdescr_);
+            unsigned nword = nbit >> bm::set_word_shift;
+            nword -= nword % bm::set_bitscan_wave_size;
+            bdescr->bit_.ptr = this->block_ + nword;
+            bdescr->bit_.cnt = bm::bitscan_wave(bdescr->bit_.ptr, bdescr->bit_.bits);
+            nbit -= nword * 32;
+            unsigned short idx = bdescr->bit_.cnt;
+            for (; idx && bdescr->bit_.bits[idx-1] > nbit; --idx)
+            {}
+            if (!idx)
+                return decode_prev_wave();
+            bdescr->bit_.idx = --idx;
+            bdescr->bit_.pos =
+                (size_type(this->block_idx_) << bm::set_block_shift) + nword * 32;
+            this->position_ = bdescr->bit_.pos + bdescr->bit_.bits[idx];
+            return true;
+        }
+        
+        /// decode previous non-empty wave of the bit block
+        bool decode_prev_wave()
+        {
+            block_descr_type* bdescr = &(this->bdescr_);
+            while (bdescr->bit_.ptr != this->block_)
+            {
+                bdescr->bit_.ptr -= bm::set_bitscan_wave_size;
+                bdescr->bit_.cnt =
+                    bm::bitscan_wave(bdescr->bit_.ptr, bdescr->bit_.bits);
+                if (bdescr->bit_.cnt)
+                {
+                    unsigned short idx = bdescr->bit_.idx =
+                                        (unsigned short)(bdescr->bit_.cnt - 1);
+                    bdescr->bit_.pos =
+                        (size_type(this->block_idx_) << bm::set_block_shift) +
+                        size_type(bdescr->bit_.ptr - this->block_) * 32;
+                    this->position_ = bdescr->bit_.pos + bdescr->bit_.bits[idx];
+                    return true;
+                }
+            } // while
+            return false;
+        }
+        
+        /// search previous blocks (down to the lower bound)
+        bool search_in_blocks()
+        {
+            const block_idx_type nb_from =
+                                block_idx_type(from_ >> bm::set_block_shift);
+            if (this->block_idx_ <= nb_from)
+                return false;
+            block_idx_type nb = this->block_idx_ - 1;
+            unsigned i = unsigned(nb >> bm::set_array_shift);
+            unsigned j = unsigned(nb & bm::set_array_mask);
+            const blocks_manager_type& bman = this->bv_->blockman_;
+            for (;;)
+            {
+                unsigned i_prev = bman.find_prev_nz_top(i);
+                if (i_prev != i) // skip not allocated top blocks
+                {
+                    if (i_prev >= bman.top_block_size())
+                        return false;
+                    i = i_prev; j = bm::set_array_mask;
+                }
+                const bm::word_t* const* blk_blk = bman.get_topblock(i);
+                if (blk_blk)
+                {
+                    for (;; --j)
+                    {
+                        nb = (block_idx_type(i) << bm::set_array_shift) + j;
+                        if (nb < nb_from)
+                            return false;
+                        this->block_ = blk_blk[j];
+                        if (this->block_)
+                        {
+                            this->block_idx_ = nb;
+                            if (search_in_block(bm::gap_max_bits - 1))
+                                return true;
+                        }
+                        if (!j)
+                            break;
+                    } // for j
+                }
+                if (!i ||
+                    (block_idx_type(i) << bm::set_array_shift) <= nb_from)
+                    break;
+                --i; j = bm::set_array_mask;
+            } // for i
+            return false;
+        }
+        
+        void check_range()
+        {
+            if (this->position_ < from_)
+                this->invalidate();
+        }
+        
+    private:
+        size_type  from_; ///< lower bound of enumeration
+    };
+
+    /*!
+        @brief Constant iterator designed to enumerate intervals (runs)
+        of "ON" bits as closed ranges [start, end]
+        
+        GAP blocks are read interval by interval, FULL blocks are skipped
+        whole and bit blocks are scanned for the first word which is not
+        all 1s, so the cost is proportional to the number of intervals
+        rather than the number of bits.
+        
+        @ingroup bvit
+    */
+    class interval_enumerator
+    {
+    public:
+        interval_enumerator()
+            : bv_(0), start_(bm::id_max), end_(bm::id_max)
+        {}
+        
+        /*! @brief Construct enumerator pointing on the interval
+            containing from (cut to start at from) or the next one
+            @param bv   bit-vector pointer
+            @param from position to start from
+        */
+        interval_enumerator(const bvector<Alloc>* bv, size_type from = 0)
+            : bv_(bv), start_(bm::id_max), end_(bm::id_max)
+        {
+            go_to(from);
+        }
+        
+        /// Checks if enumerator points on an interval
+        bool valid() const { return start_ != bm::id_max; }
+        
+        /// First position of the current interval
+        size_type start() const { return start_; }
+        
+        /// Last position of the current interval (closed interval)
+        size_type end() const { return end_; }
+        
+        interval_enumerator& operator++()
+        {
+            advance();
+            return *this;
+        }
+        
+        interval_enumerator operator++(int)
+        {
+            interval_enumerator tmp(*this);
+            advance();
+            return tmp;
+        }
+        
+        /*! \brief Advance to the next interval
+            \return false if no more intervals (enumerator becomes invalid)
+        */
+        bool advance()
+        {
+            BM_ASSERT(valid());
+            if (end_ >= bm::id_max - 1)
+            {
+                invalidate();
+                return false;
+            }
+            return go_to(end_ + 1);
+        }
+        
+        /*! \brief Go to the interval containing pos (cut to start at pos)
+            or the next available interval
+            \return false if not found (enumerator becomes invalid)
+        */
+        bool go_to(size_type pos)
+        {
+            if (!bv_ || pos >= bm::id_max || !bv_->find(pos, start_))
+            {
+                invalidate();
+                return false;
+            }
+            find_end();
+            return true;
+        }
+        
+    private:
+        void invalidate()
+        {
+            start_ = end_ = bm::id_max;
+        }
+        
+        /// find the end of the interval which starts at start_
+        void find_end()
+        {
+            const blocks_manager_type& bman = bv_->get_blocks_manager();
+            const block_idx_type nb_last =
+                block_idx_type((bm::id_max - 1) >> bm::set_block_shift);
+            block_idx_type nb = block_idx_type(start_ >> bm::set_block_shift);
+            unsigned nbit = unsigned(start_ & bm::set_block_mask);
+            for (;; ++nb, nbit = 0)
+            {
+                const bm::word_t* blk =
+                    bman.get_block(unsigned(nb >> bm::set_array_shift),
+                                   unsigned(nb & bm::set_array_mask));
+                unsigned found = 2;
+                unsigned nbit_end;
+                if (!blk)
+                    found = 0;
+                else
+                if (BM_IS_GAP(blk))
+                    found = bm::gap_find_interval_end(BMGAP_PTR(blk),
+                                                      nbit, &nbit_end);
+                else
+                if (!IS_FULL_BLOCK(blk))
+                    found = bm::bit_block_find_interval_end(blk,
+                                                            nbit, &nbit_end);
+                switch (found)
+                {
+                case 0: // interval ended with the previous block
+                    BM_ASSERT(!nbit && nb);
+                    end_ = (size_type(nb) << bm::set_block_shift) - 1;
+                    return;
+                case 1:
+                    end_ = (size_type(nb) << bm::set_block_shift) + nbit_end;
+                    return;
+                default: // interval continues in the next block
+                    if (nb == nb_last)
+                    {
+                        end_ = bm::id_max - 1;
+                        return;
+                    }
+                } // switch
+            } // for
+        }
+        
+    private:
+        const bvector<Alloc>* bv_;    ///< pointer on parent bitvector
+        size_type             start_; ///< first bit of the interval
+        size_type             end_;   ///< last bit of the interval
+    };
+
+    /*! 
+        Resource guard for bvector<>::set_allocator_pool()
+        @ingroup bvector
+        @internal
+    */
+    class mem_pool_guard
+    {
+    public:
+        mem_pool_guard() : bv_(0)
+        {}
+
+        mem_pool_guard(allocator_pool_type& pool, bvector<Alloc>& bv)
+            : bv_(&bv)
+        {
+            bv.set_allocator_pool(&pool);
+        }
+        ~mem_pool_guard()
+        {
+            if (bv_)
+                bv_->set_allocator_pool(0);
+        }
+
+        void assign_if_not_set(allocator_pool_type& pool, bvector<Alloc>& bv)
+        {
+            if (bv.get_allocator_pool() == 0) // alloc pool not set yet
+            {
+                BM_ASSERT(!bv_);
+                bv_ = &bv;
+                bv.set_allocator_pool(&pool);
+            }
+        }
+
+    private:
+        mem_pool_guard(const mem_pool_guard&) = delete;
+        void operator=(const mem_pool_guard&) = delete;
+    private:
+        bvector<Alloc>* bv_; ///< garded object
+    };
+
+
+    friend class iterator_base;
+    friend class enumerator;
+    friend class reverse_enumerator;
+    template<class BV> friend class aggregator;
+
+public:
+    /*! @brief memory allocation policy
+    
+        Defualt memory allocation policy uses BM_BIT, and standard 
+        GAP levels tune-ups
+    */
+    struct allocation_policy
+    {
+        bm::strategy  strat;
+        const         gap_word_t* glevel_len;
+        
+        allocation_policy(bm::strategy s=BM_BIT,
+                          const gap_word_t* glevels = bm::gap_len_table<true>::_len)
+        : strat(s), glevel_len(glevels)
+        {}
+    };
+    
+    
+    
+    typedef rs_index blocks_count;
+    typedef rs_index rs_index_type;
+public:
+    /*! @name Construction, initialization, assignment */
+    //@{
+    
+    /*!
+        \brief Constructs bvector class
+        \param strat - operation mode strategy, 
+                       BM_BIT - default strategy, bvector use plain bitset 
+                       blocks, (performance oriented strategy).
+                       BM_GAP - memory effitent strategy, bvector allocates 
+                       blocks as array of intervals(gaps) and convert blocks 
+                       into plain bitsets only when enthropy grows.
+        \param glevel_len 
+           - pointer on C-style array keeping GAP block sizes. 
+            bm::gap_len_table<true>::_len - default value set
+            (use bm::gap_len_table_min<true>::_len for very sparse vectors)
+            (use bm::gap_len_table_nl<true>::_len non-linear GAP growth)
+        \param bv_size
+          - bvector size (number of bits addressable by bvector), bm::id_max means 
+          "no limits" (recommended). 
+          bit vector allocates this space dynamically on demand.
+        \param alloc - alllocator for this instance
+         
+        \sa bm::gap_len_table bm::gap_len_table_min set_new_blocks_strat
+    */
+    bvector(strategy          strat      = BM_BIT,
+            const gap_word_t* glevel_len = bm::gap_len_table<true>::_len,
+            size_type         bv_size    = bm::id_max,
+            const Alloc&      alloc      = Alloc()) 
+    : blockman_(glevel_len, bv_size, alloc),
+      new_blocks_strat_(strat),
+      size_(bv_size)
+    {}
+
+    /*!
+        \brief Constructs bvector class
+    */
+    bvector(size_type         bv_size,
+            strategy          strat      = BM_BIT,
+            const gap_word_t* glevel_len = bm::gap_len_table<true>::_len,
+            const Alloc&      alloc      = Alloc()) 
+    : blockman_(glevel_len, bv_size, alloc),
+      new_blocks_strat_(strat),
+      size_(bv_size)
+    {}
+
+    /*!
+        \brief Copy constructor
+
+        Blocks are shared with the source vector (copy-on-write),
+        block gets duplicated on the first modification.
+    */
+    bvector(const bvector<Alloc>& bvect)
+        :  blockman_(bvect.blockman_),
+           new_blocks_strat_(bvect.new_blocks_strat_),
+           size_(bvect.size_)
+    {}
+    
+    /*!
+        \brief Copy constructor for range copy [left..right]
+     
+        \sa copy_range
+    */
+    bvector(const bvector<Alloc>& bvect, size_type left, size_type right)
+        : blockman_(bvect.blockman_.glevel_len_, bvect.blockman_.max_bits_, bvect.blockman_.alloc_),
+          new_blocks_strat_(bvect.new_blocks_strat_),
+          size_(bvect.size_)
+    {
+        if (!bvect.blockman_.is_init())
+            return;
+        if (left > right)
+            bm::xor_swap(left, right);
+        copy_range_no_check(bvect, left, right);
+    }
+
+    
+    ~bvector() BMNOEXEPT
+    {}
+    /*!
+        \brief Explicit post-construction initialization
+    */
+    void init();
+
+    /*! 
+        \brief Copy assignment operator (copy-on-write, see copy constructor)
+    */
+    bvector& operator=(const bvector<Alloc>& bvect)
+    {
+        if (this != &bvect)
+        {
+            blockman_.deinit_tree();
+            blockman_.share(bvect.blockman_);
+            resize(bvect.size());
+        }
+        return *this;
+    }
+
+#ifndef BM_NO_CXX11
+    /*!
+        \brief Move constructor
+    */
+    bvector(bvector<Alloc>&& bvect) BMNOEXEPT
+    {
+        blockman_.move_from(bvect.blockman_);
+        size_ = bvect.size_;
+        new_blocks_strat_ = bvect.new_blocks_strat_;
+    }
+
+
+    /*!
+        \brief Brace constructor
+    */
+    bvector(std::initializer_list<size_type> il) 
+        : blockman_(bm::gap_len_table<true>::_len, bm::id_max, Alloc()),
+          new_blocks_strat_(BM_BIT),
+          size_(bm::id_max)
+    {
+        init();
+        std::initializer_list<size_type>::const_iterator it_start = il.begin();
+        std::initializer_list<size_type>::const_iterator it_end = il.end();
+        for (; it_start < it_end; ++it_start)
+        {
+            this->set_bit_no_check(*it_start);
+        }
+    }
+    
+    /*! 
         \brief Move assignment operator
     */
     bvector& operator=(bvector<Alloc>&& bvect) BMNOEXEPT
@@ -1257,18 +1886,18 @@ public:
     //@}
 
 
-    reference operator[](bm::id_t n)
+    reference operator[](size_type n)
     {
         if (n >= size_)
         {
-            bm::id_t new_size = (n == bm::id_max) ? bm::id_max : n + 1;
+            size_type new_size = (n == bm::id_max) ? bm::id_max : n + 1;
             resize(new_size);
         }
         return reference(*this, n);
     }
 
 
-    bool operator[](bm::id_t n) const
+    bool operator[](size_type n) const
     {
         BM_ASSERT(n < size_);
         return get_bit(n);
@@ -1359,7 +1988,7 @@ public:
        \param val - new bit value
        \return  TRUE if bit was changed
     */
-    bool set_bit(bm::id_t n, bool val = true)
+    bool set_bit(size_type n, bool val = true)
     {
         BM_ASSERT_THROW(n < bm::id_max, BM_ERR_RANGE);
 
@@ -1367,20 +1996,37 @@ public:
             blockman_.init_tree();
         if (n >= size_)
         {
-            bm::id_t new_size = (n == bm::id_max) ? bm::id_max : n + 1;
+            size_type new_size = (n == bm::id_max) ? bm::id_max : n + 1;
             resize(new_size);
         }
         
         return set_bit_no_check(n, val);
     }
 
+    /*!
+       \brief Sets bit n and keeps rank-select index in sync.
+       \param n - index of the bit to be set. 
+       \param val - new bit value
+       \param rs_idx - rank-select index (see running_count_blocks)
+       \return  TRUE if bit was changed
+    */
+    bool set_bit(size_type n, bool val, rs_index_type& rs_idx)
+    {
+        bool changed = set_bit(n, val);
+        block_idx_type nb = block_idx_type(n >> bm::set_block_shift);
+        if (changed && nb < bm::set_total_blocks32)
+            rs_idx.update_bit(unsigned(nb), unsigned(n & bm::set_block_mask),
+                              val);
+        return changed;
+    }
+
     /*!
        \brief Sets bit n using bit AND with the provided value.
        \param n - index of the bit to be set. 
        \param val - new bit value
        \return  TRUE if bit was changed
     */
-    bool set_bit_and(bm::id_t n, bool val = true)
+    bool set_bit_and(size_type n, bool val = true)
     {
         BM_ASSERT(n < size_);
         BM_ASSERT_THROW(n < size_, BM_ERR_RANGE);
@@ -1402,7 +2048,7 @@ public:
        \param n - index of the bit to be set
        \return  TRUE if carry over created (1+1)
     */
-    bool inc(bm::id_t n);
+    bool inc(size_type n);
     
 
     /*!
@@ -1412,14 +2058,14 @@ public:
        \param condition - expected current value
        \return TRUE if bit was changed
     */
-    bool set_bit_conditional(bm::id_t n, bool val, bool condition)
+    bool set_bit_conditional(size_type n, bool val, bool condition)
     {
         if (val == condition) return false;
         if (!blockman_.is_init())
             blockman_.init_tree();
         if (n >= size_)
         {
-            bm::id_t new_size = (n == bm::id_max) ? bm::id_max : n + 1;
+            size_type new_size = (n == bm::id_max) ? bm::id_max : n + 1;
             resize(new_size);
         }
 
@@ -1433,12 +2079,26 @@ public:
         \param val - new bit value
         \return *this
     */
-    bvector<Alloc>& set(bm::id_t n, bool val = true)
+    bvector<Alloc>& set(size_type n, bool val = true)
     {
         set_bit(n, val);
         return *this;
     }
 
+    /*!
+        \brief Set list of bits in a bit-vector (bulk import)
+     
+        Indexes are partitioned by blocks, every block is built in one pass.
+        New blocks of sorted input are created as GAP or bit blocks
+        depending on the number of runs.
+     
+        \param ids - array of bit indexes to set
+        \param ids_size - size of the array
+        \param so - sort order of ids (BM_SORTED input imports fastest)
+    */
+    void set(const size_type* ids, size_type ids_size,
+             bm::sort_order so = bm::BM_UNKNOWN);
+
     /*!
        \brief Sets every bit in this bitset to 1.
        \return *this
@@ -1458,7 +2118,7 @@ public:
      
         \param n - bit number
     */
-    void set_bit_no_check(bm::id_t n);
+    void set_bit_no_check(size_type n);
 
 
     /*!
@@ -1472,10 +2132,28 @@ public:
         
         \return *this
     */
-    bvector<Alloc>& set_range(bm::id_t left,
-                              bm::id_t right,
+    bvector<Alloc>& set_range(size_type left,
+                              size_type right,
                               bool     value = true);
     
+    /*!
+        \brief Set bits of closed intervals [starts[i], ends[i]]
+        (bulk import)
+        
+        Sorted non-overlapping intervals are imported block by block:
+        blocks covered whole become FULL, all intervals of a partial block
+        are merged in as one GAP block, so the cost is proportional to
+        the number of intervals. Unsorted or overlapping input falls back
+        to set_range(). Vector is resized to fit the intervals.
+        
+        \param starts - interval start positions
+        \param ends   - interval end positions (closed intervals)
+        \param size   - number of intervals
+    */
+    void import_intervals(const size_type* starts,
+                          const size_type* ends,
+                          size_type        size);
+    
     /*!
         \brief Copy all bits in the specified closed interval [left,right]
 
@@ -1484,21 +2162,63 @@ public:
         \param right - interval end (closed interval)
     */
     void copy_range(const bvector<Alloc>& bvect,
-                    bm::id_t left,
-                    bm::id_t right);
+                    size_type left,
+                    size_type right);
+
+    /*!
+        \brief Insert bit into specified position
+        All the vector content after insert position is shifted right by 1 bit.
+        Vector size grows by 1 (if not at max already).
+
+        \param n - index of the bit to insert
+        \param value - insert value
+
+        \return Carry over bit value (bit shifted out of the addressable range)
+    */
+    bool insert(size_type n, bool value);
+
+    /*!
+        \brief Erase bit in the specified position
+        All the vector content after erase position is shifted left by 1 bit.
+        Vector size does not change.
+
+        \param n - index of the bit to erase
+    */
+    void erase(size_type n);
+
+    /*!
+        \brief Shift right by 1 bit, fill with zero (bit 0 gets 0)
+        \return Carry over bit value
+    */
+    bool shift_right() { return insert(0, false); }
+
+    /*!
+        \brief Shift left by 1 bit, fill with zero (last bit gets 0)
+        \return Carry over bit value (former bit 0)
+    */
+    bool shift_left();
 
     /*!
        \brief Clears bit n.
        \param n - bit's index to be cleaned.
        \return true if bit was cleared
     */
-    bool clear_bit(bm::id_t n) { return set_bit(n, false); }
+    bool clear_bit(size_type n) { return set_bit(n, false); }
+
+    /*!
+       \brief Clears bit n and keeps rank-select index in sync.
+       \param n - bit's index to be cleaned.
+       \param rs_idx - rank-select index (see running_count_blocks)
+       \return true if bit was cleared
+    */
+    bool clear_bit(size_type n, rs_index_type& rs_idx)
+        { return set_bit(n, false, rs_idx); }
     
     /*!
        \brief Clears bit n without precondiion checks
        \param n - bit's index to be cleaned.
     */
-    void clear_bit_no_check(bm::id_t n) { set_bit_no_check(n, false); }
+    void clear_bit_no_check(size_type n) { set_bit_no_check(n, false); }
 
     
     
@@ -1527,7 +2247,7 @@ public:
        \brief Flips bit n
        \return *this
     */
-    bvector<Alloc>& flip(bm::id_t n)
+    bvector<Alloc>& flip(size_type n)
     {
         //set(n, !get_bit(n));
         this->inc(n);
@@ -1590,7 +2310,7 @@ public:
        \brief population cout (count of ON bits)
        \return Total number of bits ON.
     */
-    bm::id_t count() const;
+    size_type count() const;
 
     /*! \brief Computes bitcount values for all bvector blocks
         \param arr - pointer on array of block bit counts
@@ -1598,9 +2318,9 @@ public:
         This number +1 gives you number of arr elements initialized during the
         function call.
     */
-    unsigned count_blocks(unsigned* arr) const
+    block_idx_type count_blocks(unsigned* arr) const
     {
-        bm::word_t*** blk_root = blockman_.top_blocks_root();
+        typename blocks_manager_type::top_root_type blk_root = blockman_.top_blocks_root();
         if (blk_root == 0)
             return 0;
         typename blocks_manager_type::block_count_arr_func func(blockman_, &(arr[0]));
@@ -1618,30 +2338,46 @@ public:
               wide range searches
        \return population count in the diapason
     */
-    bm::id_t count_range(bm::id_t left, 
-                         bm::id_t right, 
-                         const unsigned* block_count_arr=0) const;
+    size_type count_range(size_type left, 
+                          size_type right, 
+                          const unsigned* block_count_arr=0) const;
     
     /*! \brief compute running total of all blocks in bit vector
-        \param blocks_cnt - out pointer to counting structure, holding the array
-        Function will fill full array of running totals
-        \sa count_to, select, find_rank
+        \param blocks_cnt - out pointer to counting structure
+        Index is sized to the populated part of the vector and covers
+        the 32-bit address range (see bm::rs_index)
+        \sa count_to, select, find_rank, update_rs_index
     */
     void running_count_blocks(rs_index_type* blocks_cnt) const;
     
+    /*! \brief Re-compute rank-select index for blocks in [left..right]
+        
+        Incremental alternative to running_count_blocks() after bulk
+        modifications (set_range(), logical operations, etc.)
+        of a part of the vector.
+     
+        \param rs_idx - rank-select index to update
+        \param left - index of the first modified bit
+        \param right - index of the last modified bit
+        \sa running_count_blocks, set_bit
+    */
+    void update_rs_index(rs_index_type& rs_idx,
+                         size_type left, size_type right) const;
+    
     /*!
        \brief Returns count of 1 bits (population) in [0..right] range.
      
        This operation is also known as rank of bit N.
      
-       \param n - index of bit to rank
+       \param n - index of bit to rank (must be less than bm::id_max32,
+                  the range covered by the index)
        \param blocks_cnt - block count structure to accelerate search
                            should be prepared using running_count_blocks
        \return population count in the range
        \sa running_count_blocks
        \sa count_to_test
     */
-    bm::id_t count_to(bm::id_t n, const rs_index_type&  blocks_cnt) const;
+    size_type count_to(size_type n, const rs_index_type&  blocks_cnt) const;
 
     /*!
         \brief Returns count of 1 bits (population) in [0..right] range if test(right) == true
@@ -1658,12 +2394,12 @@ public:
         \sa running_count_blocks
         \sa count_to
     */
-    bm::id_t count_to_test(bm::id_t n, const rs_index_type&  blocks_cnt) const;
+    size_type count_to_test(size_type n, const rs_index_type&  blocks_cnt) const;
 
 
     /*! Recalculate bitcount (deprecated)
     */
-    bm::id_t recalc_count()
+    size_type recalc_count()
     {
         return count();
     }
@@ -1685,17 +2421,50 @@ public:
        \param n - Index of the bit to check.
        \return Bit value (1 or 0)
     */
-    bool get_bit(bm::id_t n) const;
+    bool get_bit(size_type n) const;
 
     /*!
        \brief returns true if bit n is set and false is bit n is 0. 
        \param n - Index of the bit to check.
        \return Bit value (1 or 0)
     */
-    bool test(bm::id_t n) const 
+    bool test(size_type n) const 
     { 
         return get_bit(n); 
     }
+
+    /*!
+       \brief Test list of bits (batch membership test)
+     
+       Indexes are partitioned by blocks, every block is resolved once
+       and tested for all its indexes.
+       Indexes outside of the vector size are reported as 0.
+     
+       \param ids - array of bit indexes to test
+       \param ids_size - size of the array
+       \param out - output flags (ids_size), out[i] = 1 if bit ids[i] is set
+       \param so - sort order of ids (BM_SORTED input is tested fastest)
+       \return number of set bits found
+    */
+    size_type test_many(const size_type* ids, size_type ids_size,
+                        unsigned char* out,
+                        bm::sort_order so = bm::BM_UNKNOWN) const;
+
+    /*!
+       \brief Select subset of indexes which are set in the bit-vector
+     
+       \param ids - array of bit indexes to test
+       \param ids_size - size of the array
+       \param subset - output array (ids_size capacity) for indexes
+                        which are set (in the input order)
+       \param so - sort order of ids (BM_SORTED input is tested fastest)
+       \return size of the subset
+     
+       @sa test_many
+    */
+    size_type test_subset(const size_type* ids, size_type ids_size,
+                          size_type* subset,
+                          bm::sort_order so = bm::BM_UNKNOWN) const;
     //@}
 
     // --------------------------------------------------------------------
@@ -1708,7 +2477,7 @@ public:
     */
     bool any() const
     {
-        word_t*** blk_root = blockman_.top_blocks_root();
+        typename blocks_manager_type::top_root_type blk_root = blockman_.top_blocks_root();
         if (!blk_root) 
             return false;
         typename blocks_manager_type::block_any_func func(blockman_);
@@ -1730,26 +2499,26 @@ public:
     //@{
     
     /*!
-       \fn bool bvector::find(bm::id_t& pos) const
+       \fn bool bvector::find(size_type& pos) const
        \brief Finds index of first 1 bit
        \param pos - index of the found 1 bit
        \return true if search returned result
        \sa get_first, get_next, extract_next, find_reverse
     */
-    bool find(bm::id_t& pos) const;
+    bool find(size_type& pos) const;
 
     /*!
-       \fn bool bvector::find(bm::id_t from, bm::id_t& pos) const
+       \fn bool bvector::find(size_type from, size_type& pos) const
        \brief Finds index of 1 bit starting from position
        \param from - position to start search from
        \param pos - index of the found 1 bit
        \return true if search returned result
        \sa get_first, get_next, extract_next, find_reverse
     */
-    bool find(bm::id_t from, bm::id_t& pos) const;
+    bool find(size_type from, size_type& pos) const;
 
     /*!
-       \fn bm::id_t bvector::get_first() const
+       \fn size_type bvector::get_first() const
        \brief find first 1 bit in vector. 
        Function may return 0 and this requires an extra check if bit 0 is 
        actually set or bit-vector is empty
@@ -1757,28 +2526,28 @@ public:
        \return Index of the first 1 bit, may return 0
        \sa get_next, find, extract_next, find_reverse
     */
-    bm::id_t get_first() const { return check_or_next(0); }
+    size_type get_first() const { return check_or_next(0); }
 
     /*!
-       \fn bm::id_t bvector::get_next(bm::id_t prev) const
+       \fn size_type bvector::get_next(size_type prev) const
        \brief Finds the number of the next bit ON.
        \param prev - Index of the previously found bit. 
        \return Index of the next bit which is ON or 0 if not found.
        \sa get_first, find, extract_next, find_reverse
     */
-    bm::id_t get_next(bm::id_t prev) const
+    size_type get_next(size_type prev) const
     {
         return (++prev == bm::id_max) ? 0 : check_or_next(prev);
     }
 
     /*!
-       \fn bm::id_t bvector::extract_next(bm::id_t prev)
+       \fn size_type bvector::extract_next(size_type prev)
        \brief Finds the number of the next bit ON and sets it to 0.
        \param prev - Index of the previously found bit. 
        \return Index of the next bit which is ON or 0 if not found.
        \sa get_first, get_next, find_reverse
     */
-    bm::id_t extract_next(bm::id_t prev)
+    size_type extract_next(size_type prev)
     {
         return (++prev == bm::id_max) ? 0 : check_or_next_extract(prev);
     }
@@ -1789,7 +2558,7 @@ public:
        \return true if search returned result
        \sa get_first, get_next, extract_next, find
     */
-    bool find_reverse(bm::id_t& pos) const;
+    bool find_reverse(size_type& pos) const;
     
     /*!
        \brief Finds dynamic range of bit-vector [first, last]
@@ -1798,7 +2567,7 @@ public:
        \return true if search returned result
        \sa get_first, get_next, extract_next, find, find_reverse
     */
-    bool find_range(bm::id_t& first, bm::id_t& last) const;
+    bool find_range(size_type& first, size_type& last) const;
     
     /*!
         \brief Find bit-vector position for the specified rank(bitcount)
@@ -1813,7 +2582,7 @@ public:
      
         \return true if requested rank was found
     */
-    bool find_rank(bm::id_t rank, bm::id_t from, bm::id_t& pos) const;
+    bool find_rank(size_type rank, size_type from, size_type& pos) const;
 
 
     /*!
@@ -1825,6 +2594,7 @@ public:
      
         \param rank - rank to find (bitcount)
         \param from - start positioon for rank search
+                      (must be less than bm::id_max32)
         \param pos  - position with speciefied rank (relative to from position)
         \param blocks_cnt - block count structure to accelerate rank search
                             should be prepared using running_count_blocks
@@ -1833,7 +2603,7 @@ public:
 
         \return true if requested rank was found
     */
-    bool find_rank(bm::id_t rank, bm::id_t from, bm::id_t& pos,
+    bool find_rank(size_type rank, size_type from, size_type& pos,
                    const rs_index_type&  blocks_cnt) const;
     
     
@@ -1851,9 +2621,27 @@ public:
 
         \sa running_count_blocks, find_rank
 
-        \return true if requested rank was found
+        \return true if requested rank was found in the range covered
+                by the index (32-bit address range)
+    */
+    bool select(size_type rank, size_type& pos, const rs_index_type&  blocks_cnt) const;
+
+    /*!
+        \brief Decode (export) indexes of 1 bits into an array
+     
+        Decodes the vector block by block (bit blocks with SIMD
+        bit-to-index kernels, GAP blocks run by run).
+        To stream the vector in fixed size buffers call it again
+        with from = ids[n-1] + 1 while the buffer comes back full.
+     
+        \param ids - output array
+        \param ids_capacity - size of the output array
+        \param from - position to start decoding from
+        \return number of indexes written (less than ids_capacity
+                 means there are no more 1 bits)
     */
-    bool select(bm::id_t rank, bm::id_t& pos, const rs_index_type&  blocks_cnt) const;
+    size_type decode(size_type* ids, size_type ids_capacity,
+                     size_type from = 0) const;
 
     //@}
 
@@ -1886,22 +2674,65 @@ public:
        \brief Logical XOR operation.
        \param vect - argument vector.
     */
-    bm::bvector<Alloc>& bit_xor(const bm::bvector<Alloc>& vect)
+    bm::bvector<Alloc>& bit_xor(const bm::bvector<Alloc>& vect)
+    {
+        combine_operation(vect, BM_XOR);
+        return *this;
+    }
+
+    /*!
+       \brief Logical SUB operation.
+       \param vect - Argument vector.
+    */
+    bm::bvector<Alloc>& bit_sub(const bm::bvector<Alloc>& bv)
+    {
+        combine_operation_sub(bv);
+        return *this;
+    }
+    
+    /*!
+       \brief Logical OR operation restricted to a closed range [left, right].
+       Only blocks intersecting the range are processed,
+       bits outside the range stay unchanged.
+       \param bv - argument vector
+       \param left - range start
+       \param right - range end
+    */
+    bm::bvector<Alloc>& bit_or(const bm::bvector<Alloc>& bv,
+                               size_type left, size_type right)
+    {
+        combine_operation_range(bv, left, right, BM_OR);
+        return *this;
+    }
+
+    /*!
+       \brief Logical AND operation restricted to a closed range [left, right].
+       Bits outside the range stay unchanged.
+       \param bv - argument vector
+       \param left - range start
+       \param right - range end
+    */
+    bm::bvector<Alloc>& bit_and(const bm::bvector<Alloc>& bv,
+                                size_type left, size_type right)
     {
-        combine_operation(vect, BM_XOR);
+        combine_operation_range(bv, left, right, BM_AND);
         return *this;
     }
 
     /*!
-       \brief Logical SUB operation.
-       \param vect - Argument vector.
+       \brief Logical SUB operation restricted to a closed range [left, right].
+       Bits outside the range stay unchanged.
+       \param bv - argument vector
+       \param left - range start
+       \param right - range end
     */
-    bm::bvector<Alloc>& bit_sub(const bm::bvector<Alloc>& bv)
+    bm::bvector<Alloc>& bit_sub(const bm::bvector<Alloc>& bv,
+                                size_type left, size_type right)
     {
-        combine_operation_sub(bv);
+        combine_operation_range(bv, left, right, BM_SUB);
         return *this;
     }
-    
+
     /*!
         \brief Inverts all bits.
     */
@@ -1924,6 +2755,45 @@ public:
     */
     void combine_operation_sub(const bm::bvector<Alloc>& bvect);
 
+    /*!
+        \brief Prepare vector for OR, AND, SUB operation on ranges of
+        top level blocks (adjust size, reserve the blocks tree).
+        Preparation is single threaded, combine_operation_xxx_top_range()
+        then can be called for disjoint ranges in parallel.
+
+        \param bvect - argument vector
+        \param opcode - operation code (BM_OR, BM_AND or BM_SUB)
+        \return number of top level blocks to process (0 - nothing to do)
+        \sa bm::parallel
+    */
+    unsigned combine_operation_prepare(const bm::bvector<Alloc>& bvect,
+                                       bm::operation opcode);
+
+    /*! \brief OR on the top level blocks range [top_from, top_to)
+        \sa combine_operation_prepare
+    */
+    void combine_operation_or_top_range(const bm::bvector<Alloc>& bvect,
+                                        unsigned top_from, unsigned top_to);
+
+    /*! \brief AND on the top level blocks range [top_from, top_to)
+        \sa combine_operation_prepare
+    */
+    void combine_operation_and_top_range(const bm::bvector<Alloc>& bvect,
+                                         unsigned top_from, unsigned top_to);
+
+    /*! \brief SUB on the top level blocks range [top_from, top_to)
+        \sa combine_operation_prepare
+    */
+    void combine_operation_sub_top_range(const bm::bvector<Alloc>& bvect,
+                                         unsigned top_from, unsigned top_to);
+
+    /*! \brief perform OR, AND or SUB on a closed range of bits [left, right]
+        (bits outside the range are not changed)
+    */
+    void combine_operation_range(const bm::bvector<Alloc>& bvect,
+                                 size_type left, size_type right,
+                                 bm::operation opcode);
+
     // @}
 
     // --------------------------------------------------------------------
@@ -1948,11 +2818,46 @@ public:
     /**
        \brief Returns enumerator pointing on specified or the next available bit.
     */
-    enumerator get_enumerator(bm::id_t pos) const
+    enumerator get_enumerator(size_type pos) const
     {
         typedef typename bvector<Alloc>::enumerator enumerator_type;
         return enumerator_type(this, pos);
     }
+
+    /**
+       \brief Returns enumerator over 1 bits of a closed range [from, to].
+    */
+    range_enumerator get_range_enumerator(size_type from, size_type to) const
+    {
+        return range_enumerator(this, from, to);
+    }
+    
+    /**
+       \brief Returns enumerator of 1-intervals (runs) starting from
+       the specified position.
+    */
+    interval_enumerator get_interval_enumerator(size_type from = 0) const
+    {
+        return interval_enumerator(this, from);
+    }
+    
+    /**
+       \brief Returns reverse enumerator pointing on the last non-zero bit.
+    */
+    reverse_enumerator last() const
+    {
+        return reverse_enumerator(this, bm::id_max - 1);
+    }
+    
+    /**
+       \brief Returns reverse enumerator pointing on specified or
+       the previous available bit (bounded from below by from).
+    */
+    reverse_enumerator get_reverse_enumerator(size_type pos,
+                                              size_type from = 0) const
+    {
+        return reverse_enumerator(this, pos, from);
+    }
     
     //@}
 
@@ -2016,6 +2921,8 @@ public:
        logical operations.
 
        Optionally function can calculate vector post optimization statistics
+
+       Frozen vector (see freeze()) is left as is.
        
        @sa optmode, optimize_gap_size
     */
@@ -2040,6 +2947,34 @@ public:
         @param glevel_len - pointer on C-style array keeping GAP block sizes. 
     */
     void set_gap_levels(const gap_word_t* glevel_len);
+
+    /*!
+        @brief Pack all blocks into one contiguous memory arena
+
+        Frozen (read-mostly) layout improves memory locality of
+        const operations (count, test, enumerator, aggregator, etc.)
+        and releases the whole vector with one deallocation.
+        Vector stays modifiable: modification copies the affected group of
+        blocks out of the arena. Call optimize() first to freeze
+        compressed blocks.
+
+        @sa is_frozen
+    */
+    void freeze() { blockman_.freeze(); }
+
+    /*!
+        @brief Returns true if vector blocks are placed in a frozen arena
+        @sa freeze
+    */
+    bool is_frozen() const { return blockman_.is_frozen(); }
+
+    /*!
+        @brief Modification epoch of the vector
+        Value changes every time the vector gets (potentially) modified,
+        pair of vector address and epoch identifies the vector content
+        (used to validate cached results, see bm::aggregator_cache).
+    */
+    bm::id64_t epoch() const { return blockman_.epoch(); }
     
     //@}
     
@@ -2108,7 +3043,7 @@ public:
      
         \internal
     */
-    const bm::word_t* get_block(unsigned nb) const
+    const bm::word_t* get_block(block_idx_type nb) const
     {
         return blockman_.get_block(nb);
     }
@@ -2116,11 +3051,12 @@ public:
     /*!
     @internal
     */
-    void combine_operation_with_block(unsigned nb,
+    void combine_operation_with_block(block_idx_type nb,
                                       const bm::word_t* arg_blk,
                                       bool arg_gap,
                                       bm::operation opcode)
     {
+        blockman_.unshare_block(nb);
         bm::word_t* blk = const_cast<bm::word_t*>(get_block(nb));
         bool gap = BM_IS_GAP(blk);
         combine_operation_with_block(nb, gap, blk, arg_blk, arg_gap, opcode);
@@ -2143,31 +3079,31 @@ public:
     
 private:
 
-    bm::id_t check_or_next(bm::id_t prev) const;
+    size_type check_or_next(size_type prev) const;
     
     /// set bit in GAP block withlength extension control
     bool gap_block_set(bm::gap_word_t* gap_blk,
-                       bool val, unsigned nblock, unsigned nbit);
+                       bool val, block_idx_type nblock, unsigned nbit);
     
     /// check if specified bit is 1, and set it to 0
     /// if specified bit is 0, scan for the next 1 and returns it
     /// if no 1 found returns 0
-    bm::id_t check_or_next_extract(bm::id_t prev);
+    size_type check_or_next_extract(size_type prev);
 
     /**
         \brief Set specified bit without checking preconditions (size, etc)
     */
-    bool set_bit_no_check(bm::id_t n, bool val);
+    bool set_bit_no_check(size_type n, bool val);
 
     /**
         \brief AND specified bit without checking preconditions (size, etc)
     */
-    bool and_bit_no_check(bm::id_t n, bool val);
+    bool and_bit_no_check(size_type n, bool val);
 
-    bool set_bit_conditional_impl(bm::id_t n, bool val, bool condition);
+    bool set_bit_conditional_impl(size_type n, bool val, bool condition);
 
 
-    void combine_operation_with_block(unsigned nb,
+    void combine_operation_with_block(block_idx_type nb,
                                       bool gap,
                                       bm::word_t* blk,
                                       const bm::word_t* arg_blk,
@@ -2188,7 +3124,7 @@ private:
                                      bm::word_t* blk,
                                      const bm::word_t* arg_blk);
 
-    void assign_gap_result(unsigned              nb,
+    void assign_gap_result(block_idx_type        nb,
                            const bm::gap_word_t* res,
                            unsigned              res_len,
                            bm::word_t*           blk,
@@ -2202,8 +3138,11 @@ private:
                            gap_word_t*           tmp_buf);
     
     void copy_range_no_check(const bvector<Alloc>& bvect,
-                             bm::id_t left,
-                             bm::id_t right);
+                             size_type left,
+                             size_type right);
+
+    /// test the first bit of the block (carry over source for erase/shift)
+    bool test_first_block_bit(block_idx_type nb) const;
 
 private:
     /**
@@ -2211,7 +3150,7 @@ private:
        \param nb - Block's linear index.
        \param blk - Blocks's pointer 
     */
-    void extend_gap_block(unsigned nb, gap_word_t* blk)
+    void extend_gap_block(block_idx_type nb, gap_word_t* blk)
     {
         blockman_.extend_gap_block(nb, blk);
     }
@@ -2219,20 +3158,49 @@ private:
     /**
        \brief Set range without validity/bouds checking
     */
-    void set_range_no_check(bm::id_t left,
-                            bm::id_t right);
+    void set_range_no_check(size_type left,
+                            size_type right);
     /**
         \brief Clear range without validity/bouds checking
     */
-    void clear_range_no_check(bm::id_t left,
-                              bm::id_t right);
+    void clear_range_no_check(size_type left,
+                              size_type right);
     
+    /**
+        Set bits from array of indexes (sorted_idx is BM_SORTED or BM_UNSORTED)
+    */
+    void import(const size_type* ids, size_type ids_size,
+                bm::sort_order sorted_idx);
+    
+    /**
+        Set bits of one block from ids[start..stop)
+    */
+    void import_block(const size_type* ids,
+                      block_idx_type nblock,
+                      size_type start, size_type stop,
+                      bm::sort_order sorted_idx);
+
+    /**
+        Test bits of one block for sorted ids[start..stop)
+    */
+    size_type test_block_many(const size_type* ids,
+                              block_idx_type nblock,
+                              size_type start, size_type stop,
+                              unsigned char* out) const;
+
+    /**
+        Compute bit-count and rank-select sub-counts of a block
+    */
+    void block_rs_counts(const bm::word_t* block,
+                         unsigned& cnt,
+                         typename rs_index_type::sb_pair_type& sc) const;
+
     /**
         Compute rank in block using rank-select index
     */
     static
     unsigned block_count_to(const bm::word_t* block,
-                            unsigned nb,
+                            block_idx_type nb,
                             unsigned nbit_right,
                             const rs_index_type&  blocks_cnt);
 
@@ -2334,8 +3302,8 @@ void bvector<Alloc>::move_from(bvector<Alloc>& bvect) BMNOEXEPT
 // -----------------------------------------------------------------------
 
 template<typename Alloc> 
-bvector<Alloc>& bvector<Alloc>::set_range(bm::id_t left,
-                                          bm::id_t right,
+bvector<Alloc>& bvector<Alloc>::set_range(size_type left,
+                                          size_type right,
                                           bool     value)
 {
     if (!blockman_.is_init())
@@ -2353,7 +3321,7 @@ bvector<Alloc>& bvector<Alloc>::set_range(bm::id_t left,
     BM_ASSERT_THROW(right < bm::id_max, BM_ERR_RANGE);
     if (right >= size_) // this vect shorter than the arg.
     {
-        bm::id_t new_size = (right == bm::id_max) ? bm::id_max : right + 1;
+        size_type new_size = (right == bm::id_max) ? bm::id_max : right + 1;
         resize(new_size);
     }
 
@@ -2371,12 +3339,12 @@ bvector<Alloc>& bvector<Alloc>::set_range(bm::id_t left,
 // -----------------------------------------------------------------------
 
 template<typename Alloc> 
-bm::id_t bvector<Alloc>::count() const
+typename bvector<Alloc>::size_type bvector<Alloc>::count() const
 {
     if (!blockman_.is_init())
         return 0;
     
-    word_t*** blk_root = blockman_.top_blocks_root();
+    typename blocks_manager_type::top_root_type blk_root = blockman_.top_blocks_root();
     if (!blk_root) 
     {
         return 0;
@@ -2420,61 +3388,103 @@ void bvector<Alloc>::running_count_blocks(rs_index_type* blocks_cnt) const
     if (!blockman_.is_init())
         return;
     
-    unsigned nb  = 0;
-    unsigned cnt = 0;
+    // index covers super-blocks up to the last non-empty one
+    const unsigned sb_max = bm::set_total_blocks32 >> bm::set_array_shift;
+    unsigned sb_size = blockman_.top_block_size();
+    if (sb_size > sb_max)
+        sb_size = sb_max;
+    for (; sb_size; --sb_size)
+    {
+        if (!blockman_.is_subblock_null(sb_size - 1))
+            break;
+    }
+    blocks_cnt->resize(sb_size);
 
-    for (; nb < bm::set_total_blocks; ++nb)
+    for (unsigned i = 0; i < sb_size; ++i)
     {
-        int no_more_blocks;
-        const bm::word_t* block = blockman_.get_block(nb, &no_more_blocks);
-        if (block)
-        {
-            cnt = blockman_.block_bitcount(block);
-            blocks_cnt->bcount[nb] = cnt;
-            
-            if (BM_IS_GAP(block))
-            {
-                const bm::gap_word_t* const gap_block = BMGAP_PTR(block);
-                blocks_cnt->subcount[nb].first = (bm::gap_word_t)
-                    bm::gap_bit_count_range(gap_block, 0, bm::rs3_border0);
-                blocks_cnt->subcount[nb].second = (bm::gap_word_t)
-                    bm::gap_bit_count_range(gap_block,
-                                            bm::gap_word_t(bm::rs3_border0+1),
-                                            bm::rs3_border1);
-            }
-            else
-            {
-                blocks_cnt->subcount[nb].first = (bm::gap_word_t)
-                    bm::bit_block_calc_count_range(block, 0, bm::rs3_border0);
-                blocks_cnt->subcount[nb].second = (bm::gap_word_t)
-                    bm::bit_block_calc_count_range(block,
-                                                   bm::rs3_border0+1,
-                                                   bm::rs3_border1);
-            }
-        }
-        if (no_more_blocks)
+        if (blockman_.is_subblock_null(i))
+            continue;
+        rs_index_type::sb_counts* sb = blocks_cnt->get_sb(i);
+        for (unsigned j = 0; j < bm::set_array_size; ++j)
         {
-            blocks_cnt->total_blocks = nb;
-            break;
-        }
-
-    } // for nb
+            const bm::word_t* block = blockman_.get_block(i, j);
+            if (block)
+                block_rs_counts(block, sb->bcount[j], sb->subcount[j]);
+        } // for j
+    } // for i
     
     // compute running count
-    for (unsigned i = 1; i < bm::set_total_blocks; ++i)
+    blocks_cnt->build_running_counts();
+}
+
+// -----------------------------------------------------------------------
+
+template<typename Alloc>
+void bvector<Alloc>::update_rs_index(rs_index_type& rs_idx,
+                                     size_type left, size_type right) const
+{
+    BM_ASSERT(left <= right);
+    
+    block_idx_type nb = block_idx_type(left >> bm::set_block_shift);
+    block_idx_type nb_to = block_idx_type(right >> bm::set_block_shift);
+    if (nb_to >= bm::set_total_blocks32)
+        nb_to = bm::set_total_blocks32 - 1;
+    
+    for (; nb <= nb_to; ++nb)
+    {
+        unsigned cnt = 0;
+        typename rs_index_type::sb_pair_type sc;
+        sc.first = sc.second = 0;
+        
+        unsigned i = unsigned(nb >> bm::set_array_shift);
+        const bm::word_t* block =
+            blockman_.get_block(i, unsigned(nb & bm::set_array_mask));
+        if (block)
+            block_rs_counts(block, cnt, sc);
+        rs_idx.set_block(unsigned(nb), cnt, sc.first, sc.second);
+    } // for nb
+}
+
+// -----------------------------------------------------------------------
+
+template<typename Alloc>
+void bvector<Alloc>::block_rs_counts(const bm::word_t* block,
+                            unsigned& cnt,
+                            typename rs_index_type::sb_pair_type& sc) const
+{
+    BM_ASSERT(block);
+    cnt = blockman_.block_bitcount(block);
+    if (BM_IS_GAP(block))
+    {
+        const bm::gap_word_t* const gap_block = BMGAP_PTR(block);
+        sc.first = (bm::gap_word_t)
+            bm::gap_bit_count_range(gap_block, 0, bm::rs3_border0);
+        sc.second = (bm::gap_word_t)
+            bm::gap_bit_count_range(gap_block,
+                                    bm::gap_word_t(bm::rs3_border0+1),
+                                    bm::rs3_border1);
+    }
+    else
     {
-        blocks_cnt->bcount[i] += blocks_cnt->bcount[i-1];
+        sc.first = (bm::gap_word_t)
+            bm::bit_block_calc_count_range(block, 0, bm::rs3_border0);
+        sc.second = (bm::gap_word_t)
+            bm::bit_block_calc_count_range(block,
+                                           bm::rs3_border0+1,
+                                           bm::rs3_border1);
     }
 }
+
 // -----------------------------------------------------------------------
 
 template<typename Alloc>
 unsigned bvector<Alloc>::block_count_to(const bm::word_t*    block,
-                                        unsigned             nb,
+                                        block_idx_type       nb,
                                         unsigned             nbit_right,
                                         const rs_index_type& blocks_cnt)
 {
     unsigned c;
+    const rs_index_type::sb_pair_type& sc = blocks_cnt.sub_count(unsigned(nb));
     
     unsigned sub_range = blocks_cnt.find_sub_range(nbit_right);
 
@@ -2494,7 +3504,7 @@ unsigned bvector<Alloc>::block_count_to(const bm::word_t*    block,
             // |--------[x]-----------[1]----------|
             if (nbit_right == rs3_border0)
             {
-                c = blocks_cnt.subcount[nb].first;
+                c = sc.first;
             }
             else
             {
@@ -2502,7 +3512,7 @@ unsigned bvector<Alloc>::block_count_to(const bm::word_t*    block,
                 c = bm::bit_block_calc_count_range(block,
                                                    nbit_right+1,
                                                    rs3_border0);
-                c = blocks_cnt.subcount[nb].first - c;
+                c = sc.first - c;
             }
         }
     break;
@@ -2513,13 +3523,13 @@ unsigned bvector<Alloc>::block_count_to(const bm::word_t*    block,
             c = bm::bit_block_calc_count_range(block,
                                                rs3_border0 + 1,
                                                nbit_right);
-            c += blocks_cnt.subcount[nb].first;
+            c += sc.first;
         }
         else
         {
             unsigned bc_second_range =
-                blocks_cnt.subcount[nb].first +
-                blocks_cnt.subcount[nb].second;
+                sc.first +
+                sc.second;
             // |--------[0]-----------[x]----------|
             if (nbit_right == rs3_border1)
             {
@@ -2538,8 +3548,8 @@ unsigned bvector<Alloc>::block_count_to(const bm::word_t*    block,
     case 2:
     {
         unsigned bc_second_range =
-            blocks_cnt.subcount[nb].first +
-            blocks_cnt.subcount[nb].second;
+            sc.first +
+            sc.second;
 
         // |--------[0]-----------[1]-x--------|
         if (nbit_right <= (rs3_border1 + rs3_half_span))
@@ -2554,7 +3564,7 @@ unsigned bvector<Alloc>::block_count_to(const bm::word_t*    block,
             // |--------[0]-----------[1]----------x
             if (nbit_right == bm::gap_max_bits-1)
             {
-                c = blocks_cnt.count(nb);
+                c = blocks_cnt.count(unsigned(nb));
             }
             else
             {
@@ -2562,8 +3572,7 @@ unsigned bvector<Alloc>::block_count_to(const bm::word_t*    block,
                 c = bm::bit_block_calc_count_range(block,
                                                    nbit_right+1,
                                                    bm::gap_max_bits-1);
-                unsigned cnt = nb ? blocks_cnt.bcount[nb-1] : 0;
-                c = blocks_cnt.bcount[nb] - cnt - c;
+                c = blocks_cnt.count(unsigned(nb)) - c;
             }
         }
     }
@@ -2581,18 +3590,21 @@ unsigned bvector<Alloc>::block_count_to(const bm::word_t*    block,
 // -----------------------------------------------------------------------
 
 template<typename Alloc>
-bm::id_t bvector<Alloc>::count_to(bm::id_t right,
-                                  const rs_index_type&  blocks_cnt) const
+typename bvector<Alloc>::size_type
+bvector<Alloc>::count_to(size_type right,
+                         const rs_index_type&  blocks_cnt) const
 {
+    // rank-select index covers the 32-bit address range
+    BM_ASSERT_THROW(right < bm::id_max32, BM_ERR_RANGE);
     if (!blockman_.is_init())
         return 0;
 
-    unsigned nblock_right = unsigned(right >>  bm::set_block_shift);    
+    block_idx_type nblock_right = block_idx_type(right >>  bm::set_block_shift);    
     unsigned nbit_right = unsigned(right & bm::set_block_mask);
     
     // running count of all blocks before target
     //
-    bm::id_t cnt = nblock_right ? blocks_cnt.bcount[nblock_right-1] : 0;
+    size_type cnt = nblock_right ? blocks_cnt.rcount(unsigned(nblock_right-1)) : 0;
 
     const bm::word_t* block = blockman_.get_block_ptr(nblock_right);
     if (!block)
@@ -2625,18 +3637,20 @@ bm::id_t bvector<Alloc>::count_to(bm::id_t right,
 // -----------------------------------------------------------------------
 
 template<typename Alloc>
-bm::id_t bvector<Alloc>::count_to_test(bm::id_t right,
-                                       const rs_index_type&  blocks_cnt) const
+typename bvector<Alloc>::size_type
+bvector<Alloc>::count_to_test(size_type right,
+                              const rs_index_type&  blocks_cnt) const
 {
+    BM_ASSERT_THROW(right < bm::id_max32, BM_ERR_RANGE);
     if (!blockman_.is_init())
         return 0;
 
-    unsigned nblock_right = unsigned(right >> bm::set_block_shift);
+    block_idx_type nblock_right = block_idx_type(right >> bm::set_block_shift);
     unsigned nbit_right = unsigned(right & bm::set_block_mask);
 
     // running count of all blocks before target
     //
-    bm::id_t cnt = 0;
+    size_type cnt = 0;
     
     const bm::word_t* block = blockman_.get_block_ptr(nblock_right);
     if (!block)
@@ -2671,7 +3685,7 @@ bm::id_t bvector<Alloc>::count_to_test(bm::id_t right,
                 return 0;
         }
     }
-    cnt += nblock_right ? blocks_cnt.bcount[nblock_right - 1] : 0;
+    cnt += nblock_right ? blocks_cnt.rcount(unsigned(nblock_right-1)) : 0;
     return cnt;
 }
 
@@ -2679,9 +3693,10 @@ bm::id_t bvector<Alloc>::count_to_test(bm::id_t right,
 // -----------------------------------------------------------------------
 
 template<typename Alloc> 
-bm::id_t bvector<Alloc>::count_range(bm::id_t left, 
-                                     bm::id_t right,
-                                     const unsigned* block_count_arr) const
+typename bvector<Alloc>::size_type
+bvector<Alloc>::count_range(size_type left, 
+                            size_type right,
+                            const unsigned* block_count_arr) const
 {
     BM_ASSERT(left <= right);
 
@@ -2692,11 +3707,11 @@ bm::id_t bvector<Alloc>::count_range(bm::id_t left,
     if (!blockman_.is_init())
         return 0;
 
-    unsigned cnt = 0;
+    size_type cnt = 0;
 
     // calculate logical number of start and destination blocks
-    unsigned nblock_left  = unsigned(left  >>  bm::set_block_shift);
-    unsigned nblock_right = unsigned(right >>  bm::set_block_shift);
+    block_idx_type nblock_left  = block_idx_type(left  >>  bm::set_block_shift);
+    block_idx_type nblock_right = block_idx_type(right >>  bm::set_block_shift);
 
     const bm::word_t* block = blockman_.get_block(nblock_left);
     bool left_gap = BM_IS_GAP(block);
@@ -2742,7 +3757,7 @@ bm::id_t bvector<Alloc>::count_range(bm::id_t left,
         return cnt + func.count();
     }
 
-    for (unsigned nb = nblock_left+1; nb < nblock_right; ++nb)
+    for (block_idx_type nb = nblock_left+1; nb < nblock_right; ++nb)
     {
         block = blockman_.get_block(nb);
         if (block_count_arr)
@@ -2753,6 +3768,21 @@ bm::id_t bvector<Alloc>::count_range(bm::id_t left,
         {
             if (block)
                 func(block);//, nb);
+            else
+            {
+                unsigned i = unsigned(nb >> bm::set_array_shift);
+                if (blockman_.is_subblock_null(i)) // skip to the next sub-block
+                {
+                    i = blockman_.find_next_nz_top(i);
+                    if (i >= blockman_.top_block_size())
+                        break;
+                    block_idx_type nb_next =
+                                block_idx_type(i) << bm::set_array_shift;
+                    if (nb_next >= nblock_right)
+                        break;
+                    nb = nb_next - 1;
+                }
+            }
         }
     }
     cnt += func.count();
@@ -2782,9 +3812,24 @@ bm::id_t bvector<Alloc>::count_range(bm::id_t left,
 template<typename Alloc>
 bvector<Alloc>& bvector<Alloc>::invert()
 {
+#ifdef BM64ADDR
+    // the wide top level is not pre-allocated: inversion covers
+    // the current capacity of the vector (or the declared size)
+    if (size_ == bm::id_max)
+    {
+        if (!blockman_.is_init())
+            blockman_.init_tree();
+    }
+    else
+    {
+        blockman_.reserve(size_);
+    }
+#else
     blockman_.reserve_top_blocks(bm::set_array_size);
+#endif
 
-    bm::word_t*** blk_root = blockman_.top_blocks_root();
+    blockman_.unshare_all();
+    typename blocks_manager_type::top_root_type blk_root = blockman_.top_blocks_root();
     typename blocks_manager_type::block_invert_func func(blockman_);    
     for_each_block(blk_root, blockman_.top_block_size(), func);
     if (size_ == bm::id_max) 
@@ -2802,13 +3847,13 @@ bvector<Alloc>& bvector<Alloc>::invert()
 // -----------------------------------------------------------------------
 
 template<typename Alloc> 
-bool bvector<Alloc>::get_bit(bm::id_t n) const
+bool bvector<Alloc>::get_bit(size_type n) const
 {    
     BM_ASSERT(n < size_);
     BM_ASSERT_THROW((n < size_), BM_ERR_RANGE);
 
     // calculate logical block number
-    unsigned nblock = unsigned(n >>  bm::set_block_shift); 
+    block_idx_type nblock = block_idx_type(n >>  bm::set_block_shift); 
     const bm::word_t* block = blockman_.get_block_ptr(nblock); // get unsanitized block ptr
 
     if (block)
@@ -2832,18 +3877,145 @@ bool bvector<Alloc>::get_bit(bm::id_t n) const
 
 // -----------------------------------------------------------------------
 
+template<typename Alloc> 
+typename bvector<Alloc>::size_type
+bvector<Alloc>::test_many(const size_type* ids, size_type ids_size,
+                          unsigned char* out, bm::sort_order so) const
+{
+    BM_ASSERT(ids && out);
+    if (!ids_size)
+        return 0;
+    if (!blockman_.is_init())
+    {
+        ::memset(out, 0, ids_size * sizeof(out[0]));
+        return 0;
+    }
+    if (so == BM_UNKNOWN) // check if ids are sorted
+    {
+        size_type i = 1;
+        for (; i < ids_size && ids[i-1] <= ids[i]; ++i)
+        {}
+        so = (i == ids_size) ? BM_SORTED : BM_UNSORTED;
+    }
+    else
+    if (so == BM_SORTED_UNIFORM)
+        so = BM_SORTED;
+
+    size_type cnt = 0;
+    if (so != BM_SORTED)
+    {
+        // unsorted input: test ids one by one
+        for (size_type i = 0; i < ids_size; ++i)
+        {
+            size_type n = ids[i];
+            const bm::word_t* blk =
+                blockman_.get_block_ptr(block_idx_type(n >> bm::set_block_shift));
+            unsigned v = 0;
+            if (blk)
+            {
+                unsigned nbit = unsigned(n & bm::set_block_mask);
+                if (BM_IS_GAP(blk))
+                {
+                    v = bm::gap_test_unr(BMGAP_PTR(blk), nbit);
+                }
+                else
+                {
+                    blk = BLOCK_ADDR_SAN(blk);
+                    v = bool(blk[nbit >> bm::set_word_shift] &
+                                        (1u << (nbit & bm::set_word_mask)));
+                }
+            }
+            out[i] = (unsigned char)v;
+            cnt += v;
+        } // for i
+        return cnt;
+    }
+    
+    for (size_type i = 0; i < ids_size; )
+    {
+        block_idx_type nblock = block_idx_type(ids[i] >> bm::set_block_shift);
+        size_type stop =
+            bm::idx_arr_block_lookup_sorted(ids, ids_size, nblock, i);
+        BM_ASSERT(stop > i);
+        cnt += test_block_many(ids, nblock, i, stop, out);
+        i = stop;
+    } // for i
+    return cnt;
+}
+
+// -----------------------------------------------------------------------
+
+template<typename Alloc> 
+typename bvector<Alloc>::size_type
+bvector<Alloc>::test_block_many(const size_type* ids,
+                                block_idx_type nblock,
+                                size_type start, size_type stop,
+                                unsigned char* out) const
+{
+    BM_ASSERT(start < stop);
+    
+    const bm::word_t* blk = blockman_.get_block_ptr(nblock);
+    if (!blk)
+    {
+        ::memset(out + start, 0, (stop - start) * sizeof(out[0]));
+        return 0;
+    }
+    if (IS_FULL_BLOCK(blk))
+    {
+        ::memset(out + start, 1, (stop - start) * sizeof(out[0]));
+        return stop - start;
+    }
+    if (BM_IS_GAP(blk))
+        return bm::gap_test_sorted_idx(BMGAP_PTR(blk), ids, start, stop, out);
+    return bm::bit_block_test_idx(blk, ids, start, stop, out);
+}
+
+// -----------------------------------------------------------------------
+
+template<typename Alloc> 
+typename bvector<Alloc>::size_type
+bvector<Alloc>::test_subset(const size_type* ids, size_type ids_size,
+                            size_type* subset, bm::sort_order so) const
+{
+    BM_ASSERT(ids && subset);
+    
+    const unsigned batch_size = 1024;
+    unsigned char flags[batch_size];
+    
+    size_type cnt = 0;
+    for (size_type i = 0; i < ids_size; i += batch_size)
+    {
+        size_type len = ids_size - i;
+        if (len > batch_size)
+            len = batch_size;
+        if (!test_many(ids + i, len, flags, so))
+            continue;
+        for (size_type k = 0; k < len; ++k)
+        {
+            subset[cnt] = ids[i + k];
+            cnt += flags[k];
+        }
+    } // for i
+    return cnt;
+}
+
+// -----------------------------------------------------------------------
+
 template<typename Alloc> 
 void bvector<Alloc>::optimize(bm::word_t* temp_block,
                               optmode     opt_mode,
                               statistics* stat)
 {
-    if (!blockman_.is_init())
+    // frozen arena keeps blocks optimized before freeze(), unsharing it
+    // here would turn it back into individually allocated blocks
+    if (!blockman_.is_init() || blockman_.is_frozen())
     {
         if (stat)
             calc_stat(stat);
         return;
     }
-    word_t*** blk_root = blockman_.top_blocks_root();
+    blockman_.unshare_all();
+    typename blocks_manager_type::top_root_type blk_root = blockman_.top_blocks_root();
 
     if (!temp_block)
         temp_block = blockman_.check_allocate_tempblock();
@@ -2858,7 +4030,7 @@ void bvector<Alloc>::optimize(bm::word_t* temp_block,
         stat->reset();
         ::memcpy(stat->gap_levels,
                 blockman_.glen(), sizeof(gap_word_t) * bm::gap_levels);
-        stat->max_serialize_mem = (unsigned)sizeof(id_t) * 4;
+        stat->max_serialize_mem = (unsigned)sizeof(size_type) * 4;
     }
 
     for_each_nzblock(blk_root, blockman_.top_block_size(), opt_func);
@@ -2908,7 +4080,8 @@ void bvector<Alloc>::set_gap_levels(const gap_word_t* glevel_len)
 {
     if (blockman_.is_init())
     {
-        word_t*** blk_root = blockman_.top_blocks_root();
+        blockman_.unshare_all();
+        typename blocks_manager_type::top_root_type blk_root = blockman_.top_blocks_root();
         typename 
             blocks_manager_type::gap_level_func  gl_func(blockman_, glevel_len);
         for_each_nzblock(blk_root, blockman_.top_block_size(),gl_func);
@@ -2937,6 +4110,16 @@ int bvector<Alloc>::compare(const bvector<Alloc>& bv) const
 
         if (blk_blk == arg_blk_blk) 
         {
+            if (!blk_blk) // skip to the next allocated top block
+            {
+                unsigned i_next = bm::min_value(blockman_.find_next_nz_top(i),
+                                            bv.blockman_.find_next_nz_top(i));
+                if (i_next > top_blocks)
+                    i_next = top_blocks;
+                bn += (i_next - i) * bm::set_array_size;
+                i = i_next - 1;
+                continue;
+            }
             bn += bm::set_array_size;
             continue;
         }
@@ -3072,7 +4255,7 @@ void bvector<Alloc>::calc_stat(struct bvector<Alloc>::statistics* st) const
 
     unsigned empty_blocks = 0;
 
-    st->max_serialize_mem = unsigned(sizeof(id_t) * 4);
+    st->max_serialize_mem = unsigned(sizeof(size_type) * 4);
 
     unsigned top_size = blockman_.top_block_size();
     for (unsigned i = 0; i < top_size; ++i)
@@ -3082,6 +4265,7 @@ void bvector<Alloc>::calc_stat(struct bvector<Alloc>::statistics* st) const
         if (!blk_blk) 
         {
             st->max_serialize_mem += unsigned(sizeof(unsigned) + 1);
+            i = blockman_.find_next_nz_top(i) - 1; // one group of zero blocks
             continue;
         }
 
@@ -3125,7 +4309,7 @@ void bvector<Alloc>::calc_stat(struct bvector<Alloc>::statistics* st) const
 // -----------------------------------------------------------------------
 
 template<class Alloc>
-void bvector<Alloc>::set_bit_no_check(bm::id_t n)
+void bvector<Alloc>::set_bit_no_check(size_type n)
 {
     BM_ASSERT(blockman_.is_init());
     BM_ASSERT_THROW(n < bm::id_max, BM_ERR_RANGE);
@@ -3133,39 +4317,170 @@ void bvector<Alloc>::set_bit_no_check(bm::id_t n)
     bool val = true; // set bit
     
     // calculate logical block number
-    unsigned nblock = unsigned(n >>  bm::set_block_shift);
+    block_idx_type nblock = block_idx_type(n >>  bm::set_block_shift);
     // calculate word number in block and bit
     unsigned nbit   = unsigned(n & bm::set_block_mask);
 
-    int block_type;
-    bm::word_t* blk =
-        blockman_.check_allocate_block(nblock,
-                                       val,
-                                       get_new_blocks_strat(),
-                                       &block_type);
-    if (!blk) return; // nothing to do
+    int block_type;
+    bm::word_t* blk =
+        blockman_.check_allocate_block(nblock,
+                                       val,
+                                       get_new_blocks_strat(),
+                                       &block_type);
+    if (!blk) return; // nothing to do
+
+    if (block_type) // gap block
+    {
+        bm::gap_word_t* gap_blk = BMGAP_PTR(blk);
+        gap_block_set(gap_blk, val, nblock, nbit);
+    }
+    else  // bit block
+    {
+        unsigned nword  = nbit >> bm::set_word_shift;
+        nbit &= bm::set_word_mask;
+        blk[nword] |= (1u << nbit); // set bit
+    }
+}
+
+// -----------------------------------------------------------------------
+
+template<class Alloc>
+void bvector<Alloc>::set(const size_type* ids, size_type ids_size,
+                         bm::sort_order so)
+{
+    BM_ASSERT(ids);
+    if (!ids_size)
+        return;
+    if (!blockman_.is_init())
+        blockman_.init_tree();
+
+    size_type max_id = ids[0];
+    switch (so)
+    {
+    case BM_SORTED: case BM_SORTED_UNIFORM:
+        max_id = ids[ids_size-1];
+        so = BM_SORTED;
+        break;
+    case BM_UNKNOWN: // check if ids are sorted
+        {
+            size_type i = 1;
+            for (; i < ids_size && ids[i-1] <= ids[i]; ++i)
+            {}
+            if (i == ids_size)
+            {
+                max_id = ids[ids_size-1];
+                so = BM_SORTED;
+                break;
+            }
+        }
+        // fall through
+    default: // BM_UNSORTED
+        for (size_type i = 1; i < ids_size; ++i)
+        {
+            if (ids[i] > max_id)
+                max_id = ids[i];
+        }
+        so = BM_UNSORTED;
+        break;
+    } // switch
+    
+    BM_ASSERT_THROW(max_id < bm::id_max, BM_ERR_RANGE);
+    if (max_id >= size_)
+    {
+        size_type new_size = (max_id == bm::id_max) ? bm::id_max : max_id + 1;
+        resize(new_size);
+    }
+    
+    import(ids, ids_size, so);
+}
+
+// -----------------------------------------------------------------------
+
+template<class Alloc>
+void bvector<Alloc>::import(const size_type* ids, size_type ids_size,
+                            bm::sort_order sorted_idx)
+{
+    BM_ASSERT(sorted_idx == BM_SORTED || sorted_idx == BM_UNSORTED);
+    
+    for (size_type i = 0; i < ids_size; )
+    {
+        block_idx_type nblock = block_idx_type(ids[i] >> bm::set_block_shift);
+        size_type stop;
+        if (sorted_idx == BM_SORTED)
+        {
+            stop = bm::idx_arr_block_lookup_sorted(ids, ids_size, nblock, i);
+        }
+        else
+        {
+            for (stop = i + 1; stop < ids_size; ++stop)
+            {
+                if (nblock != block_idx_type(ids[stop] >> bm::set_block_shift))
+                    break;
+            }
+        }
+        BM_ASSERT(stop > i);
+        import_block(ids, nblock, i, stop, sorted_idx);
+        i = stop;
+    } // for i
+}
+
+// -----------------------------------------------------------------------
 
-    if (block_type) // gap block
-    {
-        bm::gap_word_t* gap_blk = BMGAP_PTR(blk);
-        gap_block_set(gap_blk, val, nblock, nbit);
+template<class Alloc>
+void bvector<Alloc>::import_block(const size_type* ids,
+                                  block_idx_type nblock,
+                                  size_type start, size_type stop,
+                                  bm::sort_order sorted_idx)
+{
+    BM_ASSERT(start < stop);
+    
+    const bm::word_t* blk = blockman_.get_block_ptr(nblock);
+    if (IS_FULL_BLOCK(blk)) // nothing to do
+        return;
+    if (!blk && sorted_idx == BM_SORTED)
+    {
+        // choose GAP or bit representation by the number of runs
+        const gap_word_t* glen = blockman_.glen();
+        unsigned max_runs = (glen[bm::gap_max_level] - 4 - 2) / 2;
+        unsigned runs = bm::idx_arr_count_runs(ids, start, stop, max_runs);
+        int level = bm::gap_calc_level(2 * runs + 2, glen);
+        if (level >= 0)
+        {
+            bm::gap_word_t BM_VECT_ALIGN gap_temp[bm::gap_max_buff_len]
+                                                        BM_VECT_ALIGN_ATTR;
+            gap_temp[0] = 0;
+            bm::gap_set_sorted_idx(gap_temp, ids, start, stop);
+            blockman_.unshare_block(nblock);
+            blockman_.set_gap_block(nblock, gap_temp, level);
+            return;
+        }
     }
-    else  // bit block
+    
+    const size_type gap_set_limit = 32;
+    if (blk && BM_IS_GAP(blk) && (stop - start) < gap_set_limit)
     {
-        unsigned nword  = nbit >> bm::set_word_shift;
-        nbit &= bm::set_word_mask;
-        blk[nword] |= (1u << nbit); // set bit
+        // few bits on a GAP block: keep it compressed
+        for (; start < stop; ++start)
+            set_bit_no_check(ids[start]);
+        return;
     }
+    
+    int block_type;
+    bm::word_t* bit_blk =
+        blockman_.check_allocate_block(nblock, 0, BM_BIT, &block_type, false);
+    if (block_type) // GAP block
+        bit_blk = blockman_.deoptimize_block(nblock);
+    bm::set_block_bits(bit_blk, ids, start, stop);
 }
 
 // -----------------------------------------------------------------------
 
 
 template<class Alloc> 
-bool bvector<Alloc>::set_bit_no_check(bm::id_t n, bool val)
+bool bvector<Alloc>::set_bit_no_check(size_type n, bool val)
 {
     // calculate logical block number
-    unsigned nblock = unsigned(n >>  bm::set_block_shift); 
+    block_idx_type nblock = block_idx_type(n >>  bm::set_block_shift); 
 
     int block_type;
     bm::word_t* blk = 
@@ -3215,9 +4530,261 @@ bool bvector<Alloc>::set_bit_no_check(bm::id_t n, bool val)
 
 // -----------------------------------------------------------------------
 
+template<class Alloc>
+bool bvector<Alloc>::insert(size_type n, bool value)
+{
+    BM_ASSERT_THROW(n < bm::id_max, BM_ERR_RANGE);
+
+    if (size_ < bm::id_max)
+        ++size_;
+    if (!blockman_.is_init())
+    {
+        if (value)
+            set(n);
+        return false;
+    }
+
+    // calculate logical block number
+    block_idx_type nb = block_idx_type(n >>  bm::set_block_shift);
+    unsigned nbit = unsigned(n & bm::set_block_mask);
+
+    unsigned i0, j0;
+    blockman_.get_block_coord(nb, i0, j0);
+    blockman_.unshare_range(nb, bm::set_total_blocks-1); // tail shifts
+
+    unsigned top_blocks = blockman_.top_block_size();
+    bm::word_t co_flag = 0; // carry over into the next block
+
+    for (unsigned i = i0; i < top_blocks; ++i)
+    {
+        unsigned j = (i == i0) ? j0 : 0;
+        bm::word_t** blk_blk = blockman_.get_topblock(i);
+        if (!blk_blk) // empty sub-block: only the carry over can land here
+        {
+            // first block of the group gets the insert value or carry over
+            unsigned pos = (i == i0 && j == j0) ? nbit : 0;
+            bool val = (i == i0 && j == j0) ? value : bool(co_flag);
+            co_flag = 0;
+            if (val)
+            {
+                size_type nbit_abs =
+                    (size_type(i * bm::set_array_size + j) << bm::set_block_shift);
+                set_bit_no_check(nbit_abs + pos);
+            }
+            else // no carry over: skip to the next allocated sub-block
+            {
+                i = blockman_.find_next_nz_top(i + 1) - 1;
+            }
+            continue;
+        }
+        for (; j < bm::set_array_size; ++j)
+        {
+            block_idx_type nb_curr = block_idx_type(i) * bm::set_array_size + j;
+            bool first = (nb_curr == nb);
+            unsigned pos = first ? nbit : 0;
+            bool val = first ? value : bool(co_flag);
+
+            bm::word_t* block = blk_blk[j];
+            if (!block) // empty block: carry stays here
+            {
+                co_flag = 0;
+                if (val)
+                {
+                    set_bit_no_check(
+                        (size_type(nb_curr) << bm::set_block_shift) + pos);
+                    blk_blk = blockman_.get_topblock(i);
+                }
+                continue;
+            }
+            if (IS_FULL_BLOCK(block))
+            {
+                if (val) // 1 inserted into all 1s block: 1 comes out
+                {
+                    co_flag = 1;
+                    continue;
+                }
+                block = blockman_.deoptimize_block(nb_curr);
+            }
+            if (BM_IS_GAP(block))
+            {
+                bm::gap_word_t* gap_blk = BMGAP_PTR(block);
+                unsigned new_len;
+                co_flag = bm::gap_insert(gap_blk, pos, val, &new_len);
+                if (bm::gap_is_all_zero(gap_blk))
+                {
+                    blockman_.zero_block(i, j);
+                }
+                else
+                {
+                    unsigned threshold = bm::gap_limit(gap_blk, blockman_.glen());
+                    if (new_len > threshold)
+                        extend_gap_block(nb_curr, gap_blk);
+                }
+            }
+            else // bit block
+            {
+                bm::word_t acc;
+                if (pos)
+                {
+                    co_flag = bm::bit_block_insert(block, pos, val);
+                    acc = co_flag ? !bm::bit_is_all_zero(block) : 1;
+                }
+                else
+                {
+                    co_flag = bm::bit_block_shift_r1_unr(block, &acc, val);
+                }
+                if (!acc)
+                    blockman_.zero_block(i, j);
+            }
+        } // for j
+    } // for i
+
+    if (co_flag) // carry over goes beyond the allocated tree
+    {
+        block_idx_type nb_next = block_idx_type(top_blocks) * bm::set_array_size;
+        if (nb_next < bm::set_total_blocks)
+        {
+            set_bit_no_check(size_type(nb_next) << bm::set_block_shift);
+            co_flag = 0;
+        }
+    }
+    // the last block got shifted: bit which lands on id_max is outside of
+    // the addressable range, it is the carry over
+    if (block_idx_type(top_blocks) * bm::set_array_size >= bm::set_total_blocks)
+        co_flag = set_bit_no_check(bm::id_max, false);
+    return co_flag;
+}
+
+// -----------------------------------------------------------------------
+
+template<class Alloc>
+void bvector<Alloc>::erase(size_type n)
+{
+    BM_ASSERT_THROW(n < bm::id_max, BM_ERR_RANGE);
+
+    if (!blockman_.is_init())
+        return;
+
+    // calculate logical block number
+    block_idx_type nb = block_idx_type(n >>  bm::set_block_shift);
+    unsigned nbit = unsigned(n & bm::set_block_mask);
+
+    unsigned i0, j0;
+    blockman_.get_block_coord(nb, i0, j0);
+    blockman_.unshare_range(nb, bm::set_total_blocks-1); // tail shifts
+
+    unsigned top_blocks = blockman_.top_block_size();
+    for (unsigned i = i0; i < top_blocks; ++i)
+    {
+        unsigned j = (i == i0) ? j0 : 0;
+        bm::word_t** blk_blk = blockman_.get_topblock(i);
+        if (!blk_blk) // empty sub-block: the last bit gets the carry over
+        {
+            // carry over comes only from the next allocated sub-block
+            unsigned i_next = blockman_.find_next_nz_top(i + 1);
+            if (i_next > i + 1)
+            {
+                i = i_next - 2;
+                continue;
+            }
+            block_idx_type nb_next =
+                (block_idx_type(i) + 1) * bm::set_array_size;
+            if (test_first_block_bit(nb_next))
+                set_bit_no_check((size_type(nb_next) << bm::set_block_shift) - 1);
+            continue;
+        }
+        for (; j < bm::set_array_size; ++j)
+        {
+            block_idx_type nb_curr = block_idx_type(i) * bm::set_array_size + j;
+            unsigned pos = (nb_curr == nb) ? nbit : 0;
+            // carry over comes from the first bit of the next block
+            bool co_flag = test_first_block_bit(nb_curr + 1);
+
+            bm::word_t* block = blk_blk[j];
+            if (!block)
+            {
+                if (co_flag)
+                {
+                    set_bit_no_check(
+                        (size_type(nb_curr + 1) << bm::set_block_shift) - 1);
+                    blk_blk = blockman_.get_topblock(i);
+                }
+                continue;
+            }
+            if (IS_FULL_BLOCK(block))
+            {
+                if (co_flag) // 1 erased and 1 comes in: block stays FULL
+                    continue;
+                block = blockman_.deoptimize_block(nb_curr);
+            }
+            if (BM_IS_GAP(block))
+            {
+                bm::gap_word_t* gap_blk = BMGAP_PTR(block);
+                unsigned new_len;
+                bm::gap_erase(gap_blk, pos, co_flag, &new_len);
+                if (bm::gap_is_all_zero(gap_blk))
+                {
+                    blockman_.zero_block(i, j);
+                }
+                else
+                {
+                    unsigned threshold = bm::gap_limit(gap_blk, blockman_.glen());
+                    if (new_len > threshold)
+                        extend_gap_block(nb_curr, gap_blk);
+                }
+            }
+            else // bit block
+            {
+                bm::word_t acc;
+                if (pos)
+                {
+                    bm::bit_block_erase(block, pos, co_flag);
+                    acc = co_flag ? 1 : !bm::bit_is_all_zero(block);
+                }
+                else
+                {
+                    bm::bit_block_shift_l1_unr(block, &acc, co_flag);
+                }
+                if (!acc)
+                    blockman_.zero_block(i, j);
+            }
+        } // for j
+    } // for i
+}
+
+// -----------------------------------------------------------------------
+
+template<class Alloc>
+bool bvector<Alloc>::shift_left()
+{
+    bool b = this->test(0);
+    this->erase(0);
+    return b;
+}
+
+// -----------------------------------------------------------------------
+
+template<class Alloc>
+bool bvector<Alloc>::test_first_block_bit(block_idx_type nb) const
+{
+    if (nb >= bm::set_total_blocks) // last possible block
+        return false;
+    const bm::word_t* block = blockman_.get_block_ptr(nb);
+    if (!block)
+        return false;
+    if (IS_FULL_BLOCK(block))
+        return true;
+    if (BM_IS_GAP(block))
+        return bool(*BMGAP_PTR(block) & 1);
+    return bool(block[0] & 1);
+}
+
+// -----------------------------------------------------------------------
+
 template<class Alloc>
 bool bvector<Alloc>::gap_block_set(bm::gap_word_t* gap_blk,
-                                   bool val, unsigned nblock, unsigned nbit)
+                                   bool val, block_idx_type nblock,
+                                   unsigned nbit)
 {
     unsigned is_set, new_block_len;
     new_block_len =
@@ -3236,10 +4803,10 @@ bool bvector<Alloc>::gap_block_set(bm::gap_word_t* gap_blk,
 // -----------------------------------------------------------------------
 
 template<class Alloc>
-bool bvector<Alloc>::inc(bm::id_t n)
+bool bvector<Alloc>::inc(size_type n)
 {
     // calculate logical block number
-    unsigned nblock = unsigned(n >>  bm::set_block_shift);
+    block_idx_type nblock = block_idx_type(n >>  bm::set_block_shift);
     bm::word_t* blk =
         blockman_.check_allocate_block(nblock,
                                        get_new_blocks_strat());
@@ -3271,12 +4838,12 @@ bool bvector<Alloc>::inc(bm::id_t n)
 // -----------------------------------------------------------------------
 
 template<class Alloc> 
-bool bvector<Alloc>::set_bit_conditional_impl(bm::id_t n, 
+bool bvector<Alloc>::set_bit_conditional_impl(size_type n, 
                                               bool     val, 
                                               bool     condition)
 {
     // calculate logical block number
-    unsigned nblock = unsigned(n >>  bm::set_block_shift); 
+    block_idx_type nblock = block_idx_type(n >>  bm::set_block_shift); 
 
     int block_type;
     bm::word_t* blk =
@@ -3341,10 +4908,10 @@ bool bvector<Alloc>::set_bit_conditional_impl(bm::id_t n,
 
 
 template<class Alloc> 
-bool bvector<Alloc>::and_bit_no_check(bm::id_t n, bool val)
+bool bvector<Alloc>::and_bit_no_check(size_type n, bool val)
 {
     // calculate logical block number
-    unsigned nblock = unsigned(n >>  bm::set_block_shift); 
+    block_idx_type nblock = block_idx_type(n >>  bm::set_block_shift); 
 
     int block_type;
     bm::word_t* blk =
@@ -3399,7 +4966,7 @@ bool bvector<Alloc>::and_bit_no_check(bm::id_t n, bool val)
 //---------------------------------------------------------------------
 
 template<class Alloc>
-bool bvector<Alloc>::find(bm::id_t from, bm::id_t& pos) const
+bool bvector<Alloc>::find(size_type from, size_type& pos) const
 {
     BM_ASSERT_THROW(from < bm::id_max, BM_ERR_RANGE);
 
@@ -3414,13 +4981,16 @@ bool bvector<Alloc>::find(bm::id_t from, bm::id_t& pos) const
 //---------------------------------------------------------------------
 
 template<class Alloc>
-bool bvector<Alloc>::find_reverse(bm::id_t& pos) const
+bool bvector<Alloc>::find_reverse(size_type& pos) const
 {
     bool found;
     
     unsigned top_blocks = blockman_.top_block_size();
     for (unsigned i = top_blocks-1; true; --i)
     {
+        i = blockman_.find_prev_nz_top(i);
+        if (i >= top_blocks)
+            break;
         const bm::word_t* const* blk_blk = blockman_.get_topblock(i);
         if (blk_blk)
         {
@@ -3432,14 +5002,16 @@ bool bvector<Alloc>::find_reverse(bm::id_t& pos) const
                     if (blk == FULL_BLOCK_FAKE_ADDR)
                         blk = FULL_BLOCK_REAL_ADDR;
                     
+                    unsigned block_pos;
                     bool is_gap = BM_IS_GAP(blk);
-                    found = is_gap ? bm::gap_find_last(BMGAP_PTR(blk), &pos)
-                                   : bm::bit_find_last(blk, &pos);
+                    found = is_gap ? bm::gap_find_last(BMGAP_PTR(blk), &block_pos)
+                                   : bm::bit_find_last(blk, &block_pos);
                     if (found)
                     {
-                        unsigned base_idx = i * bm::set_array_size * bm::gap_max_bits;
+                        size_type base_idx =
+                            size_type(i) * bm::set_array_size * bm::gap_max_bits;
                         base_idx += j * bm::gap_max_bits;
-                        pos += base_idx;
+                        pos = base_idx + block_pos;
                         return found;
                     }
                 }
@@ -3458,12 +5030,13 @@ bool bvector<Alloc>::find_reverse(bm::id_t& pos) const
 //---------------------------------------------------------------------
 
 template<class Alloc>
-bool bvector<Alloc>::find(bm::id_t& pos) const
+bool bvector<Alloc>::find(size_type& pos) const
 {
     bool found;
     
     unsigned top_blocks = blockman_.top_block_size();
-    for (unsigned short i = 0; i < top_blocks; ++i)
+    for (unsigned i = blockman_.find_next_nz_top(0); i < top_blocks;
+                                    i = blockman_.find_next_nz_top(i + 1))
     {
         const bm::word_t* const* blk_blk = blockman_.get_topblock(i);
         if (blk_blk)
@@ -3473,21 +5046,23 @@ bool bvector<Alloc>::find(bm::id_t& pos) const
                 const bm::word_t* blk = blk_blk[j];
                 if (blk)
                 {
+                    unsigned block_pos;
                     if (blk == FULL_BLOCK_FAKE_ADDR)
                     {
-                        found = true; pos = 0;
+                        found = true; block_pos = 0;
                     }
                     else
                     {
                         bool is_gap = BM_IS_GAP(blk);
-                        found = (is_gap) ? bm::gap_find_first(BMGAP_PTR(blk), &pos)
-                                         : bm::bit_find_first(blk, &pos);
+                        found = (is_gap) ? bm::gap_find_first(BMGAP_PTR(blk), &block_pos)
+                                         : bm::bit_find_first(blk, &block_pos);
                     }
                     if (found)
                     {
-                        unsigned base_idx = i * bm::set_array_size * bm::gap_max_bits;
+                        size_type base_idx =
+                            size_type(i) * bm::set_array_size * bm::gap_max_bits;
                         base_idx += j * bm::gap_max_bits;
-                        pos += base_idx;
+                        pos = base_idx + block_pos;
                         return found;
                     }
                 }
@@ -3500,7 +5075,7 @@ bool bvector<Alloc>::find(bm::id_t& pos) const
 //---------------------------------------------------------------------
 
 template<class Alloc>
-bool bvector<Alloc>::find_range(bm::id_t& in_first, bm::id_t& in_last) const
+bool bvector<Alloc>::find_range(size_type& in_first, size_type& in_last) const
 {
     bool found = find(in_first);
     if (found)
@@ -3514,7 +5089,7 @@ bool bvector<Alloc>::find_range(bm::id_t& in_first, bm::id_t& in_last) const
 //---------------------------------------------------------------------
 
 template<class Alloc>
-bool bvector<Alloc>::find_rank(bm::id_t rank, bm::id_t from, bm::id_t& pos) const
+bool bvector<Alloc>::find_rank(size_type rank, size_type from, size_type& pos) const
 {
     BM_ASSERT_THROW(from < bm::id_max, BM_ERR_RANGE);
 
@@ -3523,7 +5098,7 @@ bool bvector<Alloc>::find_rank(bm::id_t rank, bm::id_t from, bm::id_t& pos) cons
     if (!rank || !blockman_.is_init())
         return ret;
     
-    unsigned nb  = unsigned(from  >>  bm::set_block_shift);
+    block_idx_type nb  = block_idx_type(from  >>  bm::set_block_shift);
     bm::gap_word_t nbit = bm::gap_word_t(from & bm::set_block_mask);
     unsigned bit_pos = 0;
 
@@ -3544,6 +5119,14 @@ bool bvector<Alloc>::find_rank(bm::id_t rank, bm::id_t from, bm::id_t& pos) cons
         {
             if (no_more_blocks)
                 break;
+            unsigned i = unsigned(nb >> bm::set_array_shift);
+            if (blockman_.is_subblock_null(i)) // skip to the next sub-block
+            {
+                i = blockman_.find_next_nz_top(i);
+                if (i >= blockman_.top_block_size())
+                    break;
+                nb = (block_idx_type(i) << bm::set_array_shift) - 1;
+            }
         }
         nbit ^= nbit; // zero start bit after first scanned block
     } // for nb
@@ -3554,27 +5137,28 @@ bool bvector<Alloc>::find_rank(bm::id_t rank, bm::id_t from, bm::id_t& pos) cons
 //---------------------------------------------------------------------
 
 template<class Alloc>
-bool bvector<Alloc>::find_rank(bm::id_t rank, bm::id_t from, bm::id_t& pos,
+bool bvector<Alloc>::find_rank(size_type rank, size_type from, size_type& pos,
                                const rs_index_type&  blocks_cnt) const
 {
-    BM_ASSERT_THROW(from < bm::id_max, BM_ERR_RANGE);
+    // rank-select index covers the 32-bit address range
+    BM_ASSERT_THROW(from < bm::id_max32, BM_ERR_RANGE);
 
     bool ret = false;
     
     if (!rank ||
         !blockman_.is_init() ||
-        (blocks_cnt.bcount[blocks_cnt.total_blocks-1] < rank))
+        (blocks_cnt.count() < rank))
         return ret;
     
-    unsigned nb;
+    block_idx_type nb;
     if (from)
-        nb = unsigned(from >> bm::set_block_shift);
+        nb = block_idx_type(from >> bm::set_block_shift);
     else
     {
-        nb = bm::lower_bound(blocks_cnt.bcount, rank, 0, blocks_cnt.total_blocks-1);
-        BM_ASSERT(blocks_cnt.bcount[nb] >= rank);
+        nb = blocks_cnt.find(unsigned(rank));
+        BM_ASSERT(blocks_cnt.rcount(unsigned(nb)) >= rank);
         if (nb)
-            rank -= blocks_cnt.bcount[nb-1];
+            rank -= blocks_cnt.rcount(unsigned(nb-1));
     }
     
     bm::gap_word_t nbit = bm::gap_word_t(from & bm::set_block_mask);
@@ -3588,11 +5172,12 @@ bool bvector<Alloc>::find_rank(bm::id_t rank, bm::id_t from, bm::id_t& pos,
         {
             if (!nbit) // check if the whole block can be skipped
             {
-                unsigned block_bc = blocks_cnt.count(nb);
+                unsigned block_bc = blocks_cnt.count(unsigned(nb));
                 if (rank <= block_bc) // target block
                 {
-                    nbit = blocks_cnt.select_sub_range(nb, rank);
-                    rank = bm::block_find_rank(block, rank, nbit, bit_pos);
+                    unsigned block_rank = unsigned(rank);
+                    nbit = blocks_cnt.select_sub_range(unsigned(nb), block_rank);
+                    rank = bm::block_find_rank(block, block_rank, nbit, bit_pos);
                     BM_ASSERT(rank == 0);
                     pos = bit_pos + (nb * bm::set_block_size * 32);
                     return true;
@@ -3612,6 +5197,14 @@ bool bvector<Alloc>::find_rank(bm::id_t rank, bm::id_t from, bm::id_t& pos,
         {
             if (no_more_blocks)
                 break;
+            unsigned i = unsigned(nb >> bm::set_array_shift);
+            if (blockman_.is_subblock_null(i)) // skip to the next sub-block
+            {
+                i = blockman_.find_next_nz_top(i);
+                if (i >= blockman_.top_block_size())
+                    break;
+                nb = (block_idx_type(i) << bm::set_array_shift) - 1;
+            }
         }
         nbit ^= nbit; // zero start bit after first scanned block
     } // for nb
@@ -3622,22 +5215,22 @@ bool bvector<Alloc>::find_rank(bm::id_t rank, bm::id_t from, bm::id_t& pos,
 //---------------------------------------------------------------------
 
 template<class Alloc>
-bool bvector<Alloc>::select(bm::id_t rank, bm::id_t& pos,
+bool bvector<Alloc>::select(size_type rank, size_type& pos,
                             const rs_index_type&  blocks_cnt) const
 {
     bool ret = false;
     
     if (!rank ||
         !blockman_.is_init() ||
-        (blocks_cnt.bcount[bm::set_total_blocks-1] < rank))
+        (blocks_cnt.count() < rank))
         return ret;
     
     unsigned nb;
     
-    nb = bm::lower_bound(blocks_cnt.bcount, rank, 0, blocks_cnt.total_blocks-1);
-    BM_ASSERT(blocks_cnt.bcount[nb] >= rank);
+    nb = blocks_cnt.find(unsigned(rank));
+    BM_ASSERT(blocks_cnt.rcount(nb) >= rank);
     if (nb)
-        rank -= blocks_cnt.bcount[nb-1];
+        rank -= blocks_cnt.rcount(nb-1);
     
     const bm::word_t* block = blockman_.get_block_ptr(nb);
     block = BLOCK_ADDR_SAN(block);
@@ -3645,9 +5238,10 @@ bool bvector<Alloc>::select(bm::id_t rank, bm::id_t& pos,
     BM_ASSERT(block);
     BM_ASSERT(rank <= blocks_cnt.count(nb));
     
-    bm::gap_word_t nbit = blocks_cnt.select_sub_range(nb, rank);
+    unsigned block_rank = unsigned(rank);
+    bm::gap_word_t nbit = blocks_cnt.select_sub_range(nb, block_rank);
     unsigned bit_pos = 0;
-    rank = bm::block_find_rank(block, rank, nbit, bit_pos);
+    rank = bm::block_find_rank(block, block_rank, nbit, bit_pos);
     BM_ASSERT(rank == 0);
     pos = bit_pos + (nb * bm::set_block_size * 32);
     return true;
@@ -3655,20 +5249,89 @@ bool bvector<Alloc>::select(bm::id_t rank, bm::id_t& pos,
 
 //---------------------------------------------------------------------
 
+template<class Alloc>
+typename bvector<Alloc>::size_type
+bvector<Alloc>::decode(size_type* ids, size_type ids_capacity,
+                       size_type from) const
+{
+    BM_ASSERT(ids);
+    if (!ids_capacity || !blockman_.is_init() || from >= size_)
+        return 0;
+
+    const unsigned top_size = blockman_.top_block_size();
+    block_idx_type nb = block_idx_type(from >> bm::set_block_shift);
+    unsigned nbit = unsigned(from & bm::set_block_mask);
+    unsigned j = unsigned(nb & bm::set_array_mask);
+
+    size_type cnt = 0;
+    for (unsigned i = unsigned(nb >> bm::set_array_shift); i < top_size; ++i)
+    {
+        const bm::word_t* const* blk_blk = blockman_.get_topblock(i);
+        if (!blk_blk)
+        {
+            j = nbit = 0;
+            i = blockman_.find_next_nz_top(i) - 1;
+            continue;
+        }
+        for (; j < bm::set_array_size; ++j, nbit = 0)
+        {
+            const bm::word_t* blk = blk_blk[j];
+            if (!blk)
+                continue;
+            size_type base =
+                (size_type(i) * bm::set_array_size + j) << bm::set_block_shift;
+            size_type* dest = ids + cnt;
+            size_type dest_len = ids_capacity - cnt;
+            if (BM_IS_GAP(blk))
+            {
+                cnt += bm::gap_block_decode(BMGAP_PTR(blk), nbit, base,
+                                            dest, dest_len);
+            }
+            else
+            if (IS_FULL_BLOCK(blk))
+            {
+                size_type run = bm::gap_max_bits - nbit;
+                if (run > dest_len)
+                    run = dest_len;
+                base += nbit;
+                for (size_type k = 0; k < run; ++k)
+                    dest[k] = base + k;
+                cnt += run;
+            }
+            else
+            {
+                cnt += bm::bit_block_decode(blk, nbit, base, dest, dest_len);
+            }
+            if (cnt == ids_capacity)
+                return cnt;
+        } // for j
+        j = 0;
+    } // for i
+    return cnt;
+}
+
+//---------------------------------------------------------------------
+
 template<class Alloc> 
-bm::id_t bvector<Alloc>::check_or_next(bm::id_t prev) const
+typename bvector<Alloc>::size_type
+bvector<Alloc>::check_or_next(size_type prev) const
 {
     if (!blockman_.is_init())
         return 0;
     for (;;)
     {
-        unsigned nblock = unsigned(prev >> bm::set_block_shift); 
+        block_idx_type nblock = block_idx_type(prev >> bm::set_block_shift); 
         if (nblock >= bm::set_total_blocks) 
             break;
 
-        if (blockman_.is_subblock_null(nblock >> bm::set_array_shift))
+        unsigned i = unsigned(nblock >> bm::set_array_shift);
+        if (blockman_.is_subblock_null(i))
         {
-            prev += (bm::set_blkblk_mask + 1) - (prev & bm::set_blkblk_mask);
+            // skip to the next allocated sub-block
+            i = blockman_.find_next_nz_top(i);
+            if (i >= blockman_.top_block_size())
+                break;
+            prev = size_type(i) * bm::bits_in_array;
         }
         else
         {
@@ -3685,23 +5348,16 @@ bm::id_t bvector<Alloc>::check_or_next(bm::id_t prev) const
 
             if (block)
             {
-                if (BM_IS_GAP(block))
-                {
-                    if (bm::gap_find_in_block(BMGAP_PTR(block),
-                                                nbit,
-                                                &prev))
-                    {
-                        return prev;
-                    }
-                }
-                else
-                {
-                    if (IS_FULL_BLOCK(block)) return prev;
-                    if (bm::bit_find_in_block(block, nbit, &prev))
-                    {
-                        return prev;
-                    }
-                }
+                if (IS_FULL_BLOCK(block)) return prev;
+
+                // block scan works with in-block offsets
+                bm::id_t block_pos = nbit;
+                int found = BM_IS_GAP(block) ?
+                    (int)bm::gap_find_in_block(BMGAP_PTR(block), nbit, &block_pos)
+                  : bm::bit_find_in_block(block, nbit, &block_pos);
+                prev = (size_type(nblock) << bm::set_block_shift) + block_pos;
+                if (found)
+                    return prev;
             }
             else
             {
@@ -3719,25 +5375,31 @@ bm::id_t bvector<Alloc>::check_or_next(bm::id_t prev) const
 //---------------------------------------------------------------------
 
 template<class Alloc> 
-bm::id_t bvector<Alloc>::check_or_next_extract(bm::id_t prev)
+typename bvector<Alloc>::size_type
+bvector<Alloc>::check_or_next_extract(size_type prev)
 {
     if (!blockman_.is_init())
         return 0;
 
     for (;;)
     {
-        unsigned nblock = unsigned(prev >> bm::set_block_shift); 
+        block_idx_type nblock = block_idx_type(prev >> bm::set_block_shift); 
         if (nblock >= bm::set_total_blocks) break;
 
-        if (blockman_.is_subblock_null(nblock >> bm::set_array_shift))
+        unsigned i = unsigned(nblock >> bm::set_array_shift);
+        if (blockman_.is_subblock_null(i))
         {
-            prev += (bm::set_blkblk_mask + 1) -
-                            (prev & bm::set_blkblk_mask);
+            // skip to the next allocated sub-block
+            i = blockman_.find_next_nz_top(i);
+            if (i >= blockman_.top_block_size())
+                break;
+            prev = size_type(i) * bm::bits_in_array;
         }
         else
         {
             unsigned nbit = unsigned(prev & bm::set_block_mask);
 
+            blockman_.unshare_block(nblock);
             int no_more_blocks;
             bm::word_t* block = 
                 blockman_.get_block(nblock, &no_more_blocks);
@@ -3773,9 +5435,12 @@ bm::id_t bvector<Alloc>::check_or_next_extract(bm::id_t prev)
                     }
                     else
                     {
-                        if (bm::gap_find_in_block(BMGAP_PTR(block),
-                                                    nbit,
-                                                    &prev))
+                        bm::id_t block_pos = nbit;
+                        unsigned found = bm::gap_find_in_block(
+                                        BMGAP_PTR(block), nbit, &block_pos);
+                        prev = (size_type(nblock) << bm::set_block_shift) +
+                                                                block_pos;
+                        if (found)
                         {
                             set(prev, false);
                             return prev;
@@ -3784,7 +5449,11 @@ bm::id_t bvector<Alloc>::check_or_next_extract(bm::id_t prev)
                 }
                 else // bit block
                 {
-                    if (bm::bit_find_in_block(block, nbit, &prev)) 
+                    bm::id_t block_pos = nbit;
+                    int found = bm::bit_find_in_block(block, nbit, &block_pos);
+                    prev = (size_type(nblock) << bm::set_block_shift) +
+                                                                block_pos;
+                    if (found)
                     {
                         unsigned nbit1 =
                             unsigned(prev & bm::set_block_mask); 
@@ -3822,31 +5491,73 @@ bm::id_t bvector<Alloc>::check_or_next_extract(bm::id_t prev)
     }
 
 template<class Alloc>
-void bvector<Alloc>::combine_operation_or(const bm::bvector<Alloc>& bv)
+unsigned
+bvector<Alloc>::combine_operation_prepare(const bm::bvector<Alloc>& bv,
+                                          bm::operation opcode)
 {
-    if (!bv.blockman_.is_init())
-        return;
+    switch (opcode)
+    {
+    case BM_OR:
+        if (!bv.blockman_.is_init())
+            return 0;
+        break;
+    case BM_AND:
+        if (!blockman_.is_init())
+            return 0;  // nothing to do, already empty
+        if (!bv.blockman_.is_init())
+        {
+            clear(true);
+            return 0;
+        }
+        break;
+    case BM_SUB:
+        if (!blockman_.is_init() || !bv.blockman_.is_init())
+            return 0;
+        break;
+    default:
+        BM_ASSERT(0);
+        return 0;
+    }
 
-    unsigned top_blocks = blockman_.top_block_size();
     if (size_ < bv.size_) // this vect shorter than the arg.
     {
         size_ = bv.size_;
     }
     unsigned arg_top_blocks = bv.blockman_.top_block_size();
-    top_blocks = blockman_.reserve_top_blocks(arg_top_blocks);
+    unsigned top_blocks = blockman_.reserve_top_blocks(arg_top_blocks);
+    if (opcode == BM_OR) // OR can add sub-blocks, prepare their pages
+        blockman_.reserve_top_pages(bv.blockman_);
+    return top_blocks;
+}
 
-    
-    bm::word_t*** blk_root = blockman_.top_blocks_root();
-    bm::word_t*** blk_root_arg = bv.blockman_.top_blocks_root();
+//---------------------------------------------------------------------
 
-    for (unsigned i = 0; i < top_blocks; ++i)
+template<class Alloc>
+void bvector<Alloc>::combine_operation_or(const bm::bvector<Alloc>& bv)
+{
+    unsigned top_blocks = combine_operation_prepare(bv, BM_OR);
+    combine_operation_or_top_range(bv, 0, top_blocks);
+}
+
+//---------------------------------------------------------------------
+
+template<class Alloc>
+void bvector<Alloc>::combine_operation_or_top_range(
+                                        const bm::bvector<Alloc>& bv,
+                                        unsigned top_from, unsigned top_to)
+{
+    BM_ASSERT(top_to <= blockman_.top_block_size());
+
+    // nothing to do where argument is empty (X OR 0 == X)
+    for (unsigned i = bv.blockman_.find_next_nz_top(top_from); i < top_to;
+                                    i = bv.blockman_.find_next_nz_top(i + 1))
     {
-        bm::word_t** blk_blk = blk_root[i];
-        bm::word_t** blk_blk_arg = (i < arg_top_blocks) ? blk_root_arg[i] : 0;
-        if (blk_blk == blk_blk_arg || !blk_blk_arg) // nothing to do (0 OR 0 == 0)
+        bm::word_t** blk_blk = blockman_.get_topblock(i);
+        const bm::word_t* const* blk_blk_arg = bv.blockman_.get_topblock(i);
+        if (blk_blk == blk_blk_arg) // shared group (X OR X == X)
             continue;
-        if (!blk_blk)
-            blk_blk = blockman_.alloc_top_subblock(i);
+        blk_blk = blk_blk ? blockman_.unshare_subblock(i)
+                          : blockman_.alloc_top_subblock(i);
 
         unsigned j = 0;
         bm::word_t* blk;
@@ -3884,41 +5595,36 @@ void bvector<Alloc>::combine_operation_or(const bm::bvector<Alloc>& bv)
             blockman_.zero_block(i, j+x); \
     }
 
-template<class Alloc>
-void bvector<Alloc>::combine_operation_and(const bm::bvector<Alloc>& bv)
-{
-    if (!blockman_.is_init())
-        return;  // nothing to do, already empty
-    if (!bv.blockman_.is_init())
-    {
-        clear(true);
-        return;
-    }
-
-    unsigned top_blocks = blockman_.top_block_size();
-    if (size_ < bv.size_) // this vect shorter than the arg.
-    {
-        size_ = bv.size_;
-    }
-    unsigned arg_top_blocks = bv.blockman_.top_block_size();
-    top_blocks = blockman_.reserve_top_blocks(arg_top_blocks);
+template<class Alloc>
+void bvector<Alloc>::combine_operation_and(const bm::bvector<Alloc>& bv)
+{
+    unsigned top_blocks = combine_operation_prepare(bv, BM_AND);
+    combine_operation_and_top_range(bv, 0, top_blocks);
+}
 
-    
-    bm::word_t*** blk_root = blockman_.top_blocks_root();
-    bm::word_t*** blk_root_arg = bv.blockman_.top_blocks_root();
+//---------------------------------------------------------------------
 
-    for (unsigned i = 0; i < top_blocks; ++i)
+template<class Alloc>
+void bvector<Alloc>::combine_operation_and_top_range(
+                                        const bm::bvector<Alloc>& bv,
+                                        unsigned top_from, unsigned top_to)
+{
+    BM_ASSERT(top_to <= blockman_.top_block_size());
+
+    // nothing to do where this vector is empty (0 AND 1 == 0)
+    for (unsigned i = blockman_.find_next_nz_top(top_from); i < top_to;
+                                    i = blockman_.find_next_nz_top(i + 1))
     {
-        bm::word_t** blk_blk = blk_root[i];
-        if (!blk_blk) // nothing to do (0 AND 1 == 0)
-            continue;
-        bm::word_t** blk_blk_arg = (i < arg_top_blocks) ? blk_root_arg[i] : 0;
+        bm::word_t** blk_blk = blockman_.get_topblock(i);
+        const bm::word_t* const* blk_blk_arg = bv.blockman_.get_topblock(i);
         if (!blk_blk_arg) // free a whole group of blocks
         {
-            for (unsigned j = 0; j < bm::set_array_size; ++j)
-                blockman_.zero_block(i, j);
+            blockman_.free_top_subblock(i);
             continue;
         }
+        if (blk_blk == blk_blk_arg) // shared group (X AND X == X)
+            continue;
+        blk_blk = blockman_.unshare_subblock(i);
         unsigned j = 0;
         bm::word_t* blk;
         const bm::word_t* arg_blk;
@@ -3961,28 +5667,33 @@ void bvector<Alloc>::combine_operation_and(const bm::bvector<Alloc>& bv)
 template<class Alloc>
 void bvector<Alloc>::combine_operation_sub(const bm::bvector<Alloc>& bv)
 {
-    if (!blockman_.is_init())
-        return;  
-    if (!bv.blockman_.is_init())
-        return;
+    unsigned top_blocks = combine_operation_prepare(bv, BM_SUB);
+    combine_operation_sub_top_range(bv, 0, top_blocks);
+}
 
-    unsigned top_blocks = blockman_.top_block_size();
-    if (size_ < bv.size_) // this vect shorter than the arg.
-    {
-        size_ = bv.size_;
-    }
-    unsigned arg_top_blocks = bv.blockman_.top_block_size();
-    top_blocks = blockman_.reserve_top_blocks(arg_top_blocks);
+//---------------------------------------------------------------------
 
-    bm::word_t*** blk_root = blockman_.top_blocks_root();
-    bm::word_t*** blk_root_arg = bv.blockman_.top_blocks_root();
+template<class Alloc>
+void bvector<Alloc>::combine_operation_sub_top_range(
+                                        const bm::bvector<Alloc>& bv,
+                                        unsigned top_from, unsigned top_to)
+{
+    BM_ASSERT(top_to <= blockman_.top_block_size());
 
-    for (unsigned i = 0; i < top_blocks; ++i)
+    // nothing to do where this vector is empty (0 AND NOT 1 == 0)
+    for (unsigned i = blockman_.find_next_nz_top(top_from); i < top_to;
+                                    i = blockman_.find_next_nz_top(i + 1))
     {
-        bm::word_t** blk_blk = blk_root[i];
-        bm::word_t** blk_blk_arg = (i < arg_top_blocks) ? blk_root_arg[i] : 0;
-        if (!blk_blk || !blk_blk_arg) // nothing to do (0 AND NOT 1 == 0)
+        bm::word_t** blk_blk = blockman_.get_topblock(i);
+        const bm::word_t* const* blk_blk_arg = bv.blockman_.get_topblock(i);
+        if (!blk_blk_arg) // nothing to do (X AND NOT 0 == X)
             continue;
+        if (blk_blk == blk_blk_arg) // shared group (X AND NOT X == 0)
+        {
+            blockman_.free_top_subblock(i);
+            continue;
+        }
+        blk_blk = blockman_.unshare_subblock(i);
         bm::word_t* blk;
         const bm::word_t* arg_blk;
         unsigned j = 0;
@@ -4016,6 +5727,175 @@ void bvector<Alloc>::combine_operation_sub(const bm::bvector<Alloc>& bv)
 
 //---------------------------------------------------------------------
 
+template<class Alloc>
+void bvector<Alloc>::combine_operation_range(const bm::bvector<Alloc>& bv,
+                                             size_type left, size_type right,
+                                             bm::operation opcode)
+{
+    if (right < left)
+        bm::xor_swap(left, right);
+    BM_ASSERT_THROW(right < bm::id_max, BM_ERR_RANGE);
+
+    switch (opcode)
+    {
+    case BM_OR:
+        if (!bv.blockman_.is_init())
+            return;
+        if (!blockman_.is_init())
+            blockman_.init_tree();
+        {
+            size_type arg_size = (right < bv.size_) ? right + 1 : bv.size_;
+            if (size_ < arg_size)
+                size_ = arg_size;
+        }
+        break;
+    case BM_AND:
+        if (!blockman_.is_init())
+            return;
+        if (!bv.blockman_.is_init())
+        {
+            if (left < size_)
+                clear_range_no_check(left, right < size_ ? right : size_ - 1);
+            return;
+        }
+        break;
+    case BM_SUB:
+        if (!blockman_.is_init() || !bv.blockman_.is_init())
+            return;
+        break;
+    default:
+        BM_ASSERT(0);
+        return;
+    }
+
+    block_idx_type nb_left = (left >> bm::set_block_shift);
+    block_idx_type nb_right = (right >> bm::set_block_shift);
+    unsigned nbit_left = unsigned(left & bm::set_block_mask);
+    unsigned nbit_right = unsigned(right & bm::set_block_mask);
+
+    unsigned i_from = unsigned(nb_left >> bm::set_array_shift);
+    unsigned i_to = unsigned(nb_right >> bm::set_array_shift);
+    unsigned arg_top_blocks = bv.blockman_.top_block_size();
+    unsigned top_blocks = blockman_.top_block_size();
+    if ((opcode != BM_AND && !arg_top_blocks) ||
+        (opcode != BM_OR && !top_blocks))
+        return;
+    if (opcode == BM_OR)
+    {
+        if (i_to >= arg_top_blocks)
+            i_to = arg_top_blocks - 1;
+        if (i_to >= top_blocks)
+            top_blocks = blockman_.reserve_top_blocks(i_to + 1);
+    }
+    else
+    if (i_to >= top_blocks)
+        i_to = top_blocks - 1;
+
+    // groups empty in the argument (OR) or in this vector (AND, SUB)
+    // are skipped
+    const blocks_manager_type& bman_nz =
+                            (opcode == BM_OR) ? bv.blockman_ : blockman_;
+
+    BM_DECLARE_TEMP_BLOCK(tb)
+    for (unsigned i = bman_nz.find_next_nz_top(i_from); i <= i_to;
+                                        i = bman_nz.find_next_nz_top(i + 1))
+    {
+        bm::word_t** blk_blk = blockman_.get_topblock(i);
+        const bm::word_t* const* blk_blk_arg = bv.blockman_.get_topblock(i);
+        if (blk_blk == blk_blk_arg) // shared or both empty
+        {
+            if (!blk_blk || opcode != BM_SUB)
+                continue; // (X OR X == X), (X AND X == X)
+        }
+        switch (opcode)
+        {
+        case BM_OR:
+            if (!blk_blk_arg)
+                continue;
+            blk_blk = blk_blk ? blockman_.unshare_subblock(i)
+                              : blockman_.alloc_top_subblock(i);
+            break;
+        default: // AND, SUB
+            if (!blk_blk || (!blk_blk_arg && opcode == BM_SUB))
+                continue;
+            blk_blk = blockman_.unshare_subblock(i);
+            break;
+        }
+
+        unsigned j_from = (i == i_from) ?
+                            unsigned(nb_left & bm::set_array_mask) : 0;
+        unsigned j_to = (i == unsigned(nb_right >> bm::set_array_shift)) ?
+                unsigned(nb_right & bm::set_array_mask) : bm::set_array_mask;
+        for (unsigned j = j_from; j <= j_to; ++j)
+        {
+            bm::word_t* blk = blk_blk[j];
+            const bm::word_t* arg_blk = blk_blk_arg ? blk_blk_arg[j] : 0;
+            if (opcode == BM_OR ? !arg_blk : !blk)
+                continue;
+
+            // edge blocks: argument gets masked by the range
+            //
+            block_idx_type nb = (block_idx_type(i) << bm::set_array_shift) + j;
+            unsigned l = (nb == nb_left) ? nbit_left : 0;
+            unsigned r = (nb == nb_right) ? nbit_right : bm::gap_max_bits - 1;
+            if (l || r != bm::gap_max_bits - 1)
+            {
+                if (!arg_blk)
+                {
+                    if (opcode != BM_AND)
+                        continue;
+                    bm::bit_block_set(tb, 0); // AND clears the range
+                }
+                else
+                if (BM_IS_GAP(arg_blk))
+                    bm::gap_convert_to_bitset(tb, BMGAP_PTR(arg_blk));
+                else
+                if (IS_FULL_BLOCK(arg_blk))
+                    bm::bit_block_set(tb, ~0u);
+                else
+                    bm::bit_block_copy(tb, arg_blk);
+                if (opcode == BM_AND)
+                {
+                    if (l)
+                        bm::or_bit_block(tb, 0, l);
+                    if (r != bm::gap_max_bits - 1)
+                        bm::or_bit_block(tb, r + 1, bm::gap_max_bits - 1 - r);
+                }
+                else
+                {
+                    if (l)
+                        bm::sub_bit_block(tb, 0, l);
+                    if (r != bm::gap_max_bits - 1)
+                        bm::sub_bit_block(tb, r + 1, bm::gap_max_bits - 1 - r);
+                    if (bm::bit_is_all_zero(tb))
+                        continue;
+                }
+                arg_blk = tb;
+            }
+
+            switch (opcode)
+            {
+            case BM_OR:
+                if (blk != arg_blk)
+                    combine_operation_block_or(i, j, blk, arg_blk);
+                break;
+            case BM_AND:
+                if (arg_blk)
+                    combine_operation_block_and(i, j, blk, arg_blk);
+                else
+                    blockman_.zero_block(i, j);
+                break;
+            default: // SUB
+                if (arg_blk)
+                    combine_operation_block_sub(i, j, blk, arg_blk);
+                break;
+            }
+        } // for j
+    } // for i
+}
+
+//---------------------------------------------------------------------
+
 template<class Alloc> 
 void bvector<Alloc>::combine_operation(
                                   const bm::bvector<Alloc>& bv,
@@ -4057,7 +5937,6 @@ void bvector<Alloc>::combine_operation(
         }
     }
     
-    bm::word_t*** blk_root = blockman_.top_blocks_root();
     unsigned block_idx = 0;
     unsigned i, j;
 
@@ -4073,18 +5952,23 @@ void bvector<Alloc>::combine_operation(
 
     for (i = 0; i < top_blocks; ++i)
     {
-        bm::word_t** blk_blk = blk_root[i];
+        bm::word_t** blk_blk = blockman_.get_topblock(i);
         if (blk_blk == 0) // not allocated
         {
-            if (opcode == BM_AND) // 0 AND anything == 0
-            {
-                block_idx += bm::set_array_size;
-                continue; 
-            }
-            const bm::word_t* const* bvbb = bv.blockman_.get_topblock(i);
+            // 0 AND anything == 0
+            const bm::word_t* const* bvbb =
+                (opcode == BM_AND) ? 0 : bv.blockman_.get_topblock(i);
             if (bvbb == 0) // skip it because 0 OP 0 == 0 
             {
-                block_idx += bm::set_array_size;
+                // up to the next allocated group
+                unsigned i_next = blockman_.find_next_nz_top(i);
+                if (opcode != BM_AND)
+                    i_next = bm::min_value(i_next,
+                                           bv.blockman_.find_next_nz_top(i));
+                if (i_next > top_blocks)
+                    i_next = top_blocks;
+                block_idx += (i_next - i) * bm::set_array_size;
+                i = i_next - 1;
                 continue; 
             }
             // 0 - self, non-zero argument
@@ -4100,6 +5984,7 @@ void bvector<Alloc>::combine_operation(
             } // for j
             continue;
         }
+        blk_blk = blockman_.unshare_subblock(i);
 
         if (opcode == BM_AND)
         {
@@ -4390,11 +6275,15 @@ void bvector<Alloc>::combine_operation_block_sub(
                     blockman_.zero_block(i, j);
                 return;
             }
-            // the worst case: convert arg block to bitset
-            arg_blk =
-                gap_convert_to_bitset_smart(blockman_.check_allocate_tempblock(),
-                                            BMGAP_PTR(arg_blk),
-                                            bm::gap_max_bits);
+            // FULL - GAP: subtract into a new bit-block
+            // (no shared temp block, safe for disjoint parallel ranges)
+            bm::word_t* new_blk = blockman_.get_allocator().alloc_bit_block();
+            bm::bit_block_set(new_blk, ~0u);
+            bm::gap_sub_to_bitset(new_blk, BMGAP_PTR(arg_blk));
+            blockman_.set_block_ptr(i, j, new_blk);
+            if (bm::bit_is_all_zero(new_blk))
+                blockman_.zero_block(i, j);
+            return;
         }
     }
 
@@ -4424,7 +6313,7 @@ void bvector<Alloc>::combine_operation_block_sub(
 
 template<class Alloc> 
 void 
-bvector<Alloc>::combine_operation_with_block(unsigned          nb,
+bvector<Alloc>::combine_operation_with_block(block_idx_type    nb,
                                              bool              gap,
                                              bm::word_t*       blk,
                                              const bm::word_t* arg_blk,
@@ -4608,7 +6497,7 @@ bvector<Alloc>::combine_operation_with_block(unsigned          nb,
 
 template<class Alloc>
 void bvector<Alloc>::assign_gap_result(
-                       unsigned              nb,
+                       block_idx_type        nb,
                        const bm::gap_word_t* res,
                        unsigned              res_len,
                        bm::word_t*           blk,
@@ -4714,14 +6603,105 @@ void bvector<Alloc>::assign_gap_result(
 }
 
 
+//---------------------------------------------------------------------
+
+template<typename Alloc>
+void bvector<Alloc>::import_intervals(const size_type* starts,
+                                      const size_type* ends,
+                                      size_type        size)
+{
+    BM_ASSERT(starts && ends);
+    if (!size)
+        return;
+    
+    bool sorted = (starts[0] <= ends[0]);
+    for (size_type i = 1; i < size && sorted; ++i)
+        sorted = (starts[i] <= ends[i]) && (starts[i] > ends[i-1]);
+    if (!sorted)
+    {
+        for (size_type i = 0; i < size; ++i)
+            set_range(starts[i], ends[i]);
+        return;
+    }
+    
+    size_type right = ends[size-1];
+    BM_ASSERT_THROW(right < bm::id_max, BM_ERR_RANGE);
+    if (!blockman_.is_init())
+        blockman_.init_tree();
+    if (right >= size_)
+        resize(right + 1);
+    
+    blockman_.unshare_range(block_idx_type(starts[0] >> bm::set_block_shift),
+                            block_idx_type(right >> bm::set_block_shift));
+    
+    const gap_word_t* glen = blockman_.glen();
+    const size_type max_runs = (glen[bm::gap_max_level] - 4 - 2) / 2;
+    bm::gap_word_t BM_VECT_ALIGN gap_temp[bm::gap_max_buff_len]
+                                                    BM_VECT_ALIGN_ATTR;
+    
+    block_idx_type nb = block_idx_type(starts[0] >> bm::set_block_shift);
+    for (size_type i = 0; i < size; )
+    {
+        size_type base = size_type(nb) << bm::set_block_shift;
+        block_idx_type nb_to = block_idx_type(ends[i] >> bm::set_block_shift);
+        bool last_full =
+            ((ends[i] & bm::set_block_mask) == bm::set_block_mask);
+        bm::word_t* block;
+        if (starts[i] <= base && (nb < nb_to || last_full))
+        {
+            // blocks covered by the interval
+            for (nb_to += last_full; nb < nb_to; ++nb)
+            {
+                block = blockman_.get_block(nb);
+                if (IS_FULL_BLOCK(block))
+                    continue;
+                blockman_.set_block_all_set(nb);
+            } // for
+        }
+        else
+        {
+            // intervals of the block make one GAP block
+            size_type block_last = base + (bm::gap_max_bits - 1);
+            size_type stop = i + 1;
+            for (; stop < size && (stop - i) < max_runs; ++stop)
+            {
+                if (starts[stop] > block_last)
+                    break;
+            }
+            gap_temp[0] = 0;
+            bm::gap_set_intervals(gap_temp, starts, ends, i, stop, base);
+            block = blockman_.get_block(nb);
+            if (!IS_FULL_BLOCK(block))
+                combine_operation_with_block(nb, BM_IS_GAP(block), block,
+                                             (bm::word_t*) gap_temp,
+                                             1, BM_OR);
+            if (stop < size && starts[stop] <= block_last)
+            {
+                i = stop; // GAP buffer limit: continue with the same block
+                continue;
+            }
+            ++nb;
+        }
+        // skip intervals done with, jump to the next interval's block
+        for (; i < size; ++i)
+        {
+            if (block_idx_type(ends[i] >> bm::set_block_shift) >= nb)
+                break;
+        }
+        if (i < size &&
+            block_idx_type(starts[i] >> bm::set_block_shift) > nb)
+            nb = block_idx_type(starts[i] >> bm::set_block_shift);
+    } // for i
+}
+
 //---------------------------------------------------------------------
 
 template<class Alloc> 
-void bvector<Alloc>::set_range_no_check(bm::id_t left,
-                                        bm::id_t right)
+void bvector<Alloc>::set_range_no_check(size_type left,
+                                        size_type right)
 {
-    unsigned nblock_left  = unsigned(left  >>  bm::set_block_shift);
-    unsigned nblock_right = unsigned(right >>  bm::set_block_shift);
+    block_idx_type nblock_left  = block_idx_type(left  >>  bm::set_block_shift);
+    block_idx_type nblock_right = block_idx_type(right >>  bm::set_block_shift);
 
     unsigned nbit_right = unsigned(right & bm::set_block_mask);
 
@@ -4731,9 +6711,11 @@ void bvector<Alloc>::set_range_no_check(bm::id_t left,
     bm::gap_word_t tmp_gap_blk[5];
     tmp_gap_blk[0] = 0; // just to silence GCC warning on uninit var
 
+    blockman_.unshare_range(nblock_left, nblock_right);
+
     // Set bits in the starting block
 
-    unsigned nb;
+    block_idx_type nb;
     bm::word_t* block; //= blockman_.get_block(nblock_left);
     unsigned nbit_left  = unsigned(left  & bm::set_block_mask);
     if ((nbit_left == 0) && (r == bm::bits_in_block - 1)) // full block
@@ -4760,7 +6742,7 @@ void bvector<Alloc>::set_range_no_check(bm::id_t left,
 
     // Set all full blocks between left and right
     //
-    unsigned nb_to = nblock_right + (nbit_right ==(bm::bits_in_block-1));
+    block_idx_type nb_to = nblock_right + (nbit_right ==(bm::bits_in_block-1));
     for (; nb < nb_to; ++nb)
     {
         block = blockman_.get_block(nb);
@@ -4789,14 +6771,14 @@ void bvector<Alloc>::set_range_no_check(bm::id_t left,
 //---------------------------------------------------------------------
 
 template<class Alloc>
-void bvector<Alloc>::clear_range_no_check(bm::id_t left,
-                                          bm::id_t right)
+void bvector<Alloc>::clear_range_no_check(size_type left,
+                                          size_type right)
 {
-    unsigned nb;
+    block_idx_type nb;
 
     // calculate logical number of start and destination blocks
-    unsigned nblock_left = unsigned(left >> bm::set_block_shift);
-    unsigned nblock_right = unsigned(right >> bm::set_block_shift);
+    block_idx_type nblock_left = block_idx_type(left >> bm::set_block_shift);
+    block_idx_type nblock_right = block_idx_type(right >> bm::set_block_shift);
 
     unsigned nbit_right = unsigned(right & bm::set_block_mask);
     unsigned r =
@@ -4804,6 +6786,8 @@ void bvector<Alloc>::clear_range_no_check(bm::id_t left,
 
     bm::gap_word_t tmp_gap_blk[5];
     tmp_gap_blk[0] = 0; // just to silence GCC warning on uninit var
+
+    blockman_.unshare_range(nblock_left, nblock_right);
   
     // Set bits in the starting block
     bm::word_t* block;// = blockman_.get_block(nblock_left);
@@ -4834,7 +6818,7 @@ void bvector<Alloc>::clear_range_no_check(bm::id_t left,
 
     // Clear all full blocks between left and right
 
-    unsigned nb_to = nblock_right + (nbit_right == (bm::bits_in_block - 1));
+    block_idx_type nb_to = nblock_right + (nbit_right == (bm::bits_in_block - 1));
     for (; nb < nb_to; ++nb)
     {
         int no_more_blocks;
@@ -4845,7 +6829,20 @@ void bvector<Alloc>::clear_range_no_check(bm::id_t left,
             return;
         }
         if (!block)  // nothing to do
+        {
+            unsigned i = unsigned(nb >> bm::set_array_shift);
+            if (blockman_.is_subblock_null(i))
+            {
+                i = blockman_.find_next_nz_top(i);
+                if (i >= blockman_.top_block_size())
+                    return;
+                block_idx_type nb_next = block_idx_type(i) << bm::set_array_shift;
+                if (nb_next >= nb_to)
+                    break;
+                nb = nb_next - 1;
+            }
             continue;
+        }
         blockman_.zero_block(nb);
     } // for
 
@@ -4871,8 +6868,8 @@ void bvector<Alloc>::clear_range_no_check(bm::id_t left,
 
 template<class Alloc>
 void bvector<Alloc>::copy_range(const bvector<Alloc>& bvect,
-                                bm::id_t left,
-                                bm::id_t right)
+                                size_type left,
+                                size_type right)
 {
     if (!bvect.blockman_.is_init())
     {
@@ -4895,15 +6892,15 @@ void bvector<Alloc>::copy_range(const bvector<Alloc>& bvect,
 
 template<class Alloc>
 void bvector<Alloc>::copy_range_no_check(const bvector<Alloc>& bvect,
-                                         bm::id_t left,
-                                         bm::id_t right)
+                                         size_type left,
+                                         size_type right)
 {
     BM_ASSERT(left <= right);
     BM_ASSERT_THROW(right < bm::id_max, BM_ERR_RANGE);
     
     // copy all block(s) belonging to our range
-    unsigned nblock_left  = unsigned(left  >>  bm::set_block_shift);
-    unsigned nblock_right = unsigned(right >>  bm::set_block_shift);
+    block_idx_type nblock_left  = block_idx_type(left  >>  bm::set_block_shift);
+    block_idx_type nblock_right = block_idx_type(right >>  bm::set_block_shift);
     
     blockman_.copy(bvect.blockman_, nblock_left, nblock_right);
     
@@ -4911,7 +6908,7 @@ void bvector<Alloc>::copy_range_no_check(const bvector<Alloc>& bvect,
     //
     if (left)
     {
-        bm::id_t from =
+        size_type from =
             (left + bm::gap_max_bits >= left) ? 0u : left - bm::gap_max_bits;
         clear_range_no_check(from, left-1);
     }
@@ -4938,7 +6935,8 @@ void bvector<Alloc>::throw_bad_alloc()
 //---------------------------------------------------------------------
 
 inline
-rs_index::rs_index(const rs_index& rsi) BMNOEXEPT
+rs_index::rs_index(const rs_index& rsi)
+    : total_blocks(0), sb_rcount_(0), sb_(0), sb_size_(0)
 {
     copy_from(rsi);
 }
@@ -4948,20 +6946,97 @@ rs_index::rs_index(const rs_index& rsi) BMNOEXEPT
 inline
 void rs_index::init() BMNOEXEPT
 {
-    ::memset(this->bcount, 0, sizeof(this->bcount));
-    ::memset(this->subcount, 0, sizeof(this->subcount));
-
+    for (unsigned i = 0; i < sb_size_; ++i)
+        bm::aligned_free(sb_[i]);
+    bm::aligned_free(sb_);
+    sb_ = 0; sb_rcount_ = 0; sb_size_ = 0;
     this->total_blocks = 0;
 }
 
 //---------------------------------------------------------------------
 
 inline
-void rs_index::copy_from(const rs_index& rsi) BMNOEXEPT
+void rs_index::copy_from(const rs_index& rsi)
+{
+    init();
+    resize(rsi.sb_size_);
+    for (unsigned i = 0; i < sb_size_; ++i)
+    {
+        sb_rcount_[i+1] = rsi.sb_rcount_[i+1];
+        if (rsi.sb_[i])
+            ::memcpy(get_sb(i), rsi.sb_[i], sizeof(sb_counts));
+    }
+}
+
+//---------------------------------------------------------------------
+
+inline
+void rs_index::resize(unsigned sb_size)
+{
+    BM_ASSERT(sb_size <= bm::set_total_blocks32 / bm::set_array_size);
+    if (sb_size <= sb_size_)
+        return;
+    // super-block pointers and running counts share one allocation
+    sb_counts** sb_new = (sb_counts**) bm::aligned_new_malloc(
+            sb_size * sizeof(sb_counts*) + (sb_size + 1) * sizeof(unsigned));
+    unsigned* rcount_new = (unsigned*)(sb_new + sb_size);
+    rcount_new[0] = 0;
+    unsigned cnt = count();
+    for (unsigned i = 0; i < sb_size; ++i)
+    {
+        if (i < sb_size_)
+        {
+            rcount_new[i+1] = sb_rcount_[i+1];
+            sb_new[i] = sb_[i];
+        }
+        else
+        {
+            rcount_new[i+1] = cnt;
+            sb_new[i] = 0;
+        }
+    }
+    bm::aligned_free(sb_);
+    sb_rcount_ = rcount_new; sb_ = sb_new; sb_size_ = sb_size;
+    this->total_blocks = sb_size * bm::set_array_size;
+}
+
+//---------------------------------------------------------------------
+
+inline
+rs_index::sb_counts* rs_index::get_sb(unsigned i)
 {
-    ::memcpy(this->bcount, rsi.bcount, sizeof(this->bcount));
-    ::memcpy(this->subcount, rsi.subcount, sizeof(this->subcount));
-    this->total_blocks = rsi.total_blocks;
+    BM_ASSERT(i < sb_size_);
+    if (!sb_[i])
+    {
+        sb_[i] = (sb_counts*) bm::aligned_new_malloc(sizeof(sb_counts));
+        ::memset(sb_[i], 0, sizeof(sb_counts));
+    }
+    return sb_[i];
+}
+
+//---------------------------------------------------------------------
+
+inline
+void rs_index::build_running_counts()
+{
+    unsigned cnt = 0;
+    for (unsigned i = 0; i < sb_size_; ++i)
+    {
+        sb_counts* sb = sb_[i];
+        if (sb)
+        {
+            for (unsigned j = 1; j < bm::set_array_size; ++j)
+                sb->bcount[j] += sb->bcount[j-1];
+            if (!sb->bcount[bm::set_array_size-1]) // all blocks empty
+            {
+                bm::aligned_free(sb);
+                sb_[i] = 0;
+            }
+            else
+                cnt += sb->bcount[bm::set_array_size-1];
+        }
+        sb_rcount_[i+1] = cnt;
+    } // for i
 }
 
 //---------------------------------------------------------------------
@@ -4969,8 +7044,122 @@ void rs_index::copy_from(const rs_index& rsi) BMNOEXEPT
 inline
 unsigned rs_index::count(unsigned nb) const
 {
-    return (nb == 0) ? bcount[nb]
-                     : bcount[nb] - bcount[nb-1];
+    unsigned i = nb >> bm::set_array_shift;
+    if (i >= sb_size_ || !sb_[i])
+        return 0;
+    unsigned j = nb & bm::set_array_mask;
+    const unsigned* bcount = sb_[i]->bcount;
+    return (j == 0) ? bcount[j] : bcount[j] - bcount[j-1];
+}
+
+//---------------------------------------------------------------------
+
+inline
+unsigned rs_index::rcount(unsigned nb) const
+{
+    unsigned i = nb >> bm::set_array_shift;
+    if (i >= sb_size_)
+        return count();
+    unsigned cnt = sb_rcount_[i];
+    const sb_counts* sb = sb_[i];
+    return sb ? cnt + sb->bcount[nb & bm::set_array_mask] : cnt;
+}
+
+//---------------------------------------------------------------------
+
+inline
+const rs_index::sb_pair_type& rs_index::sub_count(unsigned nb) const
+{
+    unsigned i = nb >> bm::set_array_shift;
+    BM_ASSERT(i < sb_size_ && sb_[i]);
+    return sb_[i]->subcount[nb & bm::set_array_mask];
+}
+
+//---------------------------------------------------------------------
+
+inline
+unsigned rs_index::find(unsigned rank) const
+{
+    BM_ASSERT(rank && rank <= count());
+    unsigned i = bm::lower_bound(sb_rcount_ + 1, rank, 0, sb_size_-1);
+    rank -= sb_rcount_[i];
+    const sb_counts* sb = sb_[i];
+    BM_ASSERT(sb);
+    unsigned j = bm::lower_bound(sb->bcount, rank, 0, bm::set_array_size-1);
+    return (i << bm::set_array_shift) + j;
+}
+
+//---------------------------------------------------------------------
+
+inline
+void rs_index::add(unsigned nb, int delta)
+{
+    unsigned i = nb >> bm::set_array_shift;
+    sb_counts* sb = sb_[i];
+    BM_ASSERT(sb);
+    for (unsigned j = nb & bm::set_array_mask; j < bm::set_array_size; ++j)
+        sb->bcount[j] += unsigned(delta);
+    for (unsigned k = i + 1; k <= sb_size_; ++k)
+        sb_rcount_[k] += unsigned(delta);
+    if (!sb->bcount[bm::set_array_size-1]) // super-block became empty
+    {
+        bm::aligned_free(sb);
+        sb_[i] = 0;
+    }
+}
+
+//---------------------------------------------------------------------
+
+inline
+void rs_index::set_block(unsigned nb, unsigned cnt,
+                         bm::gap_word_t first, bm::gap_word_t second)
+{
+    BM_ASSERT(nb < bm::set_total_blocks32);
+    unsigned i = nb >> bm::set_array_shift;
+    if (i >= sb_size_ || !sb_[i])
+    {
+        if (!cnt)
+            return;
+        resize(i + 1);
+    }
+    unsigned cnt_prev = count(nb);
+    sb_counts* sb = get_sb(i);
+    sb_pair_type& sc = sb->subcount[nb & bm::set_array_mask];
+    sc.first = first; sc.second = second;
+    if (cnt != cnt_prev)
+        add(nb, int(cnt - cnt_prev));
+}
+
+//---------------------------------------------------------------------
+
+inline
+void rs_index::update_bit(unsigned nb, unsigned nbit, bool val)
+{
+    BM_ASSERT(nb < bm::set_total_blocks32);
+    BM_ASSERT(nbit < bm::gap_max_bits);
+    unsigned i = nb >> bm::set_array_shift;
+    resize(i + 1);
+    sb_counts* sb = get_sb(i);
+    sb_pair_type& sc = sb->subcount[nb & bm::set_array_mask];
+    bm::gap_word_t d = val ? bm::gap_word_t(1) : bm::gap_word_t(-1);
+    if (nbit <= bm::rs3_border0)
+        sc.first = bm::gap_word_t(sc.first + d);
+    else
+    if (nbit <= bm::rs3_border1)
+        sc.second = bm::gap_word_t(sc.second + d);
+    add(nb, val ? 1 : -1);
+}
+
+//---------------------------------------------------------------------
+
+inline
+size_t rs_index::memory_used() const
+{
+    size_t mem = sizeof(rs_index) +
+                 sb_size_ * (sizeof(unsigned) + sizeof(sb_counts*));
+    for (unsigned i = 0; i < sb_size_; ++i)
+        mem += sb_[i] ? sizeof(sb_counts) : 0;
+    return mem;
 }
 
 //---------------------------------------------------------------------
@@ -4988,12 +7177,13 @@ unsigned rs_index::find_sub_range(unsigned block_bit_pos) const
 inline
 bm::gap_word_t rs_index::select_sub_range(unsigned nb, unsigned& rank) const
 {
-    if (rank > this->subcount[nb].first)
+    const sb_pair_type& sc = sub_count(nb);
+    if (rank > sc.first)
     {
-        rank -= this->subcount[nb].first;
-        if (rank > this->subcount[nb].second)
+        rank -= sc.first;
+        if (rank > sc.second)
         {
-            rank -= this->subcount[nb].second;
+            rank -= sc.second;
             return rs3_border1 + 1;
         }
         else
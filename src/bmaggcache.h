@@ -0,0 +1,342 @@
+#ifndef BMAGGCACHE__H__INCLUDED__
+#define BMAGGCACHE__H__INCLUDED__
+/*
+Copyright(c) 2002-2017 Anatoliy Kuznetsov(anatoliy_kuznetsov at yahoo.com)
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+For more information please visit:  http://bitmagic.io
+*/
+
+/*! \file bmaggcache.h
+    \brief Result cache for aggregator queries (C++11, uses STL)
+*/
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+
+#include "bm.h"
+#include "bmaggregator.h"
+
+namespace bm
+{
+
+/**
+    \brief Result cache in front of bm::aggregator
+
+    Results of OR, AND and AND-SUB queries are kept in compressed
+    (optimized and frozen) form and reused when the same query comes back.
+    Query key is the set of argument vectors: address plus modification
+    epoch of every argument (see bvector::epoch()), so modification of an
+    argument automatically invalidates all results computed from it
+    (stale entries are no longer reachable and age out of LRU).
+    AND and SUB groups are commutative, argument order does not matter.
+
+    Cache has a memory budget, least recently used results get evicted
+    when it is exceeded. Hit returns a copy-on-write copy of the result
+    (no block copy until the target gets modified).
+
+    Cache is not thread safe.
+
+    @ingroup setalgo
+*/
+template<typename BV>
+class aggregator_cache
+{
+public:
+    typedef BV                            bvector_type;
+    typedef typename BV::size_type        size_type;
+    typedef const bvector_type*           bvector_type_const_ptr;
+    typedef bm::aggregator<BV>            aggregator_type;
+
+public:
+    /**
+        \param memory_budget - max memory (bytes) used by cached results
+    */
+    explicit aggregator_cache(size_t memory_budget = 64 * 1024 * 1024)
+    : memory_budget_(memory_budget)
+    {}
+
+    /*! @name Cached logical operations (see bm::aggregator) */
+    //@{
+
+    /**
+        Aggregate group of vectors using logical OR
+        \param bv_target - target vector
+        \param bv_src    - array of pointers on bit-vector aggregate arguments
+        \param src_size  - size of bv_src
+    */
+    void combine_or(bvector_type& bv_target,
+                    const bvector_type_const_ptr* bv_src, unsigned src_size)
+    {
+        combine(bv_target, e_or, bv_src, src_size, 0, 0);
+    }
+
+    /**
+        Aggregate group of vectors using logical AND
+        \sa combine_or
+    */
+    void combine_and(bvector_type& bv_target,
+                     const bvector_type_const_ptr* bv_src, unsigned src_size)
+    {
+        combine(bv_target, e_and, bv_src, src_size, 0, 0);
+    }
+
+    /**
+        Fusion aggregate group of vectors using logical AND MINUS another set
+        \return true when found
+    */
+    bool combine_and_sub(bvector_type& bv_target,
+                     const bvector_type_const_ptr* bv_src_and, unsigned src_and_size,
+                     const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size)
+    {
+        return combine(bv_target, e_and_sub,
+                       bv_src_and, src_and_size, bv_src_sub, src_sub_size);
+    }
+    //@}
+
+    /*! @name Cache management and statistics */
+    //@{
+
+    /// Drop all cached results (counters are not reset)
+    void clear()
+    {
+        map_.clear();
+        lru_.clear();
+        memory_used_ = 0;
+    }
+
+    /// Change memory budget (evicts results if needed)
+    void set_memory_budget(size_t memory_budget)
+    {
+        memory_budget_ = memory_budget;
+        evict();
+    }
+
+    size_t memory_budget() const { return memory_budget_; }
+    /// memory used by cached results
+    size_t memory_used() const { return memory_used_; }
+    /// number of cached results
+    size_t size() const { return lru_.size(); }
+
+    /// number of queries served from cache
+    size_type hits() const { return hits_; }
+    /// number of queries computed by aggregator
+    size_type misses() const { return misses_; }
+    /// number of results evicted to fit the memory budget
+    size_type evictions() const { return evictions_; }
+
+    /// Reset hit/miss/eviction counters
+    void reset_counters() { hits_ = misses_ = evictions_ = 0; }
+
+    /// Aggregator used to compute misses
+    aggregator_type& get_aggregator() { return agg_; }
+    //@}
+
+private:
+    enum operation_code { e_or = 0, e_and, e_and_sub };
+
+    /// argument identity: vector address + modification epoch
+    struct arg_key
+    {
+        const bvector_type* bv;
+        bm::id64_t          epoch;
+
+        bool operator==(const arg_key& k) const
+            { return bv == k.bv && epoch == k.epoch; }
+        bool operator<(const arg_key& k) const
+            { return bv < k.bv || (bv == k.bv && epoch < k.epoch); }
+    };
+
+    struct query_key
+    {
+        unsigned             op;
+        unsigned             group0_size; ///< size of the first args group
+        std::vector<arg_key> args;
+
+        bool operator==(const query_key& k) const
+        {
+            return op == k.op && group0_size == k.group0_size &&
+                   args == k.args;
+        }
+    };
+
+    struct query_key_hash
+    {
+        size_t operator()(const query_key& k) const
+        {
+            bm::id64_t h = (bm::id64_t(k.op) << 32) ^ k.group0_size;
+            for (size_t i = 0; i < k.args.size(); ++i)
+            {
+                h ^= bm::id64_t(size_t(k.args[i].bv)) + k.args[i].epoch;
+                h *= 0x9E3779B97F4A7C15ull; // Fibonacci hashing
+                h ^= h >> 29;
+            }
+            return size_t(h);
+        }
+    };
+
+    struct entry
+    {
+        query_key    key;
+        bvector_type result;
+        size_t       memory;
+    };
+
+    typedef std::list<entry>                           lru_list_type;
+    typedef typename lru_list_type::iterator           lru_iterator;
+    typedef std::unordered_map<query_key, lru_iterator,
+                               query_key_hash>         map_type;
+
+private:
+    bool combine(bvector_type& bv_target, operation_code op,
+                 const bvector_type_const_ptr* bv_src0, unsigned src0_size,
+                 const bvector_type_const_ptr* bv_src1, unsigned src1_size);
+
+    /// add arguments to the key, returns max argument size
+    static
+    size_type add_args(query_key& key,
+                  const bvector_type_const_ptr* bv_src, unsigned src_size);
+
+    void evict();
+
+    aggregator_cache(const aggregator_cache&) = delete;
+    aggregator_cache& operator=(const aggregator_cache&) = delete;
+
+private:
+    aggregator_type  agg_;
+    map_type         map_;
+    lru_list_type    lru_;              ///< most recently used first
+    query_key        key_;              ///< key of the current query
+    size_t           memory_budget_;
+    size_t           memory_used_ = 0;
+    size_type        hits_ = 0;
+    size_type        misses_ = 0;
+    size_type        evictions_ = 0;
+};
+
+
+// ------------------------------------------------------------------------
+//
+// ------------------------------------------------------------------------
+
+
+template<typename BV>
+typename aggregator_cache<BV>::size_type
+aggregator_cache<BV>::add_args(query_key& key,
+                               const bvector_type_const_ptr* bv_src,
+                               unsigned src_size)
+{
+    size_type size = 0;
+    size_t from = key.args.size();
+    for (unsigned k = 0; k < src_size; ++k)
+    {
+        const bvector_type* bv = bv_src[k];
+        arg_key ak = { bv, bv->epoch() };
+        key.args.push_back(ak);
+        if (bv->size() > size)
+            size = bv->size();
+    }
+    std::sort(key.args.begin() + from, key.args.end());
+    return size;
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+bool aggregator_cache<BV>::combine(bvector_type& bv_target, operation_code op,
+                    const bvector_type_const_ptr* bv_src0, unsigned src0_size,
+                    const bvector_type_const_ptr* bv_src1, unsigned src1_size)
+{
+    key_.op = op;
+    key_.group0_size = src0_size;
+    key_.args.resize(0);
+
+    // target size harmonization (the same way aggregator does it)
+    size_type target_size = bv_target.size();
+    size_type arg_size = add_args(key_, bv_src0, src0_size);
+    if (arg_size > target_size)
+        target_size = arg_size;
+    arg_size = add_args(key_, bv_src1, src1_size);
+    if (arg_size > target_size)
+        target_size = arg_size;
+
+    typename map_type::iterator it = map_.find(key_);
+    if (it != map_.end())
+    {
+        ++hits_;
+        lru_iterator lit = it->second;
+        lru_.splice(lru_.begin(), lru_, lit); // move to the front
+        bv_target = lit->result;
+    }
+    else
+    {
+        ++misses_;
+        bvector_type bv_res;
+        switch (op)
+        {
+        case e_or:
+            agg_.combine_or(bv_res, bv_src0, src0_size);
+            break;
+        case e_and:
+            agg_.combine_and(bv_res, bv_src0, src0_size);
+            break;
+        default:
+            agg_.combine_and_sub(bv_res, bv_src0, src0_size,
+                                 bv_src1, src1_size, false);
+            break;
+        } // switch
+
+        bv_res.optimize();
+        bv_res.freeze();
+        typename bvector_type::statistics st;
+        bv_res.calc_stat(&st);
+        bv_target = bv_res;
+
+        if (st.memory_used <= memory_budget_)
+        {
+            lru_.push_front(entry());
+            entry& e = lru_.front();
+            e.key = key_;
+            e.result.swap(bv_res);
+            e.memory = st.memory_used;
+            memory_used_ += e.memory;
+            map_[key_] = lru_.begin();
+            evict();
+        }
+    }
+    if (target_size != bv_target.size())
+        bv_target.resize(target_size);
+    return bv_target.any();
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+void aggregator_cache<BV>::evict()
+{
+    while (memory_used_ > memory_budget_ && !lru_.empty())
+    {
+        entry& e = lru_.back();
+        map_.erase(e.key);
+        memory_used_ -= e.memory;
+        lru_.pop_back();
+        ++evictions_;
+    }
+}
+
+} // namespace bm
+
+#endif
@@ -52,13 +52,28 @@ class aggregator
 {
 public:
     typedef BV                         bvector_type;
+    typedef typename BV::size_type     size_type;
     typedef const bvector_type*        bvector_type_const_ptr;
     typedef bm::id64_t                 digest_type;
 
     /// Maximum aggregation capacity in one pass
     enum max_size
     {
-        max_aggregator_cap = 256
+        max_aggregator_cap = 256,
+        max_vcount_planes = 8 ///< counter planes (bits) to count max_aggregator_cap-1 args
+    };
+
+    /**
+        Fused AND-SUB query of a batch (see combine_and_sub_batch()).
+        Arguments are indexes in the argument table shared by the batch.
+    */
+    struct batch_query
+    {
+        const unsigned* and_idx;   ///< AND group (argument indexes)
+        unsigned        and_size;  ///< size of the AND group
+        const unsigned* sub_idx;   ///< SUB group (argument indexes)
+        unsigned        sub_size;  ///< size of the SUB group
+        bvector_type*   bv_target; ///< query result
     };
 
     
@@ -134,7 +149,59 @@ public:
     */
     bool combine_and_sub(bvector_type& bv_target, bool any);
     
-    bool find_first_and_sub(bm::id_t& idx);
+    bool find_first_and_sub(size_type& idx);
+
+    /**
+        Population count of fused logical AND-SUB of the added groups,
+        target vector is not built.
+        Operation does NOT performm an explicit reset of arg group(s)
+
+        \param limit - counting stops when the count reaches the limit
+                       (useful for threshold checks)
+        \return population count (partial, >= limit if stopped early)
+
+        @sa add, reset
+    */
+    size_type count_and_sub(size_type limit = bm::id_max);
+
+    /**
+        Population count of logical OR of the added group,
+        target vector is not built.
+        Operation does NOT performm an explicit reset of arg group(s)
+
+        \param limit - counting stops when the count reaches the limit
+        \return population count (partial, >= limit if stopped early)
+
+        @sa add, reset
+    */
+    size_type count_or(size_type limit = bm::id_max);
+
+    /**
+        Aggregate added group of vectors using threshold logic:
+        target bit is set when it is set in at least k vectors of the group
+        (k of N, majority vote if k = N/2+1)
+        Operation does NOT performm an explicit reset of arg group(s)
+
+        \param bv_target - target vector (input is arg group 0)
+        \param k - threshold (k=1 is OR, k=N is AND)
+
+        @sa add, reset
+    */
+    void combine_threshold(bvector_type& bv_target, unsigned k);
+
+    /**
+        Vertical count of the added group: for every bit position compute
+        number of vectors where it is set
+        Operation does NOT performm an explicit reset of arg group(s)
+
+        \param sv_target - target sparse vector of counts, size is set by
+                           the last set bit of the group
+                           (value type should fit the group size)
+
+        @sa add, reset, combine_threshold
+    */
+    template<class SV>
+    void combine_vcount(SV& sv_target);
 
     //@}
     
@@ -178,15 +245,251 @@ public:
                      const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size,
                      bool any);
     
-    bool find_first_and_sub(bm::id_t& idx,
+    bool find_first_and_sub(size_type& idx,
                      const bvector_type_const_ptr* bv_src_and, unsigned src_and_size,
                      const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size);
 
+    /**
+        Population count of fused AND MINUS (no target vector)
+     
+        \param bv_src_and    - array of pointers on bit-vectors for AND
+        \param src_and_size  - size of AND group
+        \param bv_src_sub    - array of pointers on bit-vectors for SUBstract
+        \param src_sub_size  - size of SUB group
+        \param limit         - counting stops when the count reaches the limit
+     
+        \return population count (partial, >= limit if stopped early)
+    */
+    size_type count_and_sub(
+                     const bvector_type_const_ptr* bv_src_and, unsigned src_and_size,
+                     const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size,
+                     size_type limit = bm::id_max);
+
+    /**
+        Population count of OR of a group of vectors (no target vector)
+     
+        \param bv_src    - array of pointers on bit-vector aggregate arguments
+        \param src_size  - size of bv_src
+        \param limit     - counting stops when the count reaches the limit
+     
+        \return population count (partial, >= limit if stopped early)
+    */
+    size_type count_or(const bvector_type_const_ptr* bv_src, unsigned src_size,
+                       size_type limit = bm::id_max);
+
+    /**
+        Threshold aggregation (bit is set in at least k vectors)
+        using bit-sliced vertical counters
+     
+        \param bv_target - target vector
+        \param bv_src    - array of pointers on bit-vector aggregate arguments
+        \param src_size  - size of bv_src
+        \param k         - threshold
+    */
+    void combine_threshold(bvector_type& bv_target,
+                           const bvector_type_const_ptr* bv_src,
+                           unsigned src_size, unsigned k);
+
+    /**
+        Vertical count of a group of vectors into a sparse vector
+     
+        \param sv_target - target sparse vector of counts
+        \param bv_src    - array of pointers on bit-vector aggregate arguments
+        \param src_size  - size of bv_src
+    */
+    template<class SV>
+    void combine_vcount(SV& sv_target,
+                        const bvector_type_const_ptr* bv_src, unsigned src_size);
+
+    /**
+        Vertical count of a group of vectors into bit-plains
+        (bit-plain p receives bit p of the count of each position)
+     
+        \param bv_plains   - array of target plain vectors
+        \param plains_size - size of bv_plains, must fit src_size
+                             (plains above the count width are cleared)
+        \param bv_src      - array of pointers on bit-vector aggregate arguments
+        \param src_size    - size of bv_src
+     
+        \return number of significant plains
+    */
+    unsigned combine_vcount(bvector_type* const* bv_plains, unsigned plains_size,
+                            const bvector_type_const_ptr* bv_src, unsigned src_size);
     
     //@}
 
     // -----------------------------------------------------------------------
 
+    /*! @name Batch operations */
+    //@{
+
+    /**
+        Run a batch of fused AND-SUB queries in one pass over the blocks.
+        Each block of the shared argument table is fetched once and all
+        queries are evaluated on it while it is hot in CPU cache.
+     
+        \param bv_args     - table of bit-vector arguments shared by queries
+        \param args_size   - size of bv_args
+        \param queries     - array of queries (targets must be distinct and
+                             should not be the arguments)
+        \param query_count - size of queries
+    */
+    void combine_and_sub_batch(const bvector_type_const_ptr* bv_args,
+                               unsigned args_size,
+                               const batch_query* queries,
+                               unsigned query_count);
+    //@}
+
+    // -----------------------------------------------------------------------
+
+    /*! @name Range restricted operations (C-style interface)
+        Only blocks intersecting the closed range [left, right] are
+        processed, target gets no bits outside of the range.
+    */
+    //@{
+
+    /**
+        Aggregate group of vectors using logical OR on a range
+        \param bv_target - target vector
+        \param bv_src    - array of pointers on bit-vector aggregate arguments
+        \param src_size  - size of bv_src
+        \param left      - range start
+        \param right     - range end
+    */
+    void combine_or(bvector_type& bv_target,
+                    const bvector_type_const_ptr* bv_src, unsigned src_size,
+                    size_type left, size_type right);
+
+    /**
+        Aggregate group of vectors using logical AND on a range
+        \sa combine_or
+    */
+    void combine_and(bvector_type& bv_target,
+                     const bvector_type_const_ptr* bv_src, unsigned src_size,
+                     size_type left, size_type right);
+
+    /**
+        Fusion aggregate AND MINUS on a range
+        \param any - flag if caller needs any results asap (incomplete results)
+        \return true when found
+        \sa combine_or
+    */
+    bool combine_and_sub(bvector_type& bv_target,
+                     const bvector_type_const_ptr* bv_src_and, unsigned src_and_size,
+                     const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size,
+                     size_type left, size_type right,
+                     bool any);
+    //@}
+
+    // -----------------------------------------------------------------------
+
+    /*! @name Operations on ranges of top level blocks
+        Building blocks for multi-threaded execution (see bm::parallel):
+        target is prepared once (resize_target()), then disjoint ranges
+        [top_from, top_to) can be processed concurrently by different
+        aggregator instances (each has its own arena).
+    */
+    //@{
+
+    /**
+        Aggregate range of top level blocks using logical OR
+        \param bv_target - target vector (prepared by resize_target())
+        \param bv_src    - array of pointers on bit-vector aggregate arguments
+        \param src_size  - size of bv_src
+        \param top_from  - first top level block index
+        \param top_to    - top level block index to stop (not included)
+    */
+    void combine_or_top_range(bvector_type& bv_target,
+                              const bvector_type_const_ptr* bv_src,
+                              unsigned src_size,
+                              unsigned top_from, unsigned top_to);
+
+    /**
+        Aggregate range of top level blocks using logical AND
+        \sa combine_or_top_range
+    */
+    void combine_and_top_range(bvector_type& bv_target,
+                               const bvector_type_const_ptr* bv_src,
+                               unsigned src_size,
+                               unsigned top_from, unsigned top_to);
+
+    /**
+        Fused AND-SUB aggregation of a range of top level blocks
+        \return true when found
+        \sa combine_and_sub, combine_or_top_range
+    */
+    bool combine_and_sub_top_range(bvector_type& bv_target,
+                     const bvector_type_const_ptr* bv_src_and, unsigned src_and_size,
+                     const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size,
+                     unsigned top_from, unsigned top_to,
+                     bool any);
+
+    /**
+        Find first bit of fused AND-SUB in a range of top level blocks
+        \return true when found
+        \sa find_first_and_sub, combine_or_top_range
+    */
+    bool find_first_and_sub_top_range(size_type& idx,
+                     const bvector_type_const_ptr* bv_src_and, unsigned src_and_size,
+                     const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size,
+                     unsigned top_from, unsigned top_to);
+
+    /**
+        Prepare target vector: clear (optional), harmonize size and
+        reserve top level of the blocks tree
+        \return number of top level blocks to process
+    */
+    static
+    unsigned resize_target(bvector_type& bv_target,
+                           const bvector_type_const_ptr* bv_src,
+                           unsigned src_size,
+                           bool init_clear = true);
+
+    /**
+        Maximum top level size of the arguments
+        \return number of top level blocks to process
+    */
+    static
+    unsigned max_top_blocks(const bvector_type_const_ptr* bv_src,
+                            unsigned src_size);
+
+    /**
+        Find the next top level block allocated in any of the arguments
+        \return top level block index or bm::set_top_array_size
+    */
+    static
+    unsigned find_next_nz_top_or(unsigned i,
+                                 const bvector_type_const_ptr* bv_src,
+                                 unsigned src_size);
+
+    /**
+        Find the next top level block allocated in all of the arguments
+        \return top level block index or bm::set_top_array_size
+    */
+    static
+    unsigned find_next_nz_top_and(unsigned i,
+                                  const bvector_type_const_ptr* bv_src,
+                                  unsigned src_size);
+
+    /**
+        Order AND arguments by estimated selectivity (number of allocated
+        blocks, sparse first) and find the top level range where all
+        of them have blocks (AND result can not leave it)
+        \param bv_sorted - [out] arguments in processing order
+        \param top_from  - [out] first top level block to process
+        \param top_to    - [out] last top level block to process (+1)
+        \return false if AND result is known to be empty
+    */
+    static
+    bool sort_input_vectors_and(const bvector_type_const_ptr* bv_src,
+                                unsigned src_size,
+                                bvector_type_const_ptr* bv_sorted,
+                                unsigned* top_from, unsigned* top_to);
+
+    //@}
+
+    // -----------------------------------------------------------------------
+
     /*! @name Horizontal Logical operations used for tests (C-style interface) */
     //@{
     
@@ -239,12 +542,21 @@ protected:
                          const bvector_type_const_ptr* bv_src_and, unsigned src_and_size,
                          const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size);
 
-    static
-    unsigned resize_target(bvector_type& bv_target,
+    digest_type combine_and_sub_batch(const bm::word_t* const* blk_cache,
+                                      const batch_query& q);
+
+    unsigned count_and_sub(unsigned i, unsigned j,
+                         const bvector_type_const_ptr* bv_src_and, unsigned src_and_size,
+                         const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size);
+
+    unsigned count_or(unsigned i, unsigned j,
+                      const bvector_type_const_ptr* bv_src, unsigned src_size);
+
+    void combine_threshold(unsigned i, unsigned j,
+                           bvector_type& bv_target,
                            const bvector_type_const_ptr* bv_src,
-                           unsigned src_size,
-                           bool init_clear = true);
-    
+                           unsigned src_size, unsigned k);
+
     bm::word_t* sort_input_blocks_or(const bvector_type_const_ptr* bv_src,
                                      unsigned src_size,
                                      unsigned i, unsigned j,
@@ -257,12 +569,22 @@ protected:
                                       unsigned* arg_blk_count,
                                       unsigned* arg_blk_gap_count);
 
-    bool process_bit_blocks_or(blocks_manager_type& bman_target,
-                               unsigned i, unsigned j, unsigned block_count);
+    unsigned sort_input_blocks_vcount(const bvector_type_const_ptr* bv_src,
+                                      unsigned src_size,
+                                      unsigned i, unsigned j,
+                                      unsigned* arg_blk_count,
+                                      unsigned* arg_blk_gap_count);
+
+    unsigned process_blocks_vcount(unsigned block_count,
+                                   unsigned gap_block_count);
+
+    bool process_bit_blocks_or(unsigned block_count);
 
-    bool process_gap_blocks_or(blocks_manager_type& bman_target,
-                               unsigned i, unsigned j, unsigned block_count);
+    bool process_gap_blocks_or(unsigned block_count);
     
+    digest_type process_blocks_and(unsigned block_count,
+                                   unsigned gap_block_count);
+
     digest_type process_bit_blocks_and(unsigned block_count, digest_type digest);
     
     digest_type process_gap_blocks_and(unsigned block_count, digest_type digest);
@@ -275,6 +597,21 @@ protected:
     unsigned find_effective_sub_block_size(unsigned i,
                                            const bvector_type_const_ptr* bv_src,
                                            unsigned src_size);
+
+    /**
+        Second level blocks range [j_from, j_to] of top level block i
+        within the closed bit range [left, right]
+    */
+    static
+    void block_range(unsigned i, size_type left, size_type right,
+                     unsigned* j_from, unsigned* j_to);
+
+    /**
+        Clear bits of the range edge blocks outside [left, right]
+    */
+    static
+    void clear_range_edges(bvector_type& bv_target,
+                           size_type left, size_type right);
     
 private:
     /// Memory arena for logical operations
@@ -292,6 +629,7 @@ private:
         
         bvector_type_const_ptr arg_bv0[max_aggregator_cap]; ///< arg group 0
         bvector_type_const_ptr arg_bv1[max_aggregator_cap]; ///< arg group 1
+        bvector_type_const_ptr arg_bv_and[max_aggregator_cap]; ///< sorted AND args
     };
     
     aggregator(const aggregator&) = delete;
@@ -299,6 +637,9 @@ private:
     
 private:
     arena*          ar_; ///< data arena ptr (heap allocated)
+    bm::word_t*     vcount_planes_ = 0; ///< vertical counters (on demand)
+    const bm::word_t** batch_blk_ = 0;  ///< batch argument blocks (on demand)
+    unsigned        batch_blk_size_ = 0; ///< capacity of batch_blk_
     unsigned        arg_group0_size = 0;
     unsigned        arg_group1_size = 0;
 };
@@ -322,6 +663,10 @@ aggregator<BV>::~aggregator()
 {
     BM_ASSERT(ar_);
     bm::aligned_free(ar_);
+    if (vcount_planes_)
+        bm::aligned_free(vcount_planes_);
+    if (batch_blk_)
+        bm::aligned_free(batch_blk_);
 }
 
 // ------------------------------------------------------------------------
@@ -395,7 +740,7 @@ bool aggregator<BV>::combine_and_sub(bvector_type& bv_target, bool any)
 // ------------------------------------------------------------------------
 
 template<typename BV>
-bool aggregator<BV>::find_first_and_sub(bm::id_t& idx)
+bool aggregator<BV>::find_first_and_sub(size_type& idx)
 {
     return find_first_and_sub(idx,
                         ar_->arg_bv0, arg_group0_size,
@@ -404,6 +749,41 @@ bool aggregator<BV>::find_first_and_sub(bm::id_t& idx)
 
 // ------------------------------------------------------------------------
 
+template<typename BV>
+typename aggregator<BV>::size_type
+aggregator<BV>::count_and_sub(size_type limit)
+{
+    return count_and_sub(ar_->arg_bv0, arg_group0_size,
+                         ar_->arg_bv1, arg_group1_size, limit);
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+typename aggregator<BV>::size_type
+aggregator<BV>::count_or(size_type limit)
+{
+    return count_or(ar_->arg_bv0, arg_group0_size, limit);
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+void aggregator<BV>::combine_threshold(bvector_type& bv_target, unsigned k)
+{
+    combine_threshold(bv_target, ar_->arg_bv0, arg_group0_size, k);
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV> template<class SV>
+void aggregator<BV>::combine_vcount(SV& sv_target)
+{
+    combine_vcount(sv_target, ar_->arg_bv0, arg_group0_size);
+}
+
+// ------------------------------------------------------------------------
+
 template<typename BV>
 void aggregator<BV>::combine_or(bvector_type& bv_target,
                         const bvector_type_const_ptr* bv_src, unsigned src_size)
@@ -416,7 +796,18 @@ void aggregator<BV>::combine_or(bvector_type& bv_target,
     }
 
     unsigned top_blocks = resize_target(bv_target, bv_src, src_size);
-    for (unsigned i = 0; i < top_blocks; ++i)
+    combine_or_top_range(bv_target, bv_src, src_size, 0, top_blocks);
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+void aggregator<BV>::combine_or_top_range(bvector_type& bv_target,
+                        const bvector_type_const_ptr* bv_src, unsigned src_size,
+                        unsigned top_from, unsigned top_to)
+{
+    for (unsigned i = find_next_nz_top_or(top_from, bv_src, src_size);
+         i < top_to; i = find_next_nz_top_or(i + 1, bv_src, src_size))
     {
         unsigned set_array_max = find_effective_sub_block_size(i, bv_src, src_size);
         unsigned j = 0;
@@ -442,9 +833,25 @@ void aggregator<BV>::combine_and(bvector_type& bv_target,
         return;
     }
 
-    unsigned top_blocks = resize_target(bv_target, bv_src, src_size);
-    
-    for (unsigned i = 0; i < top_blocks; ++i)
+    resize_target(bv_target, bv_src, src_size);
+
+    unsigned top_from, top_to;
+    if (!sort_input_vectors_and(bv_src, src_size, ar_->arg_bv_and,
+                                &top_from, &top_to))
+        return;
+    combine_and_top_range(bv_target, ar_->arg_bv_and, src_size,
+                          top_from, top_to);
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+void aggregator<BV>::combine_and_top_range(bvector_type& bv_target,
+                        const bvector_type_const_ptr* bv_src, unsigned src_size,
+                        unsigned top_from, unsigned top_to)
+{
+    for (unsigned i = find_next_nz_top_and(top_from, bv_src, src_size);
+         i < top_to; i = find_next_nz_top_and(i + 1, bv_src, src_size))
     {
         unsigned set_array_max = find_effective_sub_block_size(i, bv_src, src_size);
         unsigned j = 0;
@@ -467,21 +874,39 @@ bool aggregator<BV>::combine_and_sub(bvector_type& bv_target,
     BM_ASSERT_THROW(src_and_size < max_aggregator_cap, BM_ERR_RANGE);
     BM_ASSERT_THROW(src_sub_size < max_aggregator_cap, BM_ERR_RANGE);
     
-    bool global_found = false;
-
     if (!bv_src_and || !src_and_size)
     {
         bv_target.clear();
         return false;
     }
 
-    unsigned top_blocks = resize_target(bv_target, bv_src_and, src_and_size);
-    unsigned top_blocks2 = resize_target(bv_target, bv_src_sub, src_sub_size, false);
-    
-    if (top_blocks2 > top_blocks)
-        top_blocks = top_blocks2;
+    resize_target(bv_target, bv_src_and, src_and_size);
+    resize_target(bv_target, bv_src_sub, src_sub_size, false);
 
-    for (unsigned i = 0; i < top_blocks; ++i)
+    unsigned top_from, top_to;
+    if (!sort_input_vectors_and(bv_src_and, src_and_size, ar_->arg_bv_and,
+                                &top_from, &top_to))
+        return false;
+    return combine_and_sub_top_range(bv_target,
+                                     ar_->arg_bv_and, src_and_size,
+                                     bv_src_sub, src_sub_size,
+                                     top_from, top_to, any);
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+bool aggregator<BV>::combine_and_sub_top_range(bvector_type& bv_target,
+                 const bvector_type_const_ptr* bv_src_and, unsigned src_and_size,
+                 const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size,
+                 unsigned top_from, unsigned top_to,
+                 bool any)
+{
+    bool global_found = false;
+
+    for (unsigned i = find_next_nz_top_and(top_from, bv_src_and, src_and_size);
+         i < top_to;
+         i = find_next_nz_top_and(i + 1, bv_src_and, src_and_size))
     {
         unsigned set_array_max = find_effective_sub_block_size(i, bv_src_and, src_and_size);
         if (src_sub_size)
@@ -510,58 +935,623 @@ bool aggregator<BV>::combine_and_sub(bvector_type& bv_target,
             ++j;
         } while (j < set_array_max);
     } // for i
-    return global_found;
+    return global_found;
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+void aggregator<BV>::combine_and_sub_batch(const bvector_type_const_ptr* bv_args,
+                                           unsigned args_size,
+                                           const batch_query* queries,
+                                           unsigned query_count)
+{
+    // prepare targets, collect the range of blocks to process
+    //
+    unsigned top_blocks = 0;
+    bvector_type_const_ptr bv_q[max_aggregator_cap];
+    for (unsigned q = 0; q < query_count; ++q)
+    {
+        const batch_query& query = queries[q];
+        BM_ASSERT(query.bv_target);
+        BM_ASSERT_THROW(query.and_size < max_aggregator_cap, BM_ERR_RANGE);
+        BM_ASSERT_THROW(query.sub_size < max_aggregator_cap, BM_ERR_RANGE);
+        if (!query.and_size)
+        {
+            query.bv_target->clear();
+            continue;
+        }
+        for (unsigned k = 0; k < query.and_size; ++k)
+        {
+            BM_ASSERT_THROW(query.and_idx[k] < args_size, BM_ERR_RANGE);
+            bv_q[k] = bv_args[query.and_idx[k]];
+        }
+        unsigned query_top_blocks =
+                resize_target(*query.bv_target, bv_q, query.and_size);
+        for (unsigned k = 0; k < query.sub_size; ++k)
+        {
+            BM_ASSERT_THROW(query.sub_idx[k] < args_size, BM_ERR_RANGE);
+            bv_q[k] = bv_args[query.sub_idx[k]];
+        }
+        resize_target(*query.bv_target, bv_q, query.sub_size, false);
+        if (query_top_blocks > top_blocks)
+            top_blocks = query_top_blocks;
+    } // for q
+
+    if (batch_blk_size_ < args_size)
+    {
+        if (batch_blk_)
+            bm::aligned_free(batch_blk_);
+        batch_blk_ = (const bm::word_t**)
+                bm::aligned_new_malloc(args_size * sizeof(bm::word_t*));
+        batch_blk_size_ = args_size;
+    }
+
+    for (unsigned i = find_next_nz_top_or(0, bv_args, args_size);
+         i < top_blocks; i = find_next_nz_top_or(i + 1, bv_args, args_size))
+    {
+        unsigned set_array_max = find_effective_sub_block_size(i, bv_args, args_size);
+        for (unsigned j = 0; j < set_array_max; ++j)
+        {
+            // fetch argument blocks once for all queries
+            for (unsigned k = 0; k < args_size; ++k)
+                batch_blk_[k] = bv_args[k]->get_blocks_manager().get_block_ptr(i, j);
+
+            for (unsigned q = 0; q < query_count; ++q)
+            {
+                const batch_query& query = queries[q];
+                if (!query.and_size)
+                    continue;
+                digest_type digest = combine_and_sub_batch(batch_blk_, query);
+                if (digest)
+                {
+                    typename bvector_type::blocks_manager_type& bman_target =
+                                        query.bv_target->get_blocks_manager();
+                    bman_target.copy_bit_block(i, j, ar_->tb1);
+                }
+            } // for q
+        } // for j
+    } // for i
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+void aggregator<BV>::combine_or(bvector_type& bv_target,
+                        const bvector_type_const_ptr* bv_src, unsigned src_size,
+                        size_type left, size_type right)
+{
+    BM_ASSERT_THROW(src_size < max_aggregator_cap, BM_ERR_RANGE);
+    if (!src_size)
+    {
+        bv_target.clear();
+        return;
+    }
+    if (right < left)
+        bm::xor_swap(left, right);
+
+    unsigned top_blocks = resize_target(bv_target, bv_src, src_size);
+    if (!top_blocks)
+        return;
+    unsigned top_to = unsigned(right >> (bm::set_block_shift + bm::set_array_shift));
+    if (top_to >= top_blocks)
+        top_to = top_blocks - 1;
+    unsigned i_from = unsigned(left >> (bm::set_block_shift + bm::set_array_shift));
+    for (unsigned i = find_next_nz_top_or(i_from, bv_src, src_size);
+         i <= top_to; i = find_next_nz_top_or(i + 1, bv_src, src_size))
+    {
+        unsigned j_from, j_to;
+        block_range(i, left, right, &j_from, &j_to);
+        unsigned set_array_max = find_effective_sub_block_size(i, bv_src, src_size);
+        if (j_to >= set_array_max)
+            j_to = set_array_max - 1;
+        for (unsigned j = j_from; j <= j_to; ++j)
+            combine_or(i, j, bv_target, bv_src, src_size);
+    } // for i
+    clear_range_edges(bv_target, left, right);
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+void aggregator<BV>::combine_and(bvector_type& bv_target,
+                        const bvector_type_const_ptr* bv_src, unsigned src_size,
+                        size_type left, size_type right)
+{
+    BM_ASSERT_THROW(src_size < max_aggregator_cap, BM_ERR_RANGE);
+    if (!src_size)
+    {
+        bv_target.clear();
+        return;
+    }
+    if (right < left)
+        bm::xor_swap(left, right);
+
+    resize_target(bv_target, bv_src, src_size);
+    unsigned top_from, top_to;
+    if (!sort_input_vectors_and(bv_src, src_size, ar_->arg_bv_and,
+                                &top_from, &top_to))
+        return;
+    bv_src = ar_->arg_bv_and;
+
+    unsigned i = unsigned(left >> (bm::set_block_shift + bm::set_array_shift));
+    if (i < top_from)
+        i = top_from;
+    unsigned i_to = unsigned(right >> (bm::set_block_shift + bm::set_array_shift));
+    if (i_to >= top_to)
+        i_to = top_to - 1;
+    for (i = find_next_nz_top_and(i, bv_src, src_size); i <= i_to;
+         i = find_next_nz_top_and(i + 1, bv_src, src_size))
+    {
+        unsigned j_from, j_to;
+        block_range(i, left, right, &j_from, &j_to);
+        for (unsigned j = j_from; j <= j_to; ++j)
+            combine_and(i, j, bv_target, bv_src, src_size);
+    } // for i
+    clear_range_edges(bv_target, left, right);
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+bool aggregator<BV>::combine_and_sub(bvector_type& bv_target,
+                 const bvector_type_const_ptr* bv_src_and, unsigned src_and_size,
+                 const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size,
+                 size_type left, size_type right,
+                 bool any)
+{
+    BM_ASSERT_THROW(src_and_size < max_aggregator_cap, BM_ERR_RANGE);
+    BM_ASSERT_THROW(src_sub_size < max_aggregator_cap, BM_ERR_RANGE);
+
+    if (!bv_src_and || !src_and_size)
+    {
+        bv_target.clear();
+        return false;
+    }
+    if (right < left)
+        bm::xor_swap(left, right);
+
+    resize_target(bv_target, bv_src_and, src_and_size);
+    resize_target(bv_target, bv_src_sub, src_sub_size, false);
+    unsigned top_from, top_to;
+    if (!sort_input_vectors_and(bv_src_and, src_and_size, ar_->arg_bv_and,
+                                &top_from, &top_to))
+        return false;
+    bv_src_and = ar_->arg_bv_and;
+
+    typename bvector_type::blocks_manager_type& bman_target =
+                                            bv_target.get_blocks_manager();
+    bool global_found = false;
+    unsigned i = unsigned(left >> (bm::set_block_shift + bm::set_array_shift));
+    if (i < top_from)
+        i = top_from;
+    unsigned i_to = unsigned(right >> (bm::set_block_shift + bm::set_array_shift));
+    if (i_to >= top_to)
+        i_to = top_to - 1;
+    for (i = find_next_nz_top_and(i, bv_src_and, src_and_size); i <= i_to;
+         i = find_next_nz_top_and(i + 1, bv_src_and, src_and_size))
+    {
+        unsigned j_from, j_to;
+        block_range(i, left, right, &j_from, &j_to);
+        for (unsigned j = j_from; j <= j_to; ++j)
+        {
+            digest_type digest = combine_and_sub(i, j,
+                                                 bv_src_and, src_and_size,
+                                                 bv_src_sub, src_sub_size);
+            if (!digest)
+                continue;
+            // edge blocks: clear bits outside of the range
+            size_type base_idx =
+                (size_type(i) * bm::set_array_size + j) * bm::gap_max_bits;
+            if (left > base_idx)
+                bm::sub_bit_block(ar_->tb1, 0, unsigned(left - base_idx));
+            if (right < base_idx + bm::gap_max_bits - 1)
+            {
+                unsigned r = unsigned(right - base_idx);
+                bm::sub_bit_block(ar_->tb1, r + 1, bm::gap_max_bits - 1 - r);
+            }
+            digest = bm::update_block_digest0(ar_->tb1, digest);
+            if (digest)
+            {
+                bman_target.copy_bit_block(i, j, ar_->tb1);
+                if (any)
+                    return true;
+                global_found = true;
+            }
+        } // for j
+    } // for i
+    return global_found;
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+void aggregator<BV>::block_range(unsigned i, size_type left, size_type right,
+                                 unsigned* j_from, unsigned* j_to)
+{
+    typedef typename bvector_type::block_idx_type block_idx_type;
+    block_idx_type nb_left = (left >> bm::set_block_shift);
+    block_idx_type nb_right = (right >> bm::set_block_shift);
+    *j_from = (i == unsigned(nb_left >> bm::set_array_shift)) ?
+                unsigned(nb_left & bm::set_array_mask) : 0u;
+    *j_to = (i == unsigned(nb_right >> bm::set_array_shift)) ?
+                unsigned(nb_right & bm::set_array_mask) : bm::set_array_mask;
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+void aggregator<BV>::clear_range_edges(bvector_type& bv_target,
+                                       size_type left, size_type right)
+{
+    size_type size = bv_target.size(); // set_range() must not resize
+    if (!size)
+        return;
+    size_type from = left & ~size_type(bm::set_block_mask);
+    if (from < left && from < size)
+        bv_target.set_range(from, bm::min_value(left - 1, size - 1), false);
+    size_type to = right | size_type(bm::set_block_mask);
+    if (to >= size)
+        to = size - 1;
+    if (right < to)
+        bv_target.set_range(right + 1, to, false);
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+bool aggregator<BV>::find_first_and_sub(size_type& idx,
+                 const bvector_type_const_ptr* bv_src_and, unsigned src_and_size,
+                 const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size)
+{
+    BM_ASSERT_THROW(src_and_size < max_aggregator_cap, BM_ERR_RANGE);
+    BM_ASSERT_THROW(src_sub_size < max_aggregator_cap, BM_ERR_RANGE);
+    
+    if (!bv_src_and || !src_and_size)
+        return false;
+
+    unsigned top_from, top_to;
+    if (!sort_input_vectors_and(bv_src_and, src_and_size, ar_->arg_bv_and,
+                                &top_from, &top_to))
+        return false;
+    return find_first_and_sub_top_range(idx,
+                                        ar_->arg_bv_and, src_and_size,
+                                        bv_src_sub, src_sub_size,
+                                        top_from, top_to);
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+bool aggregator<BV>::find_first_and_sub_top_range(size_type& idx,
+                 const bvector_type_const_ptr* bv_src_and, unsigned src_and_size,
+                 const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size,
+                 unsigned top_from, unsigned top_to)
+{
+    for (unsigned i = find_next_nz_top_and(top_from, bv_src_and, src_and_size);
+         i < top_to;
+         i = find_next_nz_top_and(i + 1, bv_src_and, src_and_size))
+    {
+        unsigned set_array_max = find_effective_sub_block_size(i, bv_src_and, src_and_size);
+        if (src_sub_size)
+        {
+            unsigned set_array_max2 =
+                    find_effective_sub_block_size(i, bv_src_sub, src_sub_size);
+            if (set_array_max2 > set_array_max)
+                set_array_max = set_array_max2;
+        }
+        unsigned j = 0;
+        do
+        {
+            digest_type digest = combine_and_sub(i, j,
+                                                bv_src_and, src_and_size,
+                                                bv_src_sub, src_sub_size);
+            if (digest)
+            {
+                unsigned block_bit_idx = 0;
+                bool found = bm::bit_find_first(ar_->tb1, &block_bit_idx);
+                BM_ASSERT(found);
+                if (found)
+                {
+                    size_type base_idx = size_type(i) * bm::set_array_size * bm::gap_max_bits;
+                    base_idx += j * bm::gap_max_bits;
+                    idx = base_idx + block_bit_idx;
+                }
+                return found;
+            }
+            ++j;
+        } while (j < set_array_max);
+    } // for i
+    return false;
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+typename aggregator<BV>::size_type
+aggregator<BV>::count_and_sub(
+                 const bvector_type_const_ptr* bv_src_and, unsigned src_and_size,
+                 const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size,
+                 size_type limit)
+{
+    BM_ASSERT_THROW(src_and_size < max_aggregator_cap, BM_ERR_RANGE);
+    BM_ASSERT_THROW(src_sub_size < max_aggregator_cap, BM_ERR_RANGE);
+    
+    size_type cnt = 0;
+    if (!bv_src_and || !src_and_size)
+        return cnt;
+
+    // AND result can not leave the common range of AND arguments
+    unsigned top_from, top_to;
+    if (!sort_input_vectors_and(bv_src_and, src_and_size, ar_->arg_bv_and,
+                                &top_from, &top_to))
+        return cnt;
+    bv_src_and = ar_->arg_bv_and;
+    for (unsigned i = find_next_nz_top_and(top_from, bv_src_and, src_and_size);
+         i < top_to;
+         i = find_next_nz_top_and(i + 1, bv_src_and, src_and_size))
+    {
+        unsigned set_array_max =
+                find_effective_sub_block_size(i, bv_src_and, src_and_size);
+        for (unsigned j = 0; j < set_array_max; ++j)
+        {
+            cnt += count_and_sub(i, j,
+                                 bv_src_and, src_and_size,
+                                 bv_src_sub, src_sub_size);
+            if (cnt >= limit)
+                return cnt;
+        } // for j
+    } // for i
+    return cnt;
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+typename aggregator<BV>::size_type
+aggregator<BV>::count_or(const bvector_type_const_ptr* bv_src,
+                         unsigned src_size,
+                         size_type limit)
+{
+    BM_ASSERT_THROW(src_size < max_aggregator_cap, BM_ERR_RANGE);
+
+    size_type cnt = 0;
+    unsigned top_blocks = max_top_blocks(bv_src, src_size);
+    for (unsigned i = find_next_nz_top_or(0, bv_src, src_size);
+         i < top_blocks; i = find_next_nz_top_or(i + 1, bv_src, src_size))
+    {
+        unsigned set_array_max =
+                find_effective_sub_block_size(i, bv_src, src_size);
+        for (unsigned j = 0; j < set_array_max; ++j)
+        {
+            cnt += count_or(i, j, bv_src, src_size);
+            if (cnt >= limit)
+                return cnt;
+        } // for j
+    } // for i
+    return cnt;
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+void aggregator<BV>::combine_threshold(bvector_type& bv_target,
+                                       const bvector_type_const_ptr* bv_src,
+                                       unsigned src_size, unsigned k)
+{
+    BM_ASSERT_THROW(src_size < max_aggregator_cap, BM_ERR_RANGE);
+
+    if (!src_size || k > src_size)
+    {
+        bv_target.clear();
+        return;
+    }
+    if (k <= 1)
+    {
+        combine_or(bv_target, bv_src, src_size);
+        if (!k) // at least 0 of N: everything
+            bv_target.invert();
+        return;
+    }
+    if (k == src_size)
+    {
+        combine_and(bv_target, bv_src, src_size);
+        return;
+    }
+
+    unsigned top_blocks = resize_target(bv_target, bv_src, src_size);
+    for (unsigned i = find_next_nz_top_or(0, bv_src, src_size);
+         i < top_blocks; i = find_next_nz_top_or(i + 1, bv_src, src_size))
+    {
+        unsigned top_count = 0;
+        for (unsigned n = 0; n < src_size; ++n)
+            top_count += bool(bv_src[n]->get_blocks_manager().get_topblock(i));
+        if (top_count < k)
+            continue; // not enough arguments to reach the threshold
+
+        unsigned set_array_max = find_effective_sub_block_size(i, bv_src, src_size);
+        for (unsigned j = 0; j < set_array_max; ++j)
+            combine_threshold(i, j, bv_target, bv_src, src_size, k);
+    } // for i
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV> template<class SV>
+void aggregator<BV>::combine_vcount(SV& sv_target,
+                                    const bvector_type_const_ptr* bv_src,
+                                    unsigned src_size)
+{
+    BM_ASSERT_THROW(src_size < max_aggregator_cap, BM_ERR_RANGE);
+
+    sv_target.clear();
+    if (!src_size)
+        return;
+
+    size_type sv_size = 0;
+    for (unsigned k = 0; k < src_size; ++k)
+    {
+        size_type last;
+        if (bv_src[k]->find_reverse(last) && last >= sv_size)
+            sv_size = last + 1;
+    }
+    if (!sv_size)
+        return;
+
+    unsigned plane_count = bm::bit_scan_reverse(src_size) + 1;
+    BM_ASSERT_THROW(plane_count <= SV::plains(), BM_ERR_RANGE);
+
+    bvector_type* bv_plains[max_vcount_planes];
+    for (unsigned p = 0; p < plane_count; ++p)
+        bv_plains[p] = sv_target.get_plain(p);
+    combine_vcount(bv_plains, plane_count, bv_src, src_size);
+
+    sv_target.resize(sv_size);
+    if (sv_target.is_nullable()) // counts are defined for all positions
+        sv_target.get_plain(SV::plains())->set_range(0, sv_size - 1);
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+unsigned aggregator<BV>::combine_vcount(bvector_type* const* bv_plains,
+                                        unsigned plains_size,
+                                        const bvector_type_const_ptr* bv_src,
+                                        unsigned src_size)
+{
+    BM_ASSERT_THROW(src_size < max_aggregator_cap, BM_ERR_RANGE);
+
+    unsigned plane_count = src_size ? bm::bit_scan_reverse(src_size) + 1 : 0;
+    BM_ASSERT_THROW(plane_count <= plains_size, BM_ERR_RANGE);
+
+    unsigned top_blocks = 0;
+    for (unsigned p = 0; p < plains_size; ++p)
+    {
+        BM_ASSERT(bv_plains[p]);
+        if (p < plane_count)
+            top_blocks = resize_target(*bv_plains[p], bv_src, src_size);
+        else
+            bv_plains[p]->clear();
+    }
+
+    for (unsigned i = find_next_nz_top_or(0, bv_src, src_size);
+         i < top_blocks; i = find_next_nz_top_or(i + 1, bv_src, src_size))
+    {
+        unsigned set_array_max = find_effective_sub_block_size(i, bv_src, src_size);
+        for (unsigned j = 0; j < set_array_max; ++j)
+        {
+            unsigned arg_blk_count = 0;
+            unsigned arg_blk_gap_count = 0;
+            unsigned full_count =
+                sort_input_blocks_vcount(bv_src, src_size, i, j,
+                                         &arg_blk_count, &arg_blk_gap_count);
+            for (; full_count; --full_count)
+                ar_->v_arg_blk[arg_blk_count++] = FULL_BLOCK_REAL_ADDR;
+            if (!arg_blk_count && !arg_blk_gap_count)
+                continue;
+
+            unsigned pc = process_blocks_vcount(arg_blk_count, arg_blk_gap_count);
+            for (unsigned p = 0; p < pc; ++p)
+            {
+                const bm::word_t* plane = vcount_planes_ + p * bm::set_block_size;
+                if (!bm::bit_is_all_zero(plane))
+                    bv_plains[p]->get_blocks_manager().copy_bit_block(i, j, plane);
+            } // for p
+        } // for j
+    } // for i
+    return plane_count;
 }
 
 // ------------------------------------------------------------------------
 
 template<typename BV>
-bool aggregator<BV>::find_first_and_sub(bm::id_t& idx,
+unsigned aggregator<BV>::count_and_sub(unsigned i, unsigned j,
                  const bvector_type_const_ptr* bv_src_and, unsigned src_and_size,
                  const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size)
 {
-    BM_ASSERT_THROW(src_and_size < max_aggregator_cap, BM_ERR_RANGE);
-    BM_ASSERT_THROW(src_sub_size < max_aggregator_cap, BM_ERR_RANGE);
-    
-    if (!bv_src_and || !src_and_size)
-        return false;
+    unsigned arg_blk_and_count = 0;
+    unsigned arg_blk_and_gap_count = 0;
+    unsigned arg_blk_sub_count = 0;
+    unsigned arg_blk_sub_gap_count = 0;
 
-    BV bv_target; // TODO: get rid of it
-    unsigned top_blocks = resize_target(bv_target, bv_src_and, src_and_size);
-    unsigned top_blocks2 = resize_target(bv_target, bv_src_sub, src_sub_size, false);
+    bm::word_t* blk = sort_input_blocks_and(bv_src_and, src_and_size,
+                                            i, j,
+                                   &arg_blk_and_count, &arg_blk_and_gap_count);
+    if (!blk) // nothing to do - golden block(!)
+        return 0;
     
-    if (top_blocks2 > top_blocks)
-        top_blocks = top_blocks2;
-
-    for (unsigned i = 0; i < top_blocks; ++i)
+    // two arguments of the operation: count without a temp block
+    if (!arg_blk_and_gap_count && arg_blk_and_count <= 2)
     {
-        unsigned set_array_max = find_effective_sub_block_size(i, bv_src_and, src_and_size);
+        const bm::word_t* blk1 = arg_blk_and_count ?
+                                    ar_->v_arg_blk[0] : FULL_BLOCK_REAL_ADDR;
+        const bm::word_t* blk2 = (arg_blk_and_count == 2) ?
+                                    ar_->v_arg_blk[1] : 0;
         if (src_sub_size)
         {
-            unsigned set_array_max2 =
-                    find_effective_sub_block_size(i, bv_src_sub, src_sub_size);
-            if (set_array_max2 > set_array_max)
-                set_array_max = set_array_max2;
+            blk = sort_input_blocks_or(bv_src_sub, src_sub_size,
+                                       i, j,
+                                &arg_blk_sub_count, &arg_blk_sub_gap_count);
+            if (blk == FULL_BLOCK_FAKE_ADDR)
+                return 0;
         }
-        unsigned j = 0;
-        do
+        if (!arg_blk_sub_gap_count)
         {
-            digest_type digest = combine_and_sub(i, j,
-                                                bv_src_and, src_and_size,
-                                                bv_src_sub, src_sub_size);
-            if (digest)
+            switch (arg_blk_sub_count)
             {
-                bool found = bm::bit_find_first(ar_->tb1, &idx);
-                BM_ASSERT(found);
-                unsigned base_idx = i * bm::set_array_size * bm::gap_max_bits;
-                base_idx += j * bm::gap_max_bits;
-                idx += base_idx;
-                return found;
-            }
-            ++j;
-        } while (j < set_array_max);
-    } // for i
-    return false;
+            case 0:
+                return blk2 ? bm::bit_block_and_count(blk1, blk2)
+                            : bm::bit_block_count(blk1);
+            case 1:
+                if (!blk2)
+                    return bm::bit_block_sub_count(blk1, ar_->v_arg_blk[0]);
+                break;
+            default:
+                break;
+            } // switch
+        }
+    }
+    
+    digest_type digest = combine_and_sub(i, j,
+                                         bv_src_and, src_and_size,
+                                         bv_src_sub, src_sub_size);
+    return digest ? bm::bit_block_count(ar_->tb1, digest) : 0;
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+unsigned aggregator<BV>::count_or(unsigned i, unsigned j,
+                                  const bvector_type_const_ptr* bv_src,
+                                  unsigned src_size)
+{
+    unsigned arg_blk_count = 0;
+    unsigned arg_blk_gap_count = 0;
+    bm::word_t* blk =
+        sort_input_blocks_or(bv_src, src_size, i, j,
+                             &arg_blk_count, &arg_blk_gap_count);
+    if (blk == FULL_BLOCK_FAKE_ADDR) // golden block
+        return bm::gap_max_bits;
+    
+    if (!arg_blk_gap_count)
+    {
+        switch (arg_blk_count) // count without a temp block
+        {
+        case 0: return 0;
+        case 1: return bm::bit_block_count(ar_->v_arg_blk[0]);
+        case 2: return bm::bit_block_or_count(ar_->v_arg_blk[0],
+                                              ar_->v_arg_blk[1]);
+        default: break;
+        }
+    }
+    else
+    if (arg_blk_gap_count == 1 && !arg_blk_count)
+        return bm::gap_bit_count_unr(ar_->v_arg_blk_gap[0]);
+    
+    bool all_one = process_bit_blocks_or(arg_blk_count);
+    if (!all_one && arg_blk_gap_count)
+        all_one = process_gap_blocks_or(arg_blk_gap_count);
+    return all_one ? bm::gap_max_bits : bm::bit_block_count(ar_->tb1);
 }
 
 // ------------------------------------------------------------------------
@@ -625,20 +1615,15 @@ void aggregator<BV>::combine_or(unsigned i, unsigned j,
         blk = ar_->tb1;
         if (arg_blk_count || arg_blk_gap_count)
         {
-            bool all_one =
-                process_bit_blocks_or(bman_target, i, j, arg_blk_count);
-            if (!all_one)
+            bool all_one = process_bit_blocks_or(arg_blk_count);
+            if (!all_one && arg_blk_gap_count)
+                all_one = process_gap_blocks_or(arg_blk_gap_count);
+            if (all_one) // golden block (all 1s)
+                bman_target.set_block(i, j, FULL_BLOCK_FAKE_ADDR, false);
+            else
             {
-                if (arg_blk_gap_count)
-                {
-                    all_one =
-                        process_gap_blocks_or(bman_target, i, j, arg_blk_gap_count);
-                }
-                if (!all_one)
-                {
-                    // we have some results, allocate block and copy from temp
-                    bman_target.copy_bit_block(i, j, ar_->tb1);
-                }
+                // we have some results, allocate block and copy from temp
+                bman_target.copy_bit_block(i, j, ar_->tb1);
             }
         }
     }
@@ -647,6 +1632,58 @@ void aggregator<BV>::combine_or(unsigned i, unsigned j,
 
 // ------------------------------------------------------------------------
 
+template<typename BV>
+void aggregator<BV>::combine_threshold(unsigned i, unsigned j,
+                                       bvector_type& bv_target,
+                                       const bvector_type_const_ptr* bv_src,
+                                       unsigned src_size, unsigned k)
+{
+    typename bvector_type::blocks_manager_type& bman_target = bv_target.get_blocks_manager();
+
+    unsigned arg_blk_count = 0;
+    unsigned arg_blk_gap_count = 0;
+    unsigned full_count =
+        sort_input_blocks_vcount(bv_src, src_size, i, j,
+                                 &arg_blk_count, &arg_blk_gap_count);
+    if (full_count >= k) // golden block
+    {
+        bman_target.check_alloc_top_subblock(i);
+        bman_target.set_block_ptr(i, j, FULL_BLOCK_FAKE_ADDR);
+        return;
+    }
+    unsigned blk_count = arg_blk_count + arg_blk_gap_count;
+    if (full_count + blk_count < k)
+        return;
+    k -= full_count; // FULL blocks count for all bits
+
+    if (k == 1) // remaining blocks: OR
+    {
+        bool all_one = process_bit_blocks_or(arg_blk_count);
+        if (!all_one && arg_blk_gap_count)
+            all_one = process_gap_blocks_or(arg_blk_gap_count);
+        if (all_one)
+            bman_target.set_block(i, j, FULL_BLOCK_FAKE_ADDR, false);
+        else
+            bman_target.copy_bit_block(i, j, ar_->tb1);
+        return;
+    }
+    if (k == blk_count) // remaining blocks: AND
+    {
+        digest_type digest = process_bit_blocks_and(arg_blk_count, 0);
+        if (digest && arg_blk_gap_count)
+            digest = process_gap_blocks_and(arg_blk_gap_count, digest);
+        if (digest)
+            bman_target.copy_bit_block(i, j, ar_->tb1);
+        return;
+    }
+
+    unsigned plane_count = process_blocks_vcount(arg_blk_count, arg_blk_gap_count);
+    if (bm::bit_block_vcount_ge(ar_->tb1, vcount_planes_, plane_count, k))
+        bman_target.copy_bit_block(i, j, ar_->tb1);
+}
+
+// ------------------------------------------------------------------------
+
 template<typename BV>
 void aggregator<BV>::combine_and(unsigned i, unsigned j,
                                  bvector_type& bv_target,
@@ -673,21 +1710,8 @@ void aggregator<BV>::combine_and(unsigned i, unsigned j,
     {
         if (arg_blk_count || arg_blk_gap_count)
         {
-            // AND bit-blocks
-            //
-            bm::id64_t digest = 0;
-            digest = process_bit_blocks_and(arg_blk_count, digest);
-            if (!digest)
-                return;
-
-            // AND all GAP blocks (if any)
-            //
-            if (arg_blk_gap_count)
-            {
-                digest =
-                    process_gap_blocks_and(arg_blk_gap_count, digest);
-            }
-            
+            bm::id64_t digest =
+                        process_blocks_and(arg_blk_count, arg_blk_gap_count);
             if (digest) // some results
             {
                 // we have some results, allocate block and copy from temp
@@ -726,21 +1750,9 @@ aggregator<BV>::combine_and_sub(unsigned i, unsigned j,
 
     if (arg_blk_and_count || arg_blk_and_gap_count)
     {
-        // AND bit-blocks
-        //
-        digest = process_bit_blocks_and(arg_blk_and_count, digest);
+        digest = process_blocks_and(arg_blk_and_count, arg_blk_and_gap_count);
         if (!digest)
             return digest;
-
-        // AND all GAP blocks (if any)
-        //
-        if (arg_blk_and_gap_count)
-        {
-            digest =
-                process_gap_blocks_and(arg_blk_and_gap_count, digest);
-            if (!digest)
-                return digest;
-        }
     }
     else
     {
@@ -775,9 +1787,60 @@ aggregator<BV>::combine_and_sub(unsigned i, unsigned j,
 // ------------------------------------------------------------------------
 
 template<typename BV>
-bool aggregator<BV>::process_gap_blocks_or(blocks_manager_type& bman_target,
-                                           unsigned i, unsigned j,
-                                           unsigned arg_blk_gap_count)
+typename aggregator<BV>::digest_type
+aggregator<BV>::combine_and_sub_batch(const bm::word_t* const* blk_cache,
+                                      const batch_query& q)
+{
+    BM_ASSERT(q.and_size);
+
+    unsigned arg_blk_count = 0;
+    unsigned arg_blk_gap_count = 0;
+    for (unsigned k = 0; k < q.and_size; ++k)
+    {
+        const bm::word_t* arg_blk = blk_cache[q.and_idx[k]];
+        if (!arg_blk)
+            return 0;
+        if (BM_IS_GAP(arg_blk))
+            ar_->v_arg_blk_gap[arg_blk_gap_count++] = BMGAP_PTR(arg_blk);
+        else // FULL or bit block
+            ar_->v_arg_blk[arg_blk_count++] =
+                    IS_FULL_BLOCK(arg_blk) ? FULL_BLOCK_REAL_ADDR : arg_blk;
+    } // for k
+
+    digest_type digest = process_blocks_and(arg_blk_count, arg_blk_gap_count);
+    if (!digest)
+        return digest;
+
+    arg_blk_count = arg_blk_gap_count = 0;
+    for (unsigned k = 0; k < q.sub_size; ++k)
+    {
+        const bm::word_t* arg_blk = blk_cache[q.sub_idx[k]];
+        if (!arg_blk)
+            continue;
+        if (BM_IS_GAP(arg_blk))
+            ar_->v_arg_blk_gap[arg_blk_gap_count++] = BMGAP_PTR(arg_blk);
+        else
+        {
+            if (IS_FULL_BLOCK(arg_blk))
+                return 0; // golden block: nothing left
+            ar_->v_arg_blk[arg_blk_count++] = arg_blk;
+        }
+    } // for k
+    if (arg_blk_count)
+    {
+        digest = process_bit_blocks_sub(arg_blk_count, digest);
+        if (!digest)
+            return digest;
+    }
+    if (arg_blk_gap_count)
+        digest = process_gap_blocks_sub(arg_blk_gap_count, digest);
+    return digest;
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+bool aggregator<BV>::process_gap_blocks_or(unsigned arg_blk_gap_count)
 {
     bm::word_t* blk = ar_->tb1;
     bool all_one;
@@ -801,7 +1864,6 @@ bool aggregator<BV>::process_gap_blocks_or(blocks_manager_type& bman_target,
             BM_ASSERT(res == db_->gap_res_buf1);
             if (bm::gap_is_all_one(res, bm::gap_max_bits))
             {
-                bman_target.set_block(i, j, FULL_BLOCK_FAKE_ADDR, false);
                 return true; // golden block found (all 1s)!
             }
         }
@@ -812,7 +1874,6 @@ bool aggregator<BV>::process_gap_blocks_or(blocks_manager_type& bman_target,
             BM_ASSERT(res == db_->gap_res_buf2);
             if (bm::gap_is_all_one(res, bm::gap_max_bits))
             {
-                bman_target.set_block(i, j, FULL_BLOCK_FAKE_ADDR, false);
                 return true; // golden block found (all 1s)!
             }
         }
@@ -821,7 +1882,6 @@ bool aggregator<BV>::process_gap_blocks_or(blocks_manager_type& bman_target,
         BM_ASSERT(res == db_->gap_res_buf3);
         if (bm::gap_is_all_one(res, bm::gap_max_bits))
         {
-            bman_target.set_block(i, j, FULL_BLOCK_FAKE_ADDR, false);
             return true; // golden block found (all 1s)!
         }
         
@@ -841,7 +1901,6 @@ bool aggregator<BV>::process_gap_blocks_or(blocks_manager_type& bman_target,
             BM_ASSERT(res == db_->gap_res_buf1);
             if (bm::gap_is_all_one(res, bm::gap_max_bits))
             {
-                bman_target.set_block(i, j, FULL_BLOCK_FAKE_ADDR, false);
                 return true; // golden block found (all 1s)!
             }
         }
@@ -858,7 +1917,6 @@ bool aggregator<BV>::process_gap_blocks_or(blocks_manager_type& bman_target,
     all_one = bm::is_bits_one((bm::wordop_t*) blk);
     if (all_one)
     {
-        bman_target.set_block(i, j, FULL_BLOCK_FAKE_ADDR, false);
         return true;
     }
     
@@ -867,6 +1925,60 @@ bool aggregator<BV>::process_gap_blocks_or(blocks_manager_type& bman_target,
 
 // ------------------------------------------------------------------------
 
+template<typename BV>
+typename aggregator<BV>::digest_type
+aggregator<BV>::process_blocks_and(unsigned arg_blk_count,
+                                   unsigned arg_blk_gap_count)
+{
+    if (!arg_blk_gap_count)
+        return process_bit_blocks_and(arg_blk_count, 0);
+
+    // GAP length is the cost (and population) estimate: shortest first
+    //
+    const bm::gap_word_t** v_gap = ar_->v_arg_blk_gap;
+    for (unsigned k = 1; k < arg_blk_gap_count; ++k)
+    {
+        const bm::gap_word_t* gap_blk = v_gap[k];
+        unsigned len = bm::gap_length(gap_blk);
+        unsigned m = k;
+        for (; m && bm::gap_length(v_gap[m-1]) > len; --m)
+            v_gap[m] = v_gap[m-1];
+        v_gap[m] = gap_blk;
+    } // for k
+
+    if (arg_blk_count &&
+        bm::gap_bit_count_unr(v_gap[0]) >= (bm::gap_max_bits / 8))
+    {
+        digest_type digest = process_bit_blocks_and(arg_blk_count, 0);
+        if (digest)
+            digest = process_gap_blocks_and(arg_blk_gap_count, digest);
+        return digest;
+    }
+
+    // sparse GAP block seeds the result, bit-blocks are then
+    // only processed over its non-zero digest waves
+    //
+    bm::word_t* blk = ar_->tb1;
+    bm::gap_convert_to_bitset(blk, v_gap[0]);
+    digest_type digest = bm::calc_block_digest0(blk);
+
+    bit_decode_cache dcache;
+    for (unsigned k = 0; k < arg_blk_count && digest; ++k)
+    {
+        if (ar_->v_arg_blk[k] == FULL_BLOCK_REAL_ADDR)
+            continue;
+        digest = bm::bit_block_and(blk, ar_->v_arg_blk[k], digest, dcache);
+    } // for k
+    for (unsigned k = 1; k < arg_blk_gap_count && digest; ++k)
+    {
+        bm::gap_and_to_bitset(blk, v_gap[k], digest);
+        digest = bm::update_block_digest0(blk, digest);
+    } // for k
+    return digest;
+}
+
+// ------------------------------------------------------------------------
+
 template<typename BV>
 typename aggregator<BV>::digest_type
 aggregator<BV>::process_gap_blocks_and(unsigned   arg_blk_gap_count,
@@ -921,9 +2033,7 @@ aggregator<BV>::process_gap_blocks_sub(unsigned   arg_blk_gap_count,
 // ------------------------------------------------------------------------
 
 template<typename BV>
-bool aggregator<BV>::process_bit_blocks_or(blocks_manager_type& bman_target,
-                                           unsigned i, unsigned j,
-                                           unsigned arg_blk_count)
+bool aggregator<BV>::process_bit_blocks_or(unsigned arg_blk_count)
 {
     bm::word_t* blk = ar_->tb1;
     bool all_one;
@@ -951,7 +2061,6 @@ bool aggregator<BV>::process_bit_blocks_or(blocks_manager_type& bman_target,
         {
             BM_ASSERT(blk == ar_->tb1);
             BM_ASSERT(bm::is_bits_one((bm::wordop_t*) blk));
-            bman_target.set_block(i, j, FULL_BLOCK_FAKE_ADDR, false);
             return true;
         }
     } // for k
@@ -966,7 +2075,6 @@ bool aggregator<BV>::process_bit_blocks_or(blocks_manager_type& bman_target,
         {
             BM_ASSERT(blk == ar_->tb1);
             BM_ASSERT(bm::is_bits_one((bm::wordop_t*) blk));
-            bman_target.set_block(i, j, FULL_BLOCK_FAKE_ADDR, false);
             return true;
         }
     } // for k
@@ -978,7 +2086,6 @@ bool aggregator<BV>::process_bit_blocks_or(blocks_manager_type& bman_target,
         {
             BM_ASSERT(blk == ar_->tb1);
             BM_ASSERT(bm::is_bits_one((bm::wordop_t*) blk));
-            bman_target.set_block(i, j, FULL_BLOCK_FAKE_ADDR, false);
             return true;
         }
     } // for k
@@ -1086,6 +2193,7 @@ unsigned aggregator<BV>::resize_target(bvector_type& bv_target,
         unsigned arg_top_blocks = bman_arg.top_block_size();
         if (arg_top_blocks > top_blocks)
             top_blocks = bman_target.reserve_top_blocks(arg_top_blocks);
+        bman_target.reserve_top_pages(bman_arg);
         auto arg_size = bv->size();
         if (arg_size > size)
         {
@@ -1098,6 +2206,188 @@ unsigned aggregator<BV>::resize_target(bvector_type& bv_target,
 
 // ------------------------------------------------------------------------
 
+template<typename BV>
+bool aggregator<BV>::sort_input_vectors_and(const bvector_type_const_ptr* bv_src,
+                                            unsigned src_size,
+                                            bvector_type_const_ptr* bv_sorted,
+                                            unsigned* top_from, unsigned* top_to)
+{
+    BM_ASSERT(src_size);
+    unsigned blk_cnt[max_aggregator_cap];
+    unsigned i_from = 0;
+    unsigned i_to = ~0u;
+    for (unsigned k = 0; k < src_size; ++k)
+    {
+        const bvector_type* bv = bv_src[k];
+        BM_ASSERT(bv);
+        const typename bvector_type::blocks_manager_type& bman_arg =
+                                                    bv->get_blocks_manager();
+        unsigned top_blocks = bman_arg.top_block_size();
+        unsigned first = top_blocks, last = 0, cnt = 0;
+        for (unsigned i = bman_arg.find_next_nz_top(0); i < top_blocks;
+                      i = bman_arg.find_next_nz_top(i + 1))
+        {
+            const bm::word_t* const* blk_blk = bman_arg.get_topblock(i);
+            unsigned c = 0;
+            for (unsigned j = 0; j < bm::set_array_size; ++j)
+                c += bool(blk_blk[j]);
+            if (!c)
+                continue;
+            if (first == top_blocks)
+                first = i;
+            last = i;
+            cnt += c;
+        } // for i
+        if (!cnt)
+            return false; // empty argument: AND is empty
+        if (first > i_from)
+            i_from = first;
+        if (last + 1 < i_to)
+            i_to = last + 1;
+
+        // insertion sort by block count (sparse vector goes first)
+        unsigned m = k;
+        for (; m && blk_cnt[m-1] > cnt; --m)
+        {
+            blk_cnt[m] = blk_cnt[m-1];
+            bv_sorted[m] = bv_sorted[m-1];
+        }
+        blk_cnt[m] = cnt;
+        bv_sorted[m] = bv;
+    } // for k
+    *top_from = i_from;
+    *top_to = i_to;
+    return i_from < i_to;
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+unsigned aggregator<BV>::max_top_blocks(const bvector_type_const_ptr* bv_src,
+                                        unsigned src_size)
+{
+    unsigned top_blocks = 0;
+    for (unsigned i = 0; i < src_size; ++i)
+    {
+        const bvector_type* bv = bv_src[i];
+        BM_ASSERT(bv);
+        unsigned arg_top_blocks = bv->get_blocks_manager().top_block_size();
+        if (arg_top_blocks > top_blocks)
+            top_blocks = arg_top_blocks;
+    } // for i
+    return top_blocks;
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+unsigned aggregator<BV>::find_next_nz_top_or(unsigned i,
+                                        const bvector_type_const_ptr* bv_src,
+                                        unsigned src_size)
+{
+    unsigned i_next = bm::set_top_array_size;
+    for (unsigned k = 0; k < src_size; ++k)
+    {
+        BM_ASSERT(bv_src[k]);
+        unsigned nz = bv_src[k]->get_blocks_manager().find_next_nz_top(i);
+        if (nz < i_next)
+        {
+            i_next = nz;
+            if (i_next == i)
+                break;
+        }
+    } // for k
+    return i_next;
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+unsigned aggregator<BV>::find_next_nz_top_and(unsigned i,
+                                        const bvector_type_const_ptr* bv_src,
+                                        unsigned src_size)
+{
+    while (i < bm::set_top_array_size)
+    {
+        unsigned i_next = i;
+        for (unsigned k = 0; k < src_size; ++k)
+        {
+            BM_ASSERT(bv_src[k]);
+            unsigned nz = bv_src[k]->get_blocks_manager().find_next_nz_top(i);
+            if (nz > i_next)
+            {
+                i_next = nz;
+                break; // restart from the new candidate
+            }
+        } // for k
+        if (i_next == i)
+            return i;
+        i = i_next;
+    } // while
+    return bm::set_top_array_size;
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+unsigned aggregator<BV>::process_blocks_vcount(unsigned arg_blk_count,
+                                               unsigned arg_blk_gap_count)
+{
+    unsigned plane_count =
+            bm::bit_scan_reverse(arg_blk_count + arg_blk_gap_count) + 1;
+    BM_ASSERT(plane_count <= max_vcount_planes);
+    if (!vcount_planes_)
+    {
+        vcount_planes_ = (bm::word_t*) bm::aligned_new_malloc(
+            max_vcount_planes * bm::set_block_size * sizeof(bm::word_t));
+    }
+    bm::bit_block_vcount(vcount_planes_, plane_count,
+                         ar_->v_arg_blk, arg_blk_count);
+    for (unsigned k = 0; k < arg_blk_gap_count; ++k)
+        bm::gap_vcount_add(vcount_planes_, ar_->v_arg_blk_gap[k]);
+    return plane_count;
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+unsigned aggregator<BV>::sort_input_blocks_vcount(
+                                            const bvector_type_const_ptr* bv_src,
+                                            unsigned src_size,
+                                            unsigned i, unsigned j,
+                                            unsigned* arg_blk_count,
+                                            unsigned* arg_blk_gap_count)
+{
+    unsigned full_count = 0;
+    for (unsigned k = 0; k < src_size; ++k)
+    {
+        const bvector_type* bv = bv_src[k];
+        BM_ASSERT(bv);
+        const typename bvector_type::blocks_manager_type& bman_arg = bv->get_blocks_manager();
+        const bm::word_t* arg_blk = bman_arg.get_block_ptr(i, j);
+        if (!arg_blk)
+            continue;
+        if (BM_IS_GAP(arg_blk))
+        {
+            ar_->v_arg_blk_gap[*arg_blk_gap_count] = BMGAP_PTR(arg_blk);
+            (*arg_blk_gap_count)++;
+        }
+        else // FULL or bit block
+        {
+            if (IS_FULL_BLOCK(arg_blk))
+            {
+                ++full_count;
+                continue;
+            }
+            ar_->v_arg_blk[*arg_blk_count] = arg_blk;
+            (*arg_blk_count)++;
+        }
+    } // for k
+    return full_count;
+}
+
+// ------------------------------------------------------------------------
+
 template<typename BV>
 bm::word_t* aggregator<BV>::sort_input_blocks_or(const bvector_type_const_ptr* bv_src,
                                                  unsigned src_size,
@@ -62,19 +62,14 @@ void for_each_bit(const BV&    bv,
                   Func&        bit_functor)
 {
     const typename BV::blocks_manager_type& bman = bv.get_blocks_manager();
-    bm::word_t*** blk_root = bman.top_blocks_root();
-    
-    if (!blk_root)
+    if (!bman.is_init())
         return;
     
     unsigned tsize = bman.top_block_size();
-    for (unsigned i = 0; i < tsize; ++i)
+    for (unsigned i = bman.find_next_nz_top(0); i < tsize;
+                  i = bman.find_next_nz_top(i + 1))
     {
-        bm::word_t** blk_blk = blk_root[i];
-        if (!blk_blk)
-        {
-            continue;
-        }
+        const bm::word_t* const* blk_blk = bman.get_topblock(i);
         const bm::word_t* block;
         unsigned r = i * bm::set_array_size;
         unsigned j = 0;
@@ -167,6 +162,7 @@ class rank_compressor
 {
 public:
     typedef BV                         bvector_type;
+    typedef typename BV::size_type     size_type;
 //    typedef typename BV::rs_index_type block_count_type;
     typedef typename BV::rs_index_type rs_index_type;
     enum buffer_cap
@@ -220,15 +216,15 @@ void rank_compressor<BV>::compress(BV& bv_target,
         bv_target = bv_src;
         return;
     }
-    bm::id_t ibuffer[n_buffer_cap];
-    bm::id_t b_size;
+    size_type ibuffer[n_buffer_cap];
+    size_type b_size;
     
     typedef typename BV::enumerator enumerator_t;
     enumerator_t en_s = bv_src.first();
     enumerator_t en_i = bv_idx.first();
 
-    bm::id_t r_idx = b_size = 0;
-    bm::id_t i, s;
+    size_type r_idx = b_size = 0;
+    size_type i, s;
     
     for (; en_i.valid(); )
     {
@@ -252,10 +248,10 @@ void rank_compressor<BV>::compress(BV& bv_target,
         }
         BM_ASSERT(s > i);
         
-        bm::id_t dist = s - i;
+        size_type dist = s - i;
         if (dist >= 64) // sufficiently far away, jump
         {
-            bm::id_t r_dist = bv_idx.count_range(i + 1, s);
+            size_type r_dist = bv_idx.count_range(i + 1, s);
             r_idx += r_dist;
             en_i.go_to(s);
             BM_ASSERT(en_i.valid());
@@ -295,8 +291,8 @@ void rank_compressor<BV>::decompress(BV& bv_target,
         return;
     }
     
-    bm::id_t r_idx, i, s, b_size;
-    bm::id_t ibuffer[n_buffer_cap];
+    size_type r_idx, i, s, b_size;
+    size_type ibuffer[n_buffer_cap];
     
     b_size = r_idx = 0;
 
@@ -322,8 +318,8 @@ void rank_compressor<BV>::decompress(BV& bv_target,
         }
         // source is "faster" than index, need to re-align
         BM_ASSERT(s > r_idx);
-        unsigned rank = s - r_idx + 1u;
-        unsigned new_pos = 0;
+        size_type rank = s - r_idx + 1u;
+        size_type new_pos = 0;
         
         if (rank < 256)
         {
@@ -702,8 +702,6 @@ void distance_operation(const BV& bv1,
     bool is_all_and = true; // flag is distance operation is just COUNT_AND
     distance_stage(dmit, dmit_end, &is_all_and);
 
-    bm::word_t*** blk_root = bman1.top_blocks_root();
-    unsigned block_idx = 0;
     unsigned i, j;
     
     const bm::word_t* blk;
@@ -718,25 +716,27 @@ void distance_operation(const BV& bv1,
 
     for (i = 0; i < top_block_size; ++i)
     {
-        bm::word_t** blk_blk = blk_root ? blk_root[i] : 0;
+        const bm::word_t* const* blk_blk = bman1.get_topblock(i);
 
         if (blk_blk == 0) // not allocated
         {
             // AND operation requested - we can skip this portion here 
             if (is_all_and)
             {
-                block_idx += bm::set_array_size;
+                i = bman1.find_next_nz_top(i) - 1;
                 continue;
             }
             const bm::word_t* const* bvbb = bman2.get_topblock(i);
             if (bvbb == 0) 
             {
-                block_idx += bm::set_array_size;
+                // skip to the next sub-block allocated in either vector
+                i = bm::min_value(bman1.find_next_nz_top(i),
+                                  bman2.find_next_nz_top(i)) - 1;
                 continue;
             }
 
             blk = 0;
-            for (j = 0; j < bm::set_array_size; ++j,++block_idx)
+            for (j = 0; j < bm::set_array_size; ++j)
             {                
                 arg_blk = bman2.get_block(i, j);
                 if (!arg_blk) 
@@ -748,7 +748,7 @@ void distance_operation(const BV& bv1,
             continue;
         }
 
-        for (j = 0; j < bm::set_array_size; ++j, ++block_idx)
+        for (j = 0; j < bm::set_array_size; ++j)
         {
             blk = bman1.get_block(i, j);
             if (blk == 0 && is_all_and)
@@ -787,21 +787,18 @@ unsigned distance_and_operation(const BV& bv1,
     if (!bman1.is_init() || !bman2.is_init())
         return 0;
 
-    bm::word_t*** blk_root     = bman1.top_blocks_root();
-    bm::word_t*** blk_root_arg = bman2.top_blocks_root();
     unsigned count = 0;
 
     unsigned top_block_size =
         bm::min_value(bman1.top_block_size(),bman2.top_block_size());
 
-    for (unsigned i = 0; i < top_block_size; ++i)
+    for (unsigned i = bman1.find_next_nz_top(0); i < top_block_size;
+                  i = bman1.find_next_nz_top(i + 1))
     {
-        bm::word_t** blk_blk;
-        bm::word_t** blk_blk_arg;
-        if ((blk_blk = blk_root[i]) == 0 || (blk_blk_arg= blk_root_arg[i]) == 0)
-        {
+        const bm::word_t* const* blk_blk = bman1.get_topblock(i);
+        const bm::word_t* const* blk_blk_arg = bman2.get_topblock(i);
+        if (!blk_blk_arg)
             continue;
-        }
         for (unsigned j = 0; j < bm::set_array_size; j+=4)
         {
             (blk_blk[j] && blk_blk_arg[j]) ? 
@@ -856,8 +853,6 @@ void distance_operation_any(const BV& bv1,
     bool is_all_and = true; // flag is distance operation is just COUNT_AND
     distance_stage(dmit, dmit_end, &is_all_and);
   
-    bm::word_t*** blk_root = bman1.top_blocks_root();
-    unsigned block_idx = 0;
     unsigned i, j;
     
     const bm::word_t* blk;
@@ -872,28 +867,30 @@ void distance_operation_any(const BV& bv1,
 
     for (i = 0; i < top_block_size; ++i)
     {
-        bm::word_t** blk_blk = blk_root ? blk_root[i] : 0;
+        const bm::word_t* const* blk_blk = bman1.get_topblock(i);
 
         if (blk_blk == 0) // not allocated
         {
             // AND operation requested - we can skip this portion here 
             if (is_all_and)
             {
-                block_idx += bm::set_array_size;
+                i = bman1.find_next_nz_top(i) - 1;
                 continue;
             }
 
             const bm::word_t* const* bvbb = bman2.get_topblock(i);
             if (bvbb == 0) 
             {
-                block_idx += bm::set_array_size;
+                // skip to the next sub-block allocated in either vector
+                i = bm::min_value(bman1.find_next_nz_top(i),
+                                  bman2.find_next_nz_top(i)) - 1;
                 continue;
             }
 
             blk = 0;
             blk_gap = false;
 
-            for (j = 0; j < bm::set_array_size; ++j,++block_idx)
+            for (j = 0; j < bm::set_array_size; ++j)
             {                
                 arg_blk = bman2.get_block(i, j);
                 if (!arg_blk) 
@@ -923,7 +920,7 @@ void distance_operation_any(const BV& bv1,
             continue;
         }
 
-        for (j = 0; j < bm::set_array_size; ++j, ++block_idx)
+        for (j = 0; j < bm::set_array_size; ++j)
         {
             blk = bman1.get_block(i, j);
             //BLOCK_ADDR_SAN(blk_blk[j]);
@@ -977,6 +974,86 @@ bm::id_t count_and(const BV& bv1, const BV& bv2)
     return distance_and_operation(bv1, bv2);
 }
 
+/*!
+   \brief Computes bitcount of AND operation of two bitsets
+   on a closed range [left, right].
+   Only blocks intersecting the range are processed.
+   \param bv1 - Argument bit-vector.
+   \param bv2 - Argument bit-vector.
+   \param left - range start
+   \param right - range end
+   \return bitcount of the result
+   \ingroup  distance
+*/
+template<class BV>
+typename BV::size_type count_and(const BV& bv1, const BV& bv2,
+                                 typename BV::size_type left,
+                                 typename BV::size_type right)
+{
+    typedef typename BV::block_idx_type block_idx_type;
+
+    const typename BV::blocks_manager_type& bman1 = bv1.get_blocks_manager();
+    const typename BV::blocks_manager_type& bman2 = bv2.get_blocks_manager();
+    if (!bman1.is_init() || !bman2.is_init())
+        return 0;
+    if (right < left)
+        bm::xor_swap(left, right);
+
+    block_idx_type nb_left = (left >> bm::set_block_shift);
+    block_idx_type nb_right = (right >> bm::set_block_shift);
+    unsigned i_from = unsigned(nb_left >> bm::set_array_shift);
+    unsigned i_to = unsigned(nb_right >> bm::set_array_shift);
+    unsigned top_block_size =
+        bm::min_value(bman1.top_block_size(), bman2.top_block_size());
+    if (i_to >= top_block_size)
+    {
+        if (!top_block_size)
+            return 0;
+        i_to = top_block_size - 1;
+    }
+
+    BM_DECLARE_TEMP_BLOCK(tb)
+    typename BV::size_type count = 0;
+    for (unsigned i = bman1.find_next_nz_top(i_from); i <= i_to;
+                  i = bman1.find_next_nz_top(i + 1))
+    {
+        if (!bman2.get_topblock(i))
+            continue;
+        unsigned j_from = (i == unsigned(nb_left >> bm::set_array_shift)) ?
+                            unsigned(nb_left & bm::set_array_mask) : 0;
+        unsigned j_to = (i == unsigned(nb_right >> bm::set_array_shift)) ?
+                unsigned(nb_right & bm::set_array_mask) : bm::set_array_mask;
+        for (unsigned j = j_from; j <= j_to; ++j)
+        {
+            const bm::word_t* blk = bman1.get_block(i, j);
+            const bm::word_t* arg_blk = bman2.get_block(i, j);
+            if (!blk || !arg_blk)
+                continue;
+
+            // edge blocks: mask the first argument by the range
+            block_idx_type nb = (block_idx_type(i) << bm::set_array_shift) + j;
+            unsigned l = (nb == nb_left) ?
+                            unsigned(left & bm::set_block_mask) : 0;
+            unsigned r = (nb == nb_right) ?
+                unsigned(right & bm::set_block_mask) : bm::gap_max_bits - 1;
+            if (l || r != bm::gap_max_bits - 1)
+            {
+                if (BM_IS_GAP(blk))
+                    bm::gap_convert_to_bitset(tb, BMGAP_PTR(blk));
+                else
+                    bm::bit_block_copy(tb, blk);
+                if (l)
+                    bm::sub_bit_block(tb, 0, l);
+                if (r != bm::gap_max_bits - 1)
+                    bm::sub_bit_block(tb, r + 1, bm::gap_max_bits - 1 - r);
+                blk = tb;
+            }
+            count += combine_count_and_operation_with_block(blk, arg_blk);
+        } // for j
+    } // for i
+    return count;
+}
+
 /*!
    \brief Computes if there is any bit in AND operation of two bitsets
    \param bv1 - Argument bit-vector.
@@ -1100,17 +1177,18 @@ bm::id_t any_or(const BV& bv1, const BV& bv2)
     \brief Internal algorithms scans the input for the block range limit
     \internal
 */
-template<class It>
-It block_range_scan(It  first, It last, unsigned nblock, unsigned* max_id)
+template<class It, class SIZE_TYPE>
+It block_range_scan(It  first, It last,
+                    bm::block_idx_type nblock, SIZE_TYPE* max_id)
 {
     It right;
     for (right = first; right != last; ++right)
     {
-        unsigned v = unsigned(*right);
+        SIZE_TYPE v = SIZE_TYPE(*right);
         BM_ASSERT(v < bm::id_max);
         if (v >= *max_id)
             *max_id = v;
-        unsigned nb = v >> bm::set_block_shift;
+        bm::block_idx_type nb = v >> bm::set_block_shift;
         if (nb != nblock)
             break;
     }
@@ -1137,11 +1215,11 @@ void combine_or(BV& bv, It  first, It last)
     if (!bman.is_init())
         bman.init_tree();
     
-    unsigned max_id = 0;
+    typename BV::size_type max_id = 0;
 
     while (first < last)
     {
-        unsigned nblock = unsigned((*first) >> bm::set_block_shift);     
+        bm::block_idx_type nblock = bm::block_idx_type((*first) >> bm::set_block_shift);     
         It right = bm::block_range_scan(first, last, nblock, &max_id);
 
         if (max_id >= bv.size())
@@ -1219,11 +1297,11 @@ void combine_xor(BV& bv, It  first, It last)
     if (!bman.is_init())
         bman.init_tree();
     
-    unsigned max_id = 0;
+    typename BV::size_type max_id = 0;
 
     while (first < last)
     {
-        unsigned nblock = unsigned((*first) >> bm::set_block_shift);     
+        bm::block_idx_type nblock = bm::block_idx_type((*first) >> bm::set_block_shift);     
         It right = block_range_scan(first, last, nblock, &max_id);
 
         if (max_id >= bv.size())
@@ -1306,11 +1384,11 @@ void combine_sub(BV& bv, It  first, It last)
     if (!bman.is_init())
         bman.init_tree();
     
-    unsigned max_id = 0;
+    typename BV::size_type max_id = 0;
 
     while (first < last)
     {
-        unsigned nblock = unsigned((*first) >> bm::set_block_shift);     
+        bm::block_idx_type nblock = bm::block_idx_type((*first) >> bm::set_block_shift);     
         It right = block_range_scan(first, last, nblock, &max_id);
 
         if (max_id >= bv.size())
@@ -1387,10 +1465,10 @@ void combine_sub(BV& bv, It  first, It last)
 template<class BV, class It>
 void combine_and_sorted(BV& bv, It  first, It last)
 {
-    bm::id_t prev = 0;
+    typename BV::size_type prev = 0;
     for ( ;first < last; ++first)
     {
-        bm::id_t id = *first;
+        typename BV::size_type id = *first;
         BM_ASSERT(id >= prev); // make sure it's sorted
         bv.set_bit_and(id, true);
         if (++prev < id) 
@@ -1448,7 +1526,8 @@ bm::id_t count_intervals(const BV& bv)
     if (!bman.is_init())
         return 1;
 
-    bm::word_t*** blk_root = bman.top_blocks_root();
+    typename BV::blocks_manager_type::top_root_type blk_root =
+                                                    bman.top_blocks_root();
     typename BV::blocks_manager_type::block_count_change_func func(bman);
     for_each_block(blk_root, bman.top_block_size(), func);
 
@@ -1493,7 +1572,7 @@ void export_array(BV& bv, It first, It last)
     case 1:
         {
             size_t word_cnt = array_size / 4;
-            for (unsigned i = 0; i < bm::set_total_blocks; ++i)
+            for (bm::block_idx_type i = 0; i < bm::set_total_blocks; ++i)
             {
                 bm::word_t* blk =
                     bman.check_allocate_block(i, 
@@ -1547,7 +1626,7 @@ void export_array(BV& bv, It first, It last)
     case 2:
         {
             size_t word_cnt = array_size / 2;
-            for (unsigned i = 0; i < bm::set_total_blocks; ++i)
+            for (bm::block_idx_type i = 0; i < bm::set_total_blocks; ++i)
             {
                 bm::word_t* blk =
                     bman.check_allocate_block(i, 
@@ -1593,7 +1672,7 @@ void export_array(BV& bv, It first, It last)
     case 4:
         {
             size_t word_cnt = array_size;
-            for (unsigned i = 0; i < bm::set_total_blocks; ++i)
+            for (bm::block_idx_type i = 0; i < bm::set_total_blocks; ++i)
             {
                 bm::word_t* blk =
                     bman.check_allocate_block(i, 
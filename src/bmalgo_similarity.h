@@ -43,12 +43,13 @@ public:
     typedef SFunc              similarity_functor;
 public:
     similarity_descriptor()
-     : so1_(0), so2_(0), so1_idx_(0), so2_idx_(0)
+     : similarity_(0), so1_(0), so2_(0), so1_idx_(0), so2_idx_(0)
     {}
     
     similarity_descriptor(const SO* so1, const SO* so2,
                           const distance_metric_descriptor* dmd_ptr)
-    :so1_(so1),
+    :similarity_(0),
+     so1_(so1),
      so2_(so2),
      so1_idx_(0), so2_idx_(0)
     {
@@ -59,7 +60,7 @@ public:
     similarity_descriptor(const SO* so1, IDX_VALUE i1,
                           const SO* so2, IDX_VALUE i2,
                           const distance_metric_descriptor* dmd_ptr)
-    :so1_(so1), so2_(so2), so1_idx_(i1), so2_idx_(i2)
+    :similarity_(0), so1_(so1), so2_(so2), so1_idx_(i1), so2_idx_(i2)
     {
         for (size_t i = 0; i < DMD_SZ; ++i)
             dmd_[i] = dmd_ptr[i];
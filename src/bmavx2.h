@@ -1193,6 +1193,114 @@ bool avx2_is_all_one(const __m256i* BMRESTRICT block)
     } while (block < block_end);
     return true;
 }
+
+/*!
+    @brief block shift right by 1
+    @return carry over bit
+    @ingroup AVX2
+*/
+inline
+bool avx2_shift_r1(__m256i* block, unsigned* empty_acc, unsigned co1)
+{
+    __m256i* block_end =
+        (__m256i*)((bm::word_t*)(block) + bm::set_block_size);
+    __m256i mAcc = _mm256_set1_epi32(0);
+    // lane permutation to move carry over to the next word
+    __m256i mPerm = _mm256_set_epi32(6, 5, 4, 3, 2, 1, 0, 7);
+    unsigned co2;
+
+    for (;block < block_end; block += 2)
+    {
+        __m256i m1A = _mm256_load_si256(block);
+        __m256i m2A = _mm256_load_si256(block+1);
+
+        __m256i m1CO = _mm256_srli_epi32(m1A, 31);
+        __m256i m2CO = _mm256_srli_epi32(m2A, 31);
+
+        co2 = unsigned(_mm256_extract_epi32(m1CO, 7));
+
+        m1A = _mm256_slli_epi32(m1A, 1); // (block[i] << 1u)
+        m2A = _mm256_slli_epi32(m2A, 1);
+
+        __m256i m1COshft = _mm256_permutevar8x32_epi32(m1CO, mPerm);
+        m1COshft = _mm256_insert_epi32(m1COshft, int(co1), 0);
+
+        co1 = co2;
+        co2 = unsigned(_mm256_extract_epi32(m2CO, 7));
+
+        __m256i m2COshft = _mm256_permutevar8x32_epi32(m2CO, mPerm);
+        m2COshft = _mm256_insert_epi32(m2COshft, int(co1), 0);
+
+        m1A = _mm256_or_si256(m1A, m1COshft); // block[i] |= co_flag
+        m2A = _mm256_or_si256(m2A, m2COshft);
+
+        _mm256_store_si256(block, m1A);
+        _mm256_store_si256(block+1, m2A);
+
+        mAcc = _mm256_or_si256(mAcc, m1A);
+        mAcc = _mm256_or_si256(mAcc, m2A);
+
+        co1 = co2;
+    }
+    *empty_acc = !_mm256_testz_si256(mAcc, mAcc);
+    return co1;
+}
+
+/*!
+    @brief block shift left by 1
+    @return carry over bit
+    @ingroup AVX2
+*/
+inline
+bool avx2_shift_l1(__m256i* block, unsigned* empty_acc, unsigned co1)
+{
+    const unsigned block_size = bm::set_block_size / 8; // in __m256i units
+    __m256i mAcc = _mm256_set1_epi32(0);
+    __m256i mMask1 = _mm256_set1_epi32(1);
+    // lane permutation to move carry over to the previous word
+    __m256i mPerm = _mm256_set_epi32(0, 7, 6, 5, 4, 3, 2, 1);
+    unsigned co2;
+
+    for (int i = int(block_size) - 2; i >= 0; i -= 2)
+    {
+        __m256i m1A = _mm256_load_si256(block+i+1);
+        __m256i m2A = _mm256_load_si256(block+i);
+
+        __m256i m1CO = _mm256_and_si256(m1A, mMask1);
+        __m256i m2CO = _mm256_and_si256(m2A, mMask1);
+
+        co2 = unsigned(_mm256_extract_epi32(m1CO, 0));
+
+        m1A = _mm256_srli_epi32(m1A, 1); // (block[i] >> 1u)
+        m2A = _mm256_srli_epi32(m2A, 1);
+
+        __m256i m1COshft = _mm256_permutevar8x32_epi32(m1CO, mPerm);
+        m1COshft = _mm256_insert_epi32(m1COshft, int(co1), 7);
+
+        co1 = co2;
+        co2 = unsigned(_mm256_extract_epi32(m2CO, 0));
+
+        __m256i m2COshft = _mm256_permutevar8x32_epi32(m2CO, mPerm);
+        m2COshft = _mm256_insert_epi32(m2COshft, int(co1), 7);
+
+        m1COshft = _mm256_slli_epi32(m1COshft, 31);
+        m2COshft = _mm256_slli_epi32(m2COshft, 31);
+
+        m1A = _mm256_or_si256(m1A, m1COshft); // block[i] |= co_flag
+        m2A = _mm256_or_si256(m2A, m2COshft);
+
+        _mm256_store_si256(block+i+1, m1A);
+        _mm256_store_si256(block+i, m2A);
+
+        mAcc = _mm256_or_si256(mAcc, m1A);
+        mAcc = _mm256_or_si256(mAcc, m2A);
+
+        co1 = co2;
+    }
+    *empty_acc = !_mm256_testz_si256(mAcc, mAcc);
+    return co1;
+}
+
 /*!
     @brief check if wave of pointers is all NULL
     @ingroup AVX2
@@ -1732,6 +1840,174 @@ void avx2_bit_block_gather_scatter(unsigned* BMRESTRICT arr,
 
 
 
+/**
+    AVX2 set bits of a bit-block from an array of indexes
+    (idx[start..stop) belong to the same block)
+ 
+    Masks are computed 8 indexes at a time, indexes hitting the same word
+    (dense or sorted input) are combined into one store.
+ 
+    @ingroup AVX2
+    \internal
+*/
+inline
+void avx2_set_block_bits(bm::word_t* BMRESTRICT block,
+                         const unsigned* BMRESTRICT idx,
+                         unsigned start, unsigned stop)
+{
+    const unsigned unroll_factor = 8;
+    const unsigned len = (stop - start);
+    const unsigned len_unr = len - (len % unroll_factor);
+
+    __m256i sb_mask = _mm256_set1_epi32(bm::set_block_mask);
+    __m256i sw_mask = _mm256_set1_epi32(bm::set_word_mask);
+    __m256i mask1   = _mm256_set1_epi32(1);
+    __m256i maskZ   = _mm256_setzero_si256();
+
+    unsigned BM_ALIGN32 mword_v[8] BM_ALIGN32ATTR;
+    unsigned BM_ALIGN32 mask_v[8] BM_ALIGN32ATTR;
+
+    idx += start;
+    unsigned k = 0;
+    for (; k < len_unr; k+=unroll_factor)
+    {
+        __m256i nbitA = _mm256_and_si256(
+                    _mm256_loadu_si256((__m256i*)(idx+k)), sb_mask);
+        __m256i nwordA = _mm256_srli_epi32(nbitA, bm::set_word_shift);
+        __m256i maskA = _mm256_sllv_epi32(mask1,
+                                        _mm256_and_si256(nbitA, sw_mask));
+
+        // compare all word indexes with the first one
+        __m256i nword0 = _mm256_permutevar8x32_epi32(nwordA, maskZ);
+        unsigned m = unsigned(_mm256_movemask_epi8(
+                                _mm256_cmpeq_epi32(nword0, nwordA)));
+        if (m == ~0u) // all bits go to the same word: OR-reduce masks
+        {
+            maskA = _mm256_or_si256(maskA,
+                        _mm256_shuffle_epi32(maskA, _MM_SHUFFLE(1,0,3,2)));
+            maskA = _mm256_or_si256(maskA,
+                        _mm256_shuffle_epi32(maskA, _MM_SHUFFLE(2,3,0,1)));
+            __m128i mask128 = _mm_or_si128(_mm256_castsi256_si128(maskA),
+                                           _mm256_extracti128_si256(maskA, 1));
+            block[_mm256_extract_epi32(nwordA, 0)] |=
+                                    unsigned(_mm_cvtsi128_si32(mask128));
+        }
+        else // scatter
+        {
+            _mm256_store_si256((__m256i*)mword_v, nwordA);
+            _mm256_store_si256((__m256i*)mask_v, maskA);
+            block[mword_v[0]] |= mask_v[0]; block[mword_v[1]] |= mask_v[1];
+            block[mword_v[2]] |= mask_v[2]; block[mword_v[3]] |= mask_v[3];
+            block[mword_v[4]] |= mask_v[4]; block[mword_v[5]] |= mask_v[5];
+            block[mword_v[6]] |= mask_v[6]; block[mword_v[7]] |= mask_v[7];
+        }
+    } // for k
+
+    for (; k < len; ++k)
+    {
+        unsigned nbit = unsigned(idx[k] & bm::set_block_mask);
+        block[nbit >> bm::set_word_shift] |= (1u << (nbit & bm::set_word_mask));
+    }
+}
+
+/*!
+    \brief Decode bit block into an array of indexes of 1 bits
+ 
+    Table driven: positions of every byte are expanded into 8 indexes
+    and stored in one step (the store may overwrite up to 7 indexes
+    past the decoded ones, so it is used only when there is room).
+    Block is scanned in 64-bit words, sparse words are decoded
+    with bit-scan (tzcnt).
+ 
+    \return number of indexes written
+ 
+    @ingroup AVX2
+    \internal
+*/
+inline
+unsigned avx2_bit_block_decode(const bm::word_t* BMRESTRICT block,
+                               unsigned nbit_from, unsigned base,
+                               unsigned* BMRESTRICT dest, unsigned dest_len)
+{
+    const unsigned unroll_factor = 8;
+    const bm::id64_t* idx_table = bm::bit_idx_table<true>::_idx;
+    const bm::id64_t* block64 = (const bm::id64_t*)block;
+    const __m256i m8 = _mm256_set1_epi32(8);
+
+    unsigned cnt = 0;
+    unsigned nword = nbit_from >> 6;
+    bm::id64_t w = block64[nword] & (~0ull << (nbit_from & 63));
+    for (;;)
+    {
+        if (w)
+        {
+            unsigned base_w = base + (nword << 6);
+            unsigned wc = unsigned(_mm_popcnt_u64(w));
+            if (wc > dest_len - cnt) // destination is full
+            {
+                for (; cnt < dest_len; w &= w - 1)
+                    dest[cnt++] = base_w + bm::count_trailing_zeros_u64(w);
+                return cnt;
+            }
+            if (wc > 8 && (wc + unroll_factor <= dest_len - cnt))
+            {
+                __m256i mbase = _mm256_set1_epi32(int(base_w));
+                for (; w; w >>= 8)
+                {
+                    unsigned b = unsigned(w & 0xFFu);
+                    __m128i mb = _mm_loadl_epi64((const __m128i*)(idx_table + b));
+                    _mm256_storeu_si256((__m256i*)(dest + cnt),
+                            _mm256_add_epi32(_mm256_cvtepu8_epi32(mb), mbase));
+                    cnt += unsigned(_mm_popcnt_u32(b));
+                    mbase = _mm256_add_epi32(mbase, m8);
+                }
+            }
+            else // sparse word or no room for the vector store
+            {
+                for (; w; w &= w - 1)
+                    dest[cnt++] = base_w + bm::count_trailing_zeros_u64(w);
+            }
+        }
+        if (++nword == bm::set_block_size / 2)
+            break;
+        w = block64[nword];
+    } // for
+    return cnt;
+}
+
+
+/*!
+    \brief Find the first word of bit block which is not all 1s
+    (starting from nword)
+ 
+    \return word index or bm::set_block_size if all remaining words are 1s
+ 
+    @ingroup AVX2
+    \internal
+*/
+inline
+unsigned avx2_bit_find_not_full(const bm::word_t* BMRESTRICT block,
+                                unsigned nword)
+{
+    for (; nword & 7u; ++nword) // align to 256-bit
+    {
+        if (block[nword] != ~0u)
+            return nword;
+    }
+    const __m256i maskF = _mm256_set1_epi32(~0u);
+    for (; nword < bm::set_block_size; nword += 8)
+    {
+        __m256i w = _mm256_load_si256((const __m256i*)(block + nword));
+        if (!_mm256_testc_si256(w, maskF))
+        {
+            unsigned m = unsigned(_mm256_movemask_ps(
+                            _mm256_castsi256_ps(_mm256_cmpeq_epi32(w, maskF))));
+            return nword + bm::bsf_asm32(~m);
+        }
+    } // for
+    return bm::set_block_size;
+}
+
 #ifdef __GNUG__
 #pragma GCC diagnostic pop
 #endif
@@ -1806,6 +2082,21 @@ void avx2_bit_block_gather_scatter(unsigned* BMRESTRICT arr,
 #define VECT_LOWER_BOUND_SCAN_U32(arr, target, from, to) \
     avx2_lower_bound_scan_u32(arr, target, from, to)
 
+#define VECT_SHIFT_R1(b, acc, co) \
+    avx2_shift_r1((__m256i*)b, acc, co)
+
+#define VECT_SHIFT_L1(b, acc, co) \
+    avx2_shift_l1((__m256i*)b, acc, co)
+
+#define VECT_SET_BLOCK_BITS(block, idx, start, stop) \
+    avx2_set_block_bits(block, idx, start, stop)
+
+#define VECT_BIT_BLOCK_DECODE(block, nbit_from, base, dest, dest_len) \
+    avx2_bit_block_decode(block, nbit_from, base, dest, dest_len)
+
+#define VECT_BIT_FIND_NOT_FULL(block, nword) \
+    avx2_bit_find_not_full(block, nword)
+
 
 } // namespace
 
@@ -70,6 +70,7 @@ For more information please visit:  http://bitmagic.io
 
 #include "bmdef.h"
 #include "bmbmi2.h"
+#include "bmutil.h"
 
 namespace bm
 {
@@ -1393,6 +1394,95 @@ void avx2_bit_block_gather_scatter(unsigned* BMRESTRICT arr,
 
 }
 
+/*!
+    \brief Decode bit block into an array of indexes of 1 bits
+    (dense 64-bit words 16 bits at a time with compress-store,
+    sparse words with bit-scan)
+ 
+    \return number of indexes written
+ 
+    @ingroup AVX512
+    \internal
+*/
+inline
+unsigned avx512_bit_block_decode(const bm::word_t* BMRESTRICT block,
+                                 unsigned nbit_from, unsigned base,
+                                 unsigned* BMRESTRICT dest, unsigned dest_len)
+{
+    const bm::id64_t* block64 = (const bm::id64_t*)block;
+    const __m512i mseq = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8,
+                                          7, 6, 5, 4, 3, 2, 1, 0);
+    const __m512i m16 = _mm512_set1_epi32(16);
+
+    unsigned cnt = 0;
+    unsigned nword = nbit_from >> 6;
+    bm::id64_t w = block64[nword] & (~0ull << (nbit_from & 63));
+    for (;;)
+    {
+        if (w)
+        {
+            unsigned base_w = base + (nword << 6);
+            unsigned wc = unsigned(_mm_popcnt_u64(w));
+            if (wc > dest_len - cnt) // destination is full
+            {
+                for (; cnt < dest_len; w &= w - 1)
+                    dest[cnt++] = base_w + bm::count_trailing_zeros_u64(w);
+                return cnt;
+            }
+            if (wc > 8)
+            {
+                __m512i mbase =
+                    _mm512_add_epi32(_mm512_set1_epi32(int(base_w)), mseq);
+                for (; w; w >>= 16)
+                {
+                    __mmask16 m = __mmask16(w);
+                    _mm512_mask_compressstoreu_epi32(dest + cnt, m, mbase);
+                    cnt += unsigned(_mm_popcnt_u32(m));
+                    mbase = _mm512_add_epi32(mbase, m16);
+                }
+            }
+            else // sparse word
+            {
+                for (; w; w &= w - 1)
+                    dest[cnt++] = base_w + bm::count_trailing_zeros_u64(w);
+            }
+        }
+        if (++nword == bm::set_block_size / 2)
+            break;
+        w = block64[nword];
+    } // for
+    return cnt;
+}
+
+/*!
+    \brief Find the first word of bit block which is not all 1s
+    (starting from nword)
+ 
+    \return word index or bm::set_block_size if all remaining words are 1s
+ 
+    @ingroup AVX512
+    \internal
+*/
+inline
+unsigned avx512_bit_find_not_full(const bm::word_t* BMRESTRICT block,
+                                  unsigned nword)
+{
+    for (; nword & 15u; ++nword) // align to 512-bit
+    {
+        if (block[nword] != ~0u)
+            return nword;
+    }
+    const __m512i maskF = _mm512_set1_epi32(-1);
+    for (; nword < bm::set_block_size; nword += 16)
+    {
+        __mmask16 eq_m = _mm512_cmpeq_epi32_mask(
+                    _mm512_load_si512((const __m512i*)(block + nword)), maskF);
+        if (eq_m != __mmask16(~0u))
+            return nword + bm::bsf_asm32(~unsigned(eq_m));
+    } // for
+    return bm::set_block_size;
+}
+
 #ifdef __GNUG__
 #pragma GCC diagnostic pop
 #endif
@@ -1464,6 +1554,12 @@ void avx2_bit_block_gather_scatter(unsigned* BMRESTRICT arr,
 #define VECT_IS_DIGEST_ZERO(start) \
     avx512_is_digest_zero((__m512i*)start)
 
+#define VECT_BIT_BLOCK_DECODE(block, nbit_from, base, dest, dest_len) \
+    avx512_bit_block_decode(block, nbit_from, base, dest, dest_len)
+
+#define VECT_BIT_FIND_NOT_FULL(block, nword) \
+    avx512_bit_find_not_full(block, nword)
+
 
 
 } // namespace
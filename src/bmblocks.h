@@ -34,6 +34,16 @@ namespace bm
    @brief bitvector blocks manager
         Embedded class managing bit-blocks on very low level.
         Includes number of functor classes used in different bitset algorithms. 
+
+        Second level arrays of block pointers are reference counted and
+        can be shared between copies of the vector (copy-on-write).
+        Shared array is cloned (unshared) before the first modification
+        of any block it holds.
+
+        In 64-bit address mode (BM64ADDR) the wide top level is split into
+        pages of bm::set_top_page_size slots, allocated on demand, so
+        memory and top level scans stay proportional to the populated
+        part of the address space.
    @ingroup bvector
    @internal
 */
@@ -45,6 +55,41 @@ public:
     template<typename TAlloc> friend class bvector;
 
     typedef Alloc allocator_type;
+#ifdef BM64ADDR
+    typedef bm::id64_t      id_type;
+    /// top level: directory of pages of second level array pointers
+    typedef bm::word_t****  top_root_type;
+#else
+    typedef bm::id_t        id_type;
+    typedef bm::word_t***   top_root_type;
+#endif
+
+    /// reference counter of a shared second level array
+#if !defined(BM_NO_STL) && !defined(BM_NO_CXX11)
+    typedef std::atomic<unsigned> ref_counter_type;
+#else
+    typedef unsigned              ref_counter_type;
+#endif
+
+    /// modification epoch and the source of unique epoch bases
+    /// (epoch can be advanced from parallel top range operations)
+#if !defined(BM_NO_STL) && !defined(BM_NO_CXX11)
+    typedef std::atomic<bm::id64_t> epoch_counter_type;
+#else
+    typedef bm::id64_t              epoch_counter_type;
+#endif
+
+    /**
+        Memory arena of a frozen vector: bit blocks, GAP blocks and
+        second level arrays packed in one allocation.
+        Descriptor is placed at the tail of the arena memory.
+    */
+    struct arena
+    {
+        ref_counter_type ref;          ///< number of vectors using the arena
+        bm::word_t*      mem;          ///< arena memory
+        unsigned         alloc_factor; ///< arena size in bit blocks
+    };
 
     /** Base functor class (block visitor)*/
     class bm_func_base
@@ -53,7 +98,7 @@ public:
         bm_func_base(blocks_manager& bman) : bm_(bman) {}
 
         void on_empty_top(unsigned /* top_block_idx*/ ) {}
-        void on_empty_block(unsigned /* block_idx*/ ) {}
+        void on_empty_block(block_idx_type /* block_idx*/ ) {}
     private:
         bm_func_base(const bm_func_base&);
         bm_func_base& operator=(const bm_func_base&);
@@ -69,7 +114,7 @@ public:
         bm_func_base_const(const blocks_manager& bman) : bm_(bman) {}
 
         void on_empty_top(unsigned /* top_block_idx*/ ) {}
-        void on_empty_block(unsigned /* block_idx*/ ) {}
+        void on_empty_block(block_idx_type /* block_idx*/ ) {}
     private:
         bm_func_base_const(const bm_func_base_const&);
         bm_func_base_const& operator=(const bm_func_base_const&);
@@ -99,7 +144,7 @@ public:
         block_count_func(const blocks_manager& bm) 
             : block_count_base(bm), count_(0) {}
 
-        bm::id_t count() const { return count_; }
+        id_type count() const { return count_; }
 
         void operator()(const bm::word_t* block)
         {
@@ -107,7 +152,7 @@ public:
         }
 
     private:
-        bm::id_t count_;
+        id_type count_;
     };
 
 
@@ -121,7 +166,7 @@ public:
             arr_[0] = 0;
         }
 
-        void operator()(const bm::word_t* block, unsigned idx)
+        void operator()(const bm::word_t* block, block_idx_type idx)
         {
             while (++last_idx_ < idx)
             {
@@ -131,11 +176,11 @@ public:
             last_idx_ = idx;
         }
 
-        unsigned last_block() const { return last_idx_; }
+        block_idx_type last_block() const { return last_idx_; }
 
     private:
-        unsigned*  arr_;
-        unsigned   last_idx_;
+        unsigned*       arr_;
+        block_idx_type  last_idx_;
     };
 
     /** bit value change counting functor */
@@ -148,7 +193,7 @@ public:
                 prev_block_border_bit_(0)
         {}
 
-        bm::id_t block_count(const bm::word_t* block, unsigned idx)
+        bm::id_t block_count(const bm::word_t* block, block_idx_type idx)
         {
             bm::id_t cnt = 0;
             bm::id_t first_bit;
@@ -195,15 +240,15 @@ public:
             return cnt;
         }
         
-        bm::id_t count() const { return count_; }
+        id_type count() const { return count_; }
 
-        void operator()(const bm::word_t* block, unsigned idx)
+        void operator()(const bm::word_t* block, block_idx_type idx)
         {
             count_ += block_count(block, idx);
         }
 
     private:
-        bm::id_t   count_;
+        id_type    count_;
         bm::id_t   prev_block_border_bit_;
     };
 
@@ -237,7 +282,7 @@ public:
             BM_ASSERT(glevel_len);
         }
 
-        void operator()(bm::word_t* block, unsigned idx)
+        void operator()(bm::word_t* block, block_idx_type idx)
         {
             blocks_manager& bman = this->bm_;
             
@@ -252,6 +297,7 @@ public:
                 bman.set_block_ptr(idx, 0);
                 bman.get_allocator().free_gap_block(gap_blk,
                                                     bman.glen());
+                return;
             }
             else 
             if (gap_is_all_one(gap_blk, bm::gap_max_bits))
@@ -308,21 +354,15 @@ public:
         void on_empty_top(unsigned i)
         {
             BM_ASSERT(this->bm_.is_init());
-            bm::word_t*** blk_root = this->bm_.top_blocks_root();
-            bm::word_t** blk_blk = blk_root[i];
-            if (blk_blk) 
-            {
-                this->bm_.get_allocator().free_ptr(blk_blk);
-                blk_root[i] = 0;
-            }
+            this->bm_.free_top_subblock(i);
             if (stat_)
             {
                 stat_->max_serialize_mem += (unsigned)(sizeof(unsigned) + 1);
             }
         }
-        void on_empty_block(unsigned /* block_idx*/ ) { ++empty_; }
+        void on_empty_block(block_idx_type /* block_idx*/ ) { ++empty_; }
 
-        void operator()(bm::word_t* block, unsigned idx)
+        void operator()(bm::word_t* block, block_idx_type idx)
         {
             blocks_manager& bman = this->bm_;
             if (IS_FULL_BLOCK(block)) 
@@ -466,7 +506,7 @@ public:
         block_invert_func(blocks_manager& bm) 
             : bm_func_base(bm) {}
 
-        void operator()(bm::word_t* block, unsigned idx)
+        void operator()(bm::word_t* block, block_idx_type idx)
         {
             if (!block)
                 this->bm_.set_block(idx, FULL_BLOCK_FAKE_ADDR);
@@ -492,7 +532,7 @@ public:
         : bm_func_base(bm), alloc_(bm.get_allocator())
         {}
 
-        void operator()(bm::word_t* block, unsigned idx)
+        void operator()(bm::word_t* block, block_idx_type idx)
         {
             if (BM_IS_GAP(block))
                 bm::gap_set_all(BMGAP_PTR(block), bm::gap_max_bits, 0);
@@ -521,7 +561,7 @@ public:
     public:
         block_one_func(blocks_manager& bm) : bm_func_base(bm) {}
 
-        void operator()(bm::word_t* block, unsigned idx)
+        void operator()(bm::word_t* block, block_idx_type idx)
         {
             if (!IS_FULL_BLOCK(block))
                 this->bm_.set_block_all_set(idx);
@@ -533,6 +573,8 @@ public:
     : max_bits_(bm::id_max),
       top_blocks_(0),
       temp_block_(0),
+      arena_(0),
+      epoch_(new_epoch_base()),
       alloc_(Alloc())
     {
         ::memcpy(glevel_len_, bm::gap_len_table<true>::_len, sizeof(glevel_len_));
@@ -540,11 +582,13 @@ public:
     }
 
     blocks_manager(const gap_word_t* glevel_len, 
-                    bm::id_t          max_bits,
+                    id_type           max_bits,
                     const Alloc&      alloc = Alloc())
         : max_bits_(max_bits),
           top_blocks_(0),
           temp_block_(0),
+          arena_(0),
+          epoch_(new_epoch_base()),
           alloc_(alloc)
     {
         ::memcpy(glevel_len_, glevel_len, sizeof(glevel_len_));
@@ -559,6 +603,8 @@ public:
             gap_flags_(blockman.gap_flags_),
         #endif
             temp_block_(0),
+            arena_(0),
+            epoch_(new_epoch_base()),
             alloc_(blockman.alloc_)
     {
         ::memcpy(glevel_len_, blockman.glevel_len_, sizeof(glevel_len_));
@@ -566,7 +612,7 @@ public:
         if (blockman.is_init())
         {
             reserve_top_blocks(blockman.top_block_size());
-            this->copy(blockman);
+            this->share(blockman);
         }
     }
     
@@ -576,6 +622,8 @@ public:
           top_blocks_(0),
           top_block_size_(blockman.top_block_size_),
           temp_block_(0),
+          arena_(0),
+          epoch_(new_epoch_base()),
           alloc_(blockman.alloc_)
     {
         ::memcpy(glevel_len_, blockman.glevel_len_, sizeof(glevel_len_));
@@ -596,11 +644,16 @@ public:
     void swap(blocks_manager& bm) BMNOEXEPT
     {
         BM_ASSERT(this != &bm);
+        next_epoch(); bm.next_epoch();
 
-        word_t*** btmp = top_blocks_;
+        top_root_type btmp = top_blocks_;
         top_blocks_ = bm.top_blocks_;
         bm.top_blocks_ = btmp;
 
+        arena* ar = arena_;
+        arena_ = bm.arena_;
+        bm.arena_ = ar;
+
         bm::xor_swap(this->max_bits_, bm.max_bits_);
         bm::xor_swap(this->top_block_size_, bm.top_block_size_);
 
@@ -636,26 +689,26 @@ public:
         \param bits_to_store - supposed capacity (number of bits)
         \return size of the top level block
     */
-    unsigned compute_top_block_size(bm::id_t bits_to_store)
+    unsigned compute_top_block_size(id_type bits_to_store)
     {
         if (bits_to_store == bm::id_max)  // working in full-range mode
-            return bm::set_array_size;
+            return bm::set_top_array_size;
 
         unsigned top_block_sz = (unsigned)
             (bits_to_store / (bm::set_block_size * sizeof(bm::word_t) *
                                                 bm::set_array_size * 8));
-        if (top_block_sz < bm::set_array_size) ++top_block_sz;
+        if (top_block_sz < bm::set_top_array_size) ++top_block_sz;
         return top_block_sz;
     }
 
     /**
         Returns current capacity (bits)
     */
-    bm::id_t capacity() const
+    id_type capacity() const
     {
         // arithmetic overflow protection...
-        return top_block_size_ == bm::set_array_size ? bm::id_max :
-            top_block_size_ * bm::set_array_size * bm::bits_in_block;
+        return top_block_size_ == bm::set_top_array_size ? bm::id_max :
+            id_type(top_block_size_) * bm::set_array_size * bm::bits_in_block;
     }
 
     /**
@@ -663,16 +716,16 @@ public:
         \param nb - Index of block (logical linear number)
         \return block adress or NULL if not yet allocated
     */
-    bm::word_t* get_block(unsigned nb) const
+    bm::word_t* get_block(block_idx_type nb) const
     {
         if (!top_blocks_)
             return 0;
-        unsigned block_idx = nb >> bm::set_array_shift;
+        unsigned block_idx = unsigned(nb >> bm::set_array_shift);
         if (block_idx >= top_block_size_)
         {
             return 0;
         }
-        bm::word_t** blk_blk = top_blocks_[block_idx];
+        bm::word_t** blk_blk = top_slot(block_idx);
         bm::word_t* ret = blk_blk ? blk_blk[nb & bm::set_array_mask] : 0;
         if (ret == FULL_BLOCK_FAKE_ADDR)
             ret = FULL_BLOCK_REAL_ADDR;
@@ -684,12 +737,12 @@ public:
     \param nb - Index of block (logical linear number)
     \return block adress or NULL if not yet allocated or FULL_BLOCK_FAKE_ADDR
     */
-    bm::word_t* get_block_ptr(unsigned nb) const
+    bm::word_t* get_block_ptr(block_idx_type nb) const
     {
-        unsigned block_idx = nb >> bm::set_array_shift;
+        unsigned block_idx = unsigned(nb >> bm::set_array_shift);
         if (!top_blocks_ || (block_idx >= top_block_size_))
             return 0;
-        bm::word_t** blk_blk = top_blocks_[block_idx];
+        bm::word_t** blk_blk = top_slot(block_idx);
         return blk_blk ? blk_blk[nb & bm::set_array_mask] : 0;
     }
 
@@ -702,17 +755,17 @@ public:
         \param no_more_blocks - 1 if there are no more blocks at all
         \return block adress or NULL if not yet allocated
     */
-    bm::word_t* get_block(unsigned nb, int* no_more_blocks) const
+    bm::word_t* get_block(block_idx_type nb, int* no_more_blocks) const
     {
         BM_ASSERT(top_blocks_);
-        unsigned block_idx = nb >> bm::set_array_shift;
+        unsigned block_idx = unsigned(nb >> bm::set_array_shift);
         if (block_idx >= top_block_size_)
         {
             *no_more_blocks = 1;
             return 0;
         }
         *no_more_blocks = 0;
-        bm::word_t** blk_blk = top_blocks_[block_idx];
+        bm::word_t** blk_blk = top_slot(block_idx);
         bm::word_t* ret = blk_blk ? blk_blk[nb & bm::set_array_mask] : 0;
         if (ret == FULL_BLOCK_FAKE_ADDR)
             ret = FULL_BLOCK_REAL_ADDR;
@@ -724,10 +777,10 @@ public:
     */
     static
     BMFORCEINLINE
-    void get_block_coord(unsigned nb, unsigned& i, unsigned& j)
+    void get_block_coord(block_idx_type nb, unsigned& i, unsigned& j)
     {
-        i = nb >> bm::set_array_shift; // top block address
-        j = nb &  bm::set_array_mask;  // address in sub-block
+        i = unsigned(nb >> bm::set_array_shift); // top block address
+        j = unsigned(nb &  bm::set_array_mask);  // address in sub-block
     }
 
     /**
@@ -736,7 +789,7 @@ public:
     \param deep_scan - flag to perform detailed bit-block analysis
     @return bm::set_total_blocks - no more blocks
     */
-    unsigned find_next_nz_block(unsigned nb, bool deep_scan = true) const
+    block_idx_type find_next_nz_block(block_idx_type nb, bool deep_scan = true) const
     {
         if (is_init())
         {
@@ -744,18 +797,21 @@ public:
             get_block_coord(nb, i, j);
             for (;i < top_block_size_; ++i)
             { 
-                bm::word_t** blk_blk = top_blocks_[i];
+                bm::word_t** blk_blk = top_slot(i);
                 if (!blk_blk)
                 { 
-                    nb += bm::set_array_size - j;
+                    i = find_next_nz_top(i);
+                    if (i >= top_block_size_)
+                        break;
+                    blk_blk = top_slot(i);
+                    j = 0; nb = block_idx_type(i) << bm::set_array_shift;
                 }
-                else
-                   for (;j < bm::set_array_size; ++j, ++nb)
-                   {
-                       bm::word_t* blk = blk_blk[j];
-                       if (blk && !bm::check_block_zero(blk, deep_scan))
-                           return nb;
-                   } // for j
+                for (;j < bm::set_array_size; ++j, ++nb)
+                {
+                    bm::word_t* blk = blk_blk[j];
+                    if (blk && !bm::check_block_zero(blk, deep_scan))
+                        return nb;
+                } // for j
                 j = 0;
             } // for i
         } // is_init()
@@ -773,7 +829,7 @@ public:
     {
         if (!top_blocks_ || i >= top_block_size_) return 0;
 
-        const bm::word_t* const* blk_blk = top_blocks_[i];
+        const bm::word_t* const* blk_blk = top_slot(i);
         const bm::word_t* ret = (blk_blk == 0) ? 0 : blk_blk[j];
         return (ret == FULL_BLOCK_FAKE_ADDR) ? FULL_BLOCK_REAL_ADDR : ret;
     }
@@ -788,7 +844,7 @@ public:
     {
         if (!top_blocks_ || i >= top_block_size_) return 0;
 
-        const bm::word_t* const* blk_blk = top_blocks_[i];
+        const bm::word_t* const* blk_blk = top_slot(i);
         const bm::word_t* ret = (blk_blk == 0) ? 0 : blk_blk[j];
         return ret;
     }
@@ -802,7 +858,7 @@ public:
     {
         if (!top_blocks_ || i >= top_block_size_) return 0;
 
-        bm::word_t* const* blk_blk = top_blocks_[i];
+        bm::word_t* const* blk_blk = top_slot(i);
         bm::word_t* ret = (blk_blk == 0) ? 0 : blk_blk[j];
         return ret;
     }
@@ -815,20 +871,87 @@ public:
     */
     const bm::word_t* const * get_topblock(unsigned i) const
     {
-        return (!top_blocks_ || i >= top_block_size_) ? 0 : top_blocks_[i];
+        return (!top_blocks_ || i >= top_block_size_) ? 0 : top_slot(i);
+    }
+
+    /**
+        \brief Function returns top-level block in 2-level blocks array
+        \param i - top level block index
+        \return block adress or NULL if not yet allocated
+    */
+    bm::word_t** get_topblock(unsigned i)
+    {
+        return (!top_blocks_ || i >= top_block_size_) ? 0 : top_slot(i);
+    }
+
+    /**
+        Find the next allocated top-level block starting from i
+        (unallocated pages of the paged top level are skipped as a whole)
+        \param i - top level block index
+        \return top level block index or bm::set_top_array_size - no more blocks
+    */
+    unsigned find_next_nz_top(unsigned i) const
+    {
+        if (!top_blocks_)
+            return bm::set_top_array_size;
+        for (; i < top_block_size_; ++i)
+        {
+        #ifdef BM64ADDR
+            if (!top_blocks_[i >> bm::set_top_page_shift])
+            {
+                i |= bm::set_top_page_mask; // empty page
+                continue;
+            }
+        #endif
+            if (top_slot(i))
+                return i;
+        } // for i
+        return bm::set_top_array_size;
+    }
+
+    /**
+        Find the previous allocated top-level block starting from i
+        (searching backwards)
+        \param i - top level block index
+        \return top level block index or bm::set_top_array_size - no more blocks
+    */
+    unsigned find_prev_nz_top(unsigned i) const
+    {
+        if (!top_blocks_ || !top_block_size_)
+            return bm::set_top_array_size;
+        if (i >= top_block_size_)
+            i = top_block_size_ - 1;
+        for (;; --i)
+        {
+        #ifdef BM64ADDR
+            if (!top_blocks_[i >> bm::set_top_page_shift])
+            {
+                i &= ~bm::set_top_page_mask; // empty page
+                if (!i)
+                    break;
+                continue;
+            }
+        #endif
+            if (top_slot(i))
+                return i;
+            if (!i)
+                break;
+        } // for i
+        return bm::set_top_array_size;
     }
 
     /** 
         \brief Returns root block in the tree.
+        (directory of top level pages in 64-bit mode)
     */
-    bm::word_t*** top_blocks_root() const
+    top_root_type top_blocks_root() const
     {
         blocks_manager* bm = 
             const_cast<blocks_manager*>(this);
         return bm->top_blocks_root();
     }
 
-    void set_block_all_set(unsigned nb)
+    void set_block_all_set(block_idx_type nb)
     {
         bm::word_t* block = this->get_block(nb);
         set_block(nb, const_cast<bm::word_t*>(FULL_BLOCK_FAKE_ADDR));
@@ -845,7 +968,7 @@ public:
     /**
         Create(allocate) bit block. Old block (if exists) gets deleted.
     */
-    bm::word_t* alloc_bit_block(unsigned nb)
+    bm::word_t* alloc_bit_block(block_idx_type nb)
     {
         bm::word_t* block = this->get_allocator().alloc_bit_block();
         bm::word_t* old_block = set_block(nb, block);
@@ -862,7 +985,7 @@ public:
     /**
         Create all-zeros bit block. Old block (if exists) gets deleted.
     */
-    bm::word_t* make_bit_block(unsigned nb)
+    bm::word_t* make_bit_block(block_idx_type nb)
     {
         bm::word_t* block = this->alloc_bit_block(nb);
         bit_block_set(block, 0);
@@ -873,7 +996,7 @@ public:
         Create bit block as a copy of source block (bit or gap).
         Old block (if exists) gets deleted.
     */
-    bm::word_t* copy_bit_block(unsigned          nb, 
+    bm::word_t* copy_bit_block(block_idx_type          nb, 
                                const bm::word_t* block_src, int is_src_gap)
     {
         if (block_src == 0)
@@ -928,7 +1051,7 @@ public:
         Copy block from another vector.
         Note:Target block is always replaced through re-allocation.
     */
-    bm::word_t* copy_block(unsigned idx, const blocks_manager& bm_src)
+    bm::word_t* copy_block(block_idx_type idx, const blocks_manager& bm_src)
     {
         const bm::word_t* block = bm_src.get_block(idx);
         if (block == 0)
@@ -970,7 +1093,7 @@ public:
 
         initial_block_type and actual_block_type : 0 - bitset, 1 - gap
     */
-    bm::word_t* check_allocate_block(unsigned nb,
+    bm::word_t* check_allocate_block(block_idx_type nb,
                                      unsigned content_flag,
                                      int      initial_block_type,
                                      int*     actual_block_type,
@@ -987,6 +1110,7 @@ public:
             {
                 return 0; // it means nothing to do for the caller
             }
+            unshare_block(nb);
 
             if (initial_block_type == 0) // bitset requested
             {
@@ -1006,6 +1130,8 @@ public:
         else // block already exists
         {
             *actual_block_type = BM_IS_GAP(block);
+            if (unshare_block(nb)) // block is a fresh copy now
+                block = this->get_block_ptr(nb);
         }
 
         return block;
@@ -1014,8 +1140,9 @@ public:
     /**
         Function checks if block is not yet allocated, allocates and returns
     */
-    bm::word_t* check_allocate_block(unsigned nb, int initial_block_type)
+    bm::word_t* check_allocate_block(block_idx_type nb, int initial_block_type)
     {
+        unshare_block(nb);
         bm::word_t* block = this->get_block_ptr(nb);
 
         if (!IS_VALID_ADDR(block)) // NULL block or ALLSET
@@ -1048,6 +1175,7 @@ public:
     void set_all_zero(bool free_mem)
     {
         if (!is_init()) return;
+        next_epoch();
         
         unsigned top_size = this->top_block_size();
         if (free_mem)
@@ -1056,6 +1184,7 @@ public:
         }
         else
         {
+            release_shared_subblocks(); // no need to clone what gets cleared
             block_zero_func zero_func(*this);
             for_each_nzblock(top_blocks_, top_size,  zero_func);
         }
@@ -1065,31 +1194,46 @@ public:
     */
     void set_all_one()
     {
+        next_epoch();
         if (!is_init())
             init_tree();
+        release_shared_subblocks();
         block_one_func func(*this);
-        for_each_block(top_blocks_, top_block_size_,
-                                bm::set_array_size, func);
+        for_each_block(top_blocks_, top_block_size_, func);
     }
     
     
     bm::word_t** alloc_top_subblock(unsigned nblk_blk)
     {
-        BM_ASSERT(top_blocks_[nblk_blk] == 0);
-
-        bm::word_t** p = (bm::word_t**)alloc_.alloc_ptr();
-        ::memset(top_blocks_[nblk_blk] = p, 0,
-            bm::set_array_size * sizeof(bm::word_t*));
-        return p;
+        BM_ASSERT(top_slot(nblk_blk) == 0);
+        next_epoch();
+        return top_slot_ref(nblk_blk) = alloc_subblock();
     }
     
     bm::word_t** check_alloc_top_subblock(unsigned nblk_blk)
     {
-        if(top_blocks_[nblk_blk] == 0)
+        if(top_slot(nblk_blk) == 0)
         {
             return alloc_top_subblock(nblk_blk);
         }
-        return top_blocks_[nblk_blk];
+        BM_ASSERT(!is_subblock_shared(nblk_blk));
+        return top_slot(nblk_blk);
+    }
+
+    /**
+        Free (or release if shared) second level array
+        with all its blocks, make it zero pointer in the tree
+    */
+    void free_top_subblock(unsigned nblk_blk)
+    {
+        BM_ASSERT(nblk_blk < top_block_size_);
+        bm::word_t** blk_blk = top_slot(nblk_blk);
+        if (blk_blk)
+        {
+            next_epoch();
+            top_slot_ref(nblk_blk) = 0;
+            release_subblock(blk_blk);
+        }
     }
 
 
@@ -1097,9 +1241,10 @@ public:
         Places new block into descriptors table, returns old block's address.
         Old block is NOT deleted.
     */
-    bm::word_t* set_block(unsigned nb, bm::word_t* block)
+    bm::word_t* set_block(block_idx_type nb, bm::word_t* block)
     {
         bm::word_t* old_block;
+        next_epoch();
         
         if (!is_init())
             init_tree();
@@ -1110,12 +1255,12 @@ public:
             block = FULL_BLOCK_FAKE_ADDR;
 
         // top block index
-        unsigned nblk_blk = nb >> bm::set_array_shift;
+        unsigned nblk_blk = unsigned(nb >> bm::set_array_shift);
         reserve_top_blocks(nblk_blk+1);
         
         // If first level array not yet allocated, allocate it and
         // assign block to it
-        if (top_blocks_[nblk_blk] == 0)
+        if (top_slot(nblk_blk) == 0)
         {
             alloc_top_subblock(nblk_blk);
             /*
@@ -1127,11 +1272,12 @@ public:
         }
         else
         {
-            old_block = top_blocks_[nblk_blk][nb & bm::set_array_mask];
+            BM_ASSERT(!is_subblock_shared(nblk_blk));
+            old_block = top_slot(nblk_blk)[nb & bm::set_array_mask];
         }
 
         // NOTE: block will be replaced without freeing, potential memory leak?
-        top_blocks_[nblk_blk][nb & bm::set_array_mask] = block;
+        top_slot(nblk_blk)[nb & bm::set_array_mask] = block;
 
         return old_block;
     }
@@ -1139,7 +1285,7 @@ public:
     /**
     Allocate an place new GAP block (copy of provided block)
     */
-    bm::word_t* set_gap_block(unsigned      nb,
+    bm::word_t* set_gap_block(block_idx_type      nb,
                           const gap_word_t* gap_block_src,
                           int               level)
     {
@@ -1168,7 +1314,7 @@ public:
         Places new block into descriptors table, returns old block's address.
         Old block is not deleted.
     */
-    bm::word_t* set_block(unsigned nb, bm::word_t* block, bool gap)
+    bm::word_t* set_block(block_idx_type nb, bm::word_t* block, bool gap)
     {
         unsigned i, j;
         get_block_coord(nb, i, j);
@@ -1186,6 +1332,7 @@ public:
         BM_ASSERT(i < top_block_size_);
      
         bm::word_t* old_block;
+        next_epoch();
         if (block)
         {
             if (block == FULL_BLOCK_REAL_ADDR)
@@ -1197,17 +1344,19 @@ public:
 
         // If first level array not yet allocated, allocate it and
         // assign block to it
-        if (!top_blocks_[i])
+        if (!top_slot(i))
         {
-            top_blocks_[i] = (bm::word_t**)alloc_.alloc_ptr();
-            ::memset(top_blocks_[i], 0, bm::set_array_size * sizeof(void*));
+            alloc_top_subblock(i);
             old_block = 0;
         }
         else
-            old_block = top_blocks_[i][j];
+        {
+            BM_ASSERT(!is_subblock_shared(i));
+            old_block = top_slot(i)[j];
+        }
 
         // NOTE: block will be replaced without freeing, potential memory leak?
-        top_blocks_[i][j] = block;
+        top_slot(i)[j] = block;
         
         return old_block;
     }
@@ -1222,8 +1371,9 @@ public:
         BM_ASSERT(src_block != FULL_BLOCK_FAKE_ADDR);
         
         check_alloc_top_subblock(i);
-        BM_ASSERT(top_blocks_[i][j]==0);
-        bm::word_t* blk = top_blocks_[i][j] = alloc_.alloc_bit_block();
+        BM_ASSERT(top_slot(i)[j]==0);
+        next_epoch();
+        bm::word_t* blk = top_slot(i)[j] = alloc_.alloc_bit_block();
         bm::bit_block_copy(blk, src_block);
     }
 
@@ -1232,13 +1382,17 @@ public:
         Places new block into blocks table.
     */
     BMFORCEINLINE
-    void set_block_ptr(unsigned nb, bm::word_t* block)
+    void set_block_ptr(block_idx_type nb, bm::word_t* block)
     {
-        BM_ASSERT((nb >> bm::set_array_shift) < top_block_size_);
+        unsigned i, j;
+        get_block_coord(nb, i, j);
+        BM_ASSERT(i < top_block_size_);
         BM_ASSERT(is_init());
-        BM_ASSERT(top_blocks_[nb >> bm::set_array_shift]);
+        BM_ASSERT(top_slot(i));
+        BM_ASSERT(!is_subblock_shared(i));
         
-        top_blocks_[nb >> bm::set_array_shift][nb & bm::set_array_mask] =
+        next_epoch();
+        top_slot(i)[j] =
             (block == FULL_BLOCK_REAL_ADDR) ? FULL_BLOCK_FAKE_ADDR : block;
     }
 
@@ -1250,9 +1404,11 @@ public:
     {
         BM_ASSERT(is_init());
         BM_ASSERT(i < top_block_size_);
-        BM_ASSERT(top_blocks_[i]);
+        BM_ASSERT(top_slot(i));
+        BM_ASSERT(!is_subblock_shared(i));
         
-        top_blocks_[i][j] =
+        next_epoch();
+        top_slot(i)[j] =
             (block == FULL_BLOCK_REAL_ADDR) ? FULL_BLOCK_FAKE_ADDR : block;
     }
 
@@ -1262,7 +1418,7 @@ public:
         \param gap_block - Pointer to the gap block, if NULL block nb is taken
         \return new bit block's memory
     */
-    bm::word_t* convert_gap2bitset(unsigned nb, const gap_word_t* gap_block=0)
+    bm::word_t* convert_gap2bitset(block_idx_type nb, const gap_word_t* gap_block=0)
     {
         BM_ASSERT(is_init());
         
@@ -1285,7 +1441,7 @@ public:
     {
         BM_ASSERT(is_init());
         
-        if (!top_blocks_[i])
+        if (!top_slot(i))
         {
             alloc_top_subblock(i);
             /*
@@ -1293,7 +1449,9 @@ public:
             ::memset(top_blocks_[i], 0, bm::set_array_size * sizeof(void*));
             */
         }
-        bm::word_t* block = top_blocks_[i][j];
+        BM_ASSERT(!is_subblock_shared(i));
+        next_epoch();
+        bm::word_t* block = top_slot(i)[j];
         gap_block = gap_block ? gap_block : BMGAP_PTR(block);
 
         BM_ASSERT(IS_VALID_ADDR((bm::word_t*)gap_block));
@@ -1301,7 +1459,7 @@ public:
         bm::word_t* new_block = alloc_.alloc_bit_block();
         bm::gap_convert_to_bitset(new_block, gap_block);
         
-        top_blocks_[i][j] = new_block;
+        top_slot(i)[j] = new_block;
 
         // new block will replace the old one(no deletion)
         if (block)
@@ -1314,7 +1472,7 @@ public:
     /**
         Make sure block turns into true bit-block if it is GAP or a full block
     */
-    bm::word_t* deoptimize_block(unsigned nb)
+    bm::word_t* deoptimize_block(block_idx_type nb)
     {
         bm::word_t* block = this->get_block(nb);
         if (BM_IS_GAP(block))
@@ -1342,7 +1500,7 @@ public:
     /**
         Free block, make it zero pointer in the tree
     */
-    void zero_block(unsigned nb)
+    void zero_block(block_idx_type nb)
     {
         unsigned i, j;
         get_block_coord(nb, i, j);
@@ -1358,9 +1516,11 @@ public:
     {
         BM_ASSERT(top_blocks_ && i < top_block_size_);
         
-        bm::word_t** blk_blk = top_blocks_[i];
+        bm::word_t** blk_blk = top_slot(i);
         if (blk_blk)
         {
+            BM_ASSERT(!is_subblock_shared(i));
+            next_epoch();
             bm::word_t* block = blk_blk[j];
             blk_blk[j] = 0;
 
@@ -1379,12 +1539,14 @@ public:
     {
         BM_ASSERT(top_blocks_ && i < top_block_size_);
         
-        bm::word_t** blk_blk = top_blocks_[i];
+        bm::word_t** blk_blk = top_slot(i);
         bm::word_t* block = blk_blk[j];
 
         BM_ASSERT(blk_blk);
         BM_ASSERT(BM_IS_GAP(block));
+        BM_ASSERT(!is_subblock_shared(i));
 
+        next_epoch();
         blk_blk[j] = 0;
         alloc_.free_gap_block(BMGAP_PTR(block), glen());
     }
@@ -1417,7 +1579,7 @@ public:
 
         \return new GAP block pointer or NULL if block type mutated
     */
-    bm::gap_word_t* extend_gap_block(unsigned nb, gap_word_t* blk)
+    bm::gap_word_t* extend_gap_block(block_idx_type nb, gap_word_t* blk)
     {
         unsigned level = bm::gap_level(blk);
         unsigned len = bm::gap_length(blk);
@@ -1442,7 +1604,7 @@ public:
     /**
         Mark pointer as GAP and assign to the blocks tree
     */
-    void set_block_gap_ptr(unsigned nb, gap_word_t* gap_blk)
+    void set_block_gap_ptr(block_idx_type nb, gap_word_t* gap_blk)
     {
         bm::word_t* block = (bm::word_t*)BMPTR_SETBIT0(gap_blk);
         set_block_ptr(nb, block);
@@ -1498,7 +1660,18 @@ public:
     {
         unsigned m_used = (unsigned)sizeof(*this);
         m_used += (unsigned)(temp_block_ ? sizeof(word_t) * bm::set_block_size : 0);
+    #ifdef BM64ADDR
+        if (is_init())
+        {
+            unsigned pages = top_pages(top_block_size_);
+            m_used += (unsigned)(sizeof(bm::word_t***) * pages);
+            for (unsigned k = 0; k < pages; ++k)
+                if (top_blocks_[k])
+                    m_used += (unsigned)(sizeof(bm::word_t**) * top_page_len());
+        }
+    #else
         m_used += (unsigned)(sizeof(bm::word_t**) * top_block_size_);
+    #endif
 
         #ifdef BM_DISBALE_BIT_IN_PTR
         m_used += (unsigned)(gap_flags_.mem_used() - sizeof(gap_flags_));
@@ -1506,10 +1679,10 @@ public:
         
         if (is_init())
         {
-            for (unsigned i = 0; i < top_block_size_; ++i)
+            for (unsigned i = find_next_nz_top(0); i < top_block_size_;
+                                                   i = find_next_nz_top(i + 1))
             {
-                m_used += (unsigned)
-                    (top_blocks_[i] ? sizeof(void*) * bm::set_array_size : 0);
+                m_used += (unsigned)(sizeof(void*) * (bm::set_array_size + 1));
             }
         }
 
@@ -1523,10 +1696,10 @@ public:
         BM_ASSERT(top_blocks_);
         if (nsub >= top_block_size_)
             return true;
-        return top_blocks_[nsub] == NULL;
+        return top_slot(nsub) == NULL;
     }
 
-    bm::word_t*** top_blocks_root()
+    top_root_type top_blocks_root()
     {
         return top_blocks_;
     }
@@ -1556,7 +1729,7 @@ public:
     /**
         \brief reserve capacity for specified number of bits
     */
-    void reserve(unsigned max_bits)
+    void reserve(id_type max_bits)
     {
         if (max_bits) 
         {
@@ -1570,12 +1743,46 @@ public:
     */
     unsigned reserve_top_blocks(unsigned top_blocks)
     {
-        BM_ASSERT(top_blocks <= bm::set_array_size);
+        BM_ASSERT(top_blocks <= bm::set_top_array_size);
         //BM_ASSERT(is_init());
 
         if (top_blocks_ && top_blocks <= top_block_size_)
             return top_block_size_; // nothing to do
-        
+    #ifdef BM64ADDR
+        // wide top level grows geometrically to keep incremental
+        // fill-in (ascending ids) from re-copying the top array every time
+        if (top_blocks_ && top_blocks < top_block_size_ * 2)
+        {
+            top_blocks = top_block_size_ * 2;
+            if (top_blocks > bm::set_top_array_size)
+                top_blocks = bm::set_top_array_size;
+        }
+        top_blocks = top_pages_size(top_blocks);
+
+        // only the directory of pages is re-allocated,
+        // short first page of a small tree grows to the new size
+        unsigned pages = top_pages(top_blocks);
+        top_root_type new_blocks = (top_root_type)alloc_.alloc_ptr(pages);
+        ::memset(new_blocks, 0, pages * sizeof(bm::word_t***));
+        if (top_blocks_)
+        {
+            unsigned old_pages = top_pages(top_block_size_);
+            ::memcpy(new_blocks, top_blocks_, old_pages * sizeof(bm::word_t***));
+            bm::word_t*** page = top_blocks_[0];
+            if (page && top_block_size_ < bm::set_top_page_size)
+            {
+                unsigned len = top_blocks < bm::set_top_page_size ?
+                                        top_blocks : bm::set_top_page_size;
+                new_blocks[0] = (bm::word_t***)alloc_.alloc_ptr(len);
+                ::memcpy(new_blocks[0], page,
+                         top_block_size_ * sizeof(bm::word_t**));
+                ::memset(new_blocks[0] + top_block_size_, 0,
+                         (len - top_block_size_) * sizeof(bm::word_t**));
+                alloc_.free_ptr(page, top_block_size_);
+            }
+            alloc_.free_ptr(top_blocks_, old_pages);
+        }
+    #else
         bm::word_t*** new_blocks = 
             (bm::word_t***)alloc_.alloc_ptr(top_blocks);
 
@@ -1583,17 +1790,42 @@ public:
         if (top_blocks_)
         {
             for (; i < top_block_size_; ++i)
-                new_blocks[i] = top_blocks_[i];
+                new_blocks[i] = top_slot(i);
             alloc_.free_ptr(top_blocks_, top_block_size_);
         }
         for (; i < top_blocks; ++i)
             new_blocks[i] = 0;
+    #endif
         
         top_blocks_ = new_blocks;
         top_block_size_ = top_blocks;
         return top_block_size_;
     }
-    
+
+    /*!
+        \brief Pre-allocate top level pages where another vector has
+        sub-blocks, so sub-blocks of disjoint top level slots can then
+        be allocated concurrently (no-op for the flat top level)
+        \sa reserve_top_blocks
+    */
+    void reserve_top_pages(const blocks_manager& bm_src)
+    {
+    #ifdef BM64ADDR
+        if (!top_blocks_ || !bm_src.top_blocks_)
+            return;
+        unsigned top_size = bm::min_value(top_block_size_,
+                                          bm_src.top_block_size_);
+        unsigned pages = top_pages(top_size);
+        for (unsigned k = 0; k < pages; ++k)
+        {
+            if (bm_src.top_blocks_[k] && !top_blocks_[k])
+                top_slot_ref(k << bm::set_top_page_shift); // allocates page
+        }
+    #else
+        (void)bm_src;
+    #endif
+    }
+
     /** \brief Returns reference on the allocator
     */
     allocator_type& get_allocator() { return alloc_; }
@@ -1605,6 +1837,20 @@ public:
     
     /// if tree of blocks already up
     bool is_init() const { return top_blocks_ != 0; }
+
+    /**
+        Modification epoch: changes on every (potential) modification
+        of the blocks (bases are unique per blocks manager instance,
+        so a destroyed vector can not be confused with a new one)
+    */
+    bm::id64_t epoch() const
+    {
+#if !defined(BM_NO_STL) && !defined(BM_NO_CXX11)
+        return epoch_.load(std::memory_order_relaxed);
+#else
+        return epoch_;
+#endif
+    }
     
     /// allocate first level of descr. of blocks 
     void init_tree()
@@ -1613,8 +1859,15 @@ public:
         
         if (top_block_size_)
         {
+        #ifdef BM64ADDR
+            top_block_size_ = top_pages_size(top_block_size_);
+            unsigned pages = top_pages(top_block_size_);
+            top_blocks_ = (top_root_type) alloc_.alloc_ptr(pages);
+            ::memset(top_blocks_, 0, pages * sizeof(bm::word_t***));
+        #else
             top_blocks_ = (bm::word_t***) alloc_.alloc_ptr(top_block_size_);
             ::memset(top_blocks_, 0, top_block_size_ * sizeof(bm::word_t**));
+        #endif
         }
         else
         {
@@ -1622,6 +1875,215 @@ public:
         }
     }
 
+    /** Returns true if second level array is shared with
+        another vector (copy-on-write)
+    */
+    bool is_subblock_shared(unsigned i) const
+    {
+        if (!top_blocks_ || i >= top_block_size_ || !top_slot(i))
+            return false;
+        return subblock_ref_count(top_slot(i)) != 1;
+    }
+
+    /**
+        Make second level array private to this vector:
+        shared array gets cloned before modification.
+        \return new (or unchanged) second level array
+    */
+    bm::word_t** unshare_subblock(unsigned i)
+    {
+        BM_ASSERT(i < top_block_size_);
+        next_epoch(); // caller is going to modify the blocks
+        bm::word_t** blk_blk = top_slot(i);
+        if (!blk_blk || subblock_ref_count(blk_blk) == 1)
+            return blk_blk;
+
+        bm::word_t** new_blk_blk = alloc_subblock();
+        copy_subblock(new_blk_blk, blk_blk, 0, bm::set_array_size);
+        top_slot_ref(i) = new_blk_blk;
+        release_subblock(blk_blk);
+        return new_blk_blk;
+    }
+
+    /**
+        Make block writable (unshare its second level array)
+        \return true if block pointer changed (array got cloned)
+    */
+    BMFORCEINLINE
+    bool unshare_block(block_idx_type nb)
+    {
+        next_epoch(); // caller is going to modify the block
+        unsigned i = unsigned(nb >> bm::set_array_shift);
+        if (!is_subblock_shared(i))
+            return false;
+        unshare_subblock(i);
+        return true;
+    }
+
+    /**
+        Make range of blocks [nb_from..nb_to] writable
+    */
+    void unshare_range(block_idx_type nb_from, block_idx_type nb_to)
+    {
+        next_epoch();
+        if (!top_blocks_)
+            return;
+        BM_ASSERT(nb_from <= nb_to);
+        unsigned i_from = unsigned(nb_from >> bm::set_array_shift);
+        unsigned i_to = unsigned(nb_to >> bm::set_array_shift);
+        if (i_to >= top_block_size_)
+            i_to = top_block_size_ - 1;
+        for (unsigned i = find_next_nz_top(i_from); i <= i_to;
+                                            i = find_next_nz_top(i + 1))
+            unshare_subblock(i);
+    }
+
+    /**
+        Make all blocks writable (no second level array stays shared)
+    */
+    void unshare_all()
+    {
+        next_epoch();
+        if (!top_blocks_)
+            return;
+        for (unsigned i = find_next_nz_top(0); i < top_block_size_;
+                                               i = find_next_nz_top(i + 1))
+            unshare_subblock(i);
+    }
+
+    /**
+        Copy content of another blocks manager by sharing its
+        second level arrays (copy-on-write).
+        Falls back to deep copy if GAP level tables do not match.
+    */
+    void share(const blocks_manager& blockman)
+    {
+        next_epoch();
+        if (::memcmp(glevel_len_, blockman.glevel_len_, sizeof(glevel_len_)))
+        {
+            copy(blockman);
+            return;
+        }
+        unsigned arg_top_blocks = blockman.top_block_size();
+        this->reserve_top_blocks(arg_top_blocks);
+
+        if (!blockman.is_init())
+            return;
+        if (blockman.arena_) // arena blocks are shared too
+        {
+            BM_ASSERT(!arena_);
+            ref_add(&blockman.arena_->ref);
+            arena_ = blockman.arena_;
+        }
+        for (unsigned i = blockman.find_next_nz_top(0); i < arg_top_blocks;
+                                      i = blockman.find_next_nz_top(i + 1))
+        {
+            bm::word_t** blk_blk_arg = blockman.top_slot(i);
+            BM_ASSERT(top_slot(i) == 0);
+            ref_add(subblock_ref(blk_blk_arg));
+            top_slot_ref(i) = blk_blk_arg;
+        } // for i
+    }
+
+    /**
+        Pack all blocks into one contiguous memory arena (frozen layout).
+
+        Second level arrays of the arena are permanently marked as shared,
+        so modification copies the affected group of blocks out of the arena
+        (copy-on-write). Arena is freed when the last vector using it
+        is destroyed.
+    */
+    void freeze()
+    {
+        if (!top_blocks_)
+            return;
+
+        // pass 1: compute the arena size
+        //
+        size_t bit_blocks = 0, gap_words = 0, subblocks = 0;
+        for (unsigned i = find_next_nz_top(0); i < top_block_size_;
+                                               i = find_next_nz_top(i + 1))
+        {
+            bm::word_t** blk_blk = top_slot(i);
+            ++subblocks;
+            for (unsigned j = 0; j < bm::set_array_size; ++j)
+            {
+                bm::word_t* blk = blk_blk[j];
+                if (!IS_VALID_ADDR(blk))
+                    continue;
+                if (BM_IS_GAP(blk))
+                    gap_words += arena_gap_capacity(BMGAP_PTR(blk));
+                else
+                    ++bit_blocks;
+            } // for j
+        } // for i
+        if (!subblocks)
+            return;
+
+        size_t arena_size = // in bytes
+            (bit_blocks * bm::set_block_size + gap_words) * sizeof(bm::word_t) +
+            subblocks * (bm::set_array_size + 1) * sizeof(bm::word_t*) +
+            sizeof(arena);
+        const size_t block_bytes = bm::set_block_size * sizeof(bm::word_t);
+        unsigned alloc_factor =
+                        unsigned((arena_size + block_bytes - 1) / block_bytes);
+
+        bm::word_t* mem = alloc_.alloc_bit_block(alloc_factor);
+        bm::word_t* bit_ptr = mem;
+        bm::word_t* gap_ptr = mem + bit_blocks * bm::set_block_size;
+        bm::word_t** sub_ptr = (bm::word_t**)(gap_ptr + gap_words);
+
+        arena* ar = (arena*)(sub_ptr + subblocks * (bm::set_array_size + 1));
+        new(&ar->ref) ref_counter_type(1); // placement new
+        ar->mem = mem;
+        ar->alloc_factor = alloc_factor;
+
+        // pass 2: move the content into the arena
+        //
+        for (unsigned i = find_next_nz_top(0); i < top_block_size_;
+                                               i = find_next_nz_top(i + 1))
+        {
+            bm::word_t** blk_blk = top_slot(i);
+            bm::word_t** new_blk_blk = sub_ptr;
+            sub_ptr += bm::set_array_size + 1;
+            // arena array is never released to 0 (extra reference)
+            new(subblock_ref(new_blk_blk)) ref_counter_type(2);
+
+            for (unsigned j = 0; j < bm::set_array_size; ++j)
+            {
+                bm::word_t* blk = blk_blk[j];
+                if (!IS_VALID_ADDR(blk)) // NULL or FULL
+                {
+                    new_blk_blk[j] = blk;
+                    continue;
+                }
+                if (BM_IS_GAP(blk))
+                {
+                    const bm::gap_word_t* gap_blk = BMGAP_PTR(blk);
+                    ::memcpy(gap_ptr, gap_blk,
+                             bm::gap_length(gap_blk) * sizeof(bm::gap_word_t));
+                    new_blk_blk[j] = (bm::word_t*)BMPTR_SETBIT0(gap_ptr);
+                    gap_ptr += arena_gap_capacity(gap_blk);
+                }
+                else
+                {
+                    bm::bit_block_copy(bit_ptr, blk);
+                    new_blk_blk[j] = bit_ptr;
+                    bit_ptr += bm::set_block_size;
+                }
+            } // for j
+            top_slot_ref(i) = new_blk_blk;
+            release_subblock(blk_blk);
+        } // for i
+
+        if (arena_) // re-freeze: old arena no longer used by this vector
+            release_arena(arena_);
+        arena_ = ar;
+    }
+
+    /// Returns true if blocks are (at least partially) in a frozen arena
+    bool is_frozen() const { return arena_ != 0; }
+
 private:
 
     void operator =(const blocks_manager&);
@@ -1637,6 +2099,7 @@ private:
         } 
 
     /** destroy tree, free memory in all blocks and control structures
+        (shared second level arrays are released)
         Note: pointers are NOT assigned to zero(!)
     */
     void destroy_tree() BMNOEXEPT
@@ -1645,45 +2108,66 @@ private:
             return;
 
         unsigned top_blocks = top_block_size();
-        for (unsigned i = 0; i < top_blocks; ++i)
+        for (unsigned i = find_next_nz_top(0); i < top_blocks;
+                                               i = find_next_nz_top(i + 1))
         {
-            bm::word_t** blk_blk = top_blocks_[i];
-            if (!blk_blk) 
-                continue;
-            unsigned j = 0; bm::word_t* blk;
-            do
-            {
-            #ifdef BM64_AVX2
-                if (!avx2_test_all_zero_wave(blk_blk + j))
-                {
-                    BM_FREE_OP(0)
-                    BM_FREE_OP(1)
-                    BM_FREE_OP(2)
-                    BM_FREE_OP(3)
-                }
-                j += 4;
-            #elif defined(BM64_SSE4)
-                if (!sse42_test_all_zero_wave(blk_blk + j))
-                {
-                    BM_FREE_OP(0)
-                    BM_FREE_OP(1)
-                }
-                j += 2;
-            #else
-                BM_FREE_OP(0)
-                ++j;
-            #endif
-            } while (j < bm::set_array_size);
-
-            alloc_.free_ptr(top_blocks_[i]); // free second level
+            release_subblock(top_slot(i));
         } // for i
 
+    #ifdef BM64ADDR
+        unsigned pages = top_pages(top_block_size_);
+        for (unsigned k = 0; k < pages; ++k)
+        {
+            if (top_blocks_[k])
+                alloc_.free_ptr(top_blocks_[k], top_page_len());
+        }
+        alloc_.free_ptr(top_blocks_, pages); // free the top directory
+    #else
         alloc_.free_ptr(top_blocks_, top_block_size_); // free the top
+    #endif
+        if (arena_)
+        {
+            release_arena(arena_);
+            arena_ = 0;
+        }
+    }
+
+    /** free all blocks of the second level array and the array itself
+    */
+    void free_subblock(bm::word_t** blk_blk) BMNOEXEPT
+    {
+        unsigned j = 0; bm::word_t* blk;
+        do
+        {
+        #ifdef BM64_AVX2
+            if (!avx2_test_all_zero_wave(blk_blk + j))
+            {
+                BM_FREE_OP(0)
+                BM_FREE_OP(1)
+                BM_FREE_OP(2)
+                BM_FREE_OP(3)
+            }
+            j += 4;
+        #elif defined(BM64_SSE4)
+            if (!sse42_test_all_zero_wave(blk_blk + j))
+            {
+                BM_FREE_OP(0)
+                BM_FREE_OP(1)
+            }
+            j += 2;
+        #else
+            BM_FREE_OP(0)
+            ++j;
+        #endif
+        } while (j < bm::set_array_size);
+
+        alloc_.free_ptr(blk_blk, bm::set_array_size + 1); // free second level
     }
     #undef BM_FREE_OP 
 
     void deinit_tree() BMNOEXEPT
     {
+        next_epoch();
         destroy_tree();
         top_blocks_ = 0; top_block_size_ = 0;
     }
@@ -1691,15 +2175,14 @@ private:
     // ----------------------------------------------------------------
     
     void copy(const blocks_manager& blockman,
-              unsigned block_from = 0, unsigned block_to = 65535)
+              block_idx_type block_from = 0,
+              block_idx_type block_to = bm::set_total_blocks-1)
     {
+        next_epoch();
         unsigned arg_top_blocks = blockman.top_block_size();
         this->reserve_top_blocks(arg_top_blocks);
         
-        bm::word_t*** blk_root = top_blocks_root();
-        bm::word_t*** blk_root_arg = blockman.top_blocks_root();
-        
-        if (!blk_root_arg)
+        if (!blockman.is_init())
             return;
         
         unsigned i_from, j_from, i_to, j_to;
@@ -1712,61 +2195,242 @@ private:
             j_to = bm::set_array_size-1;
         }
 
-        for (unsigned i = i_from; i <= i_to; ++i)
+        for (unsigned i = blockman.find_next_nz_top(i_from); i <= i_to;
+                                      i = blockman.find_next_nz_top(i + 1))
         {
-            bm::word_t** blk_blk_arg = blk_root_arg[i];
-            if (!blk_blk_arg)
-                continue;
+            bm::word_t** blk_blk_arg = blockman.top_slot(i);
             
-            BM_ASSERT(blk_root[i] == 0);
+            BM_ASSERT(top_slot(i) == 0);
 
-            bm::word_t** blk_blk = blk_root[i] = (bm::word_t**)alloc_.alloc_ptr();
-            ::memset(blk_blk, 0, bm::set_array_size * sizeof(bm::word_t*));
+            bm::word_t** blk_blk = alloc_top_subblock(i);
             
             unsigned j = (i == i_from) ? j_from : 0;
             unsigned j_limit = (i == i_to) ? j_to+1 : bm::set_array_size;
-            bm::word_t* blk;
-            const bm::word_t* blk_arg;
-            do
+            copy_subblock(blk_blk, blk_blk_arg, j, j_limit);
+        } // for i
+    }
+
+    /** clone blocks [j, j_limit) of the second level array
+    */
+    void copy_subblock(bm::word_t**             blk_blk,
+                       const bm::word_t* const* blk_blk_arg,
+                       unsigned j, unsigned j_limit)
+    {
+        bm::word_t* blk;
+        const bm::word_t* blk_arg;
+        do
+        {
+            blk = blk_blk[j]; blk_arg = blk_blk_arg[j];
+            if (blk_arg)
             {
-                blk = blk_blk[j]; blk_arg = blk_blk_arg[j];
-                if (blk_arg)
+                bool is_gap = BM_IS_GAP(blk_arg);
+                if (is_gap)
                 {
-                    bool is_gap = BM_IS_GAP(blk_arg);
+                    blk = clone_gap_block(BMGAP_PTR(blk_arg), is_gap);
                     if (is_gap)
-                    {
-                        blk = clone_gap_block(BMGAP_PTR(blk_arg), is_gap);
-                        if (is_gap)
-                            BMSET_PTRGAP(blk);
-                    }
+                        BMSET_PTRGAP(blk);
+                }
+                else
+                {
+                    if (blk_arg == FULL_BLOCK_FAKE_ADDR /*IS_FULL_BLOCK(blk_arg)*/)
+                        blk = FULL_BLOCK_FAKE_ADDR;
                     else
                     {
-                        if (blk_arg == FULL_BLOCK_FAKE_ADDR /*IS_FULL_BLOCK(blk_arg)*/)
-                            blk = FULL_BLOCK_FAKE_ADDR;
-                        else
-                        {
-                            BM_ASSERT(!IS_FULL_BLOCK(blk_arg));
-                            blk = alloc_.alloc_bit_block();
-                            bm::bit_block_copy(blk, blk_arg);
-                        }
+                        BM_ASSERT(!IS_FULL_BLOCK(blk_arg));
+                        blk = alloc_.alloc_bit_block();
+                        bm::bit_block_copy(blk, blk_arg);
                     }
-                    blk_blk[j] = blk;
                 }
-                ++j;
-            } while (j < j_limit);
+                blk_blk[j] = blk;
+            }
+            ++j;
+        } while (j < j_limit);
+    }
+
+    // ----------------------------------------------------------------
+
+    static
+    ref_counter_type* subblock_ref(bm::word_t** blk_blk)
+    {
+        return (ref_counter_type*)(blk_blk + bm::set_array_size);
+    }
+
+    static
+    unsigned ref_count(ref_counter_type* ref)
+    {
+    #if !defined(BM_NO_STL) && !defined(BM_NO_CXX11)
+        return ref->load(std::memory_order_acquire);
+    #else
+        return *ref;
+    #endif
+    }
+
+    static
+    void ref_add(ref_counter_type* ref)
+    {
+    #if !defined(BM_NO_STL) && !defined(BM_NO_CXX11)
+        ref->fetch_add(1, std::memory_order_relaxed);
+    #else
+        ++(*ref);
+    #endif
+    }
+
+    /// drop one reference, returns true if it was the last one
+    static
+    bool ref_release(ref_counter_type* ref)
+    {
+    #if !defined(BM_NO_STL) && !defined(BM_NO_CXX11)
+        if (ref->load(std::memory_order_acquire) == 1) // exclusive owner
+            return true;
+        return ref->fetch_sub(1, std::memory_order_acq_rel) == 1;
+    #else
+        return --(*ref) == 0;
+    #endif
+    }
+
+    static
+    unsigned subblock_ref_count(bm::word_t** blk_blk)
+    {
+        return ref_count(subblock_ref(blk_blk));
+    }
+
+    /// allocate empty second level array (reference count == 1)
+    bm::word_t** alloc_subblock()
+    {
+        BM_ASSERT(sizeof(ref_counter_type) <= sizeof(bm::word_t*));
+        bm::word_t** blk_blk =
+            (bm::word_t**)alloc_.alloc_ptr(bm::set_array_size + 1);
+        ::memset(blk_blk, 0, bm::set_array_size * sizeof(bm::word_t*));
+        new(subblock_ref(blk_blk)) ref_counter_type(1); // placement new
+        return blk_blk;
+    }
+
+    /// drop reference on the second level array, free if it was the last
+    void release_subblock(bm::word_t** blk_blk) BMNOEXEPT
+    {
+        if (ref_release(subblock_ref(blk_blk)))
+            free_subblock(blk_blk);
+    }
+
+    /// GAP block size in the arena (in words), keeps SIMD alignment
+    unsigned arena_gap_capacity(const bm::gap_word_t* gap_blk) const
+    {
+        const unsigned align = 16; // 64 bytes
+        unsigned len = bm::gap_capacity(gap_blk, glevel_len_);
+        len = unsigned((len * sizeof(bm::gap_word_t) + sizeof(bm::word_t) - 1) /
+                        sizeof(bm::word_t));
+        return (len + align - 1) & ~(align - 1);
+    }
+
+    /// drop reference on the arena, free if it was the last
+    void release_arena(arena* ar) BMNOEXEPT
+    {
+        if (ref_release(&ar->ref))
+            alloc_.free_bit_block(ar->mem, ar->alloc_factor);
+    }
+
+    /// detach all shared second level arrays (tree loses their content)
+    void release_shared_subblocks()
+    {
+        for (unsigned i = find_next_nz_top(0); i < top_block_size_;
+                                               i = find_next_nz_top(i + 1))
+        {
+            bm::word_t** blk_blk = top_slot(i);
+            if (subblock_ref_count(blk_blk) != 1)
+            {
+                top_slot_ref(i) = 0;
+                release_subblock(blk_blk);
+            }
         } // for i
     }
 
 
+    /// second level array of top level slot i (i < top_block_size_)
+    BMFORCEINLINE
+    bm::word_t** top_slot(unsigned i) const
+    {
+    #ifdef BM64ADDR
+        bm::word_t*** page = top_blocks_[i >> bm::set_top_page_shift];
+        return page ? page[i & bm::set_top_page_mask] : 0;
+    #else
+        return top_blocks_[i];
+    #endif
+    }
+
+    /// top level slot i for assignment (allocates top level page)
+    bm::word_t**& top_slot_ref(unsigned i)
+    {
+        BM_ASSERT(top_blocks_ && i < top_block_size_);
+    #ifdef BM64ADDR
+        bm::word_t***& page = top_blocks_[i >> bm::set_top_page_shift];
+        if (!page)
+        {
+            unsigned len = top_page_len();
+            page = (bm::word_t***)alloc_.alloc_ptr(len);
+            ::memset(page, 0, len * sizeof(bm::word_t**));
+        }
+        return page[i & bm::set_top_page_mask];
+    #else
+        return top_blocks_[i];
+    #endif
+    }
+
+#ifdef BM64ADDR
+    /// number of top level pages for the top level size
+    static unsigned top_pages(unsigned top_size)
+    {
+        return (top_size + bm::set_top_page_mask) >> bm::set_top_page_shift;
+    }
+
+    /// top level size adjusted to the page layout: small tree has one
+    /// short page, larger tree consists of whole pages
+    static unsigned top_pages_size(unsigned top_size)
+    {
+        if (top_size <= bm::set_top_page_size)
+            return top_size;
+        return top_pages(top_size) << bm::set_top_page_shift;
+    }
+
+    /// size of a top level page (in slots)
+    unsigned top_page_len() const
+    {
+        return top_block_size_ < bm::set_top_page_size ?
+                                    top_block_size_ : bm::set_top_page_size;
+    }
+#endif
+
+private:
+    /// advance modification epoch, relaxed atomic: workers of parallel
+    /// range operations can modify different sub-trees of one vector
+    void next_epoch() BMNOEXEPT
+    {
+#if !defined(BM_NO_STL) && !defined(BM_NO_CXX11)
+        epoch_.store(epoch_.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+#else
+        ++epoch_;
+#endif
+    }
+
+    static bm::id64_t new_epoch_base()
+    {
+        static epoch_counter_type epoch_cnt(0);
+        return (++epoch_cnt) << 32;
+    }
+
 private:
     /// maximum addresable bits
-    bm::id_t                               max_bits_;
+    id_type                                max_bits_;
     /// Tree of blocks.
-    bm::word_t***                          top_blocks_;
+    top_root_type                          top_blocks_;
     /// Size of the top level block array in blocks_ tree
     unsigned                               top_block_size_;
     /// Temp block.
     bm::word_t*                            temp_block_; 
+    /// Memory arena of a frozen vector
+    arena*                                 arena_;
+    /// Modification epoch
+    epoch_counter_type                     epoch_;
     /// vector defines gap block lengths for different levels 
     gap_word_t                             glevel_len_[bm::gap_levels];
     /// allocator
@@ -408,7 +408,7 @@ void print_stat(const BV& bv, unsigned blocks = 0)
 
     if (!blocks)
     {
-        blocks = bm::set_total_blocks;
+        blocks = bm::set_total_blocks32;
     }
 
     unsigned nb;
@@ -430,7 +430,7 @@ void print_stat(const BV& bv, unsigned blocks = 0)
            }
            
            unsigned start = nb; 
-           for(unsigned i = nb+1; i < bm::set_total_blocks; ++i, ++nb)
+           for(unsigned i = nb+1; i < bm::set_total_blocks32; ++i, ++nb)
            {
                blk = bman.get_block(nb);
                if (IS_FULL_BLOCK(blk))
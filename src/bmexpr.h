@@ -0,0 +1,640 @@
+#ifndef BMEXPR__H__INCLUDED__
+#define BMEXPR__H__INCLUDED__
+/*
+Copyright(c) 2002-2017 Anatoliy Kuznetsov(anatoliy_kuznetsov at yahoo.com)
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+For more information please visit:  http://bitmagic.io
+*/
+
+/*! \file bmexpr.h
+    \brief Expression templates for fused evaluation of logical
+    expressions on bvectors
+*/
+
+#include "bm.h"
+#include "bmfunc.h"
+#include "bmdef.h"
+
+
+namespace bm
+{
+
+/**
+    Expression evaluated for one block of the blocks tree.
+    blk is 0 (all 0s), FULL_BLOCK_REAL_ADDR (all 1s), bit block or GAP block
+
+    @internal
+*/
+struct expr_block
+{
+    const bm::word_t* blk;    ///< result block
+    bm::word_t*       tmp;    ///< blk if it is a writable temp block, or 0
+    bm::id64_t        digest; ///< bit-block digest (~0 if not known)
+    bool              gap;    ///< GAP block flag
+};
+
+/**
+    Temp blocks (one per operation node) and caches of expression
+    evaluation
+
+    @internal
+*/
+class expr_context
+{
+public:
+    explicit expr_context(unsigned temp_blocks)
+    {
+        tb_ = (bm::word_t*) bm::aligned_new_malloc(
+                sizeof(bm::word_t) * bm::set_block_size *
+                (temp_blocks ? temp_blocks : 1));
+    }
+    ~expr_context() { bm::aligned_free(tb_); }
+
+    /// temp block memory
+    bm::word_t* tb() { return tb_; }
+
+    bm::bit_decode_cache dcache; ///< digest decode cache
+
+private:
+    expr_context(const expr_context&);
+    expr_context& operator=(const expr_context&);
+private:
+    bm::word_t* tb_;
+};
+
+/**
+    Combine two non-empty blocks of expression: res = res OP arg
+    Uses writable temp block of an argument or tb as the destination.
+
+    @internal
+*/
+inline
+void expr_combine(bm::operation op, expr_block& res, const expr_block& arg,
+                  bm::word_t* tb, bm::bit_decode_cache& dcache)
+{
+    BM_ASSERT(res.blk && arg.blk);
+
+    const expr_block* src = &arg;
+    bm::word_t* dst;
+    bm::id64_t digest;
+    if (res.tmp)
+    {
+        dst = res.tmp; digest = res.digest;
+    }
+    else
+    if (arg.tmp && op != BM_SUB)
+    {
+        dst = arg.tmp; digest = arg.digest; src = &res;
+    }
+    else // both arguments are read-only
+    {
+        dst = tb;
+        if (op == BM_AND && !res.gap && !arg.gap)
+        {
+            digest = bm::bit_block_and_2way(dst, res.blk, arg.blk,
+                                            res.digest & arg.digest);
+            res.blk = res.tmp = digest ? dst : 0;
+            res.digest = digest;
+            return;
+        }
+        const expr_block* m = &res; // argument to copy into temp block
+        if (op != BM_SUB && res.gap && !arg.gap)
+        {
+            m = &arg; src = &res;
+        }
+        if (m->gap)
+            bm::gap_convert_to_bitset(dst, BMGAP_PTR(m->blk));
+        else
+            bm::bit_block_copy(dst, m->blk);
+        digest = m->digest;
+    }
+
+    const bm::gap_word_t* gap_src = src->gap ? BMGAP_PTR(src->blk) : 0;
+    switch (op)
+    {
+    case BM_AND:
+        if (gap_src)
+        {
+            bm::gap_and_to_bitset(dst, gap_src, digest);
+            digest = bm::update_block_digest0(dst, digest);
+        }
+        else
+            digest = bm::bit_block_and(dst, src->blk, digest, dcache);
+        break;
+    case BM_SUB:
+        if (gap_src)
+        {
+            bm::gap_sub_to_bitset(dst, gap_src, digest);
+            digest = bm::update_block_digest0(dst, digest);
+        }
+        else
+            digest = bm::bit_block_sub(dst, src->blk, digest, dcache);
+        break;
+    case BM_OR:
+        if (gap_src)
+            bm::gap_add_to_bitset(dst, gap_src);
+        else
+        if (bm::bit_block_or(dst, src->blk)) // all 1s
+        {
+            res.blk = FULL_BLOCK_REAL_ADDR;
+            res.tmp = 0; res.gap = false; res.digest = ~0ull;
+            return;
+        }
+        digest = ~0ull;
+        break;
+    case BM_XOR:
+        if (gap_src)
+            bm::gap_xor_to_bitset(dst, gap_src);
+        else
+            bm::bit_block_xor(dst, src->blk);
+        digest = bm::calc_block_digest0(dst);
+        break;
+    default:
+        BM_ASSERT(0);
+    } // switch
+
+    res.blk = res.tmp = digest ? dst : 0;
+    res.digest = digest;
+    res.gap = false;
+}
+
+/**
+    Population count of an evaluated expression block
+    @internal
+*/
+inline
+unsigned expr_block_count(const expr_block& res)
+{
+    if (!res.blk)
+        return 0;
+    if (res.gap)
+        return bm::gap_bit_count_unr(BMGAP_PTR(res.blk));
+    if (res.blk == FULL_BLOCK_REAL_ADDR)
+        return bm::gap_max_bits;
+    return bm::bit_block_count(res.blk);
+}
+
+// ------------------------------------------------------------------------
+
+/**
+    Base class of all expression nodes (CRTP)
+
+    \ingroup setalgo
+*/
+template<class E>
+class expr_base
+{
+public:
+    const E& derived() const { return static_cast<const E&>(*this); }
+};
+
+/**
+    Expression argument: reference on a bvector
+
+    \ingroup setalgo
+*/
+template<class BV>
+class expr_leaf : public expr_base<expr_leaf<BV> >
+{
+public:
+    typedef BV                         bvector_type;
+    typedef typename BV::size_type     size_type;
+
+    enum { temp_blocks = 0 };
+
+    explicit expr_leaf(const BV& bv) : bv_(&bv) {}
+
+    /// true if expression has no blocks in top level block i
+    bool is_empty_top(unsigned i) const
+    {
+        return !bv_->get_blocks_manager().get_topblock(i);
+    }
+
+    /// next top level block (from i) where expression may have blocks
+    /// (bm::set_top_array_size if none)
+    unsigned find_next_nz_top(unsigned i) const
+    {
+        return bv_->get_blocks_manager().find_next_nz_top(i);
+    }
+
+    /// number of top level blocks of the expression
+    unsigned top_blocks() const
+    {
+        return bv_->get_blocks_manager().top_block_size();
+    }
+
+    /// size of the result vector
+    size_type size() const { return bv_->size(); }
+
+    /// evaluate block [i, j]
+    void eval(unsigned i, unsigned j, expr_context&, bm::word_t*,
+              expr_block& res) const
+    {
+        const bm::word_t* blk = bv_->get_blocks_manager().get_block_ptr(i, j);
+        res.tmp = 0;
+        res.digest = ~0ull;
+        res.gap = BM_IS_GAP(blk);
+        res.blk = (blk == FULL_BLOCK_FAKE_ADDR) ? FULL_BLOCK_REAL_ADDR : blk;
+    }
+
+    /// population count of block [i, j]
+    unsigned count_block(unsigned i, unsigned j, expr_context& ctx,
+                         bm::word_t* tb) const;
+
+private:
+    const BV* bv_;
+};
+
+/**
+    Expression node: logical operation on two sub-expressions
+
+    Evaluated block by block, without intermediate vectors.
+    AND/SUB skip the right side of the expression if the left one
+    is empty (same for OR with all 1s) and carry block digests so
+    operations touch only non-empty waves of the blocks.
+
+    \ingroup setalgo
+*/
+template<class L, class R, bm::operation OP>
+class expr_op : public expr_base<expr_op<L, R, OP> >
+{
+public:
+    typedef typename L::bvector_type   bvector_type;
+    typedef typename L::size_type      size_type;
+
+    enum { temp_blocks = L::temp_blocks + R::temp_blocks + 1 };
+
+    expr_op(const L& left, const R& right) : left_(left), right_(right) {}
+
+    bool is_empty_top(unsigned i) const
+    {
+        switch (OP)
+        {
+        case BM_AND: return left_.is_empty_top(i) || right_.is_empty_top(i);
+        case BM_SUB: return left_.is_empty_top(i);
+        default:     return left_.is_empty_top(i) && right_.is_empty_top(i);
+        }
+    }
+
+    unsigned find_next_nz_top(unsigned i) const
+    {
+        switch (OP)
+        {
+        case BM_AND:
+            for (;;) // advance until both arguments meet
+            {
+                unsigned l = left_.find_next_nz_top(i);
+                if (l >= bm::set_top_array_size)
+                    return l;
+                unsigned r = right_.find_next_nz_top(l);
+                if (r == l || r >= bm::set_top_array_size)
+                    return r;
+                i = r;
+            }
+        case BM_SUB: return left_.find_next_nz_top(i);
+        default:
+            {
+                unsigned l = left_.find_next_nz_top(i);
+                unsigned r = right_.find_next_nz_top(i);
+                return l < r ? l : r;
+            }
+        }
+    }
+
+    unsigned top_blocks() const
+    {
+        unsigned l = left_.top_blocks();
+        switch (OP)
+        {
+        case BM_AND: // result cannot extend past the shorter argument
+            {
+                unsigned r = right_.top_blocks();
+                return l < r ? l : r;
+            }
+        case BM_SUB: return l;
+        default:
+            {
+                unsigned r = right_.top_blocks();
+                return l > r ? l : r;
+            }
+        }
+    }
+
+    size_type size() const
+    {
+        size_type l = left_.size();
+        size_type r = right_.size();
+        return l > r ? l : r;
+    }
+
+    void eval(unsigned i, unsigned j, expr_context& ctx, bm::word_t* tb,
+              expr_block& res) const
+    {
+        expr_block arg;
+        if (eval_args(i, j, ctx, tb, res, arg))
+            bm::expr_combine(OP, res, arg, tb, ctx.dcache);
+    }
+
+    unsigned count_block(unsigned i, unsigned j, expr_context& ctx,
+                         bm::word_t* tb) const;
+
+private:
+    /**
+        Evaluate both arguments into res and arg
+        \return false if the result is known (in res) without combine
+    */
+    bool eval_args(unsigned i, unsigned j, expr_context& ctx, bm::word_t* tb,
+                   expr_block& res, expr_block& arg) const;
+
+private:
+    L   left_;
+    R   right_;
+};
+
+// ------------------------------------------------------------------------
+
+// ------------------------------------------------------------------------
+
+template<class BV>
+unsigned expr_leaf<BV>::count_block(unsigned i, unsigned j,
+                                    expr_context& ctx, bm::word_t* tb) const
+{
+    expr_block res;
+    eval(i, j, ctx, tb, res);
+    return bm::expr_block_count(res);
+}
+
+// ------------------------------------------------------------------------
+
+template<class L, class R, bm::operation OP>
+bool expr_op<L, R, OP>::eval_args(unsigned i, unsigned j,
+                                  expr_context& ctx, bm::word_t* tb,
+                                  expr_block& res, expr_block& arg) const
+{
+    left_.eval(i, j, ctx, tb + bm::set_block_size, res);
+    if (!res.blk)
+    {
+        if (OP == BM_AND || OP == BM_SUB) // 0 AND x, 0 SUB x
+            return false;
+    }
+    else
+    if (OP == BM_OR && res.blk == FULL_BLOCK_REAL_ADDR) // 1 OR x
+        return false;
+
+    right_.eval(i, j, ctx,
+                tb + (1 + unsigned(L::temp_blocks)) * bm::set_block_size, arg);
+    if (!arg.blk)
+    {
+        if (OP == BM_AND)
+            res = arg;
+        return false;
+    }
+    if (!res.blk) // OR, XOR
+    {
+        res = arg;
+        return false;
+    }
+    if (arg.blk == FULL_BLOCK_REAL_ADDR)
+    {
+        switch (OP)
+        {
+        case BM_AND: return false;
+        case BM_OR:  res = arg; return false;
+        case BM_SUB: res.blk = res.tmp = 0; res.gap = false; return false;
+        default: break;
+        }
+    }
+    if (res.blk == FULL_BLOCK_REAL_ADDR && OP == BM_AND)
+    {
+        res = arg;
+        return false;
+    }
+    return true;
+}
+
+// ------------------------------------------------------------------------
+
+template<class L, class R, bm::operation OP>
+unsigned expr_op<L, R, OP>::count_block(unsigned i, unsigned j,
+                                        expr_context& ctx,
+                                        bm::word_t* tb) const
+{
+    expr_block res, arg;
+    if (!eval_args(i, j, ctx, tb, res, arg))
+        return bm::expr_block_count(res);
+    if (!res.gap && !arg.gap) // count without building the result block
+    {
+        switch (OP)
+        {
+        case BM_AND: return bm::bit_operation_and_count(res.blk, arg.blk);
+        case BM_OR:  return bm::bit_operation_or_count(res.blk, arg.blk);
+        case BM_SUB: return bm::bit_operation_sub_count(res.blk, arg.blk);
+        case BM_XOR: return bm::bit_operation_xor_count(res.blk, arg.blk);
+        default: break;
+        }
+    }
+    bm::expr_combine(OP, res, arg, tb, ctx.dcache);
+    return bm::expr_block_count(res);
+}
+
+// ------------------------------------------------------------------------
+
+/**
+    \brief Evaluate expression into the target vector
+
+    Expression is evaluated block by block, no intermediate vectors are
+    created. Target vector can be one of the expression arguments.
+
+    \param bv_target - target vector (previous content is replaced)
+    \param expr - expression (bm::expr(bv1) & bv2 | ...)
+
+    \ingroup setalgo
+*/
+template<class E>
+void expr_evaluate(typename E::bvector_type& bv_target,
+                   const expr_base<E>& expr)
+{
+    typedef typename E::bvector_type bvector_type;
+    const E& e = expr.derived();
+
+    bvector_type bv(bv_target.get_new_blocks_strat(),
+                    bv_target.get_blocks_manager().glen(),
+                    e.size(), bv_target.get_allocator());
+    typename bvector_type::blocks_manager_type& bman = bv.get_blocks_manager();
+
+    unsigned top_blocks = e.top_blocks();
+    if (top_blocks)
+    {
+        bman.init_tree();
+        top_blocks = bman.reserve_top_blocks(top_blocks);
+    }
+
+    expr_context ctx(E::temp_blocks);
+    expr_block res;
+    for (unsigned i = e.find_next_nz_top(0); i < top_blocks;
+                  i = e.find_next_nz_top(i + 1))
+    {
+        for (unsigned j = 0; j < bm::set_array_size; ++j)
+        {
+            e.eval(i, j, ctx, ctx.tb(), res);
+            if (!res.blk)
+                continue;
+            if (res.blk == FULL_BLOCK_REAL_ADDR)
+                bman.set_block(i, j, FULL_BLOCK_FAKE_ADDR, false);
+            else
+            if (res.gap)
+            {
+                bool gap;
+                bm::word_t* blk =
+                    bman.clone_gap_block(BMGAP_PTR(res.blk), gap);
+                bman.set_block(i, j, blk, gap);
+            }
+            else
+                bman.copy_bit_block(i, j, res.blk);
+        } // for j
+    } // for i
+    bv_target.swap(bv);
+}
+
+/**
+    \brief Population count of the expression result
+
+    Result vector is not built, operations on pairs of bit-blocks
+    count without writing the result.
+
+    \param expr - expression (bm::expr(bv1) & bv2 | ...)
+    \return number of 1 bits in the expression result
+
+    \ingroup setalgo
+*/
+template<class E>
+typename E::size_type expr_count(const expr_base<E>& expr)
+{
+    const E& e = expr.derived();
+    expr_context ctx(E::temp_blocks);
+
+    typename E::size_type cnt = 0;
+    unsigned top_blocks = e.top_blocks();
+    for (unsigned i = e.find_next_nz_top(0); i < top_blocks;
+                  i = e.find_next_nz_top(i + 1))
+    {
+        for (unsigned j = 0; j < bm::set_array_size; ++j)
+            cnt += e.count_block(i, j, ctx, ctx.tb());
+    } // for i
+    return cnt;
+}
+
+// ------------------------------------------------------------------------
+
+/**
+    \brief Make expression argument from a bvector
+    \ingroup setalgo
+*/
+template<class Alloc>
+bm::expr_leaf<bm::bvector<Alloc> > expr(const bm::bvector<Alloc>& bv)
+{
+    return bm::expr_leaf<bm::bvector<Alloc> >(bv);
+}
+
+template<class L, class R>
+bm::expr_op<L, R, bm::BM_AND>
+operator&(const expr_base<L>& l, const expr_base<R>& r)
+{
+    return bm::expr_op<L, R, bm::BM_AND>(l.derived(), r.derived());
+}
+
+template<class L, class Alloc>
+bm::expr_op<L, bm::expr_leaf<bm::bvector<Alloc> >, bm::BM_AND>
+operator&(const expr_base<L>& l, const bm::bvector<Alloc>& r)
+{
+    return l & bm::expr(r);
+}
+
+template<class Alloc, class R>
+bm::expr_op<bm::expr_leaf<bm::bvector<Alloc> >, R, bm::BM_AND>
+operator&(const bm::bvector<Alloc>& l, const expr_base<R>& r)
+{
+    return bm::expr(l) & r;
+}
+
+template<class L, class R>
+bm::expr_op<L, R, bm::BM_OR>
+operator|(const expr_base<L>& l, const expr_base<R>& r)
+{
+    return bm::expr_op<L, R, bm::BM_OR>(l.derived(), r.derived());
+}
+
+template<class L, class Alloc>
+bm::expr_op<L, bm::expr_leaf<bm::bvector<Alloc> >, bm::BM_OR>
+operator|(const expr_base<L>& l, const bm::bvector<Alloc>& r)
+{
+    return l | bm::expr(r);
+}
+
+template<class Alloc, class R>
+bm::expr_op<bm::expr_leaf<bm::bvector<Alloc> >, R, bm::BM_OR>
+operator|(const bm::bvector<Alloc>& l, const expr_base<R>& r)
+{
+    return bm::expr(l) | r;
+}
+
+template<class L, class R>
+bm::expr_op<L, R, bm::BM_XOR>
+operator^(const expr_base<L>& l, const expr_base<R>& r)
+{
+    return bm::expr_op<L, R, bm::BM_XOR>(l.derived(), r.derived());
+}
+
+template<class L, class Alloc>
+bm::expr_op<L, bm::expr_leaf<bm::bvector<Alloc> >, bm::BM_XOR>
+operator^(const expr_base<L>& l, const bm::bvector<Alloc>& r)
+{
+    return l ^ bm::expr(r);
+}
+
+template<class Alloc, class R>
+bm::expr_op<bm::expr_leaf<bm::bvector<Alloc> >, R, bm::BM_XOR>
+operator^(const bm::bvector<Alloc>& l, const expr_base<R>& r)
+{
+    return bm::expr(l) ^ r;
+}
+
+template<class L, class R>
+bm::expr_op<L, R, bm::BM_SUB>
+operator-(const expr_base<L>& l, const expr_base<R>& r)
+{
+    return bm::expr_op<L, R, bm::BM_SUB>(l.derived(), r.derived());
+}
+
+template<class L, class Alloc>
+bm::expr_op<L, bm::expr_leaf<bm::bvector<Alloc> >, bm::BM_SUB>
+operator-(const expr_base<L>& l, const bm::bvector<Alloc>& r)
+{
+    return l - bm::expr(r);
+}
+
+template<class Alloc, class R>
+bm::expr_op<bm::expr_leaf<bm::bvector<Alloc> >, R, bm::BM_SUB>
+operator-(const bm::bvector<Alloc>& l, const expr_base<R>& r)
+{
+    return bm::expr(l) - r;
+}
+
+
+} // namespace bm
+
+#include "bmundef.h"
+
+#endif
@@ -62,7 +62,7 @@ struct bv_statistics
     /// Memory used by bitvector including temp and service blocks
     size_t  memory_used;
     /// Array of all GAP block lengths in the bvector.
-    gap_word_t   gap_length[bm::set_total_blocks];
+    gap_word_t   gap_length[bm::set_total_blocks32];
     /// GAP lengths used by bvector
     gap_word_t  gap_levels[bm::gap_levels];
 
@@ -79,7 +79,7 @@ struct bv_statistics
     /// count gap block
     void add_gap_block(unsigned capacity, unsigned length)
     {
-        (gap_blocks < bm::set_total_blocks) ? gap_length[gap_blocks] = (gap_word_t)length : 0;
+        (gap_blocks < bm::set_total_blocks32) ? gap_length[gap_blocks] = (gap_word_t)length : 0;
         ++gap_blocks;
         unsigned mem_used = (unsigned)(capacity * sizeof(gap_word_t));
         memory_used += mem_used;
@@ -208,7 +208,7 @@ int parallel_popcnt_32(unsigned int n)
 BMFORCEINLINE
 unsigned word_bitcount64(bm::id64_t x)
 {
-#if defined(BMSSE42OPT) || defined(BMAVX2OPT)
+#if defined(BMSSE42OPT) || defined(BMAVX2OPT) || defined(BMAVX512OPT)
 #if defined(BM64_SSE4) || defined(BM64_AVX2) || defined(BM64_AVX512)
     return unsigned(_mm_popcnt_u64(x));
 #else
@@ -1175,6 +1175,60 @@ unsigned gap_bfind(const T* buf, unsigned pos, unsigned* is_set)
 }
 
 
+/*!
+    \brief GAP block find the last set bit at or before the position
+    (backward search)
+
+    \param buf - GAP buffer pointer.
+    \param nbit - bit position in the block to start the search from
+    \param prev - index of the found 1 bit (out)
+ 
+    \return GAP index of the 1 interval found, 0 if 1 bit was NOT found
+
+    @ingroup gapfunc
+*/
+template<typename T>
+unsigned gap_find_prev(const T* buf, unsigned nbit, unsigned* prev)
+{
+    BM_ASSERT(prev);
+    unsigned is_set;
+    unsigned gidx = bm::gap_bfind(buf, nbit, &is_set);
+    if (is_set)
+    {
+        *prev = nbit;
+        return gidx;
+    }
+    if (gidx == 1) // block starts with 0 interval
+        return 0;
+    --gidx; // previous interval is 1
+    *prev = buf[gidx];
+    return gidx;
+}
+
+/*!
+    \brief GAP block find the end of the 1-interval (run) containing nbit
+
+    \param buf - GAP buffer pointer.
+    \param nbit - bit position in the block
+    \param end - last bit of the interval (out)
+
+    \return 0 - nbit is not set, 1 - interval ends inside the block,
+            2 - interval runs to the end of the block
+
+    @ingroup gapfunc
+*/
+template<typename T>
+unsigned gap_find_interval_end(const T* buf, unsigned nbit, unsigned* end)
+{
+    BM_ASSERT(end);
+    unsigned is_set;
+    unsigned gidx = bm::gap_bfind(buf, nbit, &is_set);
+    if (!is_set)
+        return 0;
+    *end = buf[gidx];
+    return (*end == bm::gap_max_bits - 1) ? 2u : 1u;
+}
+
 /*!
    \brief Tests if bit = pos is true.
    \param buf - GAP buffer pointer.
@@ -1317,22 +1371,23 @@ unsigned gap_test_unr(const T* buf, const unsigned pos)
 
 
 /*! For each non-zero block executes supplied function.
+    \param top_base - top level index of root[0] (page of the top level)
     \internal
 */
 template<class T, class F> 
-void for_each_nzblock(T*** root, unsigned size1, F& f)
+void for_each_nzblock(T*** root, unsigned size1, F& f, unsigned top_base = 0)
 {
     for (unsigned i = 0; i < size1; ++i)
     {
         T** blk_blk = root[i];
         if (!blk_blk) 
         {
-            f.on_empty_top(i);
+            f.on_empty_top(top_base + i);
             continue;
         }
 
         unsigned non_empty_top = 0;
-        unsigned r = i * bm::set_array_size;
+        unsigned r = (top_base + i) * bm::set_array_size;
         unsigned j = 0;
         do
         {
@@ -1410,7 +1465,7 @@ void for_each_nzblock(T*** root, unsigned size1, F& f)
         } while (j < bm::set_array_size);
 
         if (non_empty_top == 0)
-            f.on_empty_top(i);
+            f.on_empty_top(top_base + i);
     }  // for i
 }
 
@@ -1515,9 +1570,10 @@ void for_each_nzblock2(T*** root, unsigned size1, F& f)
     Function returns if function-predicate returns true
 */
 template<class T, class F> 
-bool for_each_nzblock_if(T*** root, unsigned size1, F& f)
+bool for_each_nzblock_if(T*** root, unsigned size1, F& f,
+                         unsigned top_base = 0)
 {
-    unsigned block_idx = 0;
+    unsigned block_idx = top_base * bm::set_array_size;
     for (unsigned i = 0; i < size1; ++i)
     {
         T** blk_blk = root[i];
@@ -1539,9 +1595,9 @@ bool for_each_nzblock_if(T*** root, unsigned size1, F& f)
 /*! For each block executes supplied function.
 */
 template<class T, class F> 
-void for_each_block(T*** root, unsigned size1, F& f)
+void for_each_block(T*** root, unsigned size1, F& f, unsigned top_base = 0)
 {
-    unsigned block_idx = 0;
+    unsigned block_idx = top_base * bm::set_array_size;
 
     for (unsigned i = 0; i < size1; ++i)
     {
@@ -1564,6 +1620,93 @@ void for_each_block(T*** root, unsigned size1, F& f)
     }  
 }
 
+#ifdef BM64ADDR
+
+/*! Size of a page of the paged top level (see blocks_manager)
+    \internal
+*/
+inline
+unsigned top_page_len(unsigned size1)
+{
+    return size1 < bm::set_top_page_size ? size1 : bm::set_top_page_size;
+}
+
+/*! For each non-zero block of the paged top level executes supplied
+    function (unallocated page is reported as one empty top block)
+    \internal
+*/
+template<class T, class F> 
+void for_each_nzblock(T**** root, unsigned size1, F& f)
+{
+    const unsigned page_len = bm::top_page_len(size1);
+    for (unsigned i = 0; i < size1; i += page_len)
+    {
+        T*** page = root[i >> bm::set_top_page_shift];
+        if (page)
+            bm::for_each_nzblock(page, page_len, f, i);
+        else
+            f.on_empty_top(i);
+    }
+}
+
+/*! For each non-zero block of the paged top level executes supplied
+    function (unallocated pages are skipped)
+    \internal
+*/
+template<class T, class F> 
+void for_each_nzblock2(T**** root, unsigned size1, F& f)
+{
+    const unsigned page_len = bm::top_page_len(size1);
+    for (unsigned i = 0; i < size1; i += page_len)
+    {
+        T*** page = root[i >> bm::set_top_page_shift];
+        if (page)
+            bm::for_each_nzblock2(page, page_len, f);
+    }
+}
+
+/*! For each non-zero block of the paged top level executes supplied
+    function-predicate (unallocated pages are skipped)
+    \internal
+*/
+template<class T, class F> 
+bool for_each_nzblock_if(T**** root, unsigned size1, F& f)
+{
+    const unsigned page_len = bm::top_page_len(size1);
+    for (unsigned i = 0; i < size1; i += page_len)
+    {
+        T*** page = root[i >> bm::set_top_page_shift];
+        if (page && bm::for_each_nzblock_if(page, page_len, f, i))
+            return true;
+    }
+    return false;
+}
+
+/*! For each block of the paged top level executes supplied function.
+    \internal
+*/
+template<class T, class F> 
+void for_each_block(T**** root, unsigned size1, F& f)
+{
+    const unsigned page_len = bm::top_page_len(size1);
+    for (unsigned i = 0; i < size1; i += page_len)
+    {
+        T*** page = root[i >> bm::set_top_page_shift];
+        if (page)
+        {
+            bm::for_each_block(page, page_len, f, i);
+            continue;
+        }
+        bm::id64_t block_idx = bm::id64_t(i) * bm::set_array_size;
+        bm::id64_t block_to = block_idx +
+                              bm::id64_t(page_len) * bm::set_array_size;
+        for (; block_idx < block_to; ++block_idx)
+            f(0, block_idx);
+    }
+}
+
+#endif
+
 
 
 /*! Special BM optimized analog of STL for_each
@@ -2408,6 +2551,130 @@ unsigned gap_add_value(T* buf, unsigned pos)
     return end;
 }
 
+/*!
+    @brief Insert bit into GAP block and shift the tail right by 1 bit
+    (bits shift without block decompression)
+
+    @param buf - GAP block pointer
+    @param pos - insert position
+    @param val - value to insert (0|1)
+    @param new_len - [out] new GAP length (same units as gap_set_value())
+
+    @return carry over bit (bit 65535 before the insert)
+    @ingroup gapfunc
+*/
+template<typename T>
+bool gap_insert(T* BMRESTRICT buf, 
+                unsigned pos, unsigned val, unsigned* BMRESTRICT new_len)
+{
+    BM_ASSERT(pos < bm::gap_max_bits);
+    BM_ASSERT(new_len);
+
+    unsigned is_set;
+    unsigned curr = bm::gap_bfind(buf, pos, &is_set);
+    unsigned end = unsigned(*buf >> 3);
+
+    // value of the last GAP goes out
+    bool co = bool((*buf & 1) ^ ((end - 1) & 1));
+
+    // all GAP borders starting from the insert point move right
+    for (unsigned i = curr; i < end; ++i)
+        ++(buf[i]);
+    if (curr < end && buf[end-1] == bm::gap_max_bits - 1)
+    {
+        --end; // last GAP got shifted out
+        *buf = (T)((*buf & 7) + (end << 3));
+    }
+
+    // insert position now keeps the copy of the shifted bit
+    *new_len = bm::gap_set_value(val, buf, pos, &is_set);
+    return co;
+}
+
+/*!
+    @brief Right shift GAP block by 1 bit
+    @param buf - GAP block pointer
+    @param co_flag - carry over from the previous block (0|1)
+    @param new_len - [out] new GAP length
+
+    @return carry over bit (1 or 0)
+    @ingroup gapfunc
+*/
+template<typename T>
+bool gap_shift_r1(T* BMRESTRICT buf,
+                  unsigned co_flag, unsigned* BMRESTRICT new_len)
+{
+    return bm::gap_insert(buf, 0, co_flag, new_len);
+}
+
+/*!
+    @brief Erase bit from GAP block and shift the tail left by 1 bit
+    (bits shift without block decompression)
+
+    @param buf - GAP block pointer
+    @param pos - erase position
+    @param co_flag - carry over from the next block (0|1),
+                     becomes the last bit of the block
+    @param new_len - [out] new GAP length
+
+    @ingroup gapfunc
+*/
+template<typename T>
+void gap_erase(T* BMRESTRICT buf, 
+               unsigned pos, unsigned co_flag, unsigned* BMRESTRICT new_len)
+{
+    BM_ASSERT(pos < bm::gap_max_bits);
+    BM_ASSERT(new_len);
+
+    unsigned is_set;
+    unsigned curr = bm::gap_bfind(buf, pos, &is_set);
+    unsigned end = unsigned(*buf >> 3);
+
+    if (curr < end) // the last GAP always ends at the block boundary
+    {
+        if (curr == 1 && buf[1] == 0) // first GAP is 1 bit long: drop it
+        {
+            *buf ^= 1;
+            ::memmove(&buf[1], &buf[2], (end - 1) * sizeof(T));
+            --end;
+            for (unsigned i = 1; i < end; ++i)
+                --(buf[i]);
+        }
+        else
+        {
+            for (unsigned i = curr; i < end; ++i)
+                --(buf[i]);
+            if (curr > 1 && buf[curr] == buf[curr-1]) // GAP collapsed
+            {
+                // merge the neighbours (they have the same value)
+                ::memmove(&buf[curr-1], &buf[curr+1], (end - curr) * sizeof(T));
+                end -= 2;
+            }
+        }
+        *buf = (T)((*buf & 7) + (end << 3));
+    }
+    // the last bit gets the carry over value
+    *new_len = bm::gap_set_value(co_flag, buf, bm::gap_max_bits - 1, &is_set);
+}
+
+/*!
+    @brief Left shift GAP block by 1 bit
+    @param buf - GAP block pointer
+    @param co_flag - carry over from the next block (0|1)
+    @param new_len - [out] new GAP length
+
+    @return carry over bit (1 or 0)
+    @ingroup gapfunc
+*/
+template<typename T>
+bool gap_shift_l1(T* BMRESTRICT buf,
+                  unsigned co_flag, unsigned* BMRESTRICT new_len)
+{
+    bool co = bool(*buf & 1); // first bit goes out
+    bm::gap_erase(buf, 0, co_flag, new_len);
+    return co;
+}
+
 /*!
    \brief Convert array to GAP buffer.
 
@@ -3652,6 +3919,56 @@ D gap_convert_to_arr(D* BMRESTRICT       dest,
 
 
 
+/*!
+   \brief Decode GAP block into an array of indexes of 1 bits
+   (runs of 1s are written as sequences)
+ 
+   \param buf - GAP buffer
+   \param nbit_from - first bit in the block to decode
+   \param base - index of the first bit of the block
+   \param dest - destination array
+   \param dest_len - destination capacity (decode stops when it is full)
+   \return number of indexes written
+ 
+   @ingroup gapfunc
+   @internal
+*/
+template<typename T, typename IDX, typename SZ>
+SZ gap_block_decode(const T* BMRESTRICT buf,
+                    unsigned nbit_from, IDX base,
+                    IDX* BMRESTRICT dest, SZ dest_len)
+{
+    BM_ASSERT(nbit_from < bm::gap_max_bits);
+    unsigned is_set;
+    unsigned gidx = bm::gap_bfind(buf, nbit_from, &is_set);
+    const unsigned len = (*buf) >> 3;
+    if (!is_set) // start from the next run of 1s
+    {
+        if (gidx == len)
+            return 0;
+        nbit_from = unsigned(buf[gidx]) + 1;
+        ++gidx;
+    }
+    SZ cnt = 0;
+    for (;;)
+    {
+        SZ run = SZ(unsigned(buf[gidx]) - nbit_from + 1);
+        if (run > dest_len - cnt)
+            run = dest_len - cnt;
+        IDX idx = IDX(base + nbit_from);
+        for (SZ k = 0; k < run; ++k)
+            dest[cnt + k] = IDX(idx + k);
+        cnt += run;
+        gidx += 2;
+        if (gidx > len || cnt == dest_len)
+            break;
+        nbit_from = unsigned(buf[gidx - 1]) + 1;
+    } // for
+    return cnt;
+}
+
+
+
 /*! 
     @brief Bitcount for bit string
     
@@ -3705,6 +4022,41 @@ bm::id_t bit_block_count(const bm::word_t* block)
     return count;
 }
 
+/*!
+    @brief Bitcount for bit block using digest (only non-zero waves
+    of the block marked in the digest are counted)
+ 
+    @param block - bit block
+    @param digest - block digest (superset of non-zero waves)
+
+    @ingroup bitfunc
+*/
+inline
+bm::id_t bit_block_count(const bm::word_t* BMRESTRICT block,
+                         bm::id64_t digest)
+{
+    bm::id_t count = 0;
+    while (digest)
+    {
+        bm::id64_t t = digest & (0 - digest); // lowest set bit
+        unsigned wave = bm::word_bitcount64(t - 1);
+        unsigned off = wave * bm::set_block_digest_wave_size;
+        const bm::bit_block_t::bunion_t* BMRESTRICT src_u =
+                            (const bm::bit_block_t::bunion_t*)(&block[off]);
+        unsigned j = 0;
+        do
+        {
+            count += bm::word_bitcount64(src_u->w64[j+0]) +
+                     bm::word_bitcount64(src_u->w64[j+1]) +
+                     bm::word_bitcount64(src_u->w64[j+2]) +
+                     bm::word_bitcount64(src_u->w64[j+3]);
+            j += 4;
+        } while (j < bm::set_block_digest_wave_size/2);
+        digest ^= t;
+    } // while
+    return count;
+}
+
 /*!
     @brief Bitcount for bit string
 
@@ -4092,6 +4444,219 @@ void bit_block_rotate_left_1_unr(bm::word_t* block)
     block[set_block_size - 1] = (block[set_block_size - 1] << 1) | co_flag;
 }
 
+/*!
+    @brief Right bit-shift of bit-block by 1 bit (reference)
+    (bit N moves to N+1, bit 65535 goes out as carry over)
+
+    @param block - bit-block pointer
+    @param empty_acc - [out] contains 0 if block becomes empty
+    @param co_flag - carry over from the previous block (0|1)
+
+    @return carry over bit (1 or 0)
+    @ingroup bitfunc
+*/
+inline
+bool bit_block_shift_r1(bm::word_t* BMRESTRICT block,
+                        bm::word_t* BMRESTRICT empty_acc,
+                        bm::word_t             co_flag)
+{
+    BM_ASSERT(block);
+    BM_ASSERT(empty_acc);
+    bm::word_t acc = 0;
+    for (unsigned i = 0; i < bm::set_block_size; ++i)
+    {
+        bm::word_t w = block[i];
+        bm::word_t w_co = w >> 31;
+        acc |= w = (w << 1u) | co_flag;
+        block[i] = w;
+        co_flag = w_co;
+    }
+    *empty_acc = acc;
+    return co_flag;
+}
+
+/*!
+    @brief Right bit-shift of bit-block by 1 bit (loop unrolled)
+    @param block - bit-block pointer
+    @param empty_acc - [out] contains 0 if block becomes empty
+    @param co_flag - carry over from the previous block (0|1)
+
+    @return carry over bit (1 or 0)
+    @ingroup bitfunc
+*/
+inline
+bool bit_block_shift_r1_unr(bm::word_t* BMRESTRICT block,
+                            bm::word_t* BMRESTRICT empty_acc,
+                            bm::word_t             co_flag)
+{
+    BM_ASSERT(block);
+    BM_ASSERT(empty_acc);
+#if defined(VECT_SHIFT_R1)
+    return VECT_SHIFT_R1(block, empty_acc, co_flag);
+#else
+    bm::word_t acc = 0;
+    for (unsigned i = 0; i < bm::set_block_size; i+=4)
+    {
+        bm::word_t w0 = block[i+0];
+        bm::word_t w1 = block[i+1];
+        bm::word_t w2 = block[i+2];
+        bm::word_t w3 = block[i+3];
+
+        block[i+0] = (w0 << 1u) | co_flag;
+        block[i+1] = (w1 << 1u) | (w0 >> 31);
+        block[i+2] = (w2 << 1u) | (w1 >> 31);
+        block[i+3] = (w3 << 1u) | (w2 >> 31);
+        co_flag = w3 >> 31;
+        acc |= block[i+0] | block[i+1] | block[i+2] | block[i+3];
+    }
+    *empty_acc = acc;
+    return co_flag;
+#endif
+}
+
+
+/*!
+    @brief Left bit-shift of bit-block by 1 bit (reference)
+    (bit N moves to N-1, bit 0 goes out as carry over)
+
+    @param block - bit-block pointer
+    @param empty_acc - [out] contains 0 if block becomes empty
+    @param co_flag - carry over from the next block (0|1),
+                     becomes the last bit of the block
+
+    @return carry over bit (1 or 0)
+    @ingroup bitfunc
+*/
+inline
+bool bit_block_shift_l1(bm::word_t* BMRESTRICT block,
+                        bm::word_t* BMRESTRICT empty_acc,
+                        bm::word_t             co_flag)
+{
+    BM_ASSERT(block);
+    BM_ASSERT(empty_acc);
+    bm::word_t acc = 0;
+    for (int i = bm::set_block_size-1; i >= 0; --i)
+    {
+        bm::word_t w = block[i];
+        bm::word_t w_co = w & 1u;
+        acc |= w = (w >> 1u) | (co_flag << 31u);
+        block[i] = w;
+        co_flag = w_co;
+    }
+    *empty_acc = acc;
+    return co_flag;
+}
+
+/*!
+    @brief Left bit-shift of bit-block by 1 bit (loop unrolled)
+    @param block - bit-block pointer
+    @param empty_acc - [out] contains 0 if block becomes empty
+    @param co_flag - carry over from the next block (0|1)
+
+    @return carry over bit (1 or 0)
+    @ingroup bitfunc
+*/
+inline
+bool bit_block_shift_l1_unr(bm::word_t* BMRESTRICT block,
+                            bm::word_t* BMRESTRICT empty_acc,
+                            bm::word_t             co_flag)
+{
+    BM_ASSERT(block);
+    BM_ASSERT(empty_acc);
+#if defined(VECT_SHIFT_L1)
+    return VECT_SHIFT_L1(block, empty_acc, co_flag);
+#else
+    bm::word_t acc = 0;
+    for (int i = bm::set_block_size-4; i >= 0; i-=4)
+    {
+        bm::word_t w0 = block[i+0];
+        bm::word_t w1 = block[i+1];
+        bm::word_t w2 = block[i+2];
+        bm::word_t w3 = block[i+3];
+
+        block[i+3] = (w3 >> 1u) | (co_flag << 31u);
+        block[i+2] = (w2 >> 1u) | (w3 << 31u);
+        block[i+1] = (w1 >> 1u) | (w2 << 31u);
+        block[i+0] = (w0 >> 1u) | (w1 << 31u);
+        co_flag = w0 & 1u;
+        acc |= block[i+0] | block[i+1] | block[i+2] | block[i+3];
+    }
+    *empty_acc = acc;
+    return co_flag;
+#endif
+}
+
+/*!
+    @brief insert bit into position and shift the rest right with carryover
+
+    @param block - bit-block pointer
+    @param bitpos - bit position to insert
+    @param value - bit value (0|1) to insert
+
+    @return carry over bit (bit 65535 before the insert)
+    @ingroup bitfunc
+*/
+inline
+bool bit_block_insert(bm::word_t* block, unsigned bitpos, bool value)
+{
+    BM_ASSERT(block);
+    BM_ASSERT(bitpos < bm::gap_max_bits);
+
+    unsigned nword = unsigned(bitpos >> bm::set_word_shift);
+    unsigned nbit = unsigned(bitpos & bm::set_word_mask);
+
+    bm::word_t co_flag = value;
+    if (nbit) // partial word: keep bits below the insert position
+    {
+        bm::word_t w = block[nword];
+        bm::word_t lo_mask = (1u << nbit) - 1u;
+        co_flag = w >> 31;
+        block[nword] = (w & lo_mask) | ((w & ~lo_mask) << 1u) |
+                       (bm::word_t(value) << nbit);
+        ++nword;
+    }
+    for (; nword < bm::set_block_size; ++nword)
+    {
+        bm::word_t w = block[nword];
+        bm::word_t w_co = w >> 31;
+        block[nword] = (w << 1u) | co_flag;
+        co_flag = w_co;
+    }
+    return co_flag;
+}
+
+/*!
+    @brief erase bit from position and shift the rest left with carryover
+
+    @param block - bit-block pointer
+    @param bitpos - bit position to erase
+    @param carry_over - bit value (0|1) to put into the last bit of the block
+
+    @ingroup bitfunc
+*/
+inline
+void bit_block_erase(bm::word_t* block, unsigned bitpos, bool carry_over)
+{
+    BM_ASSERT(block);
+    BM_ASSERT(bitpos < bm::gap_max_bits);
+
+    unsigned nword = unsigned(bitpos >> bm::set_word_shift);
+    unsigned nbit = unsigned(bitpos & bm::set_word_mask);
+
+    bm::word_t co_flag = carry_over;
+    for (unsigned i = bm::set_block_size - 1; i > nword; --i)
+    {
+        bm::word_t w = block[i];
+        bm::word_t w_co = w & 1u;
+        block[i] = (w >> 1u) | (co_flag << 31u);
+        co_flag = w_co;
+    }
+    // target word: bits below the erase position stay in place
+    bm::word_t w = block[nword];
+    bm::word_t lo_mask = nbit ? ((1u << nbit) - 1u) : 0u;
+    block[nword] = (w & lo_mask) | ((w >> 1u) & ~lo_mask) | (co_flag << 31u);
+}
+
 
 
 /*!
@@ -5347,10 +5912,206 @@ bool bit_block_or_5way(bm::word_t* BMRESTRICT dst,
 }
 
 
+/*!
+   \brief Bit-sliced (vertical) counters of a group of bit-blocks.
+   Plane p of the counters (bit p of the count of each bit position)
+   is stored at planes + p * bm::set_block_size.
 
+   Inputs are reduced in groups of 4 with a carry-save adder tree
+   (Harley-Seal), only the weight-4 carry is rippled into higher planes.
 
-/*!
-   \brief Block OR operation. Makes analysis if block is 0 or FULL. 
+   \param planes      - destination counter planes (initialized by the call)
+   \param plane_count - number of planes (must fit block_count)
+   \param blocks      - source bit-blocks (FULL_BLOCK_REAL_ADDR is acceptable)
+   \param block_count - number of source blocks
+
+   @ingroup bitfunc
+*/
+inline
+void bit_block_vcount(bm::word_t* BMRESTRICT planes, unsigned plane_count,
+                      const bm::word_t* const* BMRESTRICT blocks,
+                      unsigned block_count)
+{
+    BM_ASSERT(plane_count && plane_count < 16);
+    BM_ASSERT((block_count >> plane_count) == 0);
+
+    const unsigned stride = bm::set_block_size / 2;
+    bm::id64_t* BMRESTRICT p64 = (bm::id64_t*) planes;
+    for (unsigned w = 0; w < stride; ++w)
+    {
+        bm::id64_t cnt[16];
+        for (unsigned p = 0; p < plane_count; ++p)
+            cnt[p] = 0;
+        bm::id64_t ones = 0, twos = 0;
+        unsigned k = 0;
+        for (; k + 4 <= block_count; k += 4)
+        {
+            bm::id64_t a = ((const bm::id64_t*)blocks[k])[w];
+            bm::id64_t b = ((const bm::id64_t*)blocks[k+1])[w];
+            bm::id64_t c = ((const bm::id64_t*)blocks[k+2])[w];
+            bm::id64_t d = ((const bm::id64_t*)blocks[k+3])[w];
+            bm::id64_t u, twos_a, twos_b, fours;
+
+            u = ones ^ a; twos_a = (ones & a) | (u & b); ones = u ^ b;
+            u = ones ^ c; twos_b = (ones & c) | (u & d); ones = u ^ d;
+            u = twos ^ twos_a; fours = (twos & twos_a) | (u & twos_b);
+            twos = u ^ twos_b;
+            for (unsigned p = 2; fours; ++p)
+            {
+                bm::id64_t t = cnt[p] & fours; cnt[p] ^= fours; fours = t;
+            }
+        } // for k
+        for (; k < block_count; ++k)
+        {
+            bm::id64_t carry = ((const bm::id64_t*)blocks[k])[w];
+            bm::id64_t t = ones & carry; ones ^= carry; carry = t;
+            t = twos & carry; twos ^= carry; carry = t;
+            for (unsigned p = 2; carry; ++p)
+            {
+                t = cnt[p] & carry; cnt[p] ^= carry; carry = t;
+            }
+        } // for k
+        p64[w] = ones;
+        if (plane_count > 1)
+        {
+            p64[stride + w] = twos;
+            for (unsigned p = 2; p < plane_count; ++p)
+                p64[p * stride + w] = cnt[p];
+        }
+        else
+        {
+            BM_ASSERT(!twos);
+        }
+    } // for w
+}
+
+/*!
+   \brief Increment bit-sliced (vertical) counters for one word position.
+   \param cnt  - word in the counter plane 0 (see bit_block_vcount())
+   \param mask - bits to increment
+
+   @ingroup bitfunc
+*/
+inline
+void vcount_inc_word(bm::word_t* cnt, bm::word_t mask)
+{
+    for (; mask; cnt += bm::set_block_size)
+    {
+        bm::word_t carry = *cnt & mask;
+        *cnt ^= mask;
+        mask = carry;
+    }
+}
+
+/*!
+   \brief Increment bit-sliced (vertical) counters for an interval of bits
+   \param planes   - counter planes (see bit_block_vcount())
+   \param bitpos   - Offset of the start bit.
+   \param bitcount - number of bits to increment.
+
+   @ingroup bitfunc
+*/
+inline
+void vcount_add_range(bm::word_t* planes, unsigned bitpos, unsigned bitcount)
+{
+    const unsigned maskFF = ~0u;
+
+    planes += unsigned(bitpos >> bm::set_word_shift); // nword
+    bitpos &= bm::set_word_mask;
+
+    if (bitpos) // starting pos is not aligned
+    {
+        unsigned mask_r = maskFF << bitpos;
+        unsigned right_margin = bitpos + bitcount;
+        if (right_margin < 32)
+        {
+            bm::vcount_inc_word(planes, (maskFF >> (32 - right_margin)) & mask_r);
+            return;
+        }
+        bm::vcount_inc_word(planes++, mask_r);
+        bitcount -= 32 - bitpos;
+    }
+    for ( ;bitcount >= 32; bitcount -= 32)
+        bm::vcount_inc_word(planes++, maskFF);
+    if (bitcount)
+        bm::vcount_inc_word(planes, maskFF >> (32 - bitcount));
+}
+
+/*!
+   \brief Adds GAP block to bit-sliced (vertical) counters.
+   \param planes - counter planes (see bit_block_vcount())
+   \param pcurr  - GAP buffer pointer.
+
+   @ingroup gapfunc
+*/
+template<typename T>
+void gap_vcount_add(bm::word_t* planes, const T* pcurr)
+{
+    BM_ASSERT(planes && pcurr);
+
+    const T* pend = pcurr + (*pcurr >> 3);
+    if (*pcurr & 1)  // Starts with 1
+    {
+        bm::vcount_add_range(planes, 0, 1 + pcurr[1]);
+        pcurr += 3;
+    }
+    else
+        pcurr += 2;
+
+    for (; pcurr <= pend; pcurr += 2)
+    {
+        BM_ASSERT(*pcurr > pcurr[-1]);
+        bm::vcount_add_range(planes, 1u + pcurr[-1], *pcurr - pcurr[-1]);
+    }
+}
+
+/*!
+   \brief Threshold of bit-sliced (vertical) counters: dst = (counter >= k)
+   \param dst         - destination bit-block
+   \param planes      - counter planes (see bit_block_vcount())
+   \param plane_count - number of planes
+   \param k           - threshold (0 < k < 2^plane_count)
+
+   \return OR of all destination words (0 - empty block)
+
+   @ingroup bitfunc
+*/
+inline
+bm::id64_t bit_block_vcount_ge(bm::word_t* BMRESTRICT dst,
+                               const bm::word_t* BMRESTRICT planes,
+                               unsigned plane_count, unsigned k)
+{
+    BM_ASSERT(k && plane_count < 16 && (k >> plane_count) == 0);
+
+    const unsigned stride = bm::set_block_size / 2;
+    const bm::id64_t* BMRESTRICT p64 = (const bm::id64_t*) planes;
+    bm::id64_t* BMRESTRICT d64 = (bm::id64_t*) dst;
+    bm::id64_t acc = 0;
+    for (unsigned w = 0; w < stride; ++w)
+    {
+        // MSB to LSB bit-sliced comparison with a constant
+        bm::id64_t gt = 0, eq = ~0ull;
+        for (unsigned p = plane_count; p-- > 0; )
+        {
+            bm::id64_t c = p64[p * stride + w];
+            if (k & (1u << p))
+                eq &= c;
+            else
+            {
+                gt |= eq & c;
+                eq &= ~c;
+            }
+        } // for p
+        acc |= d64[w] = gt | eq;
+    } // for w
+    return acc;
+}
+
+
+
+
+/*!
+   \brief Block OR operation. Makes analysis if block is 0 or FULL. 
 
    \param dst - destination block.
    \param src - source block.
@@ -5895,6 +6656,57 @@ unsigned bit_find_first(const bm::word_t* block, unsigned* first)
     return 0u;
 }
 
+/*!
+    \brief BIT block find the end of the 1-interval (run) containing nbit
+
+    Scans for the first word which is not all 1s (SIMD accelerated
+    when available), so long runs cost a fraction of a bit-scan.
+
+    \param block - bit block buffer pointer
+    \param nbit - bit position in the block
+    \param end - last bit of the interval (out)
+
+    \return 0 - nbit is not set, 1 - interval ends inside the block,
+            2 - interval runs to the end of the block
+
+    @ingroup bitfunc
+*/
+inline
+unsigned bit_block_find_interval_end(const bm::word_t* block,
+                                     unsigned nbit, unsigned* end)
+{
+    BM_ASSERT(block);
+    BM_ASSERT(end);
+    BM_ASSERT(nbit < bm::gap_max_bits);
+
+    unsigned nword = nbit >> bm::set_word_shift;
+    nbit &= bm::set_word_mask;
+    bm::word_t w = block[nword];
+    if (!(w & (1u << nbit)))
+        return 0;
+    w = ~w & ~((1u << nbit) - 1); // 0s at and after nbit
+    if (!w)
+    {
+#ifdef VECT_BIT_FIND_NOT_FULL
+        nword = VECT_BIT_FIND_NOT_FULL(block, nword + 1);
+#else
+        for (++nword; nword < bm::set_block_size; ++nword)
+        {
+            if (block[nword] != ~0u)
+                break;
+        } // for nword
+#endif
+        if (nword == bm::set_block_size)
+        {
+            *end = bm::gap_max_bits - 1;
+            return 2;
+        }
+        w = ~block[nword];
+    }
+    *end = nword * 32u + bm::word_trailing_zeros(w) - 1;
+    return 1;
+}
+
 /*!
     \brief BIT block find position for the rank
 
@@ -6076,6 +6888,57 @@ template<typename T> T bit_convert_to_arr(T* BMRESTRICT dest,
     return (T)(pcurr - dest);
 }
 
+/*!
+    @brief Decode bit block into an array of indexes of 1 bits
+ 
+    \param block - bit block
+    \param nbit_from - first bit in the block to decode
+    \param base - index of the first bit of the block
+    \param dest - destination array
+    \param dest_len - destination capacity (decode stops when it is full)
+    \return number of indexes written
+ 
+    @ingroup bitfunc
+    @internal
+*/
+template<typename IDX, typename SZ>
+SZ bit_block_decode(const bm::word_t* BMRESTRICT block,
+                    unsigned nbit_from, IDX base,
+                    IDX* BMRESTRICT dest, SZ dest_len)
+{
+    BM_ASSERT(block && nbit_from < bm::gap_max_bits);
+#if defined(VECT_BIT_BLOCK_DECODE)
+    if (bm::conditional<sizeof(IDX)==4 && sizeof(SZ)==4>::test())
+    {
+        return (SZ)VECT_BIT_BLOCK_DECODE(block, nbit_from, unsigned(base),
+                                         (unsigned*)dest, unsigned(dest_len));
+    }
+#endif
+    SZ cnt = 0;
+    unsigned nword = nbit_from >> bm::set_word_shift;
+    bm::word_t w =
+        block[nword] & bm::block_set_table<true>::_right[nbit_from & bm::set_word_mask];
+    for (;;)
+    {
+        if (w)
+        {
+            IDX base_w = IDX(base + (nword << bm::set_word_shift));
+            if (bm::word_bitcount(w) > dest_len - cnt) // no room for all
+            {
+                for (; cnt < dest_len; w &= w - 1)
+                    dest[cnt++] = IDX(base_w + bm::word_bitcount((w & -w) - 1));
+                return cnt;
+            }
+            for (; w; w &= w - 1)
+                dest[cnt++] = IDX(base_w + bm::word_bitcount((w & -w) - 1));
+        }
+        if (++nword == bm::set_block_size)
+            break;
+        w = block[nword];
+    } // for
+    return cnt;
+}
+
 /**
     \brief Checks all conditions and returns true if block consists of only 0 bits
     \param blk - Blocks's pointer
@@ -6678,6 +7541,320 @@ unsigned idx_arr_block_lookup(const unsigned* idx, unsigned size, unsigned nb, u
 #endif
 }
 
+/**
+    block boundaries look ahead (generic index type)
+    @internal
+*/
+template<typename IDX, typename SZ>
+SZ idx_arr_block_lookup(const IDX* idx, SZ size, bm::block_idx_type nb, SZ start)
+{
+    BM_ASSERT(idx);
+    
+    if (nb == bm::block_idx_type(idx[size-1] >> bm::set_block_shift))
+        return size;
+    for (;(start < size) &&
+          (nb == bm::block_idx_type(idx[start] >> bm::set_block_shift)); ++start)
+    {}
+    return start;
+}
+
+// --------------------------------------------------------------
+
+/**
+    Set bits of a bit-block from an array of indexes [start..stop)
+    (all indexes belong to the same block)
+    @ingroup bitfunc
+    @internal
+*/
+template<typename IDX, typename SZ>
+void set_block_bits(bm::word_t* BMRESTRICT block,
+                    const IDX* BMRESTRICT idx, SZ start, SZ stop)
+{
+    BM_ASSERT(block && start <= stop);
+#if defined(VECT_SET_BLOCK_BITS)
+    if (bm::conditional<sizeof(IDX)==4 && sizeof(SZ)==4>::test())
+    {
+        VECT_SET_BLOCK_BITS(block, (const unsigned*)idx,
+                            unsigned(start), unsigned(stop));
+        return;
+    }
+#endif
+    const SZ len_unr = start + ((stop - start) - ((stop - start) % 2));
+    for (; start < len_unr; start += 2)
+    {
+        unsigned nbitA = unsigned(idx[start] & bm::set_block_mask);
+        unsigned nbitB = unsigned(idx[start+1] & bm::set_block_mask);
+        block[nbitA >> bm::set_word_shift] |= (1u << (nbitA & bm::set_word_mask));
+        block[nbitB >> bm::set_word_shift] |= (1u << (nbitB & bm::set_word_mask));
+    }
+    if (start < stop)
+    {
+        unsigned nbit = unsigned(idx[start] & bm::set_block_mask);
+        block[nbit >> bm::set_word_shift] |= (1u << (nbit & bm::set_word_mask));
+    }
+}
+
+// --------------------------------------------------------------
+
+/**
+    block boundaries search in a sorted array (galloping search)
+    \return index of the first element after start which belongs
+    to a different block (or size)
+    @internal
+*/
+template<typename IDX, typename SZ>
+SZ idx_arr_block_lookup_sorted(const IDX* idx, SZ size,
+                               bm::block_idx_type nb, SZ start)
+{
+    BM_ASSERT(idx && start < size);
+    BM_ASSERT(nb == bm::block_idx_type(idx[start] >> bm::set_block_shift));
+    
+    if (nb == bm::block_idx_type(idx[size-1] >> bm::set_block_shift))
+        return size;
+    // exponential search for the range, then binary search
+    SZ l = start, step = 1, r;
+    for (;;)
+    {
+        r = (size - l - 1 > step) ? l + step : size - 1;
+        if (nb != bm::block_idx_type(idx[r] >> bm::set_block_shift))
+            break;
+        l = r; step <<= 1;
+    }
+    // idx[l] belongs to nb, idx[r] does not
+    while (r - l > 1)
+    {
+        SZ mid = l + (r - l) / 2;
+        if (nb == bm::block_idx_type(idx[mid] >> bm::set_block_shift))
+            l = mid;
+        else
+            r = mid;
+    }
+    return r;
+}
+
+// --------------------------------------------------------------
+
+/**
+    Count 1-runs (intervals) in a sorted array of indexes [start..stop)
+    (duplicates are allowed)
+    \param max_runs - stop counting when the limit is exceeded
+    @internal
+*/
+template<typename IDX, typename SZ>
+unsigned idx_arr_count_runs(const IDX* idx, SZ start, SZ stop,
+                            unsigned max_runs)
+{
+    BM_ASSERT(start < stop);
+    unsigned runs = 1;
+    IDX prev = idx[start];
+    for (++start; start < stop; ++start)
+    {
+        IDX curr = idx[start];
+        BM_ASSERT(curr >= prev);
+        runs += (curr - prev > 1);
+        if (runs > max_runs)
+            break;
+        prev = curr;
+    }
+    return runs;
+}
+
+// --------------------------------------------------------------
+
+/**
+    Convert sorted array of indexes [start..stop) of one block
+    into GAP buffer (same as gap_set_array, duplicates are allowed)
+ 
+    \param buf - GAP buffer.
+    \return New GAP buffer length.
+    @ingroup gapfunc
+    @internal
+*/
+template<typename T, typename IDX, typename SZ>
+unsigned gap_set_sorted_idx(T* buf, const IDX* idx, SZ start, SZ stop)
+{
+    BM_ASSERT(start < stop);
+    *buf = (T)((*buf & 6u) + (1u << 3)); // gap header setup
+
+    T* pcurr = buf + 1;
+
+    T curr = T(idx[start] & bm::set_block_mask);
+    if (curr != 0) // need to add the first gap: (0 to arr[0]-1)
+    {
+        *pcurr = (T)(curr - 1);
+        ++pcurr;
+    }
+    else
+    {
+        ++(*buf); // GAP starts with 1
+    }
+    T prev = curr;
+    T acc = prev;
+
+    for (++start; start < stop; ++start)
+    {
+        curr = T(idx[start] & bm::set_block_mask);
+        if (curr == prev) // duplicate
+            continue;
+        if (curr == prev + 1)
+        {
+            ++acc;
+        }
+        else
+        {
+            *pcurr++ = acc;
+            acc = curr;
+            *pcurr++ = (T)(curr-1);
+        }
+        prev = curr;
+    }
+    *pcurr = acc;
+    if (acc != bm::gap_max_bits - 1)
+    {
+        ++pcurr;
+        *pcurr = bm::gap_max_bits - 1;
+    }
+
+    unsigned end = unsigned(pcurr - buf);
+
+    *buf = (T)((*buf & 7) + (end << 3));
+    return end+1;
+}
+
+// --------------------------------------------------------------
+
+/*!
+    \brief Convert sorted non-overlapping closed intervals [start..stop)
+    into GAP buffer of one block
+ 
+    Intervals are clipped by the block borders, adjacent intervals merge.
+ 
+    \param buf - GAP buffer (must fit 2 * (stop - start) + 2 elements)
+    \param starts - interval start positions
+    \param ends - interval end positions
+    \param base - first bit position of the block
+    \return New GAP buffer length.
+    @ingroup gapfunc
+    @internal
+*/
+template<typename T, typename IDX, typename SZ>
+unsigned gap_set_intervals(T* buf, const IDX* starts, const IDX* ends,
+                           SZ start, SZ stop, IDX base)
+{
+    BM_ASSERT(start < stop);
+    const IDX last = bm::gap_max_bits - 1;
+    
+    *buf = (T)(*buf & 6u); // gap header setup
+    T* pcurr = buf;
+    for (; start < stop; ++start)
+    {
+        BM_ASSERT(starts[start] <= ends[start]);
+        IDX from = (starts[start] <= base) ? 0 : starts[start] - base;
+        IDX to = (ends[start] - base >= last) ? last : ends[start] - base;
+        BM_ASSERT(from <= to);
+        if (pcurr == buf) // first interval
+        {
+            if (from)
+                *(++pcurr) = (T)(from - 1);
+            else
+                ++(*buf); // GAP starts with 1
+        }
+        else
+        if (IDX(*pcurr) + 1 != from) // not adjacent: add 0 interval
+        {
+            BM_ASSERT(IDX(*pcurr) < from);
+            *(++pcurr) = (T)(from - 1);
+        }
+        else
+        {
+            *pcurr = (T)to; // extend the last 1 interval
+            continue;
+        }
+        *(++pcurr) = (T)to;
+    } // for
+    if (*pcurr != last)
+        *(++pcurr) = (T)last;
+
+    unsigned end = unsigned(pcurr - buf);
+    *buf = (T)((*buf & 7) + (end << 3));
+    return end+1;
+}
+
+// --------------------------------------------------------------
+
+/**
+    Test bits of a bit-block for an array of indexes [start..stop)
+    (all indexes belong to the same block)
+
+    \param out - output flags, out[i] = 1 if bit idx[i] is set
+    \return number of set bits found
+    @ingroup bitfunc
+    @internal
+*/
+template<typename IDX, typename SZ>
+SZ bit_block_test_idx(const bm::word_t* BMRESTRICT block,
+                      const IDX* BMRESTRICT idx, SZ start, SZ stop,
+                      unsigned char* BMRESTRICT out)
+{
+    BM_ASSERT(block && start <= stop);
+    SZ cnt = 0;
+    for (; start < stop; ++start)
+    {
+        unsigned nbit = unsigned(idx[start] & bm::set_block_mask);
+        unsigned v =
+            (block[nbit >> bm::set_word_shift] >> (nbit & bm::set_word_mask)) & 1u;
+        out[start] = (unsigned char)v;
+        cnt += v;
+    }
+    return cnt;
+}
+
+// --------------------------------------------------------------
+
+/**
+    Test bits of a GAP block for a sorted array of indexes [start..stop)
+    (all indexes belong to the same block).
+    GAP intervals are walked forward with a short speculative scan,
+    binary search is used for longer jumps.
+
+    \param buf - GAP buffer.
+    \param out - output flags, out[i] = 1 if bit idx[i] is set
+    \return number of set bits found
+    @ingroup gapfunc
+    @internal
+*/
+template<typename T, typename IDX, typename SZ>
+SZ gap_test_sorted_idx(const T* BMRESTRICT buf,
+                       const IDX* BMRESTRICT idx, SZ start, SZ stop,
+                       unsigned char* BMRESTRICT out)
+{
+    BM_ASSERT(start < stop);
+    unsigned is_set;
+    unsigned pos = unsigned(idx[start] & bm::set_block_mask);
+    unsigned gidx = bm::gap_bfind(buf, pos, &is_set);
+
+    const unsigned sv = (*buf) & 1u;
+    SZ cnt = 0;
+    for (; start < stop; ++start)
+    {
+        pos = unsigned(idx[start] & bm::set_block_mask);
+        BM_ASSERT(gidx == 1 || buf[gidx-1] < pos);
+        if (buf[gidx] < pos) // moved past the current GAP
+        {
+            // last GAP element is (gap_max_bits - 1), scan stops on it
+            unsigned k = gidx + 1;
+            for (unsigned lim = gidx + 4; k < lim && buf[k] < pos; ++k)
+            {}
+            gidx = (buf[k] < pos) ? bm::gap_bfind(buf, pos, &is_set) : k;
+        }
+        is_set = sv ^ ((gidx - 1) & 1u);
+        BM_ASSERT(is_set == bm::gap_test(buf, pos));
+        out[start] = (unsigned char)is_set;
+        cnt += is_set;
+    }
+    return cnt;
+}
+
 // --------------------------------------------------------------
 
 /**
@@ -0,0 +1,577 @@
+#ifndef BMPARALLEL__H__INCLUDED__
+#define BMPARALLEL__H__INCLUDED__
+/*
+Copyright(c) 2002-2017 Anatoliy Kuznetsov(anatoliy_kuznetsov at yahoo.com)
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+For more information please visit:  http://bitmagic.io
+*/
+
+/*! \file bmparallel.h
+    \brief Thread pool and multi-threaded set algebra operations (C++11)
+*/
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <vector>
+#include <memory>
+
+#include "bm.h"
+#include "bmaggregator.h"
+
+namespace bm
+{
+
+/**
+    \brief Simple thread pool to run batches of independent tasks.
+
+    Pool keeps a fixed set of worker threads. Batch is a functor called
+    as func(task_idx, worker_idx) for every task_idx in [0..task_count),
+    tasks are taken from a shared counter (dynamic scheduling).
+    The calling thread participates in the batch as worker 0, so
+    worker index is always in [0..size()).
+
+    Pool is not reentrant: one batch at a time.
+
+    @ingroup bvector
+*/
+class thread_pool
+{
+public:
+    /**
+        \param thread_count - number of workers (0 - hardware concurrency)
+    */
+    explicit thread_pool(unsigned thread_count = 0)
+    : stop_(false), generation_(0), busy_(0), batch_(0)
+    {
+        if (!thread_count)
+            thread_count = std::thread::hardware_concurrency();
+        if (!thread_count)
+            thread_count = 1;
+        // calling thread is worker 0
+        for (unsigned i = 1; i < thread_count; ++i)
+            threads_.emplace_back(&thread_pool::worker_func, this, i);
+    }
+
+    ~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cond_start_.notify_all();
+        for (size_t i = 0; i < threads_.size(); ++i)
+            threads_[i].join();
+    }
+
+    /// Number of workers (including the calling thread)
+    unsigned size() const { return unsigned(threads_.size()) + 1; }
+
+    /**
+        \brief Run batch of tasks and wait for all of them to finish.
+        Exception thrown by a task is re-thrown in the calling thread
+        (after the batch is complete).
+
+        \param task_count - number of tasks
+        \param func - functor void(unsigned task_idx, unsigned worker_idx)
+    */
+    template<class Func>
+    void run(unsigned task_count, Func& func)
+    {
+        if (!task_count)
+            return;
+        if (task_count == 1 || threads_.empty())
+        {
+            for (unsigned i = 0; i < task_count; ++i)
+                func(i, 0u);
+            return;
+        }
+        batch<Func> b(func, task_count);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            batch_ = &b;
+            busy_ = unsigned(threads_.size());
+            ++generation_;
+        }
+        cond_start_.notify_all();
+
+        b.run(0);
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_done_.wait(lock, [this]{ return busy_ == 0; });
+            batch_ = 0;
+        }
+        if (b.eptr_)
+            std::rethrow_exception(b.eptr_);
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+protected:
+    /// type-erased batch interface
+    struct batch_base
+    {
+        virtual ~batch_base() {}
+        virtual void run(unsigned worker_idx) = 0;
+    };
+
+    /// batch of tasks executed by the functor
+    template<class Func>
+    struct batch : public batch_base
+    {
+        batch(Func& func, unsigned task_count)
+        : func_(func), task_count_(task_count), next_task_(0)
+        {}
+
+        virtual void run(unsigned worker_idx)
+        {
+            for (unsigned i = next_task_++; i < task_count_; i = next_task_++)
+            {
+                try
+                {
+                    func_(i, worker_idx);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(err_mutex_);
+                    if (!eptr_)
+                        eptr_ = std::current_exception();
+                }
+            }
+        }
+
+        Func&                  func_;
+        unsigned               task_count_;
+        std::atomic<unsigned>  next_task_;
+        std::mutex             err_mutex_;
+        std::exception_ptr     eptr_;
+    };
+
+    void worker_func(unsigned worker_idx)
+    {
+        unsigned long long generation = 0;
+        for (;;)
+        {
+            batch_base* b;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_start_.wait(lock,
+                    [this, generation]{ return stop_ || generation_ != generation; });
+                if (stop_)
+                    return;
+                generation = generation_;
+                b = batch_;
+            }
+            b->run(worker_idx);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (--busy_ == 0)
+                    cond_done_.notify_one();
+            }
+        } // for
+    }
+
+protected:
+    std::vector<std::thread>   threads_;
+    std::mutex                 mutex_;
+    std::condition_variable    cond_start_;
+    std::condition_variable    cond_done_;
+    bool                       stop_;
+    unsigned long long         generation_;  ///< batch sequence number
+    unsigned                   busy_;        ///< workers still in the batch
+    batch_base*                batch_;       ///< current batch
+};
+
+
+/**
+    \brief Multi-threaded set algebra operations on bit-vectors.
+
+    Operations split the top level of the blocks tree across the pool
+    workers. Every task owns one top level slot (bm::set_array_size blocks),
+    so no locking is used while blocks are combined. Tasks are made only
+    for the allocated slots which can change the result.
+    Result is identical to the single-threaded bvector operations.
+
+    Target vector must not use local allocation pool
+    (bvector::set_allocator_pool()), those operations fall back to
+    the single-threaded code if pool is set.
+*/
+namespace parallel
+{
+
+/**
+    Collect top level slots [0, top_blocks) to run as tasks
+    \param next_nz - functor returning the next slot to process
+    \internal
+*/
+template<class NZ>
+void collect_top_slots(std::vector<unsigned>& slots, unsigned top_blocks,
+                       const NZ& next_nz)
+{
+    slots.resize(0);
+    for (unsigned i = next_nz(0); i < top_blocks; i = next_nz(i + 1))
+        slots.push_back(i);
+}
+
+/// @internal
+template<class BV>
+struct combine_top_range_func
+{
+    typedef void (BV::*op_func_type)(const BV&, unsigned, unsigned);
+
+    combine_top_range_func(BV& bv, const BV& bv_arg, op_func_type op,
+                           const std::vector<unsigned>& slots)
+    : bv_(bv), bv_arg_(bv_arg), op_(op), slots_(slots)
+    {}
+
+    void operator()(unsigned task_idx, unsigned /*worker_idx*/)
+    {
+        unsigned i = slots_[task_idx];
+        (bv_.*op_)(bv_arg_, i, i + 1);
+    }
+
+    BV&                          bv_;
+    const BV&                    bv_arg_;
+    op_func_type                 op_;
+    const std::vector<unsigned>& slots_;
+};
+
+/// @internal
+template<class BV>
+void combine_operation(BV& bv, const BV& bv_arg,
+                       bm::operation opcode,
+                       typename combine_top_range_func<BV>::op_func_type op,
+                       bm::thread_pool& pool)
+{
+    unsigned top_blocks = bv.combine_operation_prepare(bv_arg, opcode);
+    if (!top_blocks)
+        return;
+    if (bv.get_allocator_pool()) // pool is not thread safe
+    {
+        (bv.*op)(bv_arg, 0, top_blocks);
+        return;
+    }
+    // OR changes only slots of the argument, AND, SUB - of the target
+    const typename BV::blocks_manager_type& bman_nz =
+        (opcode == bm::BM_OR) ? bv_arg.get_blocks_manager()
+                              : bv.get_blocks_manager();
+    std::vector<unsigned> slots;
+    bm::parallel::collect_top_slots(slots, top_blocks,
+        [&](unsigned i) { return bman_nz.find_next_nz_top(i); });
+    combine_top_range_func<BV> func(bv, bv_arg, op, slots);
+    pool.run(unsigned(slots.size()), func);
+}
+
+/**
+    \brief Multi-threaded OR: bv |= bv_arg
+    \param bv - target vector
+    \param bv_arg - argument vector
+    \param pool - thread pool to run the operation
+    \ingroup setalgo
+*/
+template<class BV>
+void bit_or(BV& bv, const BV& bv_arg, bm::thread_pool& pool)
+{
+    bm::parallel::combine_operation(bv, bv_arg, bm::BM_OR,
+                        &BV::combine_operation_or_top_range, pool);
+}
+
+/**
+    \brief Multi-threaded AND: bv &= bv_arg
+    \param bv - target vector
+    \param bv_arg - argument vector
+    \param pool - thread pool to run the operation
+    \ingroup setalgo
+*/
+template<class BV>
+void bit_and(BV& bv, const BV& bv_arg, bm::thread_pool& pool)
+{
+    bm::parallel::combine_operation(bv, bv_arg, bm::BM_AND,
+                        &BV::combine_operation_and_top_range, pool);
+}
+
+/**
+    \brief Multi-threaded SUB (AND NOT): bv -= bv_arg
+    \param bv - target vector
+    \param bv_arg - argument vector
+    \param pool - thread pool to run the operation
+    \ingroup setalgo
+*/
+template<class BV>
+void bit_sub(BV& bv, const BV& bv_arg, bm::thread_pool& pool)
+{
+    bm::parallel::combine_operation(bv, bv_arg, bm::BM_SUB,
+                        &BV::combine_operation_sub_top_range, pool);
+}
+
+
+/**
+    \brief Multi-threaded aggregator of a group of bit-vectors.
+
+    Every pool worker runs its own bm::aggregator (own arena and temp
+    blocks) on top level slots taken from the shared task counter.
+    Target vector is prepared single-threaded, then every top level slot
+    of the target is written by one worker only.
+    Results are identical to bm::aggregator.
+
+    \ingroup setalgo
+*/
+template<typename BV>
+class aggregator
+{
+public:
+    typedef BV                            bvector_type;
+    typedef typename BV::size_type        size_type;
+    typedef const bvector_type*           bvector_type_const_ptr;
+    typedef bm::aggregator<BV>            aggregator_type;
+
+public:
+    /**
+        \param pool - thread pool to run operations
+        (must outlive the aggregator)
+    */
+    explicit aggregator(bm::thread_pool& pool)
+    : pool_(pool)
+    {
+        for (unsigned i = 0; i < pool_.size(); ++i)
+            agg_.emplace_back(new aggregator_type());
+    }
+
+    /**
+        Aggregate group of vectors using logical OR
+        \sa bm::aggregator::combine_or
+    */
+    void combine_or(bvector_type& bv_target,
+                    const bvector_type_const_ptr* bv_src, unsigned src_size);
+
+    /**
+        Aggregate group of vectors using logical AND
+        \sa bm::aggregator::combine_and
+    */
+    void combine_and(bvector_type& bv_target,
+                     const bvector_type_const_ptr* bv_src, unsigned src_size);
+
+    /**
+        Fusion aggregate group of vectors using logical AND MINUS another set.
+        With any == true workers stop taking new slots as soon as
+        anything is found (result is incomplete, as in the serial version).
+
+        \return true when found
+        \sa bm::aggregator::combine_and_sub
+    */
+    bool combine_and_sub(bvector_type& bv_target,
+                     const bvector_type_const_ptr* bv_src_and, unsigned src_and_size,
+                     const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size,
+                     bool any);
+
+    /**
+        Find first bit of AND MINUS aggregate.
+        Slots after the best found one are cancelled (skipped),
+        slots before it are still searched to keep the result
+        identical to the serial search.
+
+        \return true when found
+        \sa bm::aggregator::find_first_and_sub
+    */
+    bool find_first_and_sub(size_type& idx,
+                     const bvector_type_const_ptr* bv_src_and, unsigned src_and_size,
+                     const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size);
+
+    aggregator(const aggregator&) = delete;
+    aggregator& operator=(const aggregator&) = delete;
+
+protected:
+    bm::thread_pool&                               pool_;
+    std::vector<std::unique_ptr<aggregator_type> > agg_; ///< per worker
+};
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+void aggregator<BV>::combine_or(bvector_type& bv_target,
+                        const bvector_type_const_ptr* bv_src, unsigned src_size)
+{
+    BM_ASSERT_THROW(src_size < aggregator_type::max_aggregator_cap, BM_ERR_RANGE);
+    if (!src_size)
+    {
+        bv_target.clear();
+        return;
+    }
+    unsigned top_blocks =
+        aggregator_type::resize_target(bv_target, bv_src, src_size);
+    if (bv_target.get_allocator_pool()) // pool is not thread safe
+    {
+        agg_[0]->combine_or_top_range(bv_target, bv_src, src_size,
+                                      0, top_blocks);
+        return;
+    }
+    std::vector<unsigned> slots;
+    bm::parallel::collect_top_slots(slots, top_blocks, [&](unsigned i)
+        { return aggregator_type::find_next_nz_top_or(i, bv_src, src_size); });
+    auto func = [&](unsigned task_idx, unsigned worker_idx)
+    {
+        unsigned i = slots[task_idx];
+        agg_[worker_idx]->combine_or_top_range(bv_target, bv_src, src_size,
+                                               i, i + 1);
+    };
+    pool_.run(unsigned(slots.size()), func);
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+void aggregator<BV>::combine_and(bvector_type& bv_target,
+                        const bvector_type_const_ptr* bv_src, unsigned src_size)
+{
+    BM_ASSERT_THROW(src_size < aggregator_type::max_aggregator_cap, BM_ERR_RANGE);
+    if (!src_size)
+    {
+        bv_target.clear();
+        return;
+    }
+    unsigned top_blocks =
+        aggregator_type::resize_target(bv_target, bv_src, src_size);
+    if (bv_target.get_allocator_pool()) // pool is not thread safe
+    {
+        agg_[0]->combine_and_top_range(bv_target, bv_src, src_size,
+                                       0, top_blocks);
+        return;
+    }
+    std::vector<unsigned> slots;
+    bm::parallel::collect_top_slots(slots, top_blocks, [&](unsigned i)
+        { return aggregator_type::find_next_nz_top_and(i, bv_src, src_size); });
+    auto func = [&](unsigned task_idx, unsigned worker_idx)
+    {
+        unsigned i = slots[task_idx];
+        agg_[worker_idx]->combine_and_top_range(bv_target, bv_src, src_size,
+                                                i, i + 1);
+    };
+    pool_.run(unsigned(slots.size()), func);
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+bool aggregator<BV>::combine_and_sub(bvector_type& bv_target,
+                 const bvector_type_const_ptr* bv_src_and, unsigned src_and_size,
+                 const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size,
+                 bool any)
+{
+    BM_ASSERT_THROW(src_and_size < aggregator_type::max_aggregator_cap, BM_ERR_RANGE);
+    BM_ASSERT_THROW(src_sub_size < aggregator_type::max_aggregator_cap, BM_ERR_RANGE);
+    if (!bv_src_and || !src_and_size)
+    {
+        bv_target.clear();
+        return false;
+    }
+    unsigned top_blocks =
+        aggregator_type::resize_target(bv_target, bv_src_and, src_and_size);
+    unsigned top_blocks2 =
+        aggregator_type::resize_target(bv_target, bv_src_sub, src_sub_size, false);
+    if (top_blocks2 > top_blocks)
+        top_blocks = top_blocks2;
+
+    if (bv_target.get_allocator_pool()) // pool is not thread safe
+    {
+        return agg_[0]->combine_and_sub_top_range(bv_target,
+                                                  bv_src_and, src_and_size,
+                                                  bv_src_sub, src_sub_size,
+                                                  0, top_blocks, any);
+    }
+    std::vector<unsigned> slots;
+    bm::parallel::collect_top_slots(slots, top_blocks, [&](unsigned i)
+        { return aggregator_type::find_next_nz_top_and(i, bv_src_and,
+                                                       src_and_size); });
+    std::atomic<bool> global_found(false);
+    auto func = [&](unsigned task_idx, unsigned worker_idx)
+    {
+        if (any && global_found.load(std::memory_order_relaxed))
+            return; // cancelled: somebody already found
+        unsigned i = slots[task_idx];
+        bool found =
+            agg_[worker_idx]->combine_and_sub_top_range(bv_target,
+                                                  bv_src_and, src_and_size,
+                                                  bv_src_sub, src_sub_size,
+                                                  i, i + 1, any);
+        if (found)
+            global_found.store(true, std::memory_order_relaxed);
+    };
+    pool_.run(unsigned(slots.size()), func);
+    return global_found.load();
+}
+
+// ------------------------------------------------------------------------
+
+template<typename BV>
+bool aggregator<BV>::find_first_and_sub(size_type& idx,
+                 const bvector_type_const_ptr* bv_src_and, unsigned src_and_size,
+                 const bvector_type_const_ptr* bv_src_sub, unsigned src_sub_size)
+{
+    BM_ASSERT_THROW(src_and_size < aggregator_type::max_aggregator_cap, BM_ERR_RANGE);
+    BM_ASSERT_THROW(src_sub_size < aggregator_type::max_aggregator_cap, BM_ERR_RANGE);
+    if (!bv_src_and || !src_and_size)
+        return false;
+
+    unsigned top_blocks = aggregator_type::max_top_blocks(bv_src_and, src_and_size);
+    unsigned top_blocks2 = aggregator_type::max_top_blocks(bv_src_sub, src_sub_size);
+    if (top_blocks2 > top_blocks)
+        top_blocks = top_blocks2;
+
+    // top level slot of the best (lowest) found result (top_blocks - none)
+    std::atomic<unsigned> found_top(top_blocks);
+    std::mutex            found_mutex;
+    size_type             found_idx = 0;
+
+    std::vector<unsigned> slots; // ascending, as in the serial search
+    bm::parallel::collect_top_slots(slots, top_blocks, [&](unsigned i)
+        { return aggregator_type::find_next_nz_top_and(i, bv_src_and,
+                                                       src_and_size); });
+    auto func = [&](unsigned task_idx, unsigned worker_idx)
+    {
+        unsigned i = slots[task_idx];
+        if (i > found_top.load(std::memory_order_relaxed))
+            return; // cancelled: result found in a lower slot
+        size_type slot_idx;
+        bool found =
+            agg_[worker_idx]->find_first_and_sub_top_range(slot_idx,
+                                                  bv_src_and, src_and_size,
+                                                  bv_src_sub, src_sub_size,
+                                                  i, i + 1);
+        if (found)
+        {
+            std::lock_guard<std::mutex> lock(found_mutex);
+            if (i < found_top.load(std::memory_order_relaxed))
+            {
+                found_idx = slot_idx;
+                found_top.store(i, std::memory_order_relaxed);
+            }
+        }
+    };
+    pool_.run(unsigned(slots.size()), func);
+
+    if (found_top.load() == top_blocks)
+        return false;
+    idx = found_idx;
+    return true;
+}
+
+} // namespace parallel
+
+} // namespace bm
+
+#endif
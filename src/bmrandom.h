@@ -109,9 +109,9 @@ private:
 
 template<class BV>
 random_subset<BV>::random_subset()
-: block_counts_(new unsigned[bm::set_total_blocks]),
-  block_bits_take_(new bm::gap_word_t[bm::set_total_blocks]),
-  block_candidates_(new unsigned[bm::set_total_blocks]),
+: block_counts_(new unsigned[bm::set_total_blocks32]),
+  block_bits_take_(new bm::gap_word_t[bm::set_total_blocks32]),
+  block_candidates_(new unsigned[bm::set_total_blocks32]),
   candidates_count_(0),
   sub_block_(new bm::word_t[bm::set_block_size])
 {
@@ -94,7 +94,8 @@ enum serialization_header_mask {
     BM_HM_RESIZE  = (1 << 1), ///< resized vector
     BM_HM_ID_LIST = (1 << 2), ///< id list stored
     BM_HM_NO_BO   = (1 << 3), ///< no byte-order
-    BM_HM_NO_GAPL = (1 << 4)  ///< no GAP levels
+    BM_HM_NO_GAPL = (1 << 4), ///< no GAP levels
+    BM_HM_64BIT   = (1 << 5)  ///< 64-bit vector size stored
 };
 
 
@@ -121,7 +122,7 @@ enum serialization_header_mask {
 
 #define BM_SET_ONE_BLOCKS(x) \
     {\
-         unsigned end_block = i + x; \
+         bm::block_idx_type end_block = i + x; \
          for (;i < end_block; ++i) \
             bman.set_block_all_set(i); \
     } \
@@ -324,7 +325,7 @@ protected:
 protected:
    void deserialize_gap(unsigned char btype, decoder_type& dec, 
                         bvector_type&  bv, blocks_manager_type& bman,
-                        unsigned i,
+                        bm::block_idx_type i,
                         bm::word_t* blk);
 protected:
     bm::gap_word_t   gap_temp_block_[bm::gap_equiv_len * 4];
@@ -376,7 +377,7 @@ private:
     static
     unsigned finalize_target_vector(blocks_manager_type& bman,
                                     set_operation        op,
-                                    unsigned             bv_block_idx);
+                                    bm::block_idx_type   bv_block_idx);
 
     /// Process (obsolete) id-list serialization format
     static
@@ -398,11 +399,16 @@ class serial_stream_iterator : protected deseriaizer_base<DEC>
 {
 public:
     typedef typename deseriaizer_base<DEC>::decoder_type decoder_type;
+#ifdef BM64ADDR
+    typedef bm::id64_t                                   size_type;
+#else
+    typedef bm::id_t                                     size_type;
+#endif
 public:
     serial_stream_iterator(const unsigned char* buf);
 
     /// serialized bitvector size
-    unsigned bv_size() const { return bv_size_; }
+    size_type bv_size() const { return bv_size_; }
 
     /// Returns true if end of bit-stream reached 
     bool is_eof() const { return end_of_stream_; }
@@ -413,6 +419,13 @@ public:
 	/// skip all zero or all-one blocks
 	void skip_mono_blocks();
 
+    /// skip zero or all-one blocks up to block nb (not included),
+    /// past the end of stream moves straight to nb
+    void skip_mono_blocks_to(bm::block_idx_type nb);
+
+    /// Number of zero or all-one blocks after the current one
+    bm::block_idx_type mono_block_count() const { return mono_block_cnt_; }
+
     /// read bit block, using logical operation
     unsigned get_bit_block(bm::word_t*       dst_block, 
                            bm::word_t*       tmp_block,
@@ -454,7 +467,7 @@ public:
     bm::id_t get_id() const { return this->last_id_; }
 
     /// Get current block index 
-    unsigned block_idx() const { return this->block_idx_; }
+    bm::block_idx_type block_idx() const { return this->block_idx_; }
 
 public:
     /// member function pointer for bitset-bitset get operations
@@ -509,15 +522,15 @@ protected:
 
     decoder_type       decoder_;
     bool               end_of_stream_;
-    unsigned           bv_size_;
+    size_type          bv_size_;
     iterator_state     state_;
     unsigned           id_cnt_;  ///< Id counter for id list
     bm::id_t           last_id_; ///< Last id from the id list
     gap_word_t         glevels_[bm::gap_levels]; ///< GAP levels
 
     unsigned           block_type_;     ///< current block type
-    unsigned           block_idx_;      ///< current block index
-    unsigned           mono_block_cnt_; ///< number of 0 or 1 blocks
+    bm::block_idx_type block_idx_;      ///< current block index
+    bm::block_idx_type mono_block_cnt_; ///< number of 0 or 1 blocks
 
     gap_word_t         gap_head_;
 };
@@ -585,6 +598,107 @@ private:
 
 
 
+/**
+    Aggregation (OR, fused AND-SUB) of serialized bit-vectors (BLOBs)
+    without deserialization of the arguments.
+
+    All BLOBs are decoded lazily, in lockstep, one block at a time.
+    Blocks which can not change the result (AND group already gave an
+    empty block or there are zero blocks in other AND arguments) are
+    only skipped in the stream.
+    BLOBs of a foreign byte order or saved as an id-list are
+    deserialized into temporary vectors when added.
+
+    \ingroup bvserial
+*/
+template<class BV>
+class serial_aggregator
+{
+public:
+    typedef BV                         bvector_type;
+    typedef typename BV::size_type     size_type;
+
+    /// Maximum number of arguments in a group
+    enum max_size
+    {
+        max_aggregator_cap = 256
+    };
+
+public:
+    serial_aggregator();
+    ~serial_aggregator();
+
+    /**
+        Attach serialized bit-vector to an argument group
+        \param buf - BLOB pointer (must be valid until the operation)
+        \param agr_group - argument group (0 - AND/OR, 1 - SUB)
+        \return current arg group size
+    */
+    unsigned add(const unsigned char* buf, unsigned agr_group = 0);
+
+    /// Reset argument groups
+    void reset();
+
+    /**
+        Aggregate group 0 using logical OR
+        \param bv_target - target vector
+    */
+    void combine_or(bvector_type& bv_target);
+
+    /**
+        Aggregate groups using fused logical AND-SUB
+        (group 0 - AND, group 1 - SUB)
+        \param bv_target - target vector
+        \return true if anything was found
+    */
+    bool combine_and_sub(bvector_type& bv_target);
+
+protected:
+    typedef typename bvector_type::blocks_manager_type blocks_manager_type;
+    typedef serial_stream_iterator<bm::decoder>        serial_stream_type;
+    typedef typename serial_stream_type::iterator_state iterator_state;
+
+    /// state of argument block
+    enum block_state
+    {
+        e_zero = 0,  ///< empty block
+        e_one,       ///< all-one block
+        e_bit,       ///< bit-block to decode
+        e_gap        ///< GAP block to decode
+    };
+
+    void init_streams();
+    void free_streams();
+    void prepare_target(bvector_type& bv_target, unsigned group_size);
+
+    block_state seek_block(unsigned k, bm::block_idx_type nb,
+                           bm::block_idx_type& next_nb);
+    void decode_block(unsigned k, block_state st, bm::set_operation op);
+
+private:
+    /// Memory arena for block operations
+    struct arena
+    {
+        BM_DECLARE_TEMP_BLOCK(tb1);  ///< result block
+        BM_DECLARE_TEMP_BLOCK(tb2);  ///< decode temp block
+        bm::gap_word_t gap_buf[bm::gap_equiv_len * 3]; ///< GAP decode buffer
+
+        const unsigned char* arg_buf[max_aggregator_cap * 2]; ///< BLOBs
+        bvector_type*        arg_bv[max_aggregator_cap * 2];  ///< deserialized
+    };
+
+    serial_aggregator(const serial_aggregator&) = delete;
+    serial_aggregator& operator=(const serial_aggregator&) = delete;
+
+private:
+    arena*              ar_;         ///< data arena ptr (heap allocated)
+    serial_stream_type* streams_;    ///< decoding streams (per operation)
+    bm::block_idx_type  bv_block_idx_ = 0; ///< current block
+    unsigned            arg_group0_size = 0;
+    unsigned            arg_group1_size = 0;
+};
+
+
 //---------------------------------------------------------------------
 
 template<class BV>
@@ -676,6 +790,11 @@ void serializer<BV>::encode_header(const BV& bv, bm::encoder& enc)
     if (!gap_serial_) 
         header_flag |= BM_HM_NO_GAPL;
 
+#ifdef BM64ADDR
+    if ((header_flag & BM_HM_RESIZE) && bv.size() > bm::id_max32)
+        header_flag |= BM_HM_64BIT;
+#endif
+
     enc.put_8(header_flag);
 
     if (byte_order_serial_)
@@ -693,7 +812,12 @@ void serializer<BV>::encode_header(const BV& bv, bm::encoder& enc)
     // save size (only if bvector has been down-sized)
     if (header_flag & BM_HM_RESIZE) 
     {
-        enc.put_32(bv.size());
+#ifdef BM64ADDR
+        if (header_flag & BM_HM_64BIT)
+            enc.put_64(bv.size());
+        else
+#endif
+            enc.put_32((bm::id_t)bv.size());
     }
     
 }
@@ -921,7 +1045,7 @@ unsigned serializer<BV>::serialize(const BV& bv,
     bm::encoder enc(buf, buf_size);  // create the encoder
     encode_header(bv, enc);
 
-    unsigned i,j;
+    bm::block_idx_type i, j;
 
 
     // save blocks.
@@ -936,13 +1060,13 @@ unsigned serializer<BV>::serialize(const BV& bv,
         if (flag)
         {
         zero_block:
-            unsigned next_nb = bman.find_next_nz_block(i+1, false);
+            bm::block_idx_type next_nb = bman.find_next_nz_block(i+1, false);
             if (next_nb == bm::set_total_blocks) // no more blocks
             {
                 enc.put_8(set_block_azero);
                 return enc.size();
             }
-            unsigned nb = next_nb - i;
+            unsigned nb = unsigned(next_nb - i);
             
             if (nb > 1 && nb < 128)
             {
@@ -979,7 +1103,7 @@ unsigned serializer<BV>::serialize(const BV& bv,
                 }
                 else
                 {
-                   unsigned nb = j - i;
+                   unsigned nb = unsigned(j - i);
                    SER_NEXT_GRP(enc, nb, set_block_1one, 
                                          set_block_8one, 
                                          set_block_16one, 
@@ -1419,7 +1543,7 @@ template<class BV, class DEC>
 void 
 deserializer<BV, DEC>::deserialize_gap(unsigned char btype, decoder_type& dec, 
                                        bvector_type&  bv, blocks_manager_type& bman,
-                                       unsigned i,
+                                       bm::block_idx_type i,
                                        bm::word_t* blk)
 {
     //typedef bit_in<DEC> bit_in_type;
@@ -1536,6 +1660,7 @@ unsigned deserializer<BV, DEC>::deserialize(bvector_type&        bv,
     {
         bman.init_tree();
     }
+    bman.unshare_all(); // blocks are modified in place
 
     bm::wordop_t* tmp_buf = 
         temp_block ? (bm::wordop_t*) temp_block 
@@ -1578,13 +1703,11 @@ unsigned deserializer<BV, DEC>::deserialize(bvector_type&        bv,
         return dec.size()-1;
     }
 
-    unsigned i;
-
     if (!(header_flag & BM_HM_NO_GAPL)) 
     {
         //gap_word_t glevels[bm::gap_levels];
         // read GAP levels information
-        for (i = 0; i < bm::gap_levels; ++i)
+        for (unsigned i = 0; i < bm::gap_levels; ++i)
         {
             /*glevels[i] =*/ dec.get_16();
         }
@@ -1592,7 +1715,13 @@ unsigned deserializer<BV, DEC>::deserialize(bvector_type&        bv,
 
     if (header_flag & (1 << 1))
     {
-        unsigned bv_size = dec.get_32();
+        typename bvector_type::size_type bv_size;
+#ifdef BM64ADDR
+        if (header_flag & BM_HM_64BIT)
+            bv_size = dec.get_64();
+        else
+#endif
+            bv_size = dec.get_32();
         if (bv_size > bv.size())
         {
             bv.resize(bv_size);
@@ -1602,7 +1731,7 @@ unsigned deserializer<BV, DEC>::deserialize(bvector_type&        bv,
     unsigned char btype;
     unsigned nb;
 
-    for (i = 0; i < bm::set_total_blocks; ++i)
+    for (bm::block_idx_type i = 0; i < bm::set_total_blocks; ++i)
     {
         btype = dec.get_8();
         bm::word_t* blk = bman.get_block(i);
@@ -1673,7 +1802,7 @@ unsigned deserializer<BV, DEC>::deserialize(bvector_type&        bv,
         }
         case set_block_bit_1bit:
         {
-            unsigned bit_idx = dec.get_16();
+            typename bvector_type::size_type bit_idx = dec.get_16();
             bit_idx += i * bm::bits_in_block; 
             bv.set_bit(bit_idx);
             continue;
@@ -1861,7 +1990,12 @@ serial_stream_iterator<DEC>::serial_stream_iterator(const unsigned char* buf)
 
         if (header_flag & (1 << 1))
         {
-            bv_size_ = decoder_.get_32();
+#ifdef BM64ADDR
+            if (header_flag & BM_HM_64BIT)
+                bv_size_ = decoder_.get_64();
+            else
+#endif
+                bv_size_ = decoder_.get_32();
         }
         state_ = e_blocks;
     }
@@ -2014,6 +2148,25 @@ void serial_stream_iterator<DEC>::skip_mono_blocks()
     state_ = e_blocks;
 }
 
+template<class DEC>
+void serial_stream_iterator<DEC>::skip_mono_blocks_to(bm::block_idx_type nb)
+{
+    BM_ASSERT(nb > block_idx_);
+    if (is_eof()) // past the end of stream: everything is zero
+    {
+        block_idx_ = nb;
+        return;
+    }
+    BM_ASSERT(state_ == e_zero_blocks || state_ == e_one_blocks);
+    if (nb > block_idx_ + mono_block_cnt_)
+    {
+        skip_mono_blocks();
+        return;
+    }
+    mono_block_cnt_ -= nb - block_idx_;
+    block_idx_ = nb;
+}
+
 template<class DEC>
 unsigned 
 serial_stream_iterator<DEC>::get_bit_block_ASSIGN(
@@ -3029,7 +3182,7 @@ unsigned
 iterator_deserializer<BV, SerialIterator>::finalize_target_vector(
                                                 blocks_manager_type& bman,
                                                 set_operation        op,
-                                                unsigned             bv_block_idx)
+                                                bm::block_idx_type   bv_block_idx)
 {
     unsigned count = 0;
     switch (op)
@@ -3044,14 +3197,15 @@ iterator_deserializer<BV, SerialIterator>::finalize_target_vector(
         {
             unsigned i, j;
             bman.get_block_coord(bv_block_idx, i, j);
-            bm::word_t*** blk_root = bman.top_blocks_root();
             unsigned top_size = bman.top_block_size();
             for (; i < top_size; ++i)
             {
-                bm::word_t** blk_blk = blk_root[i];
+                bm::word_t** blk_blk = bman.get_topblock(i);
                 if (blk_blk == 0) 
                 {
-                    bv_block_idx+=bm::set_array_size-j;
+                    // skip to the next allocated sub-block
+                    i = bman.find_next_nz_top(i) - 1;
+                    bv_block_idx = bm::block_idx_type(i + 1) * bm::set_array_size;
                     j = 0;
                     continue;
                 }
@@ -3071,14 +3225,15 @@ iterator_deserializer<BV, SerialIterator>::finalize_target_vector(
         {
             unsigned i, j;
             bman.get_block_coord(bv_block_idx, i, j);
-            bm::word_t*** blk_root = bman.top_blocks_root();
             unsigned top_size = bman.top_block_size();
             for (;i < top_size; ++i)
             {
-                bm::word_t** blk_blk = blk_root[i];
+                bm::word_t** blk_blk = bman.get_topblock(i);
                 if (blk_blk == 0) 
                 {
-                    bv_block_idx+=bm::set_array_size-j;
+                    // skip to the next allocated sub-block
+                    i = bman.find_next_nz_top(i) - 1;
+                    bv_block_idx = bm::block_idx_type(i + 1) * bm::set_array_size;
                     j = 0;
                     continue;
                 }
@@ -3219,7 +3374,7 @@ void iterator_deserializer<BV, SerialIterator>::deserialize(
         bman_target.init_tree();
     }
 
-    unsigned bv_size = sit.bv_size();
+    typename bvector_type::size_type bv_size = sit.bv_size();
     if (bv_mask.size() > bv_size) 
     {
         bv_size = bv_mask.size();    
@@ -3242,13 +3397,13 @@ void iterator_deserializer<BV, SerialIterator>::deserialize(
         return;
     }
 
-    unsigned bv_block_idx = 0;
+    bm::block_idx_type bv_block_idx = 0;
     for (;1;)
     {
 		bv_block_idx = sit.block_idx();
         // early exit check to avoid over-scan
         {
-            unsigned tb_idx = bv_block_idx >> bm::set_array_shift; // current top block
+            bm::block_idx_type tb_idx = bv_block_idx >> bm::set_array_shift; // current top block
             if (tb_idx > top_blocks)
             {
                 if (op == bm::set_AND)
@@ -3324,9 +3479,17 @@ void iterator_deserializer<BV, SerialIterator>::deserialize(
 					sit.skip_mono_blocks();
 					break;
 				}
-                sit.next();
    			    // set_SUB: set_OR: set_XOR: 
 				bman_target.copy_block(bv_block_idx, bman_mask);
+                {
+                    // skip the run of blocks not present in the mask vector
+                    bm::block_idx_type nb_next =
+                        bman_mask.find_next_nz_block(bv_block_idx + 1, false);
+                    if (nb_next > bv_block_idx + 1)
+                        sit.skip_mono_blocks_to(nb_next);
+                    else
+                        sit.next();
+                }
             }
             break;
 
@@ -3375,7 +3538,8 @@ void iterator_deserializer<BV, SerialIterator>::deserialize(
 					if (op == set_AND)
 					{
 						unsigned bit_idx = sit.get_bit();
-						unsigned bn = (bv_block_idx << bm::set_block_shift) | bit_idx;
+						typename bvector_type::size_type bn =
+                            (typename bvector_type::size_type(bv_block_idx) << bm::set_block_shift) | bit_idx;
 						bool bval_mask = bv_mask.test(bn);
 						bv_target.set_bit(bn, bval_mask);						
 						break;
@@ -3445,6 +3609,8 @@ iterator_deserializer<BV, SerialIterator>::deserialize(
     {
         bman.init_tree();
     }
+    if (!is_const_set_operation(op))
+        bman.unshare_all(); // blocks are modified in place
 
     bv.forget_count();
     if (sit.bv_size() && (sit.bv_size() > bv.size())) 
@@ -3462,7 +3628,7 @@ iterator_deserializer<BV, SerialIterator>::deserialize(
         return count;
     }
 
-    unsigned bv_block_idx = 0;
+    bm::block_idx_type bv_block_idx = 0;
 
     for (;1;)
     {
@@ -3522,6 +3688,7 @@ iterator_deserializer<BV, SerialIterator>::deserialize(
                     {
                         // TODO: make sure const operations do not 
                         // deoptimize GAP blocks
+                        bman.unshare_block(bv_block_idx);
                         blk = bman.deoptimize_block(bv_block_idx);
                     }
                 }
@@ -3540,7 +3707,15 @@ iterator_deserializer<BV, SerialIterator>::deserialize(
             {
             BM_ASSERT(bv_block_idx == sit.block_idx());
             bm::word_t* blk = bman.get_block(bv_block_idx);
-            sit.next();
+            {
+                // zero run over blocks absent in this vector: nothing to do
+                bm::block_idx_type nb_next =
+                    bman.find_next_nz_block(bv_block_idx + 1, false);
+                if (nb_next > bv_block_idx + 1)
+                    sit.skip_mono_blocks_to(nb_next);
+                else
+                    sit.next();
+            }
 
             if (blk)
             {
@@ -3573,6 +3748,7 @@ iterator_deserializer<BV, SerialIterator>::deserialize(
                     BM_ASSERT(0);
                 } // switch op
             } // if blk
+            bv_block_idx = sit.block_idx() - 1; // incremented below
             }
             break;
 
@@ -3756,6 +3932,408 @@ iterator_deserializer<BV, SerialIterator>::deserialize(
 }
 
 
+//---------------------------------------------------------------------
+
+template<class BV>
+serial_aggregator<BV>::serial_aggregator()
+: streams_(0)
+{
+    ar_ = (arena*) bm::aligned_new_malloc(sizeof(arena));
+}
+
+//---------------------------------------------------------------------
+
+template<class BV>
+serial_aggregator<BV>::~serial_aggregator()
+{
+    reset();
+    bm::aligned_free(ar_);
+}
+
+//---------------------------------------------------------------------
+
+template<class BV>
+void serial_aggregator<BV>::reset()
+{
+    unsigned arg_count = arg_group0_size + arg_group1_size;
+    for (unsigned k = 0; k < arg_count; ++k)
+    {
+        bvector_type* bv = ar_->arg_bv[k];
+        if (bv)
+        {
+            bv->~bvector_type();
+            bm::aligned_free(bv);
+        }
+    }
+    arg_group0_size = arg_group1_size = 0;
+}
+
+//---------------------------------------------------------------------
+
+template<class BV>
+unsigned serial_aggregator<BV>::add(const unsigned char* buf,
+                                    unsigned agr_group)
+{
+    BM_ASSERT_THROW(agr_group <= 1, BM_ERR_RANGE);
+    BM_ASSERT(buf);
+
+    unsigned& group_size = agr_group ? arg_group1_size : arg_group0_size;
+    BM_ASSERT_THROW(group_size < max_aggregator_cap, BM_ERR_RANGE);
+    if (!agr_group && arg_group1_size)
+    {
+        // keep group 0 first: shift group 1 arguments
+        for (unsigned k = arg_group0_size + arg_group1_size;
+             k > arg_group0_size; --k)
+        {
+            ar_->arg_buf[k] = ar_->arg_buf[k-1];
+            ar_->arg_bv[k] = ar_->arg_bv[k-1];
+        }
+    }
+    unsigned idx = agr_group ? arg_group0_size + arg_group1_size
+                             : arg_group0_size;
+
+    // streaming decode needs native byte order and a blocks stream
+    bm::decoder dec(buf);
+    unsigned char header_flag = dec.get_8();
+    ByteOrder bo = globals<true>::byte_order();
+    if (!(header_flag & BM_HM_NO_BO))
+        bo = (bm::ByteOrder) dec.get_8();
+
+    bvector_type* bv = 0;
+    if ((header_flag & BM_HM_ID_LIST) || bo != globals<true>::byte_order())
+    {
+        void* mem = bm::aligned_new_malloc(sizeof(bvector_type));
+        bv = new(mem) bvector_type();
+        bm::deserialize(*bv, buf);
+    }
+    ar_->arg_buf[idx] = buf;
+    ar_->arg_bv[idx] = bv;
+    return ++group_size;
+}
+
+//---------------------------------------------------------------------
+
+template<class BV>
+void serial_aggregator<BV>::init_streams()
+{
+    BM_ASSERT(!streams_);
+    unsigned arg_count = arg_group0_size + arg_group1_size;
+    if (!arg_count)
+        return;
+    streams_ = (serial_stream_type*)
+        bm::aligned_new_malloc(arg_count * sizeof(serial_stream_type));
+    for (unsigned k = 0; k < arg_count; ++k)
+    {
+        if (!ar_->arg_bv[k])
+            new(streams_ + k) serial_stream_type(ar_->arg_buf[k]);
+    }
+}
+
+//---------------------------------------------------------------------
+
+template<class BV>
+void serial_aggregator<BV>::free_streams()
+{
+    if (!streams_)
+        return;
+    unsigned arg_count = arg_group0_size + arg_group1_size;
+    for (unsigned k = 0; k < arg_count; ++k)
+    {
+        if (!ar_->arg_bv[k])
+            streams_[k].~serial_stream_type();
+    }
+    bm::aligned_free(streams_);
+    streams_ = 0;
+}
+
+//---------------------------------------------------------------------
+
+template<class BV>
+void serial_aggregator<BV>::prepare_target(bvector_type& bv_target,
+                                           unsigned group_size)
+{
+    blocks_manager_type& bman_target = bv_target.get_blocks_manager();
+    if (!bman_target.is_init())
+        bman_target.init_tree();
+    else
+        bv_target.clear(true);
+
+    for (unsigned k = 0; k < group_size; ++k)
+    {
+        size_type arg_size = ar_->arg_bv[k] ? ar_->arg_bv[k]->size()
+                                            : streams_[k].bv_size();
+        if (arg_size > bv_target.size())
+            bv_target.resize(arg_size);
+    } // for k
+}
+
+//---------------------------------------------------------------------
+
+template<class BV>
+typename serial_aggregator<BV>::block_state
+serial_aggregator<BV>::seek_block(unsigned k, bm::block_idx_type nb,
+                                  bm::block_idx_type& next_nb)
+{
+    const bvector_type* bv = ar_->arg_bv[k];
+    if (bv) // deserialized argument
+    {
+        const blocks_manager_type& bman = bv->get_blocks_manager();
+        unsigned i = unsigned(nb >> bm::set_array_shift);
+        if (i >= bman.top_block_size())
+        {
+            next_nb = bm::set_total_blocks;
+            return e_zero;
+        }
+        const bm::word_t* const* blk_blk = bman.get_topblock(i);
+        if (!blk_blk)
+        {
+            i = bman.find_next_nz_top(i);
+            next_nb = (i >= bman.top_block_size()) ? bm::set_total_blocks
+                        : (bm::block_idx_type(i) << bm::set_array_shift);
+            return e_zero;
+        }
+        const bm::word_t* blk = blk_blk[nb & bm::set_array_mask];
+        next_nb = nb + 1;
+        if (!blk)
+            return e_zero;
+        if (BM_IS_GAP(blk))
+            return e_gap;
+        return IS_FULL_BLOCK(blk) ? e_one : e_bit;
+    }
+
+    serial_stream_type& sit = streams_[k];
+    for (;1;)
+    {
+        if (sit.is_eof())
+        {
+            next_nb = bm::set_total_blocks;
+            return e_zero;
+        }
+        iterator_state state = sit.state();
+        switch (state)
+        {
+        case serial_stream_type::e_blocks:
+            sit.next();
+            continue;
+        case serial_stream_type::e_zero_blocks:
+        case serial_stream_type::e_one_blocks:
+            if (sit.block_idx() < nb)
+            {
+                sit.skip_mono_blocks_to(nb);
+                continue;
+            }
+            BM_ASSERT(sit.block_idx() == nb);
+            next_nb = nb + sit.mono_block_count() + 1;
+            return (state == serial_stream_type::e_zero_blocks) ? e_zero
+                                                                : e_one;
+        case serial_stream_type::e_bit_block:
+            if (sit.block_idx() < nb) // skip (seek) the block data
+            {
+                sit.get_bit_block(0, 0, bm::set_ASSIGN);
+                continue;
+            }
+            BM_ASSERT(sit.block_idx() == nb);
+            next_nb = nb + 1;
+            return e_bit;
+        case serial_stream_type::e_gap_block:
+            if (sit.block_idx() < nb)
+            {
+                sit.get_gap_block(ar_->gap_buf);
+                continue;
+            }
+            BM_ASSERT(sit.block_idx() == nb);
+            next_nb = nb + 1;
+            return e_gap;
+        default:
+            BM_ASSERT(0);
+            next_nb = bm::set_total_blocks;
+            return e_zero;
+        } // switch
+    } // for
+}
+
+//---------------------------------------------------------------------
+
+template<class BV>
+void serial_aggregator<BV>::decode_block(unsigned k, block_state st,
+                                         bm::set_operation op)
+{
+    BM_ASSERT(st == e_bit || st == e_gap);
+    bm::word_t* blk = ar_->tb1;
+    const bm::gap_word_t* gap_blk = ar_->gap_buf;
+
+    const bvector_type* bv = ar_->arg_bv[k];
+    if (bv)
+    {
+        const bm::word_t* arg_blk = bv->get_blocks_manager().get_block_ptr(
+                   unsigned(bv_block_idx_ >> bm::set_array_shift),
+                   unsigned(bv_block_idx_ & bm::set_array_mask));
+        if (st == e_bit)
+        {
+            switch (op)
+            {
+            case bm::set_ASSIGN: bm::bit_block_copy(blk, arg_blk); break;
+            case bm::set_OR:     bm::bit_block_or(blk, arg_blk);   break;
+            case bm::set_AND:    bm::bit_block_and(blk, arg_blk);  break;
+            case bm::set_SUB:    bm::bit_block_sub(blk, arg_blk);  break;
+            default: BM_ASSERT(0);
+            }
+            return;
+        }
+        gap_blk = BMGAP_PTR(arg_blk);
+    }
+    else
+    {
+        serial_stream_type& sit = streams_[k];
+        if (st == e_bit)
+        {
+            sit.get_bit_block(blk, ar_->tb2, op);
+            return;
+        }
+        sit.get_gap_block(ar_->gap_buf);
+    }
+
+    switch (op)
+    {
+    case bm::set_ASSIGN: bm::gap_convert_to_bitset(blk, gap_blk); break;
+    case bm::set_OR:     bm::gap_add_to_bitset(blk, gap_blk);     break;
+    case bm::set_AND:    bm::gap_and_to_bitset(blk, gap_blk);     break;
+    case bm::set_SUB:    bm::gap_sub_to_bitset(blk, gap_blk);     break;
+    default: BM_ASSERT(0);
+    }
+}
+
+//---------------------------------------------------------------------
+
+template<class BV>
+void serial_aggregator<BV>::combine_or(bvector_type& bv_target)
+{
+    init_streams();
+    prepare_target(bv_target, arg_group0_size);
+    blocks_manager_type& bman_target = bv_target.get_blocks_manager();
+
+    for (bm::block_idx_type nb = 0; nb < bm::set_total_blocks; )
+    {
+        bm::block_idx_type next_nb = bm::set_total_blocks;
+        bool any = false, all_one = false;
+        bv_block_idx_ = nb;
+        for (unsigned k = 0; k < arg_group0_size; ++k)
+        {
+            bm::block_idx_type arg_next_nb;
+            block_state st = seek_block(k, nb, arg_next_nb);
+            if (st == e_zero)
+            {
+                if (arg_next_nb < next_nb)
+                    next_nb = arg_next_nb;
+                continue;
+            }
+            next_nb = nb + 1;
+            if (all_one)
+                continue; // stream will be skipped on the next block
+            if (st == e_one)
+            {
+                all_one = true;
+                continue;
+            }
+            decode_block(k, st, any ? bm::set_OR : bm::set_ASSIGN);
+            any = true;
+        } // for k
+
+        if (all_one)
+            bman_target.set_block_all_set(nb);
+        else
+        if (any)
+            bman_target.copy_bit_block(nb, ar_->tb1, 0);
+        nb = next_nb;
+    } // for nb
+
+    free_streams();
+}
+
+//---------------------------------------------------------------------
+
+template<class BV>
+bool serial_aggregator<BV>::combine_and_sub(bvector_type& bv_target)
+{
+    if (!arg_group0_size)
+    {
+        bv_target.clear();
+        return false;
+    }
+    init_streams();
+    prepare_target(bv_target, arg_group0_size);
+    blocks_manager_type& bman_target = bv_target.get_blocks_manager();
+    bool found = false;
+
+    bm::block_idx_type nb = 0;
+    while (nb < bm::set_total_blocks)
+    {
+        // find the block where all AND arguments are not empty
+        //
+        bm::block_idx_type next_nb;
+        unsigned k = 0;
+        for (; k < arg_group0_size; ++k)
+        {
+            block_state st = seek_block(k, nb, next_nb);
+            if (st == e_zero)
+                break;
+        } // for k
+        if (k < arg_group0_size) // jump over the zero run and restart
+        {
+            BM_ASSERT(next_nb > nb);
+            nb = next_nb;
+            continue;
+        }
+        bv_block_idx_ = nb;
+
+        // AND group
+        //
+        bm::id64_t digest = ~0ull;
+        bool decoded = false;
+        for (k = 0; k < arg_group0_size && digest; ++k)
+        {
+            block_state st = seek_block(k, nb, next_nb);
+            if (st == e_one)
+                continue;
+            decode_block(k, st, decoded ? bm::set_AND : bm::set_ASSIGN);
+            digest = decoded ? bm::update_block_digest0(ar_->tb1, digest)
+                             : bm::calc_block_digest0(ar_->tb1);
+            decoded = true;
+        } // for k
+        if (!decoded) // all ones
+            bm::bit_block_set(ar_->tb1, ~0u);
+
+        // SUB group
+        //
+        unsigned arg_count = arg_group0_size + arg_group1_size;
+        for (k = arg_group0_size; k < arg_count && digest; ++k)
+        {
+            block_state st = seek_block(k, nb, next_nb);
+            switch (st)
+            {
+            case e_zero: break;
+            case e_one:  digest = 0; break;
+            default:
+                decode_block(k, st, bm::set_SUB);
+                digest = bm::update_block_digest0(ar_->tb1, digest);
+            }
+        } // for k
+
+        if (digest)
+        {
+            found = true;
+            if (digest == ~0ull && bm::is_bits_one((bm::wordop_t*)ar_->tb1))
+                bman_target.set_block_all_set(nb);
+            else
+                bman_target.copy_bit_block(nb, ar_->tb1, 0);
+        }
+        ++nb;
+    } // while
+
+    free_streams();
+    return found;
+}
+
 
 
 } // namespace bm
@@ -52,6 +52,59 @@ namespace bm
  */
 
 
+/*!
+    \brief Coding of sparse vector values into bit-plains
+
+    Unsigned values are stored as is. Signed values are zig-zag coded
+    (0, -1, 1, -2, 2... -> 0, 1, 2, 3, 4...), so small negative values take
+    as few bit-plains as small positive ones (two's complement would set
+    all high plains). Plain 0 is the sign of a coded value.
+
+    @ingroup sv
+    @internal
+*/
+template<typename Val>
+struct sv_value_coder
+{
+    typedef Val unsigned_type;
+    static const bool is_signed = false;
+
+    static unsigned_type encode(Val v) { return v; }
+    static Val decode(unsigned_type u) { return u; }
+};
+
+/// Zig-zag coder of signed values
+/// @internal
+template<typename Val, typename UVal>
+struct sv_signed_value_coder
+{
+    typedef UVal unsigned_type;
+    static const bool is_signed = true;
+
+    static UVal encode(Val v)
+    {
+        UVal u = UVal(UVal(v) << 1);
+        return (v < 0) ? UVal(~u) : u;
+    }
+    static Val decode(UVal u)
+    {
+        UVal h = UVal(u >> 1);
+        return Val((u & 1) ? UVal(~h) : h);
+    }
+};
+
+template<> struct sv_value_coder<signed char>
+    : public sv_signed_value_coder<signed char, unsigned char> {};
+template<> struct sv_value_coder<short>
+    : public sv_signed_value_coder<short, unsigned short> {};
+template<> struct sv_value_coder<int>
+    : public sv_signed_value_coder<int, unsigned int> {};
+template<> struct sv_value_coder<long>
+    : public sv_signed_value_coder<long, unsigned long> {};
+template<> struct sv_value_coder<long long>
+    : public sv_signed_value_coder<long long, unsigned long long> {};
+
+
 /*!
    \brief sparse vector with runtime compression using bit transposition method
  
@@ -67,6 +120,9 @@ namespace bm
  
    Overall it provides variable bit-depth compression, sparse compression in
    bit-plains.
+
+   Signed value types are zig-zag coded into bit-plains (see sv_value_coder),
+   small negative values take as little memory as small positive ones.
  
    @ingroup sv
 */
@@ -82,6 +138,9 @@ public:
     };
 
     typedef Val                                      value_type;
+    typedef bm::sv_value_coder<Val>                  value_coder_type;
+    /// type of values in bit-plains (zig-zag code of signed values)
+    typedef typename value_coder_type::unsigned_type unsigned_value_type;
     typedef bm::id_t                                 size_type;
     typedef BV                                       bvector_type;
     typedef bvector_type*                            bvector_type_ptr;
@@ -198,10 +257,10 @@ public:
         bool is_null() const;
         
         /// Returns true if iterator is at a valid position
-        bool valid() const { return pos_ != bm::id_max; }
+        bool valid() const { return pos_ != bm::id_max32; }
         
         /// Invalidate current iterator
-        void invalidate() { pos_ = bm::id_max; }
+        void invalidate() { pos_ = bm::id_max32; }
         
         /// Current position (index) in the vector
         bm::id_t pos() const { return pos_; }
@@ -344,7 +403,7 @@ public:
     */
     sparse_vector(bm::null_support null_able = bm::no_null,
                   allocation_policy_type ap = allocation_policy_type(),
-                  size_type bv_max_size = bm::id_max,
+                  size_type bv_max_size = bm::id_max32,
                   const allocator_type&   alloc  = allocator_type());
     
     /*! copy-ctor */
@@ -473,7 +532,7 @@ public:
     const_iterator begin() const;
 
     /** Provide const iterator access to the end    */
-    const_iterator end() const { return const_iterator(this, bm::id_max); }
+    const_iterator end() const { return const_iterator(this, bm::id_max32); }
 
     /** Get const_itertor re-positioned to specific element
     @param idx - position in the sparse vector
@@ -870,6 +929,13 @@ protected:
     /*! \brief push value back into vector without NULL semantics */
     void push_back_no_null(value_type v);
 
+    /*! \brief get element as unsigned (coded) value */
+    unsigned_value_type get_unsigned(bm::id_t idx) const;
+
+    /*! \brief decode values assembled from bit-plains in place (signed types) */
+    static
+    void decode_plain_values(value_type* arr, size_type size);
+
 
     const bm::word_t* get_block(unsigned p, unsigned i, unsigned j) const;
 
@@ -1116,7 +1182,7 @@ void sparse_vector<Val, BV>::import(const value_type* arr,
     size_type i;
     for (i = 0; i < size; ++i)
     {
-        unsigned bcnt = bm::bitscan(arr[i], b_list);
+        unsigned bcnt = bm::bitscan(value_coder_type::encode(arr[i]), b_list);
         const unsigned bit_idx = i + offset;
         
         for (unsigned j = 0; j < bcnt; ++j)
@@ -1209,6 +1275,8 @@ sparse_vector<Val, BV>::gather(value_type*       arr,
         return size;
     }
     ::memset(arr, 0, sizeof(value_type)*size);
+    // plains are gathered as unsigned (coded) values
+    unsigned_value_type* uarr = (unsigned_value_type*)arr;
     
     for (unsigned i = 0; i < size;)
     {
@@ -1253,7 +1321,7 @@ sparse_vector<Val, BV>::gather(value_type*       arr,
         // single element hit, use plain random access
         if (r == i+1)
         {
-            arr[i] = this->get(idx[i]);
+            uarr[i] = this->get_unsigned(idx[i]);
             ++i;
             continue;
         }
@@ -1269,12 +1337,11 @@ sparse_vector<Val, BV>::gather(value_type*       arr,
             const bm::word_t* blk = get_block(j, i0, j0);
             if (!blk)
                 continue;
-            value_type vm;
+            const unsigned_value_type vm = unsigned_value_type(unsigned_value_type(1) << j);
             if (blk == FULL_BLOCK_FAKE_ADDR)
             {
-                vm = (1u << j);
                 for (unsigned k = i; k < r; ++k)
-                    arr[k] |= vm;
+                    uarr[k] |= vm;
                 continue;
             }
             if (BM_IS_GAP(blk))
@@ -1292,11 +1359,11 @@ sparse_vector<Val, BV>::gather(value_type*       arr,
                         unsigned gap_value = gap_blk[gidx];
                         if (is_set)
                         {
-                            arr[k] |= vm = (1u << j);
+                            uarr[k] |= vm;
                             for (++k; k < r; ++k) // speculative look-up
                             {
                                 if (unsigned(idx[k] & bm::set_block_mask) <= gap_value)
-                                    arr[k] |= vm;
+                                    uarr[k] |= vm;
                                 else
                                     break;
                             }
@@ -1316,18 +1383,20 @@ sparse_vector<Val, BV>::gather(value_type*       arr,
                     {
                         unsigned nbit = unsigned(idx[k] & bm::set_block_mask);
                         is_set = bm::gap_test_unr(gap_blk, nbit);
-                        arr[k] |= value_type(bool(is_set) << j);
+                        if (is_set)
+                            uarr[k] |= vm;
                     } // for k
                 }
                 continue;
             }
-            bm::bit_block_gather_scatter(arr, blk, idx, r, i, j);
+            bm::bit_block_gather_scatter(uarr, blk, idx, r, i, j);
         } // for (each plain)
         
         i = r;
 
     } // for i
 
+    decode_plain_values(arr, size);
     return size;
 }
 
@@ -1362,6 +1431,7 @@ sparse_vector<Val, BV>::extract_range(value_type* arr,
     unsigned mask0 = 1u << (nbit & bm::set_word_mask);
     const bm::word_t* blk = 0;
     unsigned is_set;
+    unsigned_value_type* uarr = (unsigned_value_type*)arr;
     
     for (unsigned j = 0; j < sizeof(Val)*8; ++j)
     {
@@ -1401,13 +1471,14 @@ sparse_vector<Val, BV>::extract_range(value_type* arr,
                 }
             }
             size_type idx = k - offset;
-            value_type vm = (bool) is_set;
-            vm <<= j;
-            arr[idx] |= vm;
+            unsigned_value_type vm = (bool) is_set;
+            vm = unsigned_value_type(vm << j);
+            uarr[idx] |= vm;
             
         } // for k
 
     } // for j
+    decode_plain_values(arr, size);
     return 0;
 }
 
@@ -1433,25 +1504,27 @@ sparse_vector<Val, BV>::extract_plains(value_type* arr,
         end = size_;
     }
     
+    unsigned_value_type* uarr = (unsigned_value_type*)arr;
     for (size_type i = 0; i < value_bits(); ++i)
     {
         const bvector_type* bv = plains_[i];
         if (!bv)
             continue;
        
-        value_type mask = 1;
-        mask <<= i;
+        unsigned_value_type mask = 1;
+        mask = unsigned_value_type(mask << i);
         typename BV::enumerator en(bv, offset);
         for (;en.valid(); ++en)
         {
             size_type idx = *en - offset;
             if (idx >= size)
                 break;
-            arr[idx] |= mask;
+            uarr[idx] |= mask;
         } // for
         
     } // for i
 
+    decode_plain_values(arr, size);
     return 0;
 }
 
@@ -1471,8 +1544,8 @@ sparse_vector<Val, BV>::extract(value_type* arr,
     ///
     struct sv_decode_visitor_func
     {
-        sv_decode_visitor_func(value_type* varr,
-                               value_type  mask,
+        sv_decode_visitor_func(unsigned_value_type* varr,
+                               unsigned_value_type  mask,
                                size_type   off)
         : arr_(varr), mask_(mask), off_(off)
         {}
@@ -1481,7 +1554,7 @@ sparse_vector<Val, BV>::extract(value_type* arr,
         {
             size_type idx_base = arr_offset - off_;
             
-            const value_type m = mask_;
+            const unsigned_value_type m = mask_;
             unsigned i = 0;
             for (; i < bits_size; ++i)
             {
@@ -1492,12 +1565,12 @@ sparse_vector<Val, BV>::extract(value_type* arr,
         void add_range(bm::id_t arr_offset, unsigned sz)
         {
             size_type idx_base = arr_offset - off_;
-            const value_type m = mask_;
+            const unsigned_value_type m = mask_;
             for (unsigned i = 0;i < sz; ++i)
                 arr_[i + idx_base] |= m;
         }
-        value_type*  arr_;
-        value_type   mask_;
+        unsigned_value_type*  arr_;
+        unsigned_value_type   mask_;
         size_type    off_;
     };
 
@@ -1516,6 +1589,7 @@ sparse_vector<Val, BV>::extract(value_type* arr,
     }
     
 	bool masked_scan = !(offset == 0 && size == this->size());
+    unsigned_value_type* uarr = (unsigned_value_type*)arr;
 
     if (masked_scan) // use temp vector to decompress the area
     {
@@ -1528,7 +1602,7 @@ sparse_vector<Val, BV>::extract(value_type* arr,
             if (bv)
             {
                 bv_mask.copy_range(*bv, offset, end - 1);
-                sv_decode_visitor_func func(arr, (value_type(1) << i), offset);
+                sv_decode_visitor_func func(uarr, (unsigned_value_type(1) << i), offset);
                 bm::for_each_bit(bv_mask, func);
             }
         } // for i
@@ -1540,12 +1614,13 @@ sparse_vector<Val, BV>::extract(value_type* arr,
             const bvector_type* bv = plains_[i];
             if (bv)
             {
-                sv_decode_visitor_func func(arr, (value_type(1) << i), 0);
+                sv_decode_visitor_func func(uarr, (unsigned_value_type(1) << i), 0);
                 bm::for_each_bit(*bv, func);
             }
         } // for i
     }
 
+    decode_plain_values(arr, size);
     return end - start;
 }
 
@@ -1638,10 +1713,32 @@ const bm::word_t* sparse_vector<Val, BV>::get_block(unsigned p, unsigned i, unsi
 template<class Val, class BV>
 typename sparse_vector<Val, BV>::value_type
 sparse_vector<Val, BV>::get(bm::id_t i) const
+{
+    return value_coder_type::decode(get_unsigned(i));
+}
+
+//---------------------------------------------------------------------
+
+template<class Val, class BV>
+void sparse_vector<Val, BV>::decode_plain_values(value_type* arr,
+                                                 size_type   size)
+{
+    if (!value_coder_type::is_signed)
+        return;
+    const unsigned_value_type* uarr = (const unsigned_value_type*)arr;
+    for (size_type i = 0; i < size; ++i)
+        arr[i] = value_coder_type::decode(uarr[i]);
+}
+
+//---------------------------------------------------------------------
+
+template<class Val, class BV>
+typename sparse_vector<Val, BV>::unsigned_value_type
+sparse_vector<Val, BV>::get_unsigned(bm::id_t i) const
 {
     BM_ASSERT(i < size_);
     
-    value_type v = 0;
+    unsigned_value_type v = 0;
     
     // calculate logical block coordinates and masks
     //
@@ -1690,8 +1787,8 @@ sparse_vector<Val, BV>::get(bm::id_t i) const
                 is_set = 1;
             else
                 is_set = (BM_IS_GAP(blk)) ? bm::gap_test_unr(BMGAP_PTR(blk), nbit) : (blk[nword] & mask0);
-            value_type vm = (bool) is_set;
-            vm <<= (j+0);
+            unsigned_value_type vm = (bool) is_set;
+            vm = unsigned_value_type(vm << (j+0));
             v |= vm;
         }
         if ((blk = blka[0+1])!=0)
@@ -1700,8 +1797,8 @@ sparse_vector<Val, BV>::get(bm::id_t i) const
                 is_set = 1;
             else
                 is_set = (BM_IS_GAP(blk)) ? bm::gap_test_unr(BMGAP_PTR(blk), nbit) : (blk[nword] & mask0);
-            value_type vm = (bool) is_set;
-            vm <<= (j+1);
+            unsigned_value_type vm = (bool) is_set;
+            vm = unsigned_value_type(vm << (j+1));
             v |= vm;
         }
         if ((blk = blka[0+2])!=0)
@@ -1710,8 +1807,8 @@ sparse_vector<Val, BV>::get(bm::id_t i) const
                 is_set = 1;
             else
                 is_set = (BM_IS_GAP(blk)) ? bm::gap_test_unr(BMGAP_PTR(blk), nbit) : (blk[nword] & mask0);
-            value_type vm = (bool) is_set;
-            vm <<= (j+2);
+            unsigned_value_type vm = (bool) is_set;
+            vm = unsigned_value_type(vm << (j+2));
             v |= vm;
         }
         if ((blk = blka[0+3])!=0)
@@ -1720,8 +1817,8 @@ sparse_vector<Val, BV>::get(bm::id_t i) const
                 is_set = 1;
             else
                 is_set = (BM_IS_GAP(blk)) ? bm::gap_test_unr(BMGAP_PTR(blk), nbit) : (blk[nword] & mask0);
-            value_type vm = (bool) is_set;
-            vm <<= (j+3);
+            unsigned_value_type vm = (bool) is_set;
+            vm = unsigned_value_type(vm << (j+3));
             v |= vm;
         }
 
@@ -1792,8 +1889,10 @@ void sparse_vector<Val, BV>::set_value(size_type idx, value_type v)
 //---------------------------------------------------------------------
 
 template<class Val, class BV>
-void sparse_vector<Val, BV>::set_value_no_null(size_type idx, value_type v)
+void sparse_vector<Val, BV>::set_value_no_null(size_type idx, value_type val)
 {
+    unsigned_value_type v = value_coder_type::encode(val);
+
     // calculate logical block coordinates and masks
     //
     unsigned nb = unsigned(idx >>  bm::set_block_shift);
@@ -1816,7 +1915,7 @@ void sparse_vector<Val, BV>::set_value_no_null(size_type idx, value_type v)
     }
     if (v)
     {
-        value_type mask = 1u;
+        unsigned_value_type mask = 1u;
         for (unsigned j = 0; j <= bsr; ++j)
         {
             if (v & mask)
@@ -1834,7 +1933,7 @@ void sparse_vector<Val, BV>::set_value_no_null(size_type idx, value_type v)
                     bv->clear_bit_no_check(idx);
                 }
             }
-            mask <<=  1;
+            mask = unsigned_value_type(mask << 1);
         }
     }
 
@@ -1845,6 +1944,12 @@ void sparse_vector<Val, BV>::set_value_no_null(size_type idx, value_type v)
 template<class Val, class BV>
 void sparse_vector<Val, BV>::inc(size_type idx)
 {
+    if (value_coder_type::is_signed) // no carry-over on zig-zag codes
+    {
+        value_type v = (idx < size_) ? get(idx) : value_type(0);
+        set(idx, value_type(v + 1));
+        return;
+    }
     if (idx >= size_)
         size_ = idx+1;
 
@@ -2232,7 +2337,7 @@ void sparse_vector<Val, BV>::set_allocator_pool(
 
 template<class Val, class BV>
 sparse_vector<Val, BV>::const_iterator::const_iterator()
-: sv_(0), pos_(bm::id_max), buf_ptr_(0)
+: sv_(0), pos_(bm::id_max32), buf_ptr_(0)
 {}
 
 //---------------------------------------------------------------------
@@ -2251,7 +2356,7 @@ sparse_vector<Val, BV>::const_iterator::const_iterator(
 : sv_(sv), buf_ptr_(0)
 {
     BM_ASSERT(sv_);
-    pos_ = sv_->empty() ? bm::id_max : 0u;
+    pos_ = sv_->empty() ? bm::id_max32 : 0u;
 }
 
 //---------------------------------------------------------------------
@@ -2271,7 +2376,7 @@ sparse_vector<Val, BV>::const_iterator::const_iterator(
 template<class Val, class BV>
 void sparse_vector<Val, BV>::const_iterator::go_to(bm::id_t pos)
 {
-    pos_ = (!sv_ || pos >= sv_->size()) ? bm::id_max : pos;
+    pos_ = (!sv_ || pos >= sv_->size()) ? bm::id_max32 : pos;
     buf_ptr_ = 0;
 }
 
@@ -2280,11 +2385,11 @@ void sparse_vector<Val, BV>::const_iterator::go_to(bm::id_t pos)
 template<class Val, class BV>
 void sparse_vector<Val, BV>::const_iterator::advance()
 {
-    if (pos_ == bm::id_max) // nothing to do, we are at the end
+    if (pos_ == bm::id_max32) // nothing to do, we are at the end
         return;
     ++pos_;
     if (pos_ >= sv_->size())
-        pos_ = bm::id_max;
+        pos_ = bm::id_max32;
     else
     {
         if (buf_ptr_)
@@ -2335,7 +2440,7 @@ void sparse_vector<Val, BV>::const_iterator::skip_zero_values()
         }
         if (pos_ >= sv_->size())
         {
-            pos_ = bm::id_max;
+            pos_ = bm::id_max32;
             return;
         }
         if (buf_ptr_ >= buf_end)
@@ -153,6 +153,8 @@ public:
     typedef const bvector_type*             bvector_type_const_ptr;
     typedef bvector_type*                   bvector_type_ptr;
     typedef typename SV::value_type         value_type;
+    typedef typename SV::value_coder_type   value_coder_type;
+    typedef typename SV::unsigned_value_type unsigned_value_type;
     typedef typename SV::size_type          size_type;
     typedef typename bvector_type::allocator_type::allocator_pool_type allocator_pool_type;
     
@@ -206,6 +208,80 @@ public:
     */
     void find_nonzero(const SV& sv, typename SV::bvector_type& bv_out);
 
+    /**
+        \brief find all sparse vector elements LT (less than) the value
+
+        Comparison is bit-sliced (plain by plain, from the most
+        significant), vector is not decoded.
+        NULL elements are not included into the result.
+
+        \param sv      - input sparse vector
+        \param value   - value to compare with
+        \param bv_out  - output bit-vector (search result masks 1 elements)
+        \param bv_mask - optional mask to restrict the search to
+                         (0 - search all elements)
+    */
+    void find_lt(const SV&                  sv,
+                 typename SV::value_type    value,
+                 typename SV::bvector_type& bv_out,
+                 const bvector_type*        bv_mask = 0)
+    {
+        find_compare(sv, value, false, false, bv_out, bv_mask);
+    }
+
+    /**
+        \brief find all sparse vector elements LE (less or equal) the value
+        \sa find_lt
+    */
+    void find_le(const SV&                  sv,
+                 typename SV::value_type    value,
+                 typename SV::bvector_type& bv_out,
+                 const bvector_type*        bv_mask = 0)
+    {
+        find_compare(sv, value, false, true, bv_out, bv_mask);
+    }
+
+    /**
+        \brief find all sparse vector elements GT (greater than) the value
+        \sa find_lt
+    */
+    void find_gt(const SV&                  sv,
+                 typename SV::value_type    value,
+                 typename SV::bvector_type& bv_out,
+                 const bvector_type*        bv_mask = 0)
+    {
+        find_compare(sv, value, true, false, bv_out, bv_mask);
+    }
+
+    /**
+        \brief find all sparse vector elements GE (greater or equal) the value
+        \sa find_lt
+    */
+    void find_ge(const SV&                  sv,
+                 typename SV::value_type    value,
+                 typename SV::bvector_type& bv_out,
+                 const bvector_type*        bv_mask = 0)
+    {
+        find_compare(sv, value, true, true, bv_out, bv_mask);
+    }
+
+    /**
+        \brief find all sparse vector elements in the closed range [from, to]
+        (BETWEEN from AND to)
+
+        \param sv      - input sparse vector
+        \param from    - range start value
+        \param to      - range end value (inclusive)
+        \param bv_out  - output bit-vector (search result masks 1 elements)
+        \param bv_mask - optional mask to restrict the search to
+        \sa find_lt
+    */
+    void find_range(const SV&                  sv,
+                    typename SV::value_type    from,
+                    typename SV::value_type    to,
+                    typename SV::bvector_type& bv_out,
+                    const bvector_type*        bv_mask = 0);
+
     /**
         \brief invert search result ("EQ" to "not EQ")
 
@@ -274,6 +350,15 @@ protected:
                        typename SV::value_type         value,
                        bm::id_t&                       idx);
     
+    /// Bit-sliced comparison of all elements with the value (GT or LT,
+    /// optionally OR EQ), NULL elements are excluded
+    void find_compare(const SV&                  sv,
+                      typename SV::value_type    value,
+                      bool                       gt,
+                      bool                       with_eq,
+                      typename SV::bvector_type& bv_out,
+                      const bvector_type*        bv_mask);
+
     /// Prepare aggregator for AND-SUB (EQ) search
     bool prepare_and_sub_aggregator(const SV&   sv,
                                     typename SV::value_type   value);
@@ -292,6 +377,158 @@ private:
 };
 
 
+/// 64-bit sum type of the same signedness as values
+/// @internal
+template<bool is_signed> struct sv_sum_type { typedef bm::id64_t type; };
+template<> struct sv_sum_type<true> { typedef long long type; };
+
+
+/**
+    \brief Bit-sliced aggregates (COUNT, SUM, MIN, MAX, AVG) and ranking
+    queries (Top-K, quantiles) of sparse vector
+
+    Aggregates are computed on bit-plains: SUM is sum of 2^i * count(plain_i),
+    MIN, MAX and ranking queries descend through the plains refining
+    the set of candidates. Values are not decoded. All functions take an optional mask vector
+    (WHERE clause), NULL elements are not included.
+    Signed (zig-zag coded) vectors are aggregated using the sign plain.
+
+    @ingroup svalgo
+*/
+template<typename SV>
+class sparse_vector_aggregates
+{
+public:
+    typedef typename SV::bvector_type       bvector_type;
+    typedef const bvector_type*             bvector_type_const_ptr;
+    typedef typename SV::value_type         value_type;
+    typedef typename SV::value_coder_type   value_coder_type;
+    typedef typename SV::unsigned_value_type unsigned_value_type;
+    typedef typename SV::size_type          size_type;
+    typedef typename
+    bm::sv_sum_type<value_coder_type::is_signed>::type sum_type;
+
+public:
+    sparse_vector_aggregates() {}
+
+    /**
+        \brief number of NOT NULL elements
+        \param sv      - input sparse vector
+        \param bv_mask - optional mask to restrict aggregation to
+                         (0 - all elements)
+    */
+    size_type count(const SV& sv, const bvector_type* bv_mask = 0);
+
+    /**
+        \brief sum of all NOT NULL elements (modulo 2^64)
+        \param sv      - input sparse vector
+        \param bv_mask - optional mask to restrict aggregation to
+    */
+    sum_type sum(const SV& sv, const bvector_type* bv_mask = 0);
+
+    /**
+        \brief minimal value
+        \param sv      - input sparse vector
+        \param v       - [out] minimal value
+        \param bv_mask - optional mask to restrict aggregation to
+        \return false if there are no (NOT NULL) elements to aggregate
+    */
+    bool min_value(const SV& sv, value_type& v, const bvector_type* bv_mask = 0);
+
+    /**
+        \brief maximal value
+        \sa min_value
+    */
+    bool max_value(const SV& sv, value_type& v, const bvector_type* bv_mask = 0);
+
+    /**
+        \brief average value (SUM / COUNT)
+        \param sv      - input sparse vector
+        \param avg     - [out] average value
+        \param bv_mask - optional mask to restrict aggregation to
+        \return false if there are no (NOT NULL) elements to aggregate
+    */
+    bool avg(const SV& sv, double& avg, const bvector_type* bv_mask = 0);
+
+    /**
+        \brief find K largest values (Top-K)
+
+        Plains are descended from the most significant, candidates are
+        narrowed with AND/SUB and counts. Result has exactly min(K, COUNT)
+        elements, values equal to the K-th largest are taken in the index
+        order.
+
+        \param sv      - input sparse vector
+        \param k       - number of elements to find
+        \param bv_out  - output bit-vector of the found elements
+        \param bv_mask - optional mask to restrict the search to
+    */
+    void find_top_k(const SV& sv, size_type k, bvector_type& bv_out,
+                    const bvector_type* bv_mask = 0);
+
+    /**
+        \brief find K smallest values
+        \sa find_top_k
+    */
+    void find_bottom_k(const SV& sv, size_type k, bvector_type& bv_out,
+                       const bvector_type* bv_mask = 0);
+
+    /**
+        \brief quantile (nearest rank)
+
+        Finds the element of rank floor(q * (COUNT-1)) in ascending order,
+        q = 0.5 is the median (lower median for even COUNT).
+
+        \param sv      - input sparse vector
+        \param q       - quantile [0..1]
+        \param v       - [out] quantile value
+        \param bv_mask - optional mask to restrict the search to
+        \return false if there are no (NOT NULL) elements
+    */
+    bool find_quantile(const SV& sv, double q, value_type& v,
+                       const bvector_type* bv_mask = 0);
+
+protected:
+    /// Find value of rank r (0-based, ascending order) among candidates
+    /// by plains descent, candidates are narrowed to the elements equal
+    /// to the value (cand_cnt - their count, r - rank among them)
+    value_type select_rank(const SV& sv, size_type& cand_cnt, size_type& r,
+                           bvector_type* bv_less, bvector_type* bv_greater);
+
+    /// Find code of the min or max value by plains descent,
+    /// candidates are narrowed to the elements equal to it
+    unsigned_value_type select_extreme(const SV& sv, bool max_v);
+
+    /// Keep first cnt elements of the candidates
+    void keep_first(size_type cnt);
+
+    /// Translate result from the storage space (compressed vector)
+    void decompress(const SV& sv, bvector_type& bv_out);
+
+    /// Translate mask into the storage space of the vector
+    /// (rank space of a compressed vector)
+    const bvector_type* storage_mask(const SV& sv, const bvector_type* bv_mask);
+
+    /// NOT NULL elements (restricted by mask) in the storage space
+    void candidates(const SV& sv, const bvector_type* bv_mask,
+                    bvector_type& bv_out);
+
+    /// number of plains to process (plains above have no values)
+    static unsigned value_plains(const SV& sv);
+
+protected:
+    sparse_vector_aggregates(const sparse_vector_aggregates&) = delete;
+    void operator=(const sparse_vector_aggregates&) = delete;
+
+private:
+    bvector_type                       bv_cand_;  ///< MIN/MAX candidates
+    bvector_type                       bv_mask_;  ///< mask in rank space
+    bvector_type                       bv_tmp_;
+    bm::aggregator<bvector_type>       agg_;
+    bm::rank_compressor<bvector_type>  rank_compr_;
+};
+
+
 /*!
     \brief Integer set to set transformation (functional image in groups theory)
     https://en.wikipedia.org/wiki/Image_(mathematics)
@@ -651,7 +888,7 @@ void sparse_vector_scanner<SV>::find_zero(const SV&                  sv,
     if (sv.is_compressed())
     {
         bv_out.invert();
-        bv_out.set_range(sv.effective_size(), bm::id_max - 1, false);
+        bv_out.set_range(sv.effective_size(), bm::id_max32 - 1, false);
         decompress(sv, bv_out);
     }
     else
@@ -676,7 +913,7 @@ void sparse_vector_scanner<SV>::invert(const SV& sv, typename SV::bvector_type&
     if (bv_null) // correct result to only use not NULL elements
         bv_out &= *bv_null;
     else
-        bv_out.set_range(sv.size(), bm::id_max - 1, false);
+        bv_out.set_range(sv.size(), bm::id_max32 - 1, false);
 }
 
 //----------------------------------------------------------------------------
@@ -739,7 +976,10 @@ bool sparse_vector_scanner<SV>::find_first_eq(const SV&   sv,
     bool found = prepare_and_sub_aggregator(sv, value);
     if (!found)
         return found;
-    found = agg_.find_first_and_sub(idx);
+    typename bvector_type::size_type found_idx;
+    found = agg_.find_first_and_sub(found_idx);
+    if (found)
+        idx = bm::id_t(found_idx);
     agg_.reset();
     return found;
 }
@@ -748,8 +988,9 @@ bool sparse_vector_scanner<SV>::find_first_eq(const SV&   sv,
 
 template<typename SV>
 bool sparse_vector_scanner<SV>::prepare_and_sub_aggregator(const SV&   sv,
-                                           typename SV::value_type   value)
+                                           typename SV::value_type   val)
 {
+    unsigned_value_type value = value_coder_type::encode(val);
     unsigned char bits[sizeof(value) * 8];
     unsigned short bit_count_v = bm::bitscan(value, bits);
     BM_ASSERT(bit_count_v);
@@ -760,7 +1001,7 @@ bool sparse_vector_scanner<SV>::prepare_and_sub_aggregator(const SV&   sv,
     for (unsigned i = bit_count_v; i > 0; --i)
     {
         unsigned bit_idx = bits[i-1];
-        BM_ASSERT(value & (value_type(1) << bit_idx));
+        BM_ASSERT(value & (unsigned_value_type(1) << bit_idx));
         const bvector_type* bv = sv.get_plain(bit_idx);
         if (bv)
             agg_.add(bv);
@@ -774,7 +1015,7 @@ bool sparse_vector_scanner<SV>::prepare_and_sub_aggregator(const SV&   sv,
     for (unsigned i = 0; (i < sv_plains) && value; ++i)
     {
         bvector_type_const_ptr bv = sv.get_plain(i);
-        if (bv && !(value & (value_type(1) << i)))
+        if (bv && !(value & (unsigned_value_type(1) << i)))
             agg_.add(bv, 1); // agg to SUB group
     } // for i
     return true;
@@ -785,17 +1026,18 @@ bool sparse_vector_scanner<SV>::prepare_and_sub_aggregator(const SV&   sv,
 
 template<typename SV>
 void sparse_vector_scanner<SV>::find_eq_with_nulls_horizontal(const SV&  sv,
-    typename SV::value_type    value,
+    typename SV::value_type    val,
     typename SV::bvector_type& bv_out)
 {
     if (sv.empty())
         return; // nothing to do
 
-    if (!value)
+    if (!val)
     {
         find_zero(sv, bv_out);
         return;
     }
+    unsigned_value_type value = value_coder_type::encode(val);
 
     unsigned char bits[sizeof(value) * 8];
     unsigned short bit_count_v = bm::bitscan(value, bits);
@@ -829,7 +1071,7 @@ void sparse_vector_scanner<SV>::find_eq_with_nulls_horizontal(const SV&  sv,
     for (unsigned i = 0; (i < sv_plains) && value; ++i)
     {
         const bvector_type* bv_plain = sv.get_plain(i);
-        if (bv_plain && !(value & (value_type(1) << i)))
+        if (bv_plain && !(value & (unsigned_value_type(1) << i)))
             bv_out -= *bv_plain;
     }
 }
@@ -871,7 +1113,10 @@ bool sparse_vector_scanner<SV>::find_eq(const SV&                  sv,
     {
         bvector_type bv_zero;
         find_eq(sv, value, bv_zero);
-        bool found = bv_zero.find(pos);
+        typename bvector_type::size_type found_idx;
+        bool found = bv_zero.find(found_idx);
+        if (found)
+            pos = size_type(found_idx);
         return found;
     }
 
@@ -902,6 +1147,181 @@ void sparse_vector_scanner<SV>::find_nonzero(const SV& sv,
 
 //----------------------------------------------------------------------------
 
+template<typename SV>
+void sparse_vector_scanner<SV>::find_range(const SV&                  sv,
+                                           typename SV::value_type    from,
+                                           typename SV::value_type    to,
+                                           typename SV::bvector_type& bv_out,
+                                           const bvector_type*        bv_mask)
+{
+    if (from > to)
+    {
+        bv_out.clear();
+        return;
+    }
+    find_compare(sv, from, true, true, bv_out, bv_mask);
+    if (!bv_out.any())
+        return;
+
+    bvector_type bv_le;
+    typename bvector_type::mem_pool_guard mp_guard(pool_, bv_le);
+    find_compare(sv, to, false, true, bv_le, &bv_out); // LE restricted to GE
+    bv_out.swap(bv_le);
+}
+
+//----------------------------------------------------------------------------
+
+template<typename SV>
+void sparse_vector_scanner<SV>::find_compare(const SV&                  sv,
+                                             typename SV::value_type    val,
+                                             bool                       gt,
+                                             bool                       with_eq,
+                                             typename SV::bvector_type& bv_out,
+                                             const bvector_type*        bv_mask)
+{
+    bv_out.clear();
+    if (sv.empty())
+        return; // nothing to do
+
+    typename bvector_type::mem_pool_guard mp_guard;
+    mp_guard.assign_if_not_set(pool_, bv_out); // set algorithm-local memory pool to avoid heap contention
+
+    bvector_type bv_all, bv_eq, bv1;
+    typename bvector_type::mem_pool_guard mp_g1(pool_, bv_eq), mp_g2(pool_, bv1);
+
+    // the universe of the search: all NOT NULL elements (restricted by mask)
+    // compressed vector is searched in the rank space, mask is applied
+    // after decompression
+    //
+    bvector_type_const_ptr bv_and[3];
+    unsigned and_size = 0;
+    const bvector_type* bv_null = sv.get_null_bvector();
+    if (sv.is_compressed() || !bv_null)
+    {
+        bv_all.set_range(0, sv.effective_size() - 1);
+        bv_and[and_size++] = &bv_all;
+    }
+    else
+        bv_and[and_size++] = bv_null;
+    if (bv_mask && !sv.is_compressed())
+        bv_and[and_size++] = bv_mask;
+
+    const unsigned plains = sv.plains();
+    BM_ASSERT(plains <= sizeof(value_type) * 8);
+
+    unsigned_value_type value = value_coder_type::encode(val);
+    bvector_type_const_ptr bv_sub[sizeof(value_type) * 8];
+    unsigned sub_size = 0;
+    int plain_from = 0;
+    bool found = true;
+
+    // signed values: plain 0 is the sign, elements of the other sign
+    // go to the result as a whole, codes of negative values
+    // are compared in the reverse order
+    //
+    if (value_coder_type::is_signed)
+    {
+        plain_from = 1;
+        bvector_type_const_ptr bv_sign = sv.get_plain(0);
+        if (value & 1u) // negative value
+        {
+            if (gt) // GT includes all non-negative elements
+            {
+                bv_sub[0] = bv_sign;
+                agg_.combine_and_sub(bv_out, bv_and, and_size,
+                                     bv_sub, bv_sign ? 1u : 0u, false);
+            }
+            gt = !gt;
+            if (bv_sign)
+                bv_and[and_size++] = bv_sign;
+            else
+                found = false; // no negative elements
+        }
+        else
+        {
+            if (!gt && bv_sign) // LT includes all negative elements
+            {
+                bv_and[and_size] = bv_sign;
+                agg_.combine_and(bv_out, bv_and, and_size + 1);
+            }
+            if (bv_sign)
+                bv_sub[sub_size++] = bv_sign;
+        }
+    }
+    const unsigned sub_from = sub_size;
+
+    // leading run of 0 bits of the value: EQ is (universe SUB plains)
+    // GT is the rest of the universe, computed in one aggregator pass
+    //
+    int i = int(plains) - 1;
+    for (; i >= plain_from && !(value & (unsigned_value_type(1) << i)); --i)
+    {
+        bvector_type_const_ptr bv = sv.get_plain(unsigned(i));
+        if (bv)
+            bv_sub[sub_size++] = bv;
+    }
+    if (found)
+    {
+        found = agg_.combine_and_sub(bv_eq, bv_and, and_size,
+                                     bv_sub, sub_size, false);
+        if (gt && sub_size > sub_from)
+        {
+            agg_.combine_and_sub(bv1, bv_and, and_size,
+                                 bv_sub, sub_from, false);
+            bv1.bit_sub(bv_eq);
+            bv_out.bit_or(bv1);
+        }
+    }
+
+    // the rest of the plains, EQ shrinks at every step
+    //
+    for (; i >= plain_from && found; --i)
+    {
+        bvector_type_const_ptr bv = sv.get_plain(unsigned(i));
+        if (value & (unsigned_value_type(1) << i))
+        {
+            if (!gt) // LT |= EQ AND NOT plain
+            {
+                bv1 = bv_eq;
+                if (bv)
+                    bv1.bit_sub(*bv);
+                bv_out.bit_or(bv1);
+            }
+            if (!bv)
+            {
+                bv_eq.clear();
+                break;
+            }
+            bv_eq.bit_and(*bv);
+        }
+        else
+        {
+            if (!bv)
+                continue;
+            if (gt) // GT |= EQ AND plain
+            {
+                bv1 = bv_eq;
+                bv1.bit_and(*bv);
+                bv_out.bit_or(bv1);
+            }
+            bv_eq.bit_sub(*bv);
+        }
+        found = bv_eq.any();
+    } // for i
+
+    if (with_eq && found)
+        bv_out.bit_or(bv_eq);
+
+    if (sv.is_compressed())
+    {
+        decompress(sv, bv_out);
+        if (bv_mask)
+            bv_out.bit_and(*bv_mask);
+    }
+}
+
+//----------------------------------------------------------------------------
+
 template<typename SV>
 void sparse_vector_scanner<SV>::decompress(const SV&   sv,
                                            typename SV::bvector_type& bv_out)
@@ -917,6 +1337,393 @@ void sparse_vector_scanner<SV>::decompress(const SV&   sv,
 }
 
 
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+
+template<typename SV>
+unsigned sparse_vector_aggregates<SV>::value_plains(const SV& sv)
+{
+    unsigned plains = sv.effective_plains();
+    if (plains > sv.plains())
+        plains = sv.plains();
+    return plains;
+}
+
+//----------------------------------------------------------------------------
+
+template<typename SV>
+const typename SV::bvector_type*
+sparse_vector_aggregates<SV>::storage_mask(const SV& sv,
+                                           const bvector_type* bv_mask)
+{
+    if (!bv_mask || !sv.is_compressed())
+        return bv_mask;
+    const bvector_type* bv_non_null = sv.get_null_bvector();
+    BM_ASSERT(bv_non_null);
+    bv_tmp_ = *bv_mask;
+    bv_tmp_.bit_and(*bv_non_null); // rank compression needs a subset
+    rank_compr_.compress(bv_mask_, *bv_non_null, bv_tmp_);
+    return &bv_mask_;
+}
+
+//----------------------------------------------------------------------------
+
+template<typename SV>
+void sparse_vector_aggregates<SV>::candidates(const SV& sv,
+                                              const bvector_type* bv_mask,
+                                              bvector_type& bv_out)
+{
+    bv_out.clear();
+    if (sv.empty())
+        return;
+    bv_mask = storage_mask(sv, bv_mask);
+    const bvector_type* bv_null = sv.get_null_bvector();
+    if (sv.is_compressed() || !bv_null) // all elements of the storage
+    {
+        bv_out.set_range(0, sv.effective_size() - 1);
+        if (bv_mask)
+            bv_out.bit_and(*bv_mask);
+    }
+    else
+    if (bv_mask)
+    {
+        bvector_type_const_ptr bv_src[2] = { bv_null, bv_mask };
+        agg_.combine_and(bv_out, bv_src, 2);
+    }
+    else
+        bv_out = *bv_null;
+}
+
+//----------------------------------------------------------------------------
+
+template<typename SV>
+typename SV::size_type
+sparse_vector_aggregates<SV>::count(const SV& sv, const bvector_type* bv_mask)
+{
+    if (sv.empty())
+        return 0;
+    const bvector_type* bv_null = sv.get_null_bvector();
+    if (bv_null)
+        return bv_mask ? size_type(bm::count_and(*bv_null, *bv_mask))
+                       : size_type(bv_null->count());
+    size_type sz = sv.size();
+    return bv_mask ? bv_mask->count_range(0, sz - 1) : sz;
+}
+
+//----------------------------------------------------------------------------
+
+template<typename SV>
+typename sparse_vector_aggregates<SV>::sum_type
+sparse_vector_aggregates<SV>::sum(const SV& sv, const bvector_type* bv_mask)
+{
+    sum_type s = 0;
+    if (sv.empty())
+        return s;
+    // NULL elements have all bits 0, no need to exclude them
+    bv_mask = storage_mask(sv, bv_mask);
+    const unsigned plains = value_plains(sv);
+    unsigned i = 0;
+    const bvector_type* bv_sign = 0;
+    if (value_coder_type::is_signed)
+    {
+        // zig-zag: v = h for non-negative, v = -h-1 for negative elements
+        // (h - code without the sign plain)
+        i = 1;
+        bv_sign = sv.get_plain(0);
+        if (bv_sign)
+        {
+            if (bv_mask)
+            {
+                bvector_type_const_ptr bv_src[2] = { bv_sign, bv_mask };
+                agg_.combine_and(bv_cand_, bv_src, 2);
+                bv_sign = &bv_cand_;
+            }
+            s -= sum_type(bv_sign->count());
+        }
+    }
+    for (; i < plains; ++i)
+    {
+        const bvector_type* bv = sv.get_plain(i);
+        if (!bv)
+            continue;
+        sum_type cnt = bv_mask ? sum_type(bm::count_and(*bv, *bv_mask))
+                               : sum_type(bv->count());
+        if (bv_sign)
+            cnt -= 2 * sum_type(bm::count_and(*bv, *bv_sign));
+        s += cnt * (sum_type(1) << (i - unsigned(value_coder_type::is_signed)));
+    } // for i
+    return s;
+}
+
+//----------------------------------------------------------------------------
+
+template<typename SV>
+typename SV::unsigned_value_type
+sparse_vector_aggregates<SV>::select_extreme(const SV& sv, bool max_v)
+{
+    unsigned_value_type v = 0;
+    unsigned plain_from = 0;
+    if (value_coder_type::is_signed) // sign plain: negative values are less
+    {
+        plain_from = 1;
+        const bvector_type* bv = sv.get_plain(0);
+        if (bv)
+        {
+            bool neg = max_v ? !bm::any_sub(bv_cand_, *bv)
+                             : bm::any_and(bv_cand_, *bv);
+            if (neg)
+            {
+                bv_cand_.bit_and(*bv);
+                v = 1;
+                max_v = !max_v; // codes of negative values are reversed
+            }
+            else
+                bv_cand_.bit_sub(*bv);
+        }
+    }
+    // from the most significant plain: keep candidates with bit 1 (max)
+    // or bit 0 (min) if there are any
+    for (unsigned i = value_plains(sv); i > plain_from; --i)
+    {
+        const bvector_type* bv = sv.get_plain(i-1);
+        if (!bv)
+            continue;
+        const unsigned_value_type mask =
+                        unsigned_value_type(unsigned_value_type(1) << (i-1));
+        if (max_v)
+        {
+            if (bm::any_and(bv_cand_, *bv))
+            {
+                bv_cand_.bit_and(*bv);
+                v |= mask;
+            }
+        }
+        else
+        {
+            if (bm::any_sub(bv_cand_, *bv))
+                bv_cand_.bit_sub(*bv);
+            else
+                v |= mask;
+        }
+    } // for i
+    return v;
+}
+
+//----------------------------------------------------------------------------
+
+template<typename SV>
+bool sparse_vector_aggregates<SV>::min_value(const SV& sv, value_type& v,
+                                             const bvector_type* bv_mask)
+{
+    candidates(sv, bv_mask, bv_cand_);
+    if (!bv_cand_.any())
+        return false;
+    v = value_coder_type::decode(select_extreme(sv, false));
+    return true;
+}
+
+//----------------------------------------------------------------------------
+
+template<typename SV>
+bool sparse_vector_aggregates<SV>::max_value(const SV& sv, value_type& v,
+                                             const bvector_type* bv_mask)
+{
+    candidates(sv, bv_mask, bv_cand_);
+    if (!bv_cand_.any())
+        return false;
+    v = value_coder_type::decode(select_extreme(sv, true));
+    return true;
+}
+
+//----------------------------------------------------------------------------
+
+template<typename SV>
+bool sparse_vector_aggregates<SV>::avg(const SV& sv, double& avg,
+                                       const bvector_type* bv_mask)
+{
+    size_type cnt = count(sv, bv_mask);
+    if (!cnt)
+        return false;
+    avg = double(sum(sv, bv_mask)) / double(cnt);
+    return true;
+}
+
+//----------------------------------------------------------------------------
+
+template<typename SV>
+typename SV::value_type
+sparse_vector_aggregates<SV>::select_rank(const SV& sv,
+                                          size_type& cand_cnt, size_type& r,
+                                          bvector_type* bv_less,
+                                          bvector_type* bv_greater)
+{
+    BM_ASSERT(r < cand_cnt);
+    unsigned_value_type v = 0;
+    unsigned plain_from = 0;
+    bool reverse = false; // lower values have bit 1 (negative values)
+    if (value_coder_type::is_signed) // negative values come first
+    {
+        plain_from = 1;
+        const bvector_type* bv = sv.get_plain(0);
+        size_type cnt_neg = bv ? size_type(bm::count_and(bv_cand_, *bv)) : 0;
+        if (r < cnt_neg) // negative value: non-negative are greater
+        {
+            v = 1;
+            reverse = true;
+            if (cnt_neg != cand_cnt)
+            {
+                if (bv_greater)
+                {
+                    bv_tmp_ = bv_cand_;
+                    bv_tmp_.bit_sub(*bv);
+                    bv_greater->bit_or(bv_tmp_);
+                }
+                bv_cand_.bit_and(*bv);
+                cand_cnt = cnt_neg;
+            }
+        }
+        else
+        if (cnt_neg) // non-negative value: negative are less
+        {
+            if (bv_less)
+            {
+                bv_tmp_ = bv_cand_;
+                bv_tmp_.bit_and(*bv);
+                bv_less->bit_or(bv_tmp_);
+            }
+            bv_cand_.bit_sub(*bv);
+            r -= cnt_neg;
+            cand_cnt -= cnt_neg;
+        }
+    }
+    for (unsigned i = value_plains(sv); i > plain_from; --i)
+    {
+        const bvector_type* bv = sv.get_plain(i-1);
+        if (!bv)
+            continue;
+        size_type cnt0 = size_type(bm::count_sub(bv_cand_, *bv)); // bit 0
+        size_type cnt_lo = reverse ? cand_cnt - cnt0 : cnt0; // lower values
+        bool upper = (r >= cnt_lo);  // value is in the upper group
+        bool bit = (upper != reverse); // bit of the value (and its group)
+        if (bit)
+            v |= unsigned_value_type(unsigned_value_type(1) << (i-1));
+        size_type cnt = upper ? cand_cnt - cnt_lo : cnt_lo;
+        if (cnt == cand_cnt) // all candidates are in the group
+            continue;
+        // candidates of the other group are less or greater than the value
+        bvector_type* bv_other = upper ? bv_less : bv_greater;
+        if (bv_other)
+        {
+            bv_tmp_ = bv_cand_;
+            if (bit)
+                bv_tmp_.bit_sub(*bv);
+            else
+                bv_tmp_.bit_and(*bv);
+            bv_other->bit_or(bv_tmp_);
+        }
+        if (bit)
+            bv_cand_.bit_and(*bv);
+        else
+            bv_cand_.bit_sub(*bv);
+        if (upper)
+            r -= cnt_lo;
+        cand_cnt = cnt;
+    } // for i
+    return value_coder_type::decode(v);
+}
+
+//----------------------------------------------------------------------------
+
+template<typename SV>
+void sparse_vector_aggregates<SV>::keep_first(size_type cnt)
+{
+    typename bvector_type::size_type pos;
+    if (bv_cand_.find_rank(cnt, 0, pos) && pos < bm::id_max - 1)
+        bv_cand_.set_range(pos + 1, bm::id_max - 1, false);
+}
+
+//----------------------------------------------------------------------------
+
+template<typename SV>
+void sparse_vector_aggregates<SV>::decompress(const SV& sv,
+                                              bvector_type& bv_out)
+{
+    if (!sv.is_compressed())
+        return; // nothing to do
+    const bvector_type* bv_non_null = sv.get_null_bvector();
+    BM_ASSERT(bv_non_null);
+    rank_compr_.decompress(bv_tmp_, *bv_non_null, bv_out);
+    bv_out.swap(bv_tmp_);
+}
+
+//----------------------------------------------------------------------------
+
+template<typename SV>
+void sparse_vector_aggregates<SV>::find_top_k(const SV& sv, size_type k,
+                                              bvector_type& bv_out,
+                                              const bvector_type* bv_mask)
+{
+    bv_out.clear();
+    if (!k)
+        return;
+    candidates(sv, bv_mask, bv_cand_);
+    size_type cand_cnt = bv_cand_.count();
+    if (k < cand_cnt)
+    {
+        size_type r = cand_cnt - k; // rank of the K-th largest
+        select_rank(sv, cand_cnt, r, 0, &bv_out);
+        keep_first(cand_cnt - r);   // values equal to the K-th largest
+    }
+    bv_out.bit_or(bv_cand_);
+    decompress(sv, bv_out);
+}
+
+//----------------------------------------------------------------------------
+
+template<typename SV>
+void sparse_vector_aggregates<SV>::find_bottom_k(const SV& sv, size_type k,
+                                                 bvector_type& bv_out,
+                                                 const bvector_type* bv_mask)
+{
+    bv_out.clear();
+    if (!k)
+        return;
+    candidates(sv, bv_mask, bv_cand_);
+    size_type cand_cnt = bv_cand_.count();
+    if (k < cand_cnt)
+    {
+        size_type r = k - 1; // rank of the K-th smallest
+        select_rank(sv, cand_cnt, r, &bv_out, 0);
+        keep_first(r + 1);   // values equal to the K-th smallest
+    }
+    bv_out.bit_or(bv_cand_);
+    decompress(sv, bv_out);
+}
+
+//----------------------------------------------------------------------------
+
+template<typename SV>
+bool sparse_vector_aggregates<SV>::find_quantile(const SV& sv, double q,
+                                                 value_type& v,
+                                                 const bvector_type* bv_mask)
+{
+    candidates(sv, bv_mask, bv_cand_);
+    size_type cand_cnt = bv_cand_.count();
+    if (!cand_cnt)
+        return false;
+    if (q < 0.0)
+        q = 0.0;
+    if (q > 1.0)
+        q = 1.0;
+    size_type r = size_type(q * double(cand_cnt - 1));
+    if (r >= cand_cnt) // rounding
+        r = cand_cnt - 1;
+    v = select_rank(sv, cand_cnt, r, 0, 0);
+    return true;
+}
+
+
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
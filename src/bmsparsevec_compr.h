@@ -59,6 +59,8 @@ public:
     };
 
     typedef Val                                      value_type;
+    typedef typename SV::value_coder_type            value_coder_type;
+    typedef typename SV::unsigned_value_type         unsigned_value_type;
     typedef const value_type&                        const_reference;
     typedef bm::id_t                                 size_type;
     typedef SV                                       sparse_vector_type;
@@ -101,7 +103,7 @@ public:
 
     rsc_sparse_vector(bm::null_support null_able = bm::use_null,
                       allocation_policy_type ap = allocation_policy_type(),
-                      size_type bv_max_size = bm::id_max,
+                      size_type bv_max_size = bm::id_max32,
                       const allocator_type&   alloc  = allocator_type());
     ~rsc_sparse_vector();
     
@@ -597,8 +599,13 @@ void rsc_sparse_vector<Val, SV>::sync(bool force)
     bv_null->running_count_blocks(bv_blocks_ptr_); // compute popcount prefix list
     
     // sync the max-id
-    bool found = bv_null->find_reverse(max_id_);
-    if (!found)
+    typename bvector_type::size_type last;
+    bool found = bv_null->find_reverse(last);
+    if (found)
+    {
+        max_id_ = size_type(last);
+    }
+    else
     {
         BM_ASSERT(!bv_null->any());
         max_id_ = 0;
@@ -682,7 +689,8 @@ void rsc_sparse_vector<Val, SV>::optimize(bm::word_t*  temp_block,
     sv_.optimize(temp_block, opt_mode, (typename sparse_vector_type::statistics*)stat);
     if (stat)
     {
-        stat->memory_used += sizeof(rs_index_type);
+        if (bv_blocks_ptr_)
+            stat->memory_used += bv_blocks_ptr_->memory_used();
     }
 }
 
@@ -705,7 +713,8 @@ void rsc_sparse_vector<Val, SV>::calc_stat(
     sv_.calc_stat((typename sparse_vector_type::statistics*)st);
     if (st)
     {
-        st->memory_used += sizeof(rs_index_type);
+        if (bv_blocks_ptr_)
+            st->memory_used += bv_blocks_ptr_->memory_used();
     }
 }
 
@@ -727,11 +736,14 @@ rsc_sparse_vector<Val, SV>::find_rank(bm::id_t rank, bm::id_t& idx) const
     BM_ASSERT(rank);
 
     bool b;
+    typename bvector_type::size_type pos;
     const bvector_type* bv_null = get_null_bvector();
     if (in_sync())
-        b = bv_null->select(rank, idx, *bv_blocks_ptr_);
+        b = bv_null->select(rank, pos, *bv_blocks_ptr_);
     else
-        b = bv_null->find_rank(rank, 0, idx);
+        b = bv_null->find_rank(rank, 0, pos);
+    if (b)
+        idx = bm::id_t(pos);
     return b;
 }
 
@@ -755,9 +767,9 @@ rsc_sparse_vector<Val, SV>::decode(value_type* arr,
     if (idx_from >= this->size())
         return 0;
     
-    if (bm::id_max - size <= idx_from)
+    if (bm::id_max32 - size <= idx_from)
     {
-        size = bm::id_max - idx_from;
+        size = bm::id_max32 - idx_from;
     }
 
     const bvector_type* bv_null = sv_.get_null_bvector();
@@ -817,6 +829,8 @@ void rsc_sparse_vector<Val, SV>::construct_bv_blocks()
 template<class Val, class SV>
 void rsc_sparse_vector<Val, SV>::free_bv_blocks()
 {
+    if (bv_blocks_ptr_)
+        bv_blocks_ptr_->~rs_index_type();
     bm::aligned_free(bv_blocks_ptr_);
 }
 
@@ -132,6 +132,7 @@ protected:
  Header structure:
    BYTE+BYTE: Magic-signature 'BM'
    BYTE : Byte order ( 0 - Big Endian, 1 - Little Endian)
+          bit 0x80 set - signed (zig-zag coded) values
    BYTE : Number of Bit-vector plains (total)
    INT64: Vector size
    INT64: Offset of plain 0 from the header start (value 0 means plain is empty)
@@ -526,7 +527,10 @@ void sparse_vector_serializer<SV>::serialize(const SV&  sv,
     else
         enc.put_8('M');
     
-    enc.put_8((unsigned char)bo);  // byte order
+    unsigned char h3 = (unsigned char)bo;  // byte order
+    if (SV::value_coder_type::is_signed)
+        h3 |= 0x80u;
+    enc.put_8(h3);
     enc.put_8((unsigned char)plains); // number of plains
     enc.put_64(sv.size_internal());
     
@@ -576,8 +580,15 @@ void sparse_vector_deserializer<SV>::deserialize(SV& sv,
         #endif
     }
     
-    //unsigned char bv_bo =
-        dec.get_8();
+    unsigned char h3 = dec.get_8(); // byte order + signed flag
+    if (bool(h3 & 0x80u) != SV::value_coder_type::is_signed)
+    {
+        #ifndef BM_NO_STL
+            throw std::logic_error("Invalid serialization target (signedness)");
+        #else
+            BM_THROW(BM_ERR_SERIALFORMAT);
+        #endif
+    }
     unsigned plains = dec.get_8();
     unsigned sv_plains = sv.stored_plains();
     
@@ -401,6 +401,8 @@ void bvps_addr_resolver<BV>::construct_rs_index()
 template<class BV>
 void bvps_addr_resolver<BV>::free_rs_index()
 {
+    if (rs_index_)
+        rs_index_->~rs_index_type();
     bm::aligned_free(rs_index_);
     rs_index_ = 0;
 }
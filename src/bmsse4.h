@@ -410,6 +410,112 @@ bool sse4_is_all_one(const __m128i* BMRESTRICT block)
     return true;
 }
 
+/*!
+    @brief block shift right by 1
+    @return carry over bit
+    @ingroup SSE4
+*/
+inline
+bool sse42_shift_r1(__m128i* block, unsigned* empty_acc, unsigned co1)
+{
+    __m128i* block_end =
+        ( __m128i*)((bm::word_t*)(block) + bm::set_block_size);
+    __m128i mAcc = _mm_set1_epi32(0);
+    unsigned co2;
+
+    for (;block < block_end; block += 2)
+    {
+        __m128i m1A = _mm_load_si128(block);
+        __m128i m2A = _mm_load_si128(block+1);
+
+        __m128i m1CO = _mm_srli_epi32(m1A, 31);
+        __m128i m2CO = _mm_srli_epi32(m2A, 31);
+
+        co2 = unsigned(_mm_extract_epi32(m1CO, 3));
+
+        m1A = _mm_slli_epi32(m1A, 1); // (block[i] << 1u)
+        m2A = _mm_slli_epi32(m2A, 1);
+
+        // carry over moves to the next word
+        __m128i m1COshft = _mm_slli_si128 (m1CO, 4); // byte shift left by 1 int32
+        m1COshft = _mm_insert_epi32 (m1COshft, int(co1), 0);
+
+        co1 = co2;
+        co2 = unsigned(_mm_extract_epi32(m2CO, 3));
+
+        __m128i m2COshft = _mm_slli_si128 (m2CO, 4);
+        m2COshft = _mm_insert_epi32 (m2COshft, int(co1), 0);
+
+        m1A = _mm_or_si128(m1A, m1COshft); // block[i] |= co_flag
+        m2A = _mm_or_si128(m2A, m2COshft);
+
+        _mm_store_si128(block, m1A);
+        _mm_store_si128(block+1, m2A);
+
+        mAcc = _mm_or_si128(mAcc, m1A);
+        mAcc = _mm_or_si128(mAcc, m2A);
+
+        co1 = co2;
+    }
+    *empty_acc = !_mm_testz_si128(mAcc, mAcc);
+    return co1;
+}
+
+/*!
+    @brief block shift left by 1
+    @return carry over bit
+    @ingroup SSE4
+*/
+inline
+bool sse42_shift_l1(__m128i* block, unsigned* empty_acc, unsigned co1)
+{
+    const unsigned block_size = bm::set_block_size / 4; // in __m128i units
+    __m128i mAcc = _mm_set1_epi32(0);
+    __m128i mMask1 = _mm_set1_epi32(1);
+    unsigned co2;
+
+    for (int i = int(block_size) - 2; i >= 0; i -= 2)
+    {
+        __m128i m1A = _mm_load_si128(block+i+1);
+        __m128i m2A = _mm_load_si128(block+i);
+
+        __m128i m1CO = _mm_and_si128(m1A, mMask1);
+        __m128i m2CO = _mm_and_si128(m2A, mMask1);
+
+        co2 = unsigned(_mm_extract_epi32(m1CO, 0));
+
+        m1A = _mm_srli_epi32(m1A, 1); // (block[i] >> 1u)
+        m2A = _mm_srli_epi32(m2A, 1);
+
+        // carry over moves to the previous word
+        __m128i m1COshft = _mm_srli_si128 (m1CO, 4); // byte shift right by 1 int32
+        m1COshft = _mm_insert_epi32 (m1COshft, int(co1), 3);
+
+        co1 = co2;
+        co2 = unsigned(_mm_extract_epi32(m2CO, 0));
+
+        __m128i m2COshft = _mm_srli_si128 (m2CO, 4);
+        m2COshft = _mm_insert_epi32 (m2COshft, int(co1), 3);
+
+        m1COshft = _mm_slli_epi32(m1COshft, 31);
+        m2COshft = _mm_slli_epi32(m2COshft, 31);
+
+        m1A = _mm_or_si128(m1A, m1COshft); // block[i] |= co_flag
+        m2A = _mm_or_si128(m2A, m2COshft);
+
+        _mm_store_si128(block+i+1, m1A);
+        _mm_store_si128(block+i, m2A);
+
+        mAcc = _mm_or_si128(mAcc, m1A);
+        mAcc = _mm_or_si128(mAcc, m2A);
+
+        co1 = co2;
+    }
+    *empty_acc = !_mm_testz_si128(mAcc, mAcc);
+    return co1;
+}
+
+
 /*!
     @brief check if wave of pointers is all NULL
     @ingroup AVX2
@@ -910,6 +1016,12 @@ void sse4_bit_block_gather_scatter(unsigned* BMRESTRICT arr,
 #define VECT_LOWER_BOUND_SCAN_U32(arr, target, from, to) \
     sse4_lower_bound_scan_u32(arr, target, from, to)
 
+#define VECT_SHIFT_R1(b, acc, co) \
+    sse42_shift_r1((__m128i*)b, acc, co)
+
+#define VECT_SHIFT_L1(b, acc, co) \
+    sse42_shift_l1((__m128i*)b, acc, co)
+
 
 #ifdef __GNUG__
 #pragma GCC diagnostic pop
@@ -264,6 +264,26 @@ unsigned bit_scan_reverse32(unsigned value)
 #endif
 }
 
+/**
+    Number of trailing zeros of a non-zero 64-bit word
+    (does not need BMI1 TZCNT)
+*/
+inline
+unsigned count_trailing_zeros_u64(bm::id64_t w)
+{
+    BM_ASSERT(w);
+#if defined(__GNUG__)
+    return unsigned(__builtin_ctzll(w));
+#elif defined(_MSC_VER) && (defined(_M_AMD64) || defined(_M_X64))
+    unsigned long r;
+    _BitScanForward64(&r, w);
+    return unsigned(r);
+#else
+    unsigned lo = unsigned(w);
+    return lo ? bm::bit_scan_fwd(lo) : 32u + bm::bit_scan_fwd(unsigned(w >> 32));
+#endif
+}
+
 #ifdef __GNUG__
 #pragma GCC diagnostic pop
 #endif
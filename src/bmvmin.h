@@ -22,6 +22,7 @@ For more information please visit:  http://bitmagic.io
     \brief Mini bitset for testing and utility purposes (internal)
 */
 
+#include "bmdef.h"
 
 #ifdef _MSC_VER
 #pragma warning( push )
@@ -495,4 +496,6 @@ private:
 #pragma warning( pop )
 #endif
 
+#include "bmundef.h"
+
 #endif
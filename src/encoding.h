@@ -140,6 +140,7 @@ public:
     decoder_little_endian(const unsigned char* buf);
     bm::short_t get_16();
     bm::word_t get_32();
+    bm::id64_t get_64();
     void get_32(bm::word_t* w, unsigned count);
     bool get_32_OR(bm::word_t* w, unsigned count);
     void get_32_AND(bm::word_t* w, unsigned count);
@@ -1013,6 +1014,21 @@ bm::word_t decoder_little_endian::get_32()
     return a;
 }
 
+inline
+bm::id64_t decoder_little_endian::get_64()
+{
+    bm::id64_t a = ((bm::id64_t)buf_[0] << 56) +
+                   ((bm::id64_t)buf_[1] << 48) +
+                   ((bm::id64_t)buf_[2] << 40) +
+                   ((bm::id64_t)buf_[3] << 32) +
+                   ((bm::id64_t)buf_[4] << 24) +
+                   ((bm::id64_t)buf_[5] << 16) +
+                   ((bm::id64_t)buf_[6] << 8) +
+                   ((bm::id64_t)buf_[7]);
+    buf_+=sizeof(a);
+    return a;
+}
+
 inline
 void decoder_little_endian::get_32(bm::word_t* w, unsigned count)
 {
@@ -38,6 +38,8 @@ For more information please visit:  http://bitmagic.io
 #include <bm.h>
 #include <bmalgo.h>
 #include <bmaggregator.h>
+#include <bmaggcache.h>
+#include <bmexpr.h>
 #include <bmutil.h>
 #include <bmserial.h>
 #include <bmrandom.h>
@@ -49,6 +51,7 @@ For more information please visit:  http://bitmagic.io
 #include <bmsparsevec_util.h>
 #include <bmsparsevec_compr.h>
 #include <bmtimer.h>
+#include <bmparallel.h>
 
 using namespace bm;
 using namespace std;
@@ -60,6 +63,8 @@ using namespace std;
 #include <bmdbg.h>
 
 #include <vector>
+#include <algorithm>
+#include <iterator>
 
 
 #define POOL_SIZE 5000
@@ -344,6 +349,31 @@ typedef bm::bvector_mini<bm::block_allocator> bvect_mini;
 
 #endif
 
+static
+void CheckAllocationBalance()
+{
+#ifdef MEM_DEBUG
+    cout << "[--------------  Allocation digest -------------------]" << endl;
+    cout << "Number of BLOCK allocations = " <<  dbg_block_allocator::na_ << endl;
+    cout << "Number of PTR allocations = " <<  dbg_ptr_allocator::na_ << endl << endl;
+
+    if(dbg_block_allocator::balance() != 0)
+    {
+        cout << "ERROR! Block memory leak! " << endl;
+        cout << dbg_block_allocator::balance() << endl;
+        exit(1);
+    }
+
+    if(dbg_ptr_allocator::balance() != 0)
+    {
+        cout << "ERROR! Ptr memory leak! " << endl;
+        cout << dbg_ptr_allocator::balance() << endl;
+        exit(1);
+    }
+    cout << "[------------  Debug Allocation balance OK ----------]" << endl;
+#endif
+}
+
 typedef bm::sparse_vector<unsigned, bvect > sparse_vector_u32;
 typedef bm::sparse_vector<unsigned long long, bvect > sparse_vector_u64;
 typedef bm::rsc_sparse_vector<unsigned, sparse_vector_u32> rsc_sparse_vector_u32;
@@ -1218,7 +1248,7 @@ template<class T> void CheckCountGapRange(const T& vect,
 }
 
 template<typename T>
-bool FindRank(const T& bv, bm::id_t rank, bm::id_t from, bm::id_t& pos)
+bool FindRank(const T& bv, bm::id_t rank, bm::id_t from, typename T::size_type& pos)
 {
     assert(rank);
     bool res = false;
@@ -1241,7 +1271,7 @@ bool FindRank(const T& bv, bm::id_t rank, bm::id_t from, bm::id_t& pos)
         }
     } // for en
     
-    bm::id_t pos2 = *en2;
+    typename T::size_type pos2 = *en2;
     if (pos != pos2)
     {
         cerr << "FindRank enumerator::skip() failed: "
@@ -1257,7 +1287,7 @@ bool FindRank(const T& bv, bm::id_t rank, bm::id_t from, bm::id_t& pos)
 inline
 void CheckRangeCopy(const bvect& bv, unsigned from, unsigned to)
 {
-    bm::id_t f1, l1, f2, l2;
+    bvect::size_type f1, l1, f2, l2;
     
     bvect bv_cp(bv, from, to);
     bvect bv_cp2(bv, to, from); // swapped interval copy is legal
@@ -1374,7 +1404,7 @@ template<class T> void CheckCountRange(const T& vect,
         
         if (cnt1) // check if we can reverse the search (rank)
         {
-            unsigned pos, pos1;
+            bvect::size_type pos, pos1;
             pos = pos1 = 0;
             bool rf = vect.find_rank(cnt1, left, pos);
             bool rf1 = vect.find_rank(cnt1, left, pos1, bc_arr);
@@ -1388,7 +1418,7 @@ template<class T> void CheckCountRange(const T& vect,
                      << " range=" << range
                      << endl;
                 
-                unsigned pos2;
+                bvect::size_type pos2;
                 bool rf2 = FindRank(vect, cnt1, left, pos2);
                 if (!rf2)
                 {
@@ -1420,7 +1450,7 @@ template<class T> void CheckCountRange(const T& vect,
             
             if (left > 0)
             {
-                unsigned pos3;
+                bvect::size_type pos3;
                 T bv1(vect, left, bm::id_max-1);
                 std::unique_ptr<bvect::rs_index_type> bc_arr2(new bvect::rs_index_type);
                 bv1.running_count_blocks(bc_arr2.get());
@@ -1432,7 +1462,7 @@ template<class T> void CheckCountRange(const T& vect,
             
             if (right != pos)
             {
-                unsigned pos2;
+                bvect::size_type pos2;
                 bool rf2 = FindRank(vect, cnt1, left, pos2);
                 assert(rf2);
                 // check if we found zero-tail
@@ -1516,7 +1546,7 @@ void CompareEnumerators(const bvect::enumerator& en1, const bvect::enumerator& e
 // find last set bit by scan (not optimal)
 //
 static
-bool FindLastBit(const bvect& bv, bm::id_t& last_pos)
+bool FindLastBit(const bvect& bv, bvect::size_type& last_pos)
 {
     bvect::enumerator en = bv.first();
     if (!en.valid())
@@ -1567,8 +1597,8 @@ void CheckVectors(bvect_mini &bvect_min,
 
     // find_last check
     {
-        bm::id_t pos1 = 0;
-        bm::id_t pos2 = 0;
+        bvect::size_type pos1 = 0;
+        bvect::size_type pos2 = 0;
         bool last_found1 = FindLastBit(bvect_full, pos1);
         bool last_found2 = bvect_full.find_reverse(pos2);
         
@@ -1817,6 +1847,618 @@ void ShiftRotateTest()
     cout << "---------------------------- ShiftRotate test OK" << endl;
 }
 
+// reference insert: rebuild the vector by enumerator
+static
+void InsertReference(const bvect& bv, bvect& bv_ref,
+                     bvect::size_type n, bool value)
+{
+    bv_ref.clear();
+    bvect::enumerator en = bv.first();
+    for (; en.valid(); ++en)
+    {
+        bvect::size_type idx = *en;
+        bv_ref.set(idx >= n ? idx + 1 : idx);
+    }
+    if (value)
+        bv_ref.set(n);
+}
+
+// reference erase: rebuild the vector by enumerator
+static
+void EraseReference(const bvect& bv, bvect& bv_ref, bvect::size_type n)
+{
+    bv_ref.clear();
+    bvect::enumerator en = bv.first();
+    for (; en.valid(); ++en)
+    {
+        bvect::size_type idx = *en;
+        if (idx == n)
+            continue;
+        bv_ref.set(idx > n ? idx - 1 : idx);
+    }
+}
+
+static
+void CheckInsertErase(const bvect& bv, bvect::size_type n, bool value)
+{
+    bvect bv1(bv);
+    bvect bv_ref;
+    InsertReference(bv, bv_ref, n, value);
+    bv1.insert(n, value);
+    if (bv1.compare(bv_ref) != 0)
+    {
+        cerr << "Insert check failed at " << n << " value=" << value << endl;
+        exit(1);
+    }
+    bv1.erase(n);
+    if (bv1.compare(bv) != 0)
+    {
+        cerr << "Insert/Erase round trip failed at " << n << endl;
+        exit(1);
+    }
+
+    bvect bv2(bv);
+    EraseReference(bv, bv_ref, n);
+    bv2.erase(n);
+    if (bv2.compare(bv_ref) != 0)
+    {
+        cerr << "Erase check failed at " << n << endl;
+        exit(1);
+    }
+}
+
+static
+void BvectorShiftTest()
+{
+    cout << "---------------------------- Bvector insert/erase/shift test" << endl;
+
+    // block level functions
+    {
+        BM_DECLARE_TEMP_BLOCK(tb0)
+        BM_DECLARE_TEMP_BLOCK(tb1)
+        BM_DECLARE_TEMP_BLOCK(tb2)
+        bm::word_t* blk0 = tb0;
+        bm::word_t* blk1 = tb1;
+        bm::word_t* blk2 = tb2;
+        bm::gap_word_t gap_buf[bm::gap_max_buff_len + 8];
+
+        for (unsigned k = 0; k < 2000; ++k)
+        {
+            bm::bit_block_set(blk0, 0);
+            unsigned cnt = unsigned(rand()) % 300;
+            for (unsigned i = 0; i < cnt; ++i)
+            {
+                unsigned from = unsigned(rand()) % 65536;
+                unsigned len = unsigned(rand()) % 64;
+                for (unsigned b = from; b < 65536 && b < from + len; ++b)
+                    blk0[b >> 5] |= (1u << (b & 31));
+            }
+            if (k & 1)
+                blk0[bm::set_block_size - 1] |= (1u << 31);
+            if (k & 2)
+                blk0[0] |= 1u;
+
+            bm::word_t acc0, acc1;
+            unsigned co_in = k & 4 ? 1 : 0;
+
+            // shift right: reference vs unrolled/SIMD
+            bm::bit_block_copy(blk1, blk0);
+            bm::bit_block_copy(blk2, blk0);
+            bool co0 = bm::bit_block_shift_r1(blk1, &acc0, co_in);
+            bool co1 = bm::bit_block_shift_r1_unr(blk2, &acc1, co_in);
+            if (co0 != co1 || !acc0 != !acc1 ||
+                bm::bitcmp(blk1, blk2, bm::set_block_size) != 0)
+            {
+                cerr << "bit_block_shift_r1 check failed" << endl;
+                exit(1);
+            }
+
+            // shift left: reference vs unrolled/SIMD
+            bm::bit_block_copy(blk1, blk0);
+            bm::bit_block_copy(blk2, blk0);
+            co0 = bm::bit_block_shift_l1(blk1, &acc0, co_in);
+            co1 = bm::bit_block_shift_l1_unr(blk2, &acc1, co_in);
+            if (co0 != co1 || !acc0 != !acc1 ||
+                bm::bitcmp(blk1, blk2, bm::set_block_size) != 0)
+            {
+                cerr << "bit_block_shift_l1 check failed" << endl;
+                exit(1);
+            }
+
+            // GAP insert and erase vs bit-block insert and erase
+            unsigned pos = (k & 8) ? 0 : unsigned(rand()) % 65536;
+            for (unsigned op = 0; op < 2; ++op)
+            {
+                *gap_buf = 0;
+                unsigned gap_len =
+                   bm::bit_convert_to_gap(gap_buf, blk0,
+                                          bm::gap_max_bits, bm::gap_max_buff_len);
+                if (!gap_len)
+                    break; // too many GAPs
+                *gap_buf = bm::gap_word_t(*gap_buf | (bm::gap_max_level << 1));
+
+                bm::bit_block_copy(blk1, blk0);
+                unsigned new_len;
+                if (op == 0)
+                {
+                    co0 = bm::bit_block_insert(blk1, pos, bool(co_in));
+                    co1 = bm::gap_insert(gap_buf, pos, co_in, &new_len);
+                }
+                else
+                {
+                    bm::bit_block_erase(blk1, pos, bool(co_in));
+                    bm::gap_erase(gap_buf, pos, co_in, &new_len);
+                    co0 = co1;
+                }
+                bm::gap_convert_to_bitset(blk2, gap_buf);
+                if (co0 != co1 || bm::bitcmp(blk1, blk2, bm::set_block_size) != 0 ||
+                    new_len != unsigned(*gap_buf >> 3))
+                {
+                    cerr << "GAP insert/erase check failed op=" << op
+                         << " pos=" << pos << endl;
+                    exit(1);
+                }
+            }
+            // bit-block insert vs scalar reference
+            bm::bit_block_copy(blk1, blk0);
+            co0 = bm::bit_block_insert(blk1, pos, bool(co_in));
+            if (co0 != bool(blk0[bm::set_block_size - 1] >> 31))
+            {
+                cerr << "bit_block_insert carry over check failed" << endl;
+                exit(1);
+            }
+            for (unsigned b = 0; b < 65536; ++b)
+            {
+                bool v1 = (blk1[b >> 5] >> (b & 31)) & 1;
+                bool v0;
+                if (b < pos)
+                    v0 = (blk0[b >> 5] >> (b & 31)) & 1;
+                else if (b == pos)
+                    v0 = bool(co_in);
+                else
+                    v0 = (blk0[(b-1) >> 5] >> ((b-1) & 31)) & 1;
+                if (v0 != v1)
+                {
+                    cerr << "bit_block_insert check failed at " << b << endl;
+                    exit(1);
+                }
+            }
+        } // for k
+    }
+
+    // bvector level
+    {
+        bvect bv;
+        CheckInsertErase(bv, 0, true);
+        CheckInsertErase(bv, 100000, true);
+        CheckInsertErase(bv, 100000, false);
+    }
+    {
+        bvect bv;
+        bv.set(65535);
+        bv.set(65536 * 2 - 1);
+        bv.set(65536 * 3);
+        bv.set(65536 * 256 - 1);  // sub-block boundary
+        bv.set(65536 * 256 * 3);  // next sub-block after an empty one
+        bv.set(bm::id_max - 2);   // last addressable bit after insert
+        bvect::size_type test_pos[] =
+            { 0, 1, 65535, 65536, 65536 * 2, 65536 * 256 - 1, 65536 * 256,
+              65536 * 256 * 3, bm::id_max - 2 };
+        for (unsigned i = 0; i < sizeof(test_pos)/sizeof(test_pos[0]); ++i)
+        {
+            CheckInsertErase(bv, test_pos[i], true);
+            CheckInsertErase(bv, test_pos[i], false);
+        }
+    }
+    {
+        bvect bv(bm::BM_GAP);
+        bv.set_range(100, 65536 * 2);           // FULL block in between
+        bv.set_range(65536 * 5, 65536 * 7 - 1); // FULL blocks
+        bv.set_range(65536 * 9 - 10, 65536 * 9 + 10);
+        for (unsigned i = 0; i < 1000; ++i)
+            bv.set(65536 * 12 + i * 3);
+        bvect bv_opt(bv);
+        bv_opt.optimize();
+        for (unsigned i = 0; i < 200; ++i)
+        {
+            bvect::size_type pos = unsigned(rand()) % (65536 * 13);
+            CheckInsertErase(bv, pos, bool(i & 1));
+            CheckInsertErase(bv_opt, pos, bool(i & 1));
+        }
+        CheckInsertErase(bv, 65536 * 5, false);
+        CheckInsertErase(bv, 65536 * 5, true);
+        CheckInsertErase(bv_opt, 65536 * 7 - 1, false);
+    }
+
+    // shift_right/shift_left as repeated operations
+    {
+        bvect bv;
+        bv.set(0);
+        bv.set(65535);
+        bv.set_range(65536 * 3, 65536 * 4 - 1);
+        bvect bv_c(bv);
+        for (unsigned i = 0; i < 70000; ++i)
+        {
+            bool co = bv.shift_right();
+            if (co)
+            {
+                cerr << "shift_right() unexpected carry over" << endl;
+                exit(1);
+            }
+        }
+        if (bv.count() != bv_c.count() || !bv.test(70000) ||
+            !bv.test(65535 + 70000) || bv.test(0))
+        {
+            cerr << "shift_right() check failed" << endl;
+            exit(1);
+        }
+        for (unsigned i = 0; i < 70000; ++i)
+        {
+            bool co = bv.shift_left();
+            if (co)
+            {
+                cerr << "shift_left() unexpected carry over" << endl;
+                exit(1);
+            }
+        }
+        if (bv.compare(bv_c) != 0)
+        {
+            cerr << "shift_left() check failed" << endl;
+            exit(1);
+        }
+        bool co = bv.shift_left();
+        if (!co || bv.test(0) || !bv.test(65534))
+        {
+            cerr << "shift_left() carry over check failed" << endl;
+            exit(1);
+        }
+    }
+
+    // carry over at the end of the addressable range
+    {
+        bvect bv;
+        bv.set(bm::id_max - 1);
+        bv.set(5);
+        bool co = bv.shift_right();
+        bvect::size_type last = 0;
+        bv.find_reverse(last);
+        if (!co || bv.count() != 1 || !bv.test(6) || last != 6)
+        {
+            cerr << "shift_right() carry over at id_max check failed" << endl;
+            exit(1);
+        }
+        bv.set(bm::id_max - 1);
+        co = bv.insert(100, true);
+        if (!co || bv.count() != 2 || !bv.test(100) || !bv.test(6) ||
+            bv.test(bm::id_max - 1))
+        {
+            cerr << "insert() carry over at id_max check failed" << endl;
+            exit(1);
+        }
+        co = bv.insert(100, true);
+        if (co || bv.count() != 3)
+        {
+            cerr << "insert() unexpected carry over at id_max" << endl;
+            exit(1);
+        }
+    }
+    {
+        bvect bv;
+        bool co;
+#ifndef BM64ADDR // full 48-bit vector is too large to allocate
+        bv.set(); // FULL blocks up to the last one
+        bvect::size_type cnt = bv.count();
+        co = bv.shift_right();
+        if (!co || bv.test(0) || !bv.test(bm::id_max - 1) ||
+            bv.count() != cnt - 1)
+        {
+            cerr << "shift_right() of FULL last block check failed" << endl;
+            exit(1);
+        }
+        bv.clear();
+#endif
+        bv.set_range(bm::id_max - 65536 * 3, bm::id_max - 1);
+        bv.optimize();
+        co = bv.shift_right();
+        if (!co || bv.count() != 65536 * 3 - 1 ||
+            bv.test(bm::id_max - 65536 * 3) || !bv.test(bm::id_max - 1))
+        {
+            cerr << "shift_right() of the last blocks check failed" << endl;
+            exit(1);
+        }
+    }
+
+    cout << "---------------------------- Bvector insert/erase/shift test OK" << endl;
+}
+
+// fill the vector with a mix of bit, GAP and FULL blocks
+// in top level slots [0, top_slots) picked at random
+template<class BV>
+void GenerateMixedBlocksVector(BV& bv, unsigned slots, unsigned top_slots)
+{
+    for (unsigned k = 0; k < slots; ++k)
+    {
+        unsigned top = unsigned(rand()) % top_slots;
+        bm::id_t from = bm::id_t(top) * bm::set_array_size * bm::gap_max_bits +
+                        (unsigned(rand()) % bm::set_array_size) * bm::gap_max_bits;
+        switch (k % 3)
+        {
+        case 0: // bit-blocks
+            for (unsigned i = 0; i < 65536 * 2; i += 1 + unsigned(rand()) % 7)
+                bv.set(from + i);
+            break;
+        case 1: // GAP blocks
+            for (unsigned i = 0; i < 65536 * 2; i += 300)
+                bv.set_range(from + i, from + i + unsigned(rand()) % 64);
+            break;
+        default: // FULL blocks
+            bv.set_range(from, from + unsigned(rand()) % (65536 * 4));
+            break;
+        }
+    }
+}
+
+static
+void CheckCopyOnWrite(const bvect& bv, const bvect& bv_ref, const char* msg)
+{
+    if (bv.compare(bv_ref) != 0 || bv.count() != bv_ref.count() ||
+        bv.size() != bv_ref.size())
+    {
+        cerr << "Copy-on-write check failed: " << msg << endl;
+        exit(1);
+    }
+}
+
+// apply the same modification to a shared copy and to a deep copy
+static
+void CopyOnWriteModify(bvect& bv, unsigned op, const bvect& bv_arg,
+                       bvect::size_type idx)
+{
+    switch (op)
+    {
+    case 0:  bv.set(idx); break;
+    case 1:  bv.set(idx, false); break;
+    case 2:  bv.flip(idx); break;
+    case 3:  bv.set_range(idx, idx + 200000); break;
+    case 4:  bv.set_range(idx, idx + 200000, false); break;
+    case 5:  bv.invert(); break;
+    case 6:  bv.optimize(); break;
+    case 7:  bv.bit_or(bv_arg); break;
+    case 8:  bv.bit_and(bv_arg); break;
+    case 9:  bv.bit_sub(bv_arg); break;
+    case 10: bv.bit_xor(bv_arg); break;
+    case 11: bv.insert(idx, true); break;
+    case 12: bv.erase(idx); break;
+    case 13: bv.extract_next(idx); break;
+    case 14: bv.clear(); break;
+    case 15: bv.resize(idx); break;
+    case 16: bv.set_gap_levels(bm::gap_len_table_min<true>::_len); break;
+    case 17:
+        {
+            bvect::size_type arr[3] = { idx, idx + 10, idx + 70000 };
+            bm::combine_or(bv, arr, arr + 3);
+        }
+        break;
+    case 18:
+        {
+            BM_DECLARE_TEMP_BLOCK(tb)
+            struct bvect::statistics st;
+            bv_arg.calc_stat(&st);
+            std::vector<unsigned char> buf(st.max_serialize_mem);
+            bm::serialize(bv_arg, buf.data(), tb);
+            bm::deserialize(bv, buf.data());
+        }
+        break;
+    default:
+        assert(0);
+    }
+}
+
+static
+void CopyOnWriteTest()
+{
+    cout << "---------------------------- Bvector copy-on-write test" << endl;
+
+    const unsigned op_count = 19;
+    for (unsigned pass = 0; pass < 6; ++pass)
+    {
+        bvect bv, bv_arg;
+        GenerateMixedBlocksVector(bv, 24, 16);
+        GenerateMixedBlocksVector(bv_arg, 12, 16);
+        if (pass & 1)
+        {
+            bv.optimize();
+            bv_arg.optimize();
+        }
+        bvect bv_ref(bv, 0, bm::id_max - 1); // range copy is a deep copy
+
+        for (unsigned op = 0; op < op_count; ++op)
+        {
+            bvect::size_type idx = bvect::size_type(rand()) %
+                                   (16 * bm::set_array_size * bm::gap_max_bits);
+            bvect bv1(bv);
+            bvect bv2;
+            bv2 = bv;
+            bvect bv1_ref(bv_ref, 0, bm::id_max - 1);
+
+            CopyOnWriteModify(bv1, op, bv_arg, idx);
+            CopyOnWriteModify(bv1_ref, op, bv_arg, idx);
+            CheckCopyOnWrite(bv1, bv1_ref, "modified copy");
+            CheckCopyOnWrite(bv, bv_ref, "source vector");
+            CheckCopyOnWrite(bv2, bv_ref, "second copy");
+
+            // modify the source, copies must stay intact
+            bvect bv3(bv2);
+            CopyOnWriteModify(bv2, op_count - 1 - op, bv1, idx);
+            CheckCopyOnWrite(bv3, bv_ref, "copy of a modified source");
+
+            // operations between vectors sharing blocks
+            bvect bv4(bv);
+            bv4.bit_and(bv);
+            CheckCopyOnWrite(bv4, bv_ref, "AND with itself (shared)");
+            bv4.bit_or(bv);
+            CheckCopyOnWrite(bv4, bv_ref, "OR with itself (shared)");
+            bv4.bit_sub(bv);
+            if (bv4.any())
+            {
+                cerr << "Copy-on-write SUB of shared vectors failed" << endl;
+                exit(1);
+            }
+        } // for op
+        CheckCopyOnWrite(bv, bv_ref, "source vector at exit");
+    } // for pass
+
+    // copy chains, out of order destruction
+    {
+        bvect* bv0 = new bvect;
+        GenerateMixedBlocksVector(*bv0, 16, 16);
+        bvect bv_ref(*bv0, 0, bm::id_max - 1);
+        bvect* bv1 = new bvect(*bv0);
+        bvect* bv2 = new bvect(*bv1);
+        delete bv0;
+        bv1->set(10);
+        CheckCopyOnWrite(*bv2, bv_ref, "chain copy");
+        delete bv1;
+        CheckCopyOnWrite(*bv2, bv_ref, "chain copy after delete");
+        delete bv2;
+    }
+
+    cout << "---------------------------- Bvector copy-on-write test OK" << endl;
+}
+
+static
+void FreezeTest()
+{
+    cout << "---------------------------- Bvector freeze test" << endl;
+
+    for (unsigned pass = 0; pass < 4; ++pass)
+    {
+        bvect bv, bv_arg;
+        GenerateMixedBlocksVector(bv, 24, 16);
+        GenerateMixedBlocksVector(bv_arg, 12, 16);
+        if (pass & 1)
+            bv.optimize();
+        bvect bv_ref(bv, 0, bm::id_max - 1);
+
+        bv.freeze();
+        if (!bv.is_frozen() || bv_ref.is_frozen())
+        {
+            cerr << "freeze() state check failed" << endl;
+            exit(1);
+        }
+        // optimize() keeps the arena layout
+        bv.optimize();
+        {
+            const bvect::blocks_manager_type& bman = bv.get_blocks_manager();
+            for (unsigned i = 0; i < bman.top_block_size(); ++i)
+            {
+                if (bman.get_topblock(i) && !bman.is_subblock_shared(i))
+                {
+                    cerr << "optimize() unpacked frozen vector" << endl;
+                    exit(1);
+                }
+            }
+        }
+        CheckCopyOnWrite(bv, bv_ref, "frozen vector");
+
+        // const operations on the frozen vector
+        {
+            bvect::enumerator en = bv.first();
+            bvect::enumerator en_ref = bv_ref.first();
+            for (; en.valid(); ++en, ++en_ref)
+            {
+                if (!en_ref.valid() || *en != *en_ref || !bv.test(*en))
+                {
+                    cerr << "Frozen vector enumerator check failed" << endl;
+                    exit(1);
+                }
+            }
+            if (en_ref.valid())
+            {
+                cerr << "Frozen vector enumerator end check failed" << endl;
+                exit(1);
+            }
+            if (bv.count_range(100, 1000000) != bv_ref.count_range(100, 1000000))
+            {
+                cerr << "Frozen vector count_range check failed" << endl;
+                exit(1);
+            }
+        }
+
+        // frozen vector as an aggregator input
+        {
+            bvect bv_agg;
+            bvect bv_control(bv_ref);
+            bv_control |= bv_arg;
+            bm::aggregator<bvect> agg;
+            bvect* agg_list[2] = { &bv, &bv_arg };
+            agg.combine_or(bv_agg, agg_list, 2);
+            CheckCopyOnWrite(bv_agg, bv_control, "aggregator OR");
+        }
+
+        // serialization round trip and counting operation deserialization
+        {
+            BM_DECLARE_TEMP_BLOCK(tb)
+            struct bvect::statistics st;
+            bv.calc_stat(&st);
+            std::vector<unsigned char> buf(st.max_serialize_mem);
+            size_t slen = bm::serialize(bv, buf.data(), tb);
+            buf.resize(slen);
+            bvect bv_s;
+            bm::deserialize(bv_s, buf.data());
+            CheckCopyOnWrite(bv_s, bv_ref, "serialization of frozen vector");
+
+            bv_arg.calc_stat(&st);
+            std::vector<unsigned char> buf_arg(st.max_serialize_mem);
+            bm::serialize(bv_arg, buf_arg.data(), tb);
+            bvect::size_type cnt =
+                operation_deserializer<bvect>::deserialize(bv,
+                                                           buf_arg.data(),
+                                                           0,
+                                                           set_COUNT_AND);
+            if (cnt != bm::count_and(bv_ref, bv_arg))
+            {
+                cerr << "Frozen vector COUNT_AND deserialization failed" << endl;
+                exit(1);
+            }
+            CheckCopyOnWrite(bv, bv_ref, "frozen vector after COUNT_AND");
+        }
+
+        // modifications copy blocks out of the arena
+        {
+            bvect bv1(bv);
+            bvect bv1_ref(bv_ref, 0, bm::id_max - 1);
+            for (unsigned op = 0; op < 19; ++op)
+            {
+                bvect::size_type idx = bvect::size_type(rand()) %
+                                   (16 * bm::set_array_size * bm::gap_max_bits);
+                CopyOnWriteModify(bv1, op, bv_arg, idx);
+                CopyOnWriteModify(bv1_ref, op, bv_arg, idx);
+                CheckCopyOnWrite(bv1, bv1_ref, "modified frozen copy");
+                CheckCopyOnWrite(bv, bv_ref, "frozen source vector");
+            }
+            bv1.freeze(); // re-freeze
+            CheckCopyOnWrite(bv1, bv1_ref, "re-frozen vector");
+            bv1.freeze();
+            CheckCopyOnWrite(bv1, bv1_ref, "frozen twice");
+        }
+
+        // frozen arena outlives its first owner
+        {
+            bvect* bv0 = new bvect(bv);
+            bv.set(10, !bv.test(10));
+            bv.flip(10);
+            CheckCopyOnWrite(bv, bv_ref, "frozen vector modified back");
+            bvect bv2(*bv0);
+            bv.clear(true);
+            delete bv0;
+            CheckCopyOnWrite(bv2, bv_ref, "copy of a released frozen vector");
+        }
+    } // for pass
+
+    cout << "---------------------------- Bvector freeze test OK" << endl;
+}
+
 static
 void EmptyBVTest()
 {
@@ -2082,7 +2724,7 @@ void BasicFunctionalityTest()
         
         bvect_full.running_count_blocks(&bc_arr);
         
-        bm::id_t pos1, pos2, pos3, pos4;
+        bvect::size_type pos1, pos2, pos3, pos4;
         auto rf1 = FindRank(bvect_full, i+1, 0, pos1);
         auto rf2 = bvect_full.find_rank(i+1, 0, pos2);
         auto rf3 = bvect_full.find_rank(i+1, 0, pos3);
@@ -2113,7 +2755,7 @@ void BasicFunctionalityTest()
 
     for (i = 0; i < ITERATIONS; ++i)
     {
-        bm::id_t pos1, pos2, pos3, pos4;
+        bvect::size_type pos1, pos2, pos3, pos4;
         auto rf1 = FindRank(bvect_full1, i+1, 0, pos1);
         auto rf2 = bvect_full1.find_rank(i+1, 0, pos2);
         auto rf3 = bvect_full1.find_rank(i+1, 0, pos3);
@@ -2279,7 +2921,7 @@ void RankFindTest()
     bv1.running_count_blocks(&bc_arr1);
 
     bool rf1, rf2, rf3;
-    bm::id_t pos, pos1;
+    bvect::size_type pos, pos1;
     rf1 = bv1.find_rank(1, 20, pos);
     rf3 = bv1.find_rank(1, 20, pos1, bc_arr1);
     assert(rf1);
@@ -2312,7 +2954,7 @@ void RankFindTest()
         for (unsigned i = 0; i < max_size; ++i)
         {
             bool rf1, rf3;
-            bm::id_t pos, pos1;
+            bvect::size_type pos, pos1;
             
             rf1 = bv1.find_rank(0, i, pos);
             rf3 = bv1.find_rank(0, i, pos1, bc_arr1);
@@ -2436,7 +3078,7 @@ void TestRandomSubset(const bvect& bv, bm::random_subset<bvect>& rsub)
         {
             printf("\nRandom subset failed! sample_count = %u result_count=%u\n", 
                    sample_count,
-                   bv_subset.count());
+                   unsigned(bv_subset.count()));
             exit(1);
         }
         {
@@ -3238,18 +3880,581 @@ void OrOperationsTest()
 
 
 static
-void SubOperationsTest()
+void CheckBulkSet(const bvect& bv_base, const std::vector<bvect::size_type>& ids,
+                  bm::sort_order so)
 {
-    assert(ITERATIONS < BITVECT_SIZE);
+    bvect bv(bv_base);
+    bvect bv_control(bv_base, 0, bm::id_max - 1);
+    for (size_t i = 0; i < ids.size(); ++i)
+        bv_control.set_bit(ids[i]);
+    bv.set(ids.data(), bvect::size_type(ids.size()), so);
+    if (bv.compare(bv_control) != 0 || bv.count() != bv_control.count())
+    {
+        cerr << "Bulk set() failed, sort order=" << so << endl;
+        exit(1);
+    }
+    CheckCopyOnWrite(bv_base, bvect(bv_base, 0, bm::id_max - 1),
+                     "bulk set() source");
+}
 
-    cout << "----------------------------------- SubOperationTest" << endl;
+static
+void BulkSetTest()
+{
+    cout << "---------------------------- Bulk set() test" << endl;
 
     {
+        bvect bv;
+        bvect::size_type ids[] = { 0, 1, 2, 3, 10, 11, 65535, 65536, 200000 };
+        bv.set(ids, sizeof(ids)/sizeof(ids[0]), bm::BM_SORTED);
+        assert(bv.count() == sizeof(ids)/sizeof(ids[0]));
+        for (unsigned i = 0; i < sizeof(ids)/sizeof(ids[0]); ++i)
+            assert(bv.test(ids[i]));
+        // few runs per block: GAP blocks are created
+        struct bvect::statistics st;
+        bv.calc_stat(&st);
+        assert(st.gap_blocks == 3 && st.bit_blocks == 0);
 
-    bvect_mini   bvect_min1(256);
-    bvect_mini   bvect_min2(256);
-    bvect        bvect_full1;
-    bvect        bvect_full2;
+        bvect bv1(10); // vector grows to fit the ids
+        bv1.set(ids, sizeof(ids)/sizeof(ids[0]), bm::BM_UNSORTED);
+        assert(bv1.size() == 200001);
+        assert(bv1.compare(bv) == 0);
+    }
+
+    for (unsigned pass = 0; pass < 4; ++pass)
+    {
+        bvect bv_base;
+        if (pass & 1)
+        {
+            GenerateMixedBlocksVector(bv_base, 24, 16);
+            if (pass & 2)
+                bv_base.optimize();
+        }
+        std::vector<bvect::size_type> ids;
+        
+        // dense sorted runs
+        for (bvect::size_type i = 0; i < 5000000; i += 1 + unsigned(rand()) % 3)
+            ids.push_back(i);
+        CheckBulkSet(bv_base, ids, bm::BM_SORTED);
+        CheckBulkSet(bv_base, ids, bm::BM_UNKNOWN);
+        
+        // sparse sorted with duplicates
+        ids.resize(0);
+        for (bvect::size_type i = 0; i < 20000000; i += unsigned(rand()) % 1000)
+            ids.push_back(i);
+        CheckBulkSet(bv_base, ids, bm::BM_SORTED);
+        
+        // runs of random length
+        ids.resize(0);
+        for (bvect::size_type i = 0; i < 10000000; i += unsigned(rand()) % 5000)
+        {
+            unsigned len = unsigned(rand()) % 300;
+            for (unsigned k = 0; k < len; ++k)
+                ids.push_back(i++);
+        }
+        CheckBulkSet(bv_base, ids, bm::BM_SORTED);
+        
+        // unsorted
+        for (size_t i = ids.size(); i > 1; --i)
+        {
+            size_t j = size_t(rand()) % i;
+            bvect::size_type tmp = ids[i-1]; ids[i-1] = ids[j]; ids[j] = tmp;
+        }
+        CheckBulkSet(bv_base, ids, bm::BM_UNSORTED);
+        CheckBulkSet(bv_base, ids, bm::BM_UNKNOWN);
+    } // for pass
+
+    cout << "---------------------------- Bulk set() test OK" << endl;
+}
+
+static
+void CheckTestMany(const bvect& bv, const std::vector<bvect::size_type>& ids,
+                   bm::sort_order so)
+{
+    bvect::size_type sz = bvect::size_type(ids.size());
+    std::vector<unsigned char> flags(ids.size() + 1, 7);
+    std::vector<bvect::size_type> subset(ids.size() + 1);
+    
+    bvect::size_type cnt = bv.test_many(ids.data(), sz, flags.data(), so);
+    bvect::size_type subset_size =
+                        bv.test_subset(ids.data(), sz, subset.data(), so);
+    bvect::size_type cnt_control = 0;
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        bool v = ids[i] < bv.size() && bv.test(ids[i]);
+        if (flags[i] != v)
+        {
+            cerr << "test_many() failed at id=" << ids[i]
+                 << " sort order=" << so << endl;
+            exit(1);
+        }
+        if (v)
+        {
+            assert(subset[cnt_control] == ids[i]);
+            ++cnt_control;
+        }
+    }
+    assert(flags[ids.size()] == 7);
+    assert(cnt == cnt_control);
+    assert(subset_size == cnt_control);
+}
+
+static
+void TestManyTest()
+{
+    cout << "---------------------------- test_many() test" << endl;
+
+    {
+        bvect bv { 1, 10, 65535, 65536, 200000 };
+        bvect::size_type ids[] = { 0, 1, 2, 10, 65535, 65536, 100000, 200000 };
+        const unsigned ids_size = sizeof(ids)/sizeof(ids[0]);
+        unsigned char flags[ids_size];
+        bvect::size_type subset[ids_size];
+        
+        bvect::size_type cnt = bv.test_many(ids, ids_size, flags);
+        assert(cnt == 5);
+        assert(!flags[0] && flags[1] && !flags[2] && flags[3]);
+        assert(flags[4] && flags[5] && !flags[6] && flags[7]);
+        cnt = bv.test_subset(ids, ids_size, subset, bm::BM_SORTED);
+        assert(cnt == 5);
+        assert(subset[0] == 1 && subset[4] == 200000);
+        
+        bvect bv_empty;
+        cnt = bv_empty.test_many(ids, ids_size, flags);
+        assert(cnt == 0 && !flags[0] && !flags[7]);
+        
+        bvect bv_short(100); // ids past the size are reported as 0
+        bv_short.set_range(0, 99);
+        cnt = bv_short.test_many(ids, ids_size, flags);
+        assert(cnt == 4 && flags[3] && !flags[4] && !flags[7]);
+    }
+
+    for (unsigned pass = 0; pass < 2; ++pass)
+    {
+        bvect bv;
+        GenerateMixedBlocksVector(bv, 24, 16);
+        if (pass)
+        {
+            bv.set_range(100000, 400000); // full blocks
+            bv.optimize();
+        }
+        std::vector<bvect::size_type> ids;
+        
+        // dense sorted
+        for (bvect::size_type i = 0; i < 3000000; i += 1 + unsigned(rand()) % 7)
+            ids.push_back(i);
+        CheckTestMany(bv, ids, bm::BM_SORTED);
+        CheckTestMany(bv, ids, bm::BM_UNKNOWN);
+        
+        // sparse sorted with duplicates, including ids past the last block
+        ids.resize(0);
+        for (bvect::size_type i = 0; i < bv.size() - 1000000; i += unsigned(rand()) % 100000)
+            ids.push_back(i);
+        CheckTestMany(bv, ids, bm::BM_SORTED);
+        
+        // unsorted
+        for (size_t i = ids.size(); i > 1; --i)
+        {
+            size_t j = size_t(rand()) % i;
+            bvect::size_type tmp = ids[i-1]; ids[i-1] = ids[j]; ids[j] = tmp;
+        }
+        CheckTestMany(bv, ids, bm::BM_UNSORTED);
+        CheckTestMany(bv, ids, bm::BM_UNKNOWN);
+    } // for pass
+
+    cout << "---------------------------- test_many() test OK" << endl;
+}
+
+static
+void CheckDecode(const bvect& bv, bvect::size_type buf_size,
+                 bvect::size_type from)
+{
+    std::vector<bvect::size_type> buf(buf_size);
+    const bvect::size_type from0 = from;
+    bvect::enumerator en(&bv, from);
+    bvect::size_type total = 0;
+    for (;;)
+    {
+        bvect::size_type n = bv.decode(buf.data(), buf_size, from);
+        for (bvect::size_type i = 0; i < n; ++i, ++en)
+        {
+            if (!en.valid() || *en != buf[i])
+            {
+                cerr << "decode() failed at i=" << i << " buf_size=" << buf_size
+                     << " from=" << from << endl;
+                exit(1);
+            }
+        }
+        total += n;
+        if (n < buf_size)
+            break;
+        from = buf[n-1] + 1;
+    } // for
+    assert(!en.valid());
+    assert(total == bv.count_range(from0, bm::id_max - 1));
+}
+
+static
+void DecodeTest()
+{
+    cout << "---------------------------- decode() test" << endl;
+
+    {
+        bvect bv { 0, 1, 31, 32, 65535, 65536, 100000, bm::id_max - 1 };
+        bvect::size_type buf[16];
+        bvect::size_type n = bv.decode(buf, 16);
+        assert(n == 8);
+        assert(buf[0] == 0 && buf[3] == 32 && buf[7] == bm::id_max - 1);
+        n = bv.decode(buf, 3, 2);
+        assert(n == 3 && buf[0] == 31 && buf[2] == 65535);
+        n = bv.decode(buf, 16, 100001);
+        assert(n == 1 && buf[0] == bm::id_max - 1);
+        
+        bvect bv_empty;
+        assert(bv_empty.decode(buf, 16) == 0);
+    }
+
+    for (unsigned pass = 0; pass < 3; ++pass)
+    {
+        bvect bv;
+        GenerateMixedBlocksVector(bv, 24, 16);
+        if (pass)
+        {
+            bv.set_range(100000, 400000); // full blocks
+            bv.set_range(bm::id_max - 70000, bm::id_max - 1);
+            if (pass == 2)
+                bv.optimize();
+        }
+        bvect::size_type buf_sizes[] = { 1, 7, 33, 40, 41, 1000, 65536, 3000000 };
+        for (unsigned k = 0; k < sizeof(buf_sizes)/sizeof(buf_sizes[0]); ++k)
+        {
+            CheckDecode(bv, buf_sizes[k], 0);
+            CheckDecode(bv, buf_sizes[k], 123457);
+        }
+    } // for pass
+
+    cout << "---------------------------- decode() test OK" << endl;
+}
+
+static
+void CheckRangeEnumerators(const bvect& bv,
+                           const std::vector<bvect::size_type>& vect,
+                           bvect::size_type from, bvect::size_type to)
+{
+    // forward [from, to]
+    std::vector<bvect::size_type>::const_iterator it =
+                        std::lower_bound(vect.begin(), vect.end(), from);
+    bvect::range_enumerator ren = bv.get_range_enumerator(from, to);
+    for (; it != vect.end() && *it <= to; ++it, ++ren)
+    {
+        if (!ren.valid() || *ren != *it)
+        {
+            cerr << "range_enumerator failed at " << *it << " range=["
+                 << from << ", " << to << "]" << endl;
+            exit(1);
+        }
+    }
+    assert(!ren.valid());
+    
+    // backward [from, to]
+    std::vector<bvect::size_type>::const_reverse_iterator rit(
+                        std::upper_bound(vect.begin(), vect.end(), to));
+    bvect::reverse_enumerator rev = bv.get_reverse_enumerator(to, from);
+    for (; rit != vect.rend() && *rit >= from; ++rit, ++rev)
+    {
+        if (!rev.valid() || *rev != *rit)
+        {
+            cerr << "reverse_enumerator failed at " << *rit << " range=["
+                 << from << ", " << to << "]" << endl;
+            exit(1);
+        }
+    }
+    assert(!rev.valid());
+}
+
+static
+void ReverseEnumeratorTest()
+{
+    cout << "---------------------------- reverse/range enumerator test" << endl;
+
+    {
+        bvect bv;
+        bvect::reverse_enumerator rev = bv.last();
+        assert(!rev.valid());
+        bvect::range_enumerator ren = bv.get_range_enumerator(0, 100);
+        assert(!ren.valid());
+        
+        bv.set(0); bv.set(31); bv.set(32); bv.set(65536); bv.set(bm::id_max - 1);
+        rev = bv.last();
+        assert(*rev == bm::id_max - 1);
+        ++rev; assert(*rev == 65536);
+        ++rev; assert(*rev == 32);
+        rev++; assert(*rev == 31);
+        ++rev; assert(*rev == 0);
+        ++rev; assert(!rev.valid());
+        
+        rev = bv.get_reverse_enumerator(65535);
+        assert(rev.valid() && *rev == 32);
+        rev = bv.get_reverse_enumerator(65537, 33);
+        assert(rev.valid() && *rev == 65536);
+        ++rev; assert(!rev.valid());
+        
+        ren = bv.get_range_enumerator(1, 65536);
+        assert(*ren == 31);
+        ++ren; assert(*ren == 32);
+        ++ren; assert(*ren == 65536);
+        ++ren; assert(!ren.valid());
+        ren = bv.get_range_enumerator(33, 65535);
+        assert(!ren.valid());
+    }
+
+    for (unsigned pass = 0; pass < 3; ++pass)
+    {
+        bvect bv;
+        GenerateMixedBlocksVector(bv, 24, 16);
+        if (pass)
+        {
+            bv.set_range(100000, 400000); // full blocks
+            bv.set_range(bm::id_max - 70000, bm::id_max - 1);
+            if (pass == 2)
+                bv.optimize();
+        }
+        std::vector<bvect::size_type> vect;
+        for (bvect::enumerator en = bv.first(); en.valid(); ++en)
+            vect.push_back(*en);
+        
+        CheckRangeEnumerators(bv, vect, 0, bm::id_max - 1);
+        CheckRangeEnumerators(bv, vect, 100001, 399999);
+        CheckRangeEnumerators(bv, vect, 65535, 65536 * 3);
+        for (unsigned k = 0; k < 200; ++k)
+        {
+            bvect::size_type from = bvect::size_type(rand()) % (65536 * 26);
+            bvect::size_type to = from + bvect::size_type(rand()) % (65536 * 2);
+            CheckRangeEnumerators(bv, vect, from, to);
+        }
+    } // for pass
+
+    cout << "---------------------------- reverse/range enumerator test OK" << endl;
+}
+
+static
+void CheckIntervalEnumerator(const bvect& bv)
+{
+    // reference runs from the bit enumerator
+    std::vector<bvect::size_type> starts, ends;
+    for (bvect::enumerator en = bv.first(); en.valid(); ++en)
+    {
+        if (!ends.empty() && ends.back() + 1 == *en)
+            ends.back() = *en;
+        else
+        {
+            starts.push_back(*en);
+            ends.push_back(*en);
+        }
+    }
+    
+    bvect::interval_enumerator ien = bv.get_interval_enumerator();
+    for (size_t i = 0; i < starts.size(); ++i, ++ien)
+    {
+        if (!ien.valid() ||
+            ien.start() != starts[i] || ien.end() != ends[i])
+        {
+            cerr << "interval_enumerator failed at [" << starts[i] << ", "
+                 << ends[i] << "]" << endl;
+            exit(1);
+        }
+    }
+    assert(!ien.valid());
+    
+    // go_to() into the middle of intervals
+    for (size_t i = 0; i < starts.size(); i += 1 + starts.size() / 50)
+    {
+        bvect::size_type mid = starts[i] + (ends[i] - starts[i]) / 2;
+        ien.go_to(mid);
+        assert(ien.valid());
+        assert(ien.start() == mid && ien.end() == ends[i]);
+        if (ends[i] + 1 < bm::id_max)
+        {
+            ien.go_to(ends[i] + 1);
+            if (i + 1 < starts.size())
+                assert(ien.valid() && ien.start() == starts[i+1]);
+            else
+                assert(!ien.valid());
+        }
+    }
+}
+
+static
+void IntervalsTest()
+{
+    cout << "---------------------------- intervals test" << endl;
+
+    {
+        bvect bv;
+        bvect::interval_enumerator ien(&bv);
+        assert(!ien.valid());
+        
+        bvect::size_type starts[] = { 0, 5, 65530, 65536 * 3 - 1, bm::id_max - 2 };
+        bvect::size_type ends[] =   { 3, 5, 65536 * 2, 65536 * 5, bm::id_max - 1 };
+        bv.import_intervals(starts, ends, 5);
+        assert(bv.count() == 4 + 1 + (65536 + 7) + (65536 * 2 + 2) + 2);
+        ien = bv.get_interval_enumerator();
+        for (unsigned i = 0; i < 5; ++i, ++ien)
+        {
+            assert(ien.valid());
+            assert(ien.start() == starts[i] && ien.end() == ends[i]);
+        }
+        assert(!ien.valid());
+        
+        // adjacent intervals merge
+        bvect bv1;
+        bvect::size_type starts1[] = { 10, 21, 100 };
+        bvect::size_type ends1[] =   { 20, 30, 100 };
+        bv1.import_intervals(starts1, ends1, 3);
+        ien = bv1.get_interval_enumerator(15);
+        assert(ien.start() == 15 && ien.end() == 30);
+        ++ien;
+        assert(ien.start() == 100 && ien.end() == 100);
+        
+        // unsorted and overlapping intervals
+        bvect bv2, bv3;
+        bvect::size_type starts2[] = { 100, 10, 15 };
+        bvect::size_type ends2[] =   { 200, 20, 150 };
+        bv2.import_intervals(starts2, ends2, 3);
+        bv3.set_range(10, 200);
+        assert(bv2.compare(bv3) == 0);
+    }
+
+    for (unsigned pass = 0; pass < 4; ++pass)
+    {
+        bvect bv1, bv2;
+        if (pass & 1)
+        {
+            GenerateMixedBlocksVector(bv1, 24, 16);
+            bv2 = bv1;
+            bv1.optimize();
+        }
+        std::vector<bvect::size_type> starts, ends;
+        bvect::size_type pos = bvect::size_type(rand()) % 100;
+        while (pos < 65536 * 40)
+        {
+            bvect::size_type len;
+            switch (rand() % 4)
+            {
+            case 0: len = 1 + bvect::size_type(rand()) % (65536 * 3); break;
+            case 1: len = 1 + bvect::size_type(rand()) % 1000; break;
+            default: len = 1 + bvect::size_type(rand()) % 4; break;
+            }
+            starts.push_back(pos);
+            ends.push_back(pos + len - 1);
+            pos += len + ((pass & 2) ? 1 + bvect::size_type(rand()) % 3 :
+                                       bvect::size_type(rand()) % 2000);
+        }
+        bv1.import_intervals(starts.data(), ends.data(), starts.size());
+        for (size_t i = 0; i < starts.size(); ++i)
+            bv2.set_range(starts[i], ends[i]);
+        if (bv1.compare(bv2) != 0)
+        {
+            cerr << "import_intervals() failed pass=" << pass << endl;
+            exit(1);
+        }
+        CheckIntervalEnumerator(bv1);
+        bv1.optimize();
+        CheckIntervalEnumerator(bv1);
+    } // for pass
+
+    cout << "---------------------------- intervals test OK" << endl;
+}
+
+template<class E>
+void CheckExpr(const bm::expr_base<E>& e, const bvect& bv_ref, const char* msg)
+{
+    bvect bv;
+    bm::expr_evaluate(bv, e);
+    bvect::size_type cnt = bm::expr_count(e);
+    if (bv.compare(bv_ref) != 0 || cnt != bv_ref.count())
+    {
+        cerr << "Expression check failed: " << msg << endl;
+        exit(1);
+    }
+}
+
+static
+void ExprTest()
+{
+    cout << "---------------------------- expression templates test" << endl;
+
+    {
+        bvect a, b;
+        CheckExpr(bm::expr(a) & b, bvect(), "empty AND");
+        a.set(10); b.set(10); b.set(bm::id_max - 1);
+        CheckExpr(bm::expr(a) | b, b, "OR");
+        bvect ref; ref.set(bm::id_max - 1);
+        CheckExpr(b - bm::expr(a), ref, "SUB");
+        CheckExpr(bm::expr(a) ^ b, ref, "XOR");
+        CheckExpr(bm::expr(a) - a, bvect(), "a - a");
+        // arguments with different numbers of top level blocks
+        CheckExpr(bm::expr(a) & b, a, "short AND long");
+        CheckExpr(bm::expr(b) & a, a, "long AND short");
+        CheckExpr(bm::expr(a) - b, bvect(), "short SUB long");
+        CheckExpr(bm::expr(a) & b & b, a, "short AND long AND long");
+    }
+
+    for (unsigned pass = 0; pass < 4; ++pass)
+    {
+        bvect a, b, c, d;
+        GenerateMixedBlocksVector(a, 24, 16);
+        GenerateMixedBlocksVector(b, 24, 16);
+        GenerateMixedBlocksVector(c, 24, 16);
+        GenerateMixedBlocksVector(d, 24, 16);
+        if (pass & 1)
+        {
+            b |= a; // overlapping blocks
+            d.set_range(0, 65536 * 256 * 3); // FULL blocks
+        }
+        if (pass & 2)
+        {
+            a.optimize(); c.optimize(); d.optimize();
+        }
+
+        CheckExpr((bm::expr(a) & b) | (bm::expr(c) - d),
+                  (a & b) | (c - d), "(a & b) | (c - d)");
+        CheckExpr(bm::expr(a) ^ ((bm::expr(b) | c) & d),
+                  a ^ ((b | c) & d), "a ^ ((b | c) & d)");
+        CheckExpr((bm::expr(a) - b) - (bm::expr(c) ^ d),
+                  (a - b) - (c ^ d), "(a - b) - (c ^ d)");
+        CheckExpr((bm::expr(a) | b | c) & (bm::expr(d) ^ a),
+                  (a | b | c) & (d ^ a), "(a | b | c) & (d ^ a)");
+        CheckExpr(d - (bm::expr(a) & b & c), d - (a & b & c),
+                  "d - (a & b & c)");
+        CheckExpr(bm::expr(a) & a, a, "a & a");
+        CheckExpr(bm::expr(a) ^ a, bvect(), "a ^ a");
+
+        // target is one of the arguments
+        bvect ref = (a & b) - c;
+        bm::expr_evaluate(a, (bm::expr(a) & b) - c);
+        if (a.compare(ref) != 0)
+        {
+            cerr << "Expression check failed: a = (a & b) - c" << endl;
+            exit(1);
+        }
+    } // for pass
+
+    cout << "---------------------------- expression templates test OK" << endl;
+}
+
+static
+void SubOperationsTest()
+{
+    assert(ITERATIONS < BITVECT_SIZE);
+
+    cout << "----------------------------------- SubOperationTest" << endl;
+
+    {
+
+    bvect_mini   bvect_min1(256);
+    bvect_mini   bvect_min2(256);
+    bvect        bvect_full1;
+    bvect        bvect_full2;
 
     bvect_full1.set_new_blocks_strat(bm::BM_GAP);
     bvect_full2.set_new_blocks_strat(bm::BM_GAP);
@@ -4191,63 +5396,258 @@ void DesrializationTest2()
    } // for i
 
 }
+
 static
-void AggregatorTest()
+void CheckParallelOp(const bm::bvector<>& bv1, const bm::bvector<>& bv2,
+                     bm::thread_pool& pool)
 {
-  cout << "---------------------------- Aggregator Test" << endl;
+    for (unsigned op = 0; op < 3; ++op)
+    {
+        bm::bvector<> bv_s(bv1);
+        bm::bvector<> bv_p(bv1);
+        switch (op)
+        {
+        case 0:
+            bv_s.bit_or(bv2);
+            bm::parallel::bit_or(bv_p, bv2, pool);
+            break;
+        case 1:
+            bv_s.bit_and(bv2);
+            bm::parallel::bit_and(bv_p, bv2, pool);
+            break;
+        case 2:
+            bv_s.bit_sub(bv2);
+            bm::parallel::bit_sub(bv_p, bv2, pool);
+            break;
+        }
+        if (bv_s.compare(bv_p) != 0 || bv_s.size() != bv_p.size() ||
+            bv_s.count() != bv_p.count())
+        {
+            cerr << "Parallel operation check failed op=" << op << endl;
+            exit(1);
+        }
+        struct bm::bvector<>::statistics st_s, st_p;
+        bv_s.calc_stat(&st_s);
+        bv_p.calc_stat(&st_p);
+        if (st_s.bit_blocks != st_p.bit_blocks ||
+            st_s.gap_blocks != st_p.gap_blocks)
+        {
+            cerr << "Parallel operation blocks mismatch op=" << op << endl;
+            exit(1);
+        }
+    }
+}
 
-    bvect* bv_arr[128] = { 0, };
-    bvect* bv_arr2[128] = { 0, };
+static
+void ParallelOpsTest()
+{
+    cout << "---------------------------- Parallel OR, AND, SUB test" << endl;
 
-    bm::aggregator<bvect> agg;
-    
+    bm::thread_pool pool(4);
     {
-        bvect bv1, bv2, bv3;
-        bvect bv_empty;
-        bvect bv_control;
-        
-        bv_arr[0] = &bv1;
-        agg.combine_or(bv3, bv_arr, 1);
-        assert(bv3.count()==0);
-        
-        bv3[100] = true;
-        bv1.invert();
-        bv_control.invert();
-        bv_arr[0] = &bv1;
-        agg.combine_or(bv3, bv_arr, 1);
-        int res = bv_control.compare(bv3);
-        assert(res == 0);
-        
-        bv_arr[0] = &bv1;
-        bv_arr[1] = &bv2;
-        agg.combine_or(bv3, bv_arr, 2);
-        res = bv_control.compare(bv3);
-        assert(res == 0);
-        
-        bv2[1000000] = true;
-        bv_arr[0] = &bv1;
-        bv_arr[1] = &bv2;
-        agg.combine_or(bv3, bv_arr, 2);
-        res = bv_control.compare(bv3);
-        assert(res == 0);
+        bm::bvector<> bv1, bv2;
+        CheckParallelOp(bv1, bv2, pool);
+        bv1.set(10);
+        CheckParallelOp(bv1, bv2, pool);
+        CheckParallelOp(bv2, bv1, pool);
     }
+    for (unsigned pass = 0; pass < 20; ++pass)
     {
-        bvect bv1, bv2, bv3;
-        bvect bv_empty;
-        bvect bv_control;
-        int res;
+        bm::bvector<> bv1, bv2;
+        GenerateMixedBlocksVector(bv1, 20, 64);
+        GenerateMixedBlocksVector(bv2, 20, 64);
+        if (pass & 1)
+        {
+            bv1.optimize();
+            bv2.resize(bv2.size() / 2);
+        }
+        CheckParallelOp(bv1, bv2, pool);
+        CheckParallelOp(bv2, bv1, pool);
+        CheckParallelOp(bv1, bv1, pool);
+    }
 
-        bv1.invert();
-        bv_control.invert();
-        bv_arr[0] = &bv1;
-        agg.combine_and(bv3, bv_arr, 1);
-        res = bv_control.compare(bv3);
-        assert(res == 0);
-        
-        bv2.invert();
-        bv2.set_range(100000, 100100);
-        bv_arr[0] = &bv1;
-        bv_arr[1] = &bv2;
+    // copies sharing blocks (copy-on-write) modified concurrently
+    {
+        bm::bvector<> bv;
+        GenerateMixedBlocksVector(bv, 20, 64);
+        const unsigned copy_count = 16;
+        std::vector<bm::bvector<> > copies(copy_count, bv);
+        auto modify = [&bv](bm::bvector<>& bvc, unsigned k)
+        {
+            bm::bvector<> bv_tmp(bv);
+            bv_tmp.set_range(k * 100000, k * 100000 + 70000);
+            bvc.bit_xor(bv_tmp);
+            bvc.set(k * 1000000 + k);
+            if (k & 1)
+                bvc.invert();
+        };
+        auto task = [&](unsigned task_idx, unsigned /*worker_idx*/)
+        {
+            modify(copies[task_idx], task_idx);
+        };
+        pool.run(copy_count, task);
+        for (unsigned k = 0; k < copy_count; ++k)
+        {
+            bm::bvector<> bv_s(bv, 0, bm::id_max - 1); // deep copy
+            modify(bv_s, k);
+            if (bv_s.compare(copies[k]) != 0)
+            {
+                cerr << "Concurrent copy-on-write check failed " << k << endl;
+                exit(1);
+            }
+        }
+    }
+
+    cout << "---------------------------- Parallel OR, AND, SUB test OK" << endl;
+}
+
+static
+void ParallelAggregatorTest()
+{
+    cout << "---------------------------- Parallel Aggregator test" << endl;
+
+    bm::thread_pool pool(4);
+    bm::aggregator<bm::bvector<> > agg;
+    bm::parallel::aggregator<bm::bvector<> > agg_p(pool);
+
+    for (unsigned pass = 0; pass < 20; ++pass)
+    {
+        const unsigned cnt = 6;
+        bm::bvector<> bv[cnt];
+        const bm::bvector<>* agg_list[cnt];
+        for (unsigned k = 0; k < cnt; ++k)
+        {
+            GenerateMixedBlocksVector(bv[k], 30, 64);
+            if (pass & 1)
+                bv[k].optimize();
+            agg_list[k] = &bv[k];
+        }
+        // common bits for AND, AND-SUB (second range is not in SUB group)
+        for (unsigned k = 0; k < cnt; ++k)
+        {
+            bv[k].set_range(pass * 65536 * 300, pass * 65536 * 300 + 100000);
+            if (k < cnt - 2)
+                bv[k].set_range(65536 * 256 * 40 + pass * 1000,
+                                65536 * 256 * 40 + 65536 * 3);
+        }
+        
+        bm::bvector<> bv_s, bv_p;
+        agg.combine_or(bv_s, agg_list, cnt);
+        agg_p.combine_or(bv_p, agg_list, cnt);
+        if (bv_s.compare(bv_p) != 0 || bv_s.size() != bv_p.size())
+        {
+            cerr << "Parallel aggregator OR check failed" << endl;
+            exit(1);
+        }
+        agg.combine_and(bv_s, agg_list, cnt);
+        agg_p.combine_and(bv_p, agg_list, cnt);
+        if (bv_s.compare(bv_p) != 0 || !bv_p.any())
+        {
+            cerr << "Parallel aggregator AND check failed" << endl;
+            exit(1);
+        }
+        
+        for (unsigned sub_cnt = 0; sub_cnt < 3; ++sub_cnt)
+        {
+            const bm::bvector<>** sub_list = agg_list + cnt - sub_cnt;
+            bool f_s = agg.combine_and_sub(bv_s, agg_list, cnt - sub_cnt,
+                                           sub_list, sub_cnt, false);
+            bool f_p = agg_p.combine_and_sub(bv_p, agg_list, cnt - sub_cnt,
+                                             sub_list, sub_cnt, false);
+            if (f_s != f_p || bv_s.compare(bv_p) != 0)
+            {
+                cerr << "Parallel aggregator AND-SUB check failed" << endl;
+                exit(1);
+            }
+            
+            f_p = agg_p.combine_and_sub(bv_p, agg_list, cnt - sub_cnt,
+                                        sub_list, sub_cnt, true);
+            if (f_s != f_p || (f_p && !bv_p.any()))
+            {
+                cerr << "Parallel aggregator AND-SUB(any) check failed" << endl;
+                exit(1);
+            }
+            bv_p -= bv_s;
+            if (bv_p.any())
+            {
+                cerr << "Parallel aggregator AND-SUB(any) result incorrect" << endl;
+                exit(1);
+            }
+
+            bm::bvector<>::size_type idx_s = 0, idx_p = 0;
+            f_s = agg.find_first_and_sub(idx_s, agg_list, cnt - sub_cnt,
+                                         sub_list, sub_cnt);
+            f_p = agg_p.find_first_and_sub(idx_p, agg_list, cnt - sub_cnt,
+                                           sub_list, sub_cnt);
+            if (f_s != f_p || idx_s != idx_p)
+            {
+                cerr << "Parallel aggregator find_first_and_sub check failed "
+                     << idx_s << " " << idx_p << endl;
+                exit(1);
+            }
+        } // for sub_cnt
+    } // for pass
+
+    cout << "---------------------------- Parallel Aggregator test OK" << endl;
+}
+
+static
+void AggregatorTest()
+{
+  cout << "---------------------------- Aggregator Test" << endl;
+
+    bvect* bv_arr[128] = { 0, };
+    bvect* bv_arr2[128] = { 0, };
+
+    bm::aggregator<bvect> agg;
+    
+    {
+        bvect bv1, bv2, bv3;
+        bvect bv_empty;
+        bvect bv_control;
+        
+        bv_arr[0] = &bv1;
+        agg.combine_or(bv3, bv_arr, 1);
+        assert(bv3.count()==0);
+        
+        bv3[100] = true;
+        bv1.invert();
+        bv_control.invert();
+        bv_arr[0] = &bv1;
+        agg.combine_or(bv3, bv_arr, 1);
+        int res = bv_control.compare(bv3);
+        assert(res == 0);
+        
+        bv_arr[0] = &bv1;
+        bv_arr[1] = &bv2;
+        agg.combine_or(bv3, bv_arr, 2);
+        res = bv_control.compare(bv3);
+        assert(res == 0);
+        
+        bv2[1000000] = true;
+        bv_arr[0] = &bv1;
+        bv_arr[1] = &bv2;
+        agg.combine_or(bv3, bv_arr, 2);
+        res = bv_control.compare(bv3);
+        assert(res == 0);
+    }
+    {
+        bvect bv1, bv2, bv3;
+        bvect bv_empty;
+        bvect bv_control;
+        int res;
+
+        bv1.invert();
+        bv_control.invert();
+        bv_arr[0] = &bv1;
+        agg.combine_and(bv3, bv_arr, 1);
+        res = bv_control.compare(bv3);
+        assert(res == 0);
+        
+        bv2.invert();
+        bv2.set_range(100000, 100100);
+        bv_arr[0] = &bv1;
+        bv_arr[1] = &bv2;
         bv_control.set_range(100000, 100100);
         agg.combine_and(bv3, bv_arr, 2);
         res = bv_control.compare(bv3);
@@ -4381,135 +5781,976 @@ void AggregatorTest()
 
 
 static
-void StressTestAggregatorOR(unsigned repetitions)
+void CheckAggregatorCount(bm::aggregator<bvect>& agg,
+                          const bvect* const* and_arr, unsigned and_size,
+                          const bvect* const* sub_arr, unsigned sub_size)
 {
-  cout << "---------------------------- Aggregator OR Stress Test" << endl;
-   unsigned size = BITVECT_SIZE - 10;
-
-
-    unsigned i;
-    for (i = 0; i < repetitions; ++i)
+    bvect bv_target;
+    agg.combine_and_sub(bv_target, and_arr, and_size, sub_arr, sub_size, false);
+    bvect::size_type cnt_c = bv_target.count();
+    bvect::size_type cnt = agg.count_and_sub(and_arr, and_size, sub_arr, sub_size);
+    if (cnt != cnt_c)
     {
-        int opt = rand() % 2;
-        cout << endl << " - - - - - - - - - - - - AGG OR STRESS STEP " << i << endl;;
-        
-        switch (rand() % 3)
-        {
-        case 0:
-            size = BITVECT_SIZE / 10;
-            break;
-        case 1:
-            size = BITVECT_SIZE / 2;
-            break;
-        default:
-            size = BITVECT_SIZE - 10;
-            break;
-        } // switch
-        
-        unsigned start1 = 0;
-        switch (rand() % 3)
+        cerr << "Error: count_and_sub() mismatch " << cnt << " " << cnt_c << endl;
+        exit(1);
+    }
+    if (cnt_c > 10)
+    {
+        bvect::size_type lim = cnt_c / 2;
+        cnt = agg.count_and_sub(and_arr, and_size, sub_arr, sub_size, lim);
+        if (cnt < lim || cnt > cnt_c)
         {
-        case 1:
-            start1 += size / 5;
-            break;
-        default:
-            break;
+            cerr << "Error: count_and_sub() limit check failed " << cnt << endl;
+            exit(1);
         }
+    }
 
-        unsigned start2 = 0;
-        switch (rand() % 3)
+    bv_target.clear();
+    agg.combine_or(bv_target, and_arr, and_size);
+    cnt_c = bv_target.count();
+    cnt = agg.count_or(and_arr, and_size);
+    if (cnt != cnt_c)
+    {
+        cerr << "Error: count_or() mismatch " << cnt << " " << cnt_c << endl;
+        exit(1);
+    }
+    if (cnt_c > 10)
+    {
+        bvect::size_type lim = cnt_c / 3;
+        cnt = agg.count_or(and_arr, and_size, lim);
+        if (cnt < lim || cnt > cnt_c)
         {
-        case 1:
-            start2 += size / 5;
-            break;
-        default:
-            break;
+            cerr << "Error: count_or() limit check failed " << cnt << endl;
+            exit(1);
         }
+    }
+}
 
-        bvect_mini   bvect_min1(size);
-        bvect bv0, bv1, bv2, bv3, bv4, bv5, bv6, bv7, bv8, bv9;
+static
+void AggregatorCountTest()
+{
+    cout << "---------------------------- Aggregator count test" << endl;
 
-        // 0 skipped
-        FillSetsRandomMethod(&bvect_min1, &bv1, start1, size, opt);
-        FillSetsRandomMethod(&bvect_min1, &bv2, start2, size, opt);
-        // 3 skipped
-        FillSetsRandomMethod(&bvect_min1, &bv5, start1, size, opt);
-        FillSetsRandomMethod(&bvect_min1, &bv6, start2, size, opt);
-        FillSetsRandomMethod(&bvect_min1, &bv7, start1, size, opt);
-        FillSetsRandomMethod(&bvect_min1, &bv8, start2, size, opt);
-        FillSetsRandomMethod(&bvect_min1, &bv9, start2, size, opt);
-        
-        bm::aggregator<bvect> agg;
-        
-        bvect* agg_list[32] = {0, };
-        
-        agg_list[0] = &bv0;
-        agg_list[1] = &bv1;
-        agg_list[2] = &bv2;
-        agg_list[3] = &bv3;
-        agg_list[4] = &bv4;
-        agg_list[5] = &bv5;
-        agg_list[6] = &bv6;
-        agg_list[7] = &bv7;
-        agg_list[8] = &bv8;
-        agg_list[9] = &bv9;
-        
-        bvect bv_target1, bv_target2;
-        
-        unsigned cnt = 10;
-        agg.combine_or(bv_target1, agg_list, cnt);
-        agg.combine_or_horizontal(bv_target2, agg_list, cnt);
+    bm::aggregator<bvect> agg;
+    {
+        bvect bv1, bv2;
+        const bvect* and_arr[2] = { &bv1, &bv2 };
+        CheckAggregatorCount(agg, and_arr, 2, 0, 0);
 
-        int res = bv_target1.compare(bv_target2);
-        if (res!=0)
-        {
-            cerr << "Error: Aggregator OR check failed!" << endl;
-            exit(1);
-        }
-        for (unsigned j = 1; j < cnt; ++j)
-        {
-            agg.combine_or(bv_target1, agg_list, j);
-            agg.combine_or_horizontal(bv_target2, agg_list, j);
-            res = bv_target1.compare(bv_target2);
-            if (res!=0)
+        bv1.invert();
+        bv2.set_range(100, 200000);
+        CheckAggregatorCount(agg, and_arr, 2, 0, 0);
+        CheckAggregatorCount(agg, and_arr, 1, and_arr + 1, 1);
+        assert(agg.count_and_sub(and_arr, 2, 0, 0) == 200000 - 100 + 1);
+        assert(agg.count_or(and_arr, 2, 10) >= 10);
+    }
+
+    {
+        bvect a, b, c, d;
+        GenerateMixedBlocksVector(a, 24, 16);
+        GenerateMixedBlocksVector(b, 24, 16);
+        GenerateMixedBlocksVector(c, 12, 16);
+        for (unsigned i = 0; i < 3000000; i += 7)
+            d.set(i);
+        d.set_range(bm::set_array_size * bm::gap_max_bits * 3, 
+                     bm::set_array_size * bm::gap_max_bits * 4);
+        a.set_range(1, 100000);
+        b.set_range(2000, 300000);
+        c.optimize();
+
+        const bvect* arr[4] = { &a, &b, &c, &d };
+        const bvect* sub[4] = { &d, &c, &b, &a };
+        for (unsigned and_size = 1; and_size <= 4; ++and_size)
+        {
+            for (unsigned sub_size = 0; sub_size <= 3; ++sub_size)
             {
-                cerr << "Error: Aggregator OR check failed! 1.laddder step = "
-                     << j << endl;
-                exit(1);
+                CheckAggregatorCount(agg, arr, and_size, sub, sub_size);
+                CheckAggregatorCount(agg, sub, and_size, arr, sub_size);
             }
         }
-        
-        for (unsigned j = 0; j < cnt; ++j)
+
+        // group interface
+        bvect bv_target;
+        agg.reset();
+        agg.add(&a); agg.add(&b);
+        agg.add(&c, 1);
+        bvect::size_type cnt = agg.count_and_sub();
+        agg.combine_and_sub(bv_target);
+        assert(cnt == bv_target.count());
+        cnt = agg.count_or();
+        agg.combine_or(bv_target);
+        assert(cnt == bv_target.count());
+        agg.reset();
+    }
+
+    cout << "---------------------------- Aggregator count test OK" << endl;
+}
+
+
+static
+void CheckThresholdAggregation(bm::aggregator<bvect>& agg,
+                               const bvect* const* bv_src, unsigned src_size)
+{
+    // reference: bit-sliced counters built with bvector logical operations
+    const unsigned plane_count = 8;
+    bvect planes[plane_count];
+    bvect bv_any;
+    for (unsigned n = 0; n < src_size; ++n)
+    {
+        bvect carry(*bv_src[n]);
+        bv_any |= carry;
+        for (unsigned p = 0; carry.any(); ++p)
         {
-            agg.combine_or(bv_target1, agg_list+j, cnt-j);
-            agg.combine_or_horizontal(bv_target2, agg_list+j, cnt-j);
-            res = bv_target1.compare(bv_target2);
-            if (res!=0)
+            assert(p < plane_count);
+            bvect t(planes[p]);
+            t &= carry;
+            planes[p] ^= carry;
+            carry.swap(t);
+        }
+    }
+
+    for (unsigned k = 1; k <= src_size + 1; ++k)
+    {
+        bvect bv_gt, bv_eq(bv_any);
+        for (unsigned p = plane_count; p-- > 0; )
+        {
+            if (k & (1u << p))
+                bv_eq &= planes[p];
+            else
             {
-                cerr << "Error: Aggregator OR check failed! 2.laddder step = "
-                     << j << endl;
-                exit(1);
+                bvect t(bv_eq);
+                t &= planes[p];
+                bv_gt |= t;
+                bv_eq -= planes[p];
             }
         }
+        bv_gt |= bv_eq;
 
+        bvect bv_target;
+        agg.combine_threshold(bv_target, bv_src, src_size, k);
+        if (bv_target.compare(bv_gt) != 0)
+        {
+            cerr << "Error: threshold aggregation failed k=" << k
+                 << " N=" << src_size << endl;
+            exit(1);
+        }
+    }
 
-    } // for i
-
-  cout << "---------------------------- Aggregator OR Stress Test OK" << endl;
+    sparse_vector_u32 sv;
+    agg.combine_vcount(sv, bv_src, src_size);
+    for (unsigned p = 0; p < plane_count; ++p)
+    {
+        const bvect* bv_plain = sv.get_plain(p);
+        bool eq = bv_plain ? (bv_plain->compare(planes[p]) == 0)
+                           : !planes[p].any();
+        if (!eq)
+        {
+            cerr << "Error: vertical count plain mismatch " << p << endl;
+            exit(1);
+        }
+    }
+    bvect::size_type last;
+    if (bv_any.find_reverse(last))
+    {
+        assert(sv.size() == last + 1);
+        assert(sv.get(last) > 0);
+    }
+    else
+    {
+        assert(sv.size() == 0);
+    }
 }
 
 static
-void StressTestAggregatorAND(unsigned repetitions)
+void ThresholdAggregatorTest()
 {
-  cout << "---------------------------- Aggregator AND Stress Test" << endl;
-   unsigned size = BITVECT_SIZE - 10;
+    cout << "---------------------------- Threshold aggregator test" << endl;
 
+    bm::aggregator<bvect> agg;
+    {
+        bvect bv1 { 1, 2, 3, 100000 };
+        bvect bv2 { 2, 3, 200000 };
+        bvect bv3 { 3, 100000, 200000 };
+        bvect bv4;
+        bv4.set_range(65536, 65536 * 3);
 
-    unsigned i;
+        agg.add(&bv1); agg.add(&bv2); agg.add(&bv3); agg.add(&bv4);
+
+        bvect bv_target;
+        agg.combine_threshold(bv_target, 2);
+        bvect bv_control { 2, 3, 100000, 200000 };
+        assert(bv_target.compare(bv_control) == 0);
+
+        agg.combine_threshold(bv_target, 3);
+        bvect bv_control3 { 3, 100000 };
+        assert(bv_target.compare(bv_control3) == 0);
+
+        agg.combine_threshold(bv_target, 5);
+        assert(!bv_target.any());
+
+        sparse_vector_u32 sv;
+        agg.combine_vcount(sv);
+        assert(sv.size() == 200000 + 1);
+        assert(sv.get(0) == 0);
+        assert(sv.get(1) == 1);
+        assert(sv.get(3) == 3);
+        assert(sv.get(100000) == 3);
+        assert(sv.get(200000) == 2);
+        assert(sv.get(65536) == 1);
+        agg.reset();
+    }
+
+    {
+        bvect bv_f1, bv_f2, bv_f3;
+        bv_f1.invert();
+        bv_f2.set_range(0, 65536 * 2 - 1);
+        bv_f3.set_range(100, 65536 * 5);
+        bv_f3.optimize();
+        const bvect* arr[3] = { &bv_f1, &bv_f2, &bv_f3 };
+        bvect bv_target;
+        agg.combine_threshold(bv_target, arr, 3, 3);
+        assert(bv_target.count() == 65536 * 2 - 100);
+        agg.combine_threshold(bv_target, arr + 1, 2, 1);
+        assert(bv_target.count() == 65536 * 5 + 1);
+        CheckThresholdAggregation(agg, arr + 1, 2);
+    }
+
+    {
+        const unsigned vect_count = 9;
+        bvect bvs[vect_count];
+        const bvect* arr[vect_count];
+        for (unsigned n = 0; n < vect_count; ++n)
+        {
+            GenerateMixedBlocksVector(bvs[n], 12 + n * 2, 16);
+            for (unsigned i = n; i < 3000000; i += 3 + n)
+                bvs[n].set(i);
+            if (n & 1)
+                bvs[n].optimize();
+            arr[n] = &bvs[n];
+        }
+        bvs[2].set_range(1000, 65536 * 300);
+        bvs[5].set_range(70000, 65536 * 200);
+        for (unsigned n = 1; n <= vect_count; n += 2)
+            CheckThresholdAggregation(agg, arr, n);
+    }
+
+    cout << "---------------------------- Threshold aggregator test OK" << endl;
+}
+
+
+static
+void VerticalCountTest()
+{
+    cout << "---------------------------- Vertical count test" << endl;
+
+    bm::aggregator<bvect> agg;
+
+    const unsigned vect_count = 37;
+    bvect bvs[vect_count];
+    const bvect* arr[vect_count];
+    for (unsigned n = 0; n < vect_count; ++n)
+    {
+        switch (n % 4)
+        {
+        case 0: GenerateMixedBlocksVector(bvs[n], 6, 16); break;
+        case 1: bvs[n].set_range(n * 1000, 65536 * 40); break;
+        case 2: for (unsigned i = n; i < 65536 * 50; i += n) bvs[n].set(i);
+                break;
+        case 3: for (unsigned i = 0; i < 65536 * 60; i += 1 + unsigned(rand()) % 3)
+                    bvs[n].set(i);
+                bvs[n].set_range(65536 * 10, 65536 * 12);
+                break;
+        }
+        bvs[n].optimize();
+        arr[n] = &bvs[n];
+    }
+
+    const unsigned plain_count = 6;
+    for (unsigned src_size = 1; src_size <= vect_count; src_size += 4)
+    {
+        // reference counters with bvector logical operations
+        bvect planes[plain_count];
+        for (unsigned n = 0; n < src_size; ++n)
+        {
+            bvect carry(bvs[n]);
+            for (unsigned p = 0; carry.any(); ++p)
+            {
+                assert(p < plain_count);
+                bvect t(planes[p]);
+                t &= carry;
+                planes[p] ^= carry;
+                carry.swap(t);
+            }
+        }
+
+        bvect plains[plain_count];
+        bvect* bv_plains[plain_count];
+        for (unsigned p = 0; p < plain_count; ++p)
+        {
+            plains[p].set(p); // must be cleared
+            bv_plains[p] = &plains[p];
+        }
+        unsigned pc = agg.combine_vcount(bv_plains, plain_count, arr, src_size);
+        assert(pc == bm::bit_scan_reverse(src_size) + 1);
+        for (unsigned p = 0; p < plain_count; ++p)
+        {
+            if (plains[p].compare(planes[p]) != 0)
+            {
+                cerr << "Error: vertical count plain mismatch p=" << p
+                     << " N=" << src_size << endl;
+                exit(1);
+            }
+        }
+    }
+
+    {
+        sparse_vector_u32 sv(bm::use_null);
+        agg.combine_vcount(sv, arr, vect_count);
+        bvect::size_type pos = 65536 * 11;
+        unsigned cnt = 0;
+        for (unsigned n = 0; n < vect_count; ++n)
+            cnt += bvs[n].test(pos);
+        assert(sv.get(pos) == cnt);
+        assert(!sv.is_null(pos));
+        assert(sv.is_null(sv.size()));
+    }
+
+    cout << "---------------------------- Vertical count test OK" << endl;
+}
+
+
+static
+void AggregatorBatchTest()
+{
+    cout << "---------------------------- Aggregator batch test" << endl;
+
+    typedef bm::aggregator<bvect>::batch_query batch_query;
+    bm::aggregator<bvect> agg;
+
+    const unsigned args_size = 20;
+    bvect bvs[args_size];
+    const bvect* bv_args[args_size];
+    for (unsigned n = 0; n < args_size; ++n)
+    {
+        switch (n % 5)
+        {
+        case 0: GenerateMixedBlocksVector(bvs[n], 12, 16); break;
+        case 1: bvs[n].set_range(n * 1000, 65536 * 40); break;
+        case 2: for (unsigned i = n; i < 65536 * 50; i += n) bvs[n].set(i);
+                break;
+        case 3: for (unsigned i = 0; i < 65536 * 30; i += 1 + unsigned(rand()) % 5)
+                    bvs[n].set(i);
+                break;
+        case 4: bvs[n].invert(); bvs[n].set_range(65536 * 3, 65536 * 5, false);
+                break;
+        }
+        if (n & 1)
+            bvs[n].optimize();
+        bv_args[n] = &bvs[n];
+    }
+
+    const unsigned query_count = 64;
+    unsigned and_idx[query_count][4];
+    unsigned sub_idx[query_count][3];
+    bvect targets[query_count];
+    batch_query queries[query_count];
+    for (unsigned q = 0; q < query_count; ++q)
+    {
+        batch_query& query = queries[q];
+        query.and_size = q % 5; // 0 - empty query
+        query.sub_size = q % 4;
+        for (unsigned k = 0; k < 4; ++k)
+            and_idx[q][k] = unsigned(rand()) % args_size;
+        for (unsigned k = 0; k < 3; ++k)
+            sub_idx[q][k] = unsigned(rand()) % args_size;
+        query.and_idx = and_idx[q];
+        query.sub_idx = sub_idx[q];
+        query.bv_target = &targets[q];
+        targets[q].set(10); // must be cleared
+    }
+
+    agg.combine_and_sub_batch(bv_args, args_size, queries, query_count);
+
+    for (unsigned q = 0; q < query_count; ++q)
+    {
+        const batch_query& query = queries[q];
+        const bvect* bv_and[4];
+        const bvect* bv_sub[3];
+        for (unsigned k = 0; k < query.and_size; ++k)
+            bv_and[k] = bv_args[query.and_idx[k]];
+        for (unsigned k = 0; k < query.sub_size; ++k)
+            bv_sub[k] = bv_args[query.sub_idx[k]];
+        bvect bv_control;
+        agg.combine_and_sub(bv_control, bv_and, query.and_size,
+                            bv_sub, query.sub_size, false);
+        if (targets[q].compare(bv_control) != 0)
+        {
+            cerr << "Error: batch AND-SUB mismatch, query=" << q << endl;
+            exit(1);
+        }
+    }
+
+    cout << "---------------------------- Aggregator batch test OK" << endl;
+}
+
+
+static
+void SerialAggregatorTest()
+{
+    cout << "---------------------------- Serial aggregator test" << endl;
+
+    const unsigned vect_count = 10;
+    bvect bvs[vect_count];
+    unsigned char* blobs[vect_count];
+    {
+        GenerateMixedBlocksVector(bvs[0], 24, 16);
+        bvs[1].invert();
+        bvs[1].set_range(65536 * 3, 65536 * 1000, false);
+        for (unsigned i = 0; i < 65536 * 20; i += 3)
+            bvs[2].set(i);
+        bvs[2].set_range(65536 * 5, 65536 * 7);
+        for (unsigned i = 0; i < 65536 * 2000; i += 65536 / 4) // sparse
+            bvs[3].set(i);
+        bvs[4].set_range(1000, 65536 * 30);
+        bvs[4].set_range(65536 * 100, 65536 * 1500);
+        for (unsigned i = 0; i < 65536 * 40; i += 1 + unsigned(rand()) % 50)
+            bvs[5].set(i);
+        GenerateMixedBlocksVector(bvs[6], 12, 16);
+        bvs[6] |= bvs[4];
+        bvs[7].set(65536 * 5 + 7); // 1 bit block
+        bvs[7].set(65536 * 1200);
+        bvs[8].set_range(0, 65536 * 64);
+        for (unsigned i = 100; i < 65536 * 64; i += 50)
+            bvs[8].set(i, false);
+        // bvs[9] is empty
+    }
+
+    BM_DECLARE_TEMP_BLOCK(tb)
+    for (unsigned n = 0; n < vect_count; ++n)
+    {
+        bvs[n].optimize(tb);
+        bvect::statistics st;
+        bvs[n].calc_stat(&st);
+        blobs[n] = new unsigned char[st.max_serialize_mem];
+        bm::serialize(bvs[n], blobs[n], tb);
+    }
+
+    bm::aggregator<bvect> agg;
+    bm::serial_aggregator<bvect> sagg;
+
+    // OR of all subsets of size 1..4
+    for (unsigned from = 0; from < vect_count; ++from)
+    {
+        for (unsigned cnt = 1; cnt <= 4 && from + cnt <= vect_count; ++cnt)
+        {
+            const bvect* bv_arr[4];
+            sagg.reset();
+            for (unsigned k = 0; k < cnt; ++k)
+            {
+                bv_arr[k] = &bvs[from + k];
+                sagg.add(blobs[from + k]);
+            }
+            bvect bv_control, bv_target;
+            agg.combine_or(bv_control, bv_arr, cnt);
+            bv_target.set(65536 * 2000); // must be cleared
+            sagg.combine_or(bv_target);
+            if (bv_control.compare(bv_target) != 0)
+            {
+                cerr << "Error: serial OR mismatch " << from << ":" << cnt << endl;
+                exit(1);
+            }
+        }
+    }
+
+    // AND-SUB
+    for (unsigned from = 0; from < vect_count; ++from)
+    {
+        for (unsigned and_cnt = 1; and_cnt <= 3; ++and_cnt)
+        {
+            for (unsigned sub_cnt = 0; sub_cnt <= 2; ++sub_cnt)
+            {
+                const bvect* bv_and[3];
+                const bvect* bv_sub[2];
+                sagg.reset();
+                for (unsigned k = 0; k < sub_cnt; ++k) // group 1 added first
+                {
+                    unsigned idx = (from + 5 + k) % vect_count;
+                    bv_sub[k] = &bvs[idx];
+                    sagg.add(blobs[idx], 1);
+                }
+                for (unsigned k = 0; k < and_cnt; ++k)
+                {
+                    unsigned idx = (from + k * 3) % vect_count;
+                    bv_and[k] = &bvs[idx];
+                    sagg.add(blobs[idx]);
+                }
+                bvect bv_control, bv_target;
+                bool f1 = agg.combine_and_sub(bv_control, bv_and, and_cnt,
+                                              bv_sub, sub_cnt, false);
+                bool f2 = sagg.combine_and_sub(bv_target);
+                if (bv_control.compare(bv_target) != 0 || f1 != f2)
+                {
+                    cerr << "Error: serial AND-SUB mismatch " << from << ":"
+                         << and_cnt << ":" << sub_cnt << endl;
+                    exit(1);
+                }
+            }
+        }
+    }
+
+    for (unsigned n = 0; n < vect_count; ++n)
+        delete [] blobs[n];
+
+    cout << "---------------------------- Serial aggregator test OK" << endl;
+}
+
+
+static
+void AggregatorArgOrderTest()
+{
+    cout << "---------------------------- Aggregator argument order test" << endl;
+
+    bm::aggregator<bvect> agg;
+
+    const unsigned args_size = 6;
+    bvect bvs[args_size];
+    bvs[0].set_range(0, 65536 * 300);              // dense, wide
+    for (unsigned i = 0; i < 65536 * 300; i += 1 + unsigned(rand()) % 3)
+        bvs[1].set(i);                              // dense bit-blocks
+    for (unsigned i = 65536 * 150; i < 65536 * 160; i += 97)
+        bvs[2].set(i);                              // sparse, narrow range
+    for (unsigned i = 7; i < 65536 * 200; i += 65536 / 2)
+        bvs[3].set_range(i, i + 10);                // sparse GAP runs
+    bvs[4].invert();                                // all ones
+    bvs[4].set_range(65536 * 155, 65536 * 156, false);
+    bvs[5].set_range(65536 * 400, 65536 * 410);     // disjoint range
+    for (unsigned n = 0; n < args_size; ++n)
+        if (n & 1)
+            bvs[n].optimize();
+
+    bvect bv_sub;
+    for (unsigned i = 65536 * 150; i < 65536 * 160; i += 97 * 3)
+        bv_sub.set(i);
+    const bvect* bv_src_sub[1] = { &bv_sub };
+
+    unsigned idx[4];
+    for (unsigned pass = 0; pass < 300; ++pass)
+    {
+        unsigned and_size = 1 + pass % 4;
+        for (unsigned k = 0; k < and_size; ++k)
+        {
+            idx[k] = unsigned(rand()) % args_size;
+            if (pass < 100 && idx[k] == 5)
+                idx[k] = 2; // most queries should not be empty
+        }
+        const bvect* bv_src_and[4];
+        for (unsigned k = 0; k < and_size; ++k)
+            bv_src_and[k] = &bvs[idx[k]];
+        unsigned sub_size = pass & 1;
+
+        bvect bv_control;
+        agg.combine_and_sub_horizontal(bv_control, bv_src_and, and_size,
+                                       bv_src_sub, sub_size);
+        bvect bv_target;
+        bv_target.set(65536 * 500);
+        bool found = agg.combine_and_sub(bv_target, bv_src_and, and_size,
+                                         bv_src_sub, sub_size, false);
+        if (bv_target.compare(bv_control) != 0 || found != bv_control.any())
+        {
+            cerr << "Error: AND-SUB mismatch, pass=" << pass << endl;
+            exit(1);
+        }
+        bvect::size_type cnt = agg.count_and_sub(bv_src_and, and_size,
+                                                 bv_src_sub, sub_size);
+        if (cnt != bv_control.count())
+        {
+            cerr << "Error: AND-SUB count mismatch, pass=" << pass << endl;
+            exit(1);
+        }
+        bvect::size_type first, first_c;
+        found = agg.find_first_and_sub(first, bv_src_and, and_size,
+                                       bv_src_sub, sub_size);
+        bool found_c = bv_control.find(first_c);
+        if (found != found_c || (found && first != first_c))
+        {
+            cerr << "Error: AND-SUB find first mismatch, pass=" << pass << endl;
+            exit(1);
+        }
+        if (!sub_size)
+        {
+            agg.combine_and(bv_target, bv_src_and, and_size);
+            if (bv_target.compare(bv_control) != 0)
+            {
+                cerr << "Error: AND mismatch, pass=" << pass << endl;
+                exit(1);
+            }
+        }
+    } // for pass
+
+    cout << "---------------------------- Aggregator argument order test OK" << endl;
+}
+
+
+static
+void RangeOperationsTest()
+{
+    cout << "---------------------------- Range operations test" << endl;
+
+    bm::aggregator<bvect> agg;
+
+    const unsigned vect_count = 5;
+    bvect bvs[vect_count];
+    bvs[0].set_range(100, 65536 * 20);
+    for (unsigned i = 0; i < 65536 * 25; i += 1 + unsigned(rand()) % 3)
+        bvs[1].set(i);
+    for (unsigned i = 65536 * 2; i < 65536 * 30; i += 1000)
+        bvs[2].set_range(i, i + 100);
+    GenerateMixedBlocksVector(bvs[3], 3, 16);
+    bvs[4].invert();
+    bvs[4].set_range(65536 * 7, 65536 * 9 + 5, false);
+    for (unsigned n = 0; n < vect_count; ++n)
+        if (n & 1)
+            bvs[n].optimize();
+
+    for (unsigned pass = 0; pass < 200; ++pass)
+    {
+        unsigned n1 = unsigned(rand()) % vect_count;
+        unsigned n2 = unsigned(rand()) % vect_count;
+        bvect::size_type left, right;
+        switch (pass % 4)
+        {
+        case 0: // block aligned
+            left = 65536 * (unsigned(rand()) % 20);
+            right = left + 65536 * (1 + unsigned(rand()) % 300) - 1;
+            break;
+        case 1: // inside one block
+            left = unsigned(rand()) % (65536 * 20);
+            right = left + unsigned(rand()) % 1000;
+            break;
+        default:
+            left = unsigned(rand()) % (65536 * 35);
+            right = unsigned(rand()) % (65536 * 35);
+            break;
+        }
+        bvect::size_type l = left < right ? left : right;
+        bvect::size_type r = left < right ? right : left;
+
+        bvect bv_arg_r; // argument restricted to the range
+        bv_arg_r.copy_range(bvs[n2], l, r);
+        bvect bv_in, bv_out; // target in and out of the range
+        bv_in.copy_range(bvs[n1], l, r);
+        bv_out = bvs[n1];
+        bv_out.set_range(l, r, false);
+
+        // bvector range operations
+        //
+        {
+            bvect bv(bvs[n1]), bv_control(bvs[n1]);
+            bv.bit_or(bvs[n2], left, right);
+            bv_control.bit_or(bv_arg_r);
+            if (bv.compare(bv_control) != 0)
+            {
+                cerr << "Error: range OR mismatch, pass=" << pass << endl;
+                exit(1);
+            }
+        }
+        {
+            bvect bv(bvs[n1]), bv_control(bv_in);
+            bv.bit_sub(bvs[n2], left, right);
+            bv_control.bit_sub(bv_arg_r);
+            bv_control.bit_or(bv_out);
+            if (bv.compare(bv_control) != 0)
+            {
+                cerr << "Error: range SUB mismatch, pass=" << pass << endl;
+                exit(1);
+            }
+        }
+        {
+            bvect bv(bvs[n1]), bv_control(bv_in);
+            bv.bit_and(bvs[n2], left, right);
+            bv_control.bit_and(bv_arg_r);
+            bv_control.bit_or(bv_out);
+            if (bv.compare(bv_control) != 0)
+            {
+                cerr << "Error: range AND mismatch, pass=" << pass << endl;
+                exit(1);
+            }
+            bv_control.bit_and(bv_arg_r);
+            bvect::size_type cnt = bm::count_and(bvs[n1], bvs[n2], left, right);
+            if (cnt != bv_control.count())
+            {
+                cerr << "Error: range count_and mismatch, pass=" << pass
+                     << " " << cnt << "!=" << bv_control.count() << endl;
+                exit(1);
+            }
+        }
+
+        // aggregator range operations
+        //
+        const bvect* bv_src[3] = { &bvs[n1], &bvs[n2],
+                                   &bvs[unsigned(rand()) % vect_count] };
+        const bvect* bv_sub[1] = { &bvs[unsigned(rand()) % vect_count] };
+        {
+            bvect bv_target, bv_full, bv_control;
+            agg.combine_or(bv_target, bv_src, 3, left, right);
+            agg.combine_or(bv_full, bv_src, 3);
+            bv_control.copy_range(bv_full, l, r);
+            if (bv_target.compare(bv_control) != 0)
+            {
+                cerr << "Error: aggregator range OR mismatch, pass=" << pass << endl;
+                exit(1);
+            }
+            agg.combine_and(bv_target, bv_src, 3, left, right);
+            agg.combine_and(bv_full, bv_src, 3);
+            bv_control.copy_range(bv_full, l, r);
+            if (bv_target.compare(bv_control) != 0)
+            {
+                cerr << "Error: aggregator range AND mismatch, pass=" << pass << endl;
+                exit(1);
+            }
+            bool found = agg.combine_and_sub(bv_target, bv_src, 2, bv_sub, 1,
+                                             left, right, false);
+            agg.combine_and_sub(bv_full, bv_src, 2, bv_sub, 1, false);
+            bv_control.copy_range(bv_full, l, r);
+            if (bv_target.compare(bv_control) != 0 ||
+                found != bv_control.any())
+            {
+                cerr << "Error: aggregator range AND-SUB mismatch, pass="
+                     << pass << endl;
+                exit(1);
+            }
+        }
+    } // for pass
+
+    cout << "---------------------------- Range operations test OK" << endl;
+}
+
+static
+void CheckCachedResult(bm::aggregator_cache<bvect>& agg_cache,
+                       const bvect* bv_src[], unsigned src_size,
+                       const bvect* bv_sub[], unsigned sub_size,
+                       bool expect_hit)
+{
+    bm::aggregator<bvect> agg;
+    bvect bv_target, bv_control;
+    bvect::size_type hits = agg_cache.hits();
+    bool found = agg_cache.combine_and_sub(bv_target, bv_src, src_size,
+                                           bv_sub, sub_size);
+    bool found_c = agg.combine_and_sub(bv_control, bv_src, src_size,
+                                       bv_sub, sub_size, false);
+    if (bv_target.compare(bv_control) != 0 || found != found_c)
+    {
+        cerr << "Error: aggregator cache AND-SUB mismatch" << endl;
+        exit(1);
+    }
+    if ((agg_cache.hits() != hits) != expect_hit)
+    {
+        cerr << "Error: aggregator cache unexpected "
+             << (expect_hit ? "miss" : "hit") << endl;
+        exit(1);
+    }
+}
+
+static
+void AggregatorCacheTest()
+{
+    cout << "---------------------------- Aggregator cache test" << endl;
+
+    bm::aggregator<bvect> agg;
+    bm::aggregator_cache<bvect> agg_cache;
+
+    const unsigned vect_count = 5;
+    bvect bvs[vect_count];
+    for (unsigned i = 0; i < 65536 * 25; i += 1 + unsigned(rand()) % 3)
+        bvs[0].set(i);
+    bvs[1].set_range(100, 65536 * 20);
+    for (unsigned i = 65536 * 2; i < 65536 * 30; i += 1000)
+        bvs[2].set_range(i, i + 100);
+    GenerateMixedBlocksVector(bvs[3], 3, 16);
+    bvs[4].invert();
+    bvs[4].set_range(65536 * 7, 65536 * 9 + 5, false);
+    bvs[4].optimize();
+
+    // cached results match aggregator, repeated queries are hits
+    // (regardless of the argument order)
+    {
+        const bvect* bv_src[3] = { &bvs[0], &bvs[1], &bvs[2] };
+        const bvect* bv_src_r[3] = { &bvs[2], &bvs[0], &bvs[1] };
+        for (unsigned pass = 0; pass < 2; ++pass)
+        {
+            bvect bv_target, bv_control;
+            agg_cache.combine_or(bv_target, pass ? bv_src_r : bv_src, 3);
+            agg.combine_or(bv_control, bv_src, 3);
+            if (bv_target.compare(bv_control) != 0)
+            {
+                cerr << "Error: aggregator cache OR mismatch" << endl;
+                exit(1);
+            }
+            agg_cache.combine_and(bv_target, pass ? bv_src_r : bv_src, 3);
+            agg.combine_and(bv_control, bv_src, 3);
+            if (bv_target.compare(bv_control) != 0)
+            {
+                cerr << "Error: aggregator cache AND mismatch" << endl;
+                exit(1);
+            }
+            // hit result is a private copy: modification is not visible
+            // to the next query
+            bv_target.set(10);
+            bv_target.optimize();
+        }
+        assert(agg_cache.misses() == 2 && agg_cache.hits() == 2);
+        assert(agg_cache.size() == 2);
+        assert(agg_cache.memory_used() > 0);
+
+        // OR and AND over the same arguments are different queries,
+        // AND-SUB groups are not interchangeable
+        const bvect* bv_sub[1] = { &bvs[2] };
+        CheckCachedResult(agg_cache, bv_src, 2, bv_sub, 1, false);
+        CheckCachedResult(agg_cache, bv_src, 2, bv_sub, 1, true);
+        CheckCachedResult(agg_cache, bv_src + 1, 2, bv_src, 1, false);
+        CheckCachedResult(agg_cache, bv_src + 1, 2, bv_src, 1, true);
+
+        // target size is preserved
+        bvect bv_target(1000);
+        agg_cache.combine_or(bv_target, bv_src, 3);
+        assert(bv_target.size() == bm::id_max);
+        bvect bv_s1(5000), bv_s2(7000), bv_control(1000);
+        bv_s1.set(10); bv_s2.set(10); bv_s2.set(6000);
+        const bvect* bv_src_s[2] = { &bv_s1, &bv_s2 };
+        bvect bv_target_s(1000);
+        agg_cache.combine_or(bv_target_s, bv_src_s, 2);
+        agg.combine_or(bv_control, bv_src_s, 2);
+        assert(bv_target_s.size() == 7000);
+        assert(bv_target_s.compare(bv_control) == 0);
+    }
+
+    // any modification of an argument invalidates cached results
+    {
+        const bvect* bv_src[2] = { &bvs[0], &bvs[3] };
+        const bvect* bv_sub[2] = { &bvs[2], &bvs[4] };
+        CheckCachedResult(agg_cache, bv_src, 2, bv_sub, 2, false);
+        CheckCachedResult(agg_cache, bv_src, 2, bv_sub, 2, true);
+
+        for (unsigned op = 0; op < 14; ++op)
+        {
+            bvect& bv = bvs[op % 2 ? 4 : 3];
+            bvect bv_tmp;
+            bv_tmp.set_range(65536 * 3, 65536 * 5);
+            bm::id64_t epoch = bv.epoch();
+            switch (op)
+            {
+            case 0:  bv.set_bit(65536 * 2 + 1); break;
+            case 1:  bv.clear_bit(65536 * 2 + 3); break;
+            case 2:  bv.bit_or(bv_tmp); break;
+            case 3:  bv.bit_sub(bv_tmp); break;
+            case 4:  bv.set_range(10, 65536 * 2); break;
+            case 5:  bv.invert(); break;
+            case 6:  bv.optimize(); break;
+            case 7:  bv.insert(100, true); break;
+            case 8:  bv.shift_right(); break;
+            case 9:  bv.erase(5); break;
+            case 10: bv.swap(bv_tmp); break;
+            case 11: bv = bv_tmp; break;
+            case 12: bv.resize(65536 * 3); break;
+            default:
+                {
+                    unsigned ids[] = { 1, 5, 65536 * 40 };
+                    bm::combine_or(bv, ids, ids + 3);
+                }
+                break;
+            } // switch
+            if (bv.epoch() == epoch)
+            {
+                cerr << "Error: epoch is not updated, op=" << op << endl;
+                exit(1);
+            }
+            CheckCachedResult(agg_cache, bv_src, 2, bv_sub, 2, false);
+            CheckCachedResult(agg_cache, bv_src, 2, bv_sub, 2, true);
+        } // for op
+
+        // const operations keep the epoch
+        bm::id64_t epoch = bvs[3].epoch();
+        bvect bv_copy(bvs[3]);
+        bvs[3].count();
+        bvs[3].test(10);
+        assert(bvs[3].epoch() == epoch);
+        assert(bv_copy.epoch() != epoch);
+        CheckCachedResult(agg_cache, bv_src, 2, bv_sub, 2, true);
+
+        // copy has the same content but a different identity
+        bv_src[1] = &bv_copy;
+        CheckCachedResult(agg_cache, bv_src, 2, bv_sub, 2, false);
+
+        // modification of the shared copy unshares blocks and changes
+        // epoch only for the modified vector
+        bv_copy.clear();
+        assert(bvs[3].epoch() == epoch);
+        CheckCachedResult(agg_cache, bv_src, 2, bv_sub, 2, false);
+        bv_src[1] = &bvs[3];
+        CheckCachedResult(agg_cache, bv_src, 2, bv_sub, 2, true);
+    }
+
+    // memory budget
+    {
+        agg_cache.clear();
+        agg_cache.reset_counters();
+        assert(agg_cache.size() == 0 && agg_cache.memory_used() == 0);
+
+        // copies of the same vector: different queries, same result size
+        bvect bv_copies[vect_count];
+        const bvect* bv_src[vect_count];
+        for (unsigned n = 0; n < vect_count; ++n)
+        {
+            bv_copies[n] = bvs[0];
+            bv_src[n] = &bv_copies[n];
+        }
+        bvect bv_target;
+        agg_cache.combine_or(bv_target, bv_src, 1);
+        size_t mem = agg_cache.memory_used();
+        assert(mem > 0);
+
+        agg_cache.set_memory_budget(mem * 2 + mem / 2);
+        for (unsigned n = 1; n < vect_count; ++n)
+        {
+            agg_cache.combine_or(bv_target, bv_src + n, 1);
+            assert(agg_cache.memory_used() <= agg_cache.memory_budget());
+        }
+        assert(agg_cache.evictions() == vect_count - 2);
+        assert(agg_cache.size() == 2);
+
+        // evicted (least recently used) query is recomputed
+        bvect::size_type misses = agg_cache.misses();
+        bvect bv_control;
+        agg_cache.combine_or(bv_target, bv_src, 1);
+        agg.combine_or(bv_control, bv_src, 1);
+        assert(agg_cache.misses() == misses + 1);
+        assert(bv_target.compare(bv_control) == 0);
+
+        // result larger than the budget is not cached
+        agg_cache.set_memory_budget(1);
+        assert(agg_cache.size() == 0);
+        agg_cache.combine_or(bv_target, bv_src, 2);
+        agg.combine_or(bv_control, bv_src, 2);
+        assert(agg_cache.size() == 0 && agg_cache.memory_used() == 0);
+        assert(bv_target.compare(bv_control) == 0);
+    }
+
+    cout << "---------------------------- Aggregator cache test OK" << endl;
+}
+
+
+static
+void StressTestAggregatorOR(unsigned repetitions)
+{
+  cout << "---------------------------- Aggregator OR Stress Test" << endl;
+   unsigned size = BITVECT_SIZE - 10;
+
+
+    unsigned i;
     for (i = 0; i < repetitions; ++i)
     {
         int opt = rand() % 2;
-        cout << endl << " - - - - - - - - - - - - AGG AND STRESS STEP " << i << endl;;
+        cout << endl << " - - - - - - - - - - - - AGG OR STRESS STEP " << i << endl;;
         
         switch (rand() % 3)
         {
@@ -4572,55 +6813,173 @@ void StressTestAggregatorAND(unsigned repetitions)
         agg_list[8] = &bv8;
         agg_list[9] = &bv9;
         
-        bvect bv_target1, bv_target2, bv_target3, bv_target4;
-        bvect bv_empty;
+        bvect bv_target1, bv_target2;
         
         unsigned cnt = 10;
-        agg.combine_and(bv_target1, agg_list, cnt);
-        agg.combine_and_horizontal(bv_target2, agg_list, cnt);
-        agg.combine_and_sub(bv_target3, agg_list, cnt, 0, 0, false);
-        agg.combine_and_sub(bv_empty, agg_list, cnt, agg_list, cnt, false);
+        agg.combine_or(bv_target1, agg_list, cnt);
+        agg.combine_or_horizontal(bv_target2, agg_list, cnt);
 
         int res = bv_target1.compare(bv_target2);
         if (res!=0)
         {
-            cerr << "Error: Aggregator AND check failed!" << endl;
-            exit(1);
-        }
-        res = bv_target3.compare(bv_target1);
-        if (res!=0)
-        {
-            cerr << "Error: Aggregator AND-SUB(0) check failed!" << endl;
+            cerr << "Error: Aggregator OR check failed!" << endl;
             exit(1);
         }
-        assert(!bv_empty.any());
         for (unsigned j = 1; j < cnt; ++j)
         {
-            agg.combine_and(bv_target1, agg_list, j);
-            agg.combine_and_horizontal(bv_target2, agg_list, j);
-            agg.combine_and_sub(bv_target3, agg_list, cnt, 0, 0, false);
-            agg.combine_and_sub(bv_empty, agg_list, cnt, agg_list, cnt, false);
-
-            
+            agg.combine_or(bv_target1, agg_list, j);
+            agg.combine_or_horizontal(bv_target2, agg_list, j);
             res = bv_target1.compare(bv_target2);
             if (res!=0)
             {
-                cerr << "Error: Aggregator AND check failed! 1.laddder step = "
+                cerr << "Error: Aggregator OR check failed! 1.laddder step = "
                      << j << endl;
                 exit(1);
             }
-            res = bv_target1.compare(bv_target3);
+        }
+        
+        for (unsigned j = 0; j < cnt; ++j)
+        {
+            agg.combine_or(bv_target1, agg_list+j, cnt-j);
+            agg.combine_or_horizontal(bv_target2, agg_list+j, cnt-j);
+            res = bv_target1.compare(bv_target2);
             if (res!=0)
             {
-                cerr << "Error: Aggregator AND-SUB(0) check failed! 1.laddder step = "
+                cerr << "Error: Aggregator OR check failed! 2.laddder step = "
                      << j << endl;
                 exit(1);
             }
-            assert(!bv_empty.any());
         }
-        
-        for (unsigned j = 0; j < cnt; ++j)
-        {
+
+
+    } // for i
+
+  cout << "---------------------------- Aggregator OR Stress Test OK" << endl;
+}
+
+static
+void StressTestAggregatorAND(unsigned repetitions)
+{
+  cout << "---------------------------- Aggregator AND Stress Test" << endl;
+   unsigned size = BITVECT_SIZE - 10;
+
+
+    unsigned i;
+    for (i = 0; i < repetitions; ++i)
+    {
+        int opt = rand() % 2;
+        cout << endl << " - - - - - - - - - - - - AGG AND STRESS STEP " << i << endl;;
+        
+        switch (rand() % 3)
+        {
+        case 0:
+            size = BITVECT_SIZE / 10;
+            break;
+        case 1:
+            size = BITVECT_SIZE / 2;
+            break;
+        default:
+            size = BITVECT_SIZE - 10;
+            break;
+        } // switch
+        
+        unsigned start1 = 0;
+        switch (rand() % 3)
+        {
+        case 1:
+            start1 += size / 5;
+            break;
+        default:
+            break;
+        }
+
+        unsigned start2 = 0;
+        switch (rand() % 3)
+        {
+        case 1:
+            start2 += size / 5;
+            break;
+        default:
+            break;
+        }
+
+        bvect_mini   bvect_min1(size);
+        bvect bv0, bv1, bv2, bv3, bv4, bv5, bv6, bv7, bv8, bv9;
+
+        // 0 skipped
+        FillSetsRandomMethod(&bvect_min1, &bv1, start1, size, opt);
+        FillSetsRandomMethod(&bvect_min1, &bv2, start2, size, opt);
+        // 3 skipped
+        FillSetsRandomMethod(&bvect_min1, &bv5, start1, size, opt);
+        FillSetsRandomMethod(&bvect_min1, &bv6, start2, size, opt);
+        FillSetsRandomMethod(&bvect_min1, &bv7, start1, size, opt);
+        FillSetsRandomMethod(&bvect_min1, &bv8, start2, size, opt);
+        FillSetsRandomMethod(&bvect_min1, &bv9, start2, size, opt);
+        
+        bm::aggregator<bvect> agg;
+        
+        bvect* agg_list[32] = {0, };
+        
+        agg_list[0] = &bv0;
+        agg_list[1] = &bv1;
+        agg_list[2] = &bv2;
+        agg_list[3] = &bv3;
+        agg_list[4] = &bv4;
+        agg_list[5] = &bv5;
+        agg_list[6] = &bv6;
+        agg_list[7] = &bv7;
+        agg_list[8] = &bv8;
+        agg_list[9] = &bv9;
+        
+        bvect bv_target1, bv_target2, bv_target3, bv_target4;
+        bvect bv_empty;
+        
+        unsigned cnt = 10;
+        agg.combine_and(bv_target1, agg_list, cnt);
+        agg.combine_and_horizontal(bv_target2, agg_list, cnt);
+        agg.combine_and_sub(bv_target3, agg_list, cnt, 0, 0, false);
+        agg.combine_and_sub(bv_empty, agg_list, cnt, agg_list, cnt, false);
+
+        int res = bv_target1.compare(bv_target2);
+        if (res!=0)
+        {
+            cerr << "Error: Aggregator AND check failed!" << endl;
+            exit(1);
+        }
+        res = bv_target3.compare(bv_target1);
+        if (res!=0)
+        {
+            cerr << "Error: Aggregator AND-SUB(0) check failed!" << endl;
+            exit(1);
+        }
+        assert(!bv_empty.any());
+        for (unsigned j = 1; j < cnt; ++j)
+        {
+            agg.combine_and(bv_target1, agg_list, j);
+            agg.combine_and_horizontal(bv_target2, agg_list, j);
+            agg.combine_and_sub(bv_target3, agg_list, cnt, 0, 0, false);
+            agg.combine_and_sub(bv_empty, agg_list, cnt, agg_list, cnt, false);
+
+            
+            res = bv_target1.compare(bv_target2);
+            if (res!=0)
+            {
+                cerr << "Error: Aggregator AND check failed! 1.laddder step = "
+                     << j << endl;
+                exit(1);
+            }
+            res = bv_target1.compare(bv_target3);
+            if (res!=0)
+            {
+                cerr << "Error: Aggregator AND-SUB(0) check failed! 1.laddder step = "
+                     << j << endl;
+                exit(1);
+            }
+            assert(!bv_empty.any());
+        }
+        
+        for (unsigned j = 0; j < cnt; ++j)
+        {
             if (j == 9)
                 cerr << j << endl;
             agg.combine_and(bv_target1, agg_list+j, cnt-j);
@@ -6912,7 +9271,7 @@ void GetNextTest()
    {
        bvect  bv;
        bool found;
-       bm::id_t pos;
+       bvect::size_type pos;
        found = bv.find(0, pos);
        
        if (found)
@@ -6986,7 +9345,7 @@ void GetNextTest()
    {
        bvect  bv(BM_GAP);
        bool found;
-       bm::id_t pos;
+       bvect::size_type pos;
        found = bv.find(0, pos);
        if (found)
        {
@@ -7053,7 +9412,7 @@ void GetNextTest()
        bool found;
        
        bv.set_range(100000, 20000000);
-       bm::id_t pos;
+       bvect::size_type pos;
        found = bv.find_reverse(pos);
        assert(found && pos == 20000000);
 
@@ -7080,7 +9439,7 @@ void GetNextTest()
    {
        bvect  bv;
        bool found;
-       bm::id_t pos;
+       bvect::size_type pos;
        bv.invert();
        
        found = bv.find_reverse(pos);
@@ -7225,7 +9584,7 @@ void GetNextTest()
         last_found = nbit1;
    } // while
    
-   unsigned pos = 0;
+   bvect::size_type pos = 0;
    bool found = bvect_full1.find_reverse(pos);
    assert(found && pos == last_found);
 
@@ -7236,6 +9595,383 @@ void GetNextTest()
 
 }
 
+static
+void AddressRangeTest()
+{
+    cout << "-------------------------------------------- AddressRangeTest" << endl;
+
+    typedef bvect::size_type size_type;
+
+    // ids spread across the whole address space of the vector
+    // (64-bit mode covers ids above the 32-bit limit)
+    //
+    size_type ids[] = { 0, 65535, 65536, 
+                        size_type(bm::id_max32) - 5,
+#ifdef BM64ADDR
+                        size_type(bm::id_max32), size_type(bm::id_max32) + 10,
+                        (size_type(1) << 40) + 3,
+#endif
+                        bm::id_max - 2
+                      };
+    const unsigned ids_cnt = sizeof(ids) / sizeof(ids[0]);
+    
+    bvect bv;
+    for (unsigned i = 0; i < ids_cnt; ++i)
+        bv.set(ids[i]);
+    if (bv.count() != ids_cnt)
+    {
+        cout << "Address range count failed: " << bv.count() << endl;
+        exit(1);
+    }
+    {
+        unsigned i = 0;
+        bvect::enumerator en = bv.first();
+        for (; en.valid(); ++en, ++i)
+        {
+            if (*en != ids[i])
+            {
+                cout << "Address range enumerator failed: " << *en << endl;
+                exit(1);
+            }
+        }
+        assert(i == ids_cnt);
+    }
+    {
+        size_type pos;
+        bool found = bv.find_reverse(pos);
+        assert(found && pos == bm::id_max - 2);
+        found = bv.find(ids[3] + 1, pos);
+        assert(found && pos == ids[4]);
+        assert(bv.get_next(ids[3]) == ids[4]);
+    }
+    // rank-select index (covers the 32-bit range)
+    {
+        std::unique_ptr<bvect::rs_index_type> rs(new bvect::rs_index_type);
+        bv.running_count_blocks(rs.get());
+        assert(bv.count_to(ids[3], *rs) == 4);
+        assert(bv.count_to(ids[3] + 1, *rs) == 4);
+        size_type pos;
+        bool found = bv.select(4, pos, *rs);
+        assert(found && pos == ids[3]);
+        found = bv.find_rank(2, ids[1], pos, *rs);
+        assert(found && pos == ids[2]);
+        (void)found;
+    }
+    {
+        size_type left = ids[3] - 100;
+        size_type right = ids[4] + 1;
+        bvect bv_r;
+        bv_r.set_range(left, right);
+        assert(bv_r.count() == right - left + 1);
+        assert(bv_r.count_range(left, right) == right - left + 1);
+
+        bv_r &= bv;
+        assert(bv_r.count() == 2);
+    }
+    {
+        BM_DECLARE_TEMP_BLOCK(tb)
+        bm::serializer<bvect> bv_ser;
+        bm::serializer<bvect>::buffer sbuf;
+        bv.optimize(tb);
+        bv_ser.serialize(bv, sbuf, 0);
+
+        bvect bv2;
+        bm::deserialize(bv2, sbuf.buf());
+        if (bv2.compare(bv) != 0)
+        {
+            cout << "Address range deserialization failed" << endl;
+            exit(1);
+        }
+        bvect bv3;
+        bv3.set(ids[1]);
+        bm::operation_deserializer<bvect> od;
+        od.deserialize(bv3, sbuf.buf(), tb, bm::set_OR);
+        assert(bv3.compare(bv) == 0);
+        od.deserialize(bv3, sbuf.buf(), tb, bm::set_XOR);
+        assert(bv3.count() == 0);
+    }
+    {
+        bm::aggregator<bvect> agg;
+        bvect bv_target;
+        bvect bv1(bv);
+        bv1.set(ids[2] + 1);
+        agg.add(&bv);
+        agg.add(&bv1);
+        agg.combine_and(bv_target);
+        assert(bv_target.compare(bv) == 0);
+    }
+
+    cout << "-------------------------------------------- AddressRangeTest OK" << endl;
+}
+
+#ifdef BM64ADDR
+
+// fills vector with ids around the 32-bit limit and in the sparse
+// upper part of the 48-bit address space, seed picks the layout
+static
+void GenerateAddressRangeVector(bvect& bv, std::vector<bvect::size_type>& ids,
+                                unsigned seed)
+{
+    typedef bvect::size_type size_type;
+    const size_type bases[] = {
+        0,
+        size_type(bm::id_max32) - 70000,
+        size_type(bm::id_max32) + 65536 * 7,
+        size_type(bm::id_max32) * 3 + 65536 * 256 * 5,
+        (size_type(1) << 36) + 11,         // next page of the top level
+        (size_type(1) << 40) - 65536 * 2,
+        bm::id_max - 400000
+    };
+    const unsigned bases_cnt = sizeof(bases) / sizeof(bases[0]);
+
+    srand(seed);
+    for (unsigned k = 0; k < bases_cnt; ++k)
+    {
+        if (((seed + k) % 5) == 0) // leave some regions empty
+            continue;
+        size_type base = bases[k];
+        // sparse ids (GAP blocks) and dense range (bit or FULL blocks)
+        for (unsigned i = 0; i < 300; ++i)
+            bv.set(base + size_type(rand() % 150000));
+        if ((seed + k) & 1)
+            bv.set_range(base + 70000, base + 70000 + 65536 + (seed % 3) * 65536);
+    }
+    if (seed & 1)
+        bv.optimize();
+
+    ids.resize(0);
+    for (bvect::enumerator en = bv.first(); en.valid(); ++en)
+        ids.push_back(*en);
+}
+
+// check vector against the sorted reference list of ids
+static
+void CheckAddressRangeVector(const bvect& bv,
+                             const std::vector<bvect::size_type>& ids,
+                             const char* msg)
+{
+    bool eq = (bv.count() == ids.size());
+    if (eq)
+    {
+        size_t i = 0;
+        for (bvect::enumerator en = bv.first(); en.valid(); ++en, ++i)
+        {
+            if (*en != ids[i])
+            {
+                eq = false;
+                break;
+            }
+        }
+    }
+    if (!eq)
+    {
+        cerr << msg << " failed. count=" << bv.count()
+             << " expected=" << ids.size() << endl;
+        exit(1);
+    }
+}
+
+static
+void AddressRange64Test()
+{
+    cout << "-------------------------------------------- AddressRange64Test" << endl;
+
+    typedef bvect::size_type size_type;
+    typedef std::vector<size_type> id_vector;
+
+    // sparse upper range does not allocate the full top level
+    {
+        bvect bv;
+        bv.set(bm::id_max - 1);
+        bv.set(size_type(bm::id_max32) * 7);
+        bvect::statistics st;
+        bv.calc_stat(&st);
+        if (st.memory_used > 2 * 1024 * 1024)
+        {
+            cerr << "Top level memory is not sparse: "
+                 << st.memory_used << endl;
+            exit(1);
+        }
+        bvect bv2(bv);
+        bv2 |= bv;
+        bv2 &= bv;
+        assert(bv2.compare(bv) == 0);
+        assert(bv2.count() == 2);
+    }
+
+    BM_DECLARE_TEMP_BLOCK(tb)
+    bm::thread_pool pool(4);
+    bm::aggregator<bvect> agg;
+    bm::parallel::aggregator<bvect> agg_p(pool);
+
+    for (unsigned pass = 0; pass < 8; ++pass)
+    {
+        bvect bv1, bv2, bv3;
+        id_vector ids1, ids2, ids3;
+        GenerateAddressRangeVector(bv1, ids1, pass);
+        GenerateAddressRangeVector(bv2, ids2, pass + 3);
+        GenerateAddressRangeVector(bv3, ids3, pass * 7 + 1);
+
+        id_vector r_or, r_and, r_sub, r_xor;
+        std::set_union(ids1.begin(), ids1.end(), ids2.begin(), ids2.end(),
+                       std::back_inserter(r_or));
+        std::set_intersection(ids1.begin(), ids1.end(),
+                              ids2.begin(), ids2.end(),
+                              std::back_inserter(r_and));
+        std::set_difference(ids1.begin(), ids1.end(),
+                            ids2.begin(), ids2.end(),
+                            std::back_inserter(r_sub));
+        std::set_symmetric_difference(ids1.begin(), ids1.end(),
+                                      ids2.begin(), ids2.end(),
+                                      std::back_inserter(r_xor));
+
+        // serialization round-trip and operation deserialization
+        {
+            bm::serializer<bvect> bv_ser;
+            bm::serializer<bvect>::buffer sbuf;
+            bv_ser.serialize(bv2, sbuf, 0);
+
+            bvect bv_d;
+            bm::deserialize(bv_d, sbuf.buf());
+            CheckAddressRangeVector(bv_d, ids2, "64-bit deserialization");
+
+            bm::operation_deserializer<bvect> od;
+            bvect bv_op(bv1);
+            od.deserialize(bv_op, sbuf.buf(), tb, bm::set_OR);
+            CheckAddressRangeVector(bv_op, r_or, "64-bit deserialization OR");
+            bv_op = bv1;
+            od.deserialize(bv_op, sbuf.buf(), tb, bm::set_AND);
+            CheckAddressRangeVector(bv_op, r_and, "64-bit deserialization AND");
+            bv_op = bv1;
+            od.deserialize(bv_op, sbuf.buf(), tb, bm::set_SUB);
+            CheckAddressRangeVector(bv_op, r_sub, "64-bit deserialization SUB");
+            bv_op = bv1;
+            od.deserialize(bv_op, sbuf.buf(), tb, bm::set_XOR);
+            CheckAddressRangeVector(bv_op, r_xor, "64-bit deserialization XOR");
+
+            size_type cnt = od.deserialize(bv1, sbuf.buf(), tb,
+                                           bm::set_COUNT_AND);
+            assert(cnt == r_and.size());
+            (void)cnt;
+        }
+
+        // plain and parallel logical operations
+        {
+            bvect bv_op(bv1);
+            bv_op |= bv2;
+            CheckAddressRangeVector(bv_op, r_or, "64-bit OR");
+            bv_op = bv1;
+            bv_op &= bv2;
+            CheckAddressRangeVector(bv_op, r_and, "64-bit AND");
+            bv_op = bv1;
+            bv_op -= bv2;
+            CheckAddressRangeVector(bv_op, r_sub, "64-bit SUB");
+            assert(bm::count_and(bv1, bv2) == r_and.size());
+            assert(bm::count_or(bv1, bv2) == r_or.size());
+
+            bv_op = bv1;
+            bm::parallel::bit_or(bv_op, bv2, pool);
+            CheckAddressRangeVector(bv_op, r_or, "64-bit parallel OR");
+            bv_op = bv1;
+            bm::parallel::bit_and(bv_op, bv2, pool);
+            CheckAddressRangeVector(bv_op, r_and, "64-bit parallel AND");
+            bv_op = bv1;
+            bm::parallel::bit_sub(bv_op, bv2, pool);
+            CheckAddressRangeVector(bv_op, r_sub, "64-bit parallel SUB");
+        }
+
+        // aggregator: OR, AND, AND-SUB, find first
+        {
+            const bvect* agg_list[3] = { &bv1, &bv2, &bv3 };
+            const bvect* sub_list[1] = { &bv3 };
+
+            id_vector r_or3, r_and3, r_and_sub;
+            std::set_union(r_or.begin(), r_or.end(),
+                           ids3.begin(), ids3.end(),
+                           std::back_inserter(r_or3));
+            std::set_intersection(r_and.begin(), r_and.end(),
+                                  ids3.begin(), ids3.end(),
+                                  std::back_inserter(r_and3));
+            std::set_difference(r_and.begin(), r_and.end(),
+                                ids3.begin(), ids3.end(),
+                                std::back_inserter(r_and_sub));
+
+            bvect bv_s, bv_p;
+            agg.combine_or(bv_s, agg_list, 3);
+            CheckAddressRangeVector(bv_s, r_or3, "64-bit aggregator OR");
+            agg_p.combine_or(bv_p, agg_list, 3);
+            CheckAddressRangeVector(bv_p, r_or3, "64-bit parallel aggregator OR");
+
+            agg.combine_and(bv_s, agg_list, 3);
+            CheckAddressRangeVector(bv_s, r_and3, "64-bit aggregator AND");
+            agg_p.combine_and(bv_p, agg_list, 3);
+            CheckAddressRangeVector(bv_p, r_and3, "64-bit parallel aggregator AND");
+
+            bool f_s = agg.combine_and_sub(bv_s, agg_list, 2,
+                                           sub_list, 1, false);
+            assert(f_s == !r_and_sub.empty());
+            CheckAddressRangeVector(bv_s, r_and_sub, "64-bit aggregator AND-SUB");
+            bool f_p = agg_p.combine_and_sub(bv_p, agg_list, 2,
+                                             sub_list, 1, false);
+            assert(f_p == f_s);
+            CheckAddressRangeVector(bv_p, r_and_sub,
+                                    "64-bit parallel aggregator AND-SUB");
+
+            size_type idx_s = 0, idx_p = 0;
+            f_s = agg.find_first_and_sub(idx_s, agg_list, 2, sub_list, 1);
+            f_p = agg_p.find_first_and_sub(idx_p, agg_list, 2, sub_list, 1);
+            assert(f_s == !r_and_sub.empty() && f_p == f_s);
+            if (f_s && (idx_s != r_and_sub[0] || idx_p != r_and_sub[0]))
+            {
+                cerr << "64-bit find_first_and_sub failed "
+                     << idx_s << " " << idx_p << endl;
+                exit(1);
+            }
+            (void)f_p;
+        }
+
+        // rank-select index covers the 32-bit address range
+        {
+            std::unique_ptr<bvect::rs_index_type> rs(new bvect::rs_index_type);
+            bv1.running_count_blocks(rs.get());
+
+            id_vector::const_iterator it_lim =
+                std::upper_bound(ids1.begin(), ids1.end(),
+                                 size_type(bm::id_max32));
+            size_type idx_cnt = size_type(it_lim - ids1.begin());
+            size_type pos;
+            bool found;
+            if (idx_cnt)
+            {
+                found = bv1.select(idx_cnt, pos, *rs);
+                assert(found && pos == ids1[idx_cnt - 1]);
+                found = bv1.select(1, pos, *rs);
+                assert(found && pos == ids1[0]);
+                found = bv1.find_rank(idx_cnt, 0, pos, *rs);
+                assert(found && pos == ids1[idx_cnt - 1]);
+
+                // rank positions are below bm::id_max32
+                size_type k = ids1[idx_cnt - 1] < bm::id_max32 ?
+                                                idx_cnt : idx_cnt - 1;
+                if (k)
+                    assert(bv1.count_to(ids1[k - 1], *rs) == k);
+                assert(bv1.count_to(bm::id_max32 - 1, *rs) == k);
+            }
+            found = bv1.select(idx_cnt + 1, pos, *rs);
+            if (found) // bits above the limit are not indexed
+            {
+                cerr << "64-bit select above the index limit: "
+                     << pos << endl;
+                exit(1);
+            }
+        }
+    } // for pass
+
+    cout << "-------------------------------------------- AddressRange64Test OK" << endl;
+}
+
+#endif
+
 // Test contributed by Maxim Shemanarev.
 static
 void MaxSTest()
@@ -7936,7 +10672,7 @@ void SetTest()
 template<class A, class B> void CompareMiniSet(const A& ms,
                                           const B& bvm)
 {
-    for (unsigned i = 0; i < bm::set_total_blocks; ++i)
+    for (unsigned i = 0; i < bm::set_total_blocks32; ++i)
     {
         bool ms_val = ms.test(i)!=0;
         bool bvm_val = bvm.is_bit_true(i)!=0;
@@ -7953,8 +10689,8 @@ void MiniSetTest()
 {
     cout << "----------------------- MiniSetTest" << endl;
     {
-    bm::miniset<bm::block_allocator, bm::set_total_blocks> ms;
-    bvect_mini bvm(bm::set_total_blocks);
+    bm::miniset<bm::block_allocator, bm::set_total_blocks32> ms;
+    bvect_mini bvm(bm::set_total_blocks32);
 
 
     CompareMiniSet(ms, bvm);
@@ -7999,8 +10735,8 @@ void MiniSetTest()
 
 
     {
-    bm::miniset<bm::block_allocator, bm::set_total_blocks> ms;
-    bvect_mini bvm(bm::set_total_blocks);
+    bm::miniset<bm::block_allocator, bm::set_total_blocks32> ms;
+    bvect_mini bvm(bm::set_total_blocks32);
 
 
     ms.set(1);
@@ -8009,14 +10745,14 @@ void MiniSetTest()
     CompareMiniSet(ms, bvm);
 
     unsigned i;
-    for (i = 1; i < bm::set_total_blocks; i+=3)
+    for (i = 1; i < bm::set_total_blocks32; i+=3)
     {
         ms.set(i);
         bvm.set_bit(i);
     }
     CompareMiniSet(ms, bvm);
 
-    for (i = 1; i < bm::set_total_blocks/2; i+=3)
+    for (i = 1; i < bm::set_total_blocks32/2; i+=3)
     {
         ms.set(i, false);
         bvm.clear_bit(i);
@@ -8026,8 +10762,8 @@ void MiniSetTest()
 
 
     {
-    bm::bvmini<bm::set_total_blocks> ms(0);
-    bvect_mini bvm(bm::set_total_blocks);
+    bm::bvmini<bm::set_total_blocks32> ms(0);
+    bvect_mini bvm(bm::set_total_blocks32);
 
 
     CompareMiniSet(ms, bvm);
@@ -8055,14 +10791,14 @@ void MiniSetTest()
     CompareMiniSet(ms, bvm);
 
 
-    for (i = 1; i < bm::set_total_blocks; i+=3)
+    for (i = 1; i < bm::set_total_blocks32; i+=3)
     {
         ms.set(i);
         bvm.set_bit(i);
     }
     CompareMiniSet(ms, bvm);
 
-    for (i = 1; i < bm::set_total_blocks/2; i+=3)
+    for (i = 1; i < bm::set_total_blocks32/2; i+=3)
     {
         ms.set(i, false);
         bvm.clear_bit(i);
@@ -8072,8 +10808,8 @@ void MiniSetTest()
 
 
     {
-    bm::miniset<bm::block_allocator, bm::set_total_blocks> ms;
-    bvect_mini bvm(bm::set_total_blocks);
+    bm::miniset<bm::block_allocator, bm::set_total_blocks32> ms;
+    bvect_mini bvm(bm::set_total_blocks32);
 
 
     ms.set(1);
@@ -9466,7 +12202,7 @@ void CountRangeTest()
     
     for (unsigned i = 0; i < bm::set_total_blocks; ++i)
     {
-        assert(bc_arr.bcount[i] == 2);
+        assert(bc_arr.rcount(i) == 2);
     } // for
     
     VerifyCountRange(bv1, bc_arr, 200000);
@@ -9477,7 +12213,7 @@ void CountRangeTest()
     
     for (unsigned i = 0; i < bm::set_total_blocks; ++i)
     {
-        assert(bc_arr1.bcount[i] == 2);
+        assert(bc_arr1.rcount(i) == 2);
     } // for
     
     VerifyCountRange(bv1, bc_arr1, 200000);
@@ -9497,12 +12233,12 @@ void CountRangeTest()
     bvect::rs_index_type bc_arr;
     bv1.running_count_blocks(&bc_arr);
 
-    assert(bc_arr.bcount[0] == 2);
-    assert(bc_arr.bcount[1] == 5);
+    assert(bc_arr.rcount(0) == 2);
+    assert(bc_arr.rcount(1) == 5);
 
     for (unsigned i = 2; i < bm::set_total_blocks; ++i)
     {
-        assert(bc_arr.bcount[i] == 5);
+        assert(bc_arr.rcount(i) == 5);
     } // for
     
     VerifyCountRange(bv1, bc_arr, 200000);
@@ -9521,28 +12257,108 @@ void CountRangeTest()
             VerifyCountRange(bv1, bc_arr, 200000);
     }}
 
-    
-    cout << "---------------------------- CountRangeTest OK" << endl;
-}
-
-static
-void ExportTest()
-{
-    cout << "---------------------------- ExportTest..." << endl;
-
-    {
-    char buf[20] = {0,};
-
-    buf[0] = 1;
-    buf[1] = 1;
-    buf[2]= (char)(1 << 1);
-
-    bvect bv1;
-    export_array(bv1, buf + 0, buf + 20);
+    cout << "check sparse rank-select index size" << endl;
+    {{
+        bvect bv1;
+        bv1.set(10);
+        bv1.set(bm::id_max / 2);
+        bvect::rs_index_type bc_arr;
+        bv1.running_count_blocks(&bc_arr);
+        assert(bc_arr.count() == 2);
+        if (bc_arr.memory_used() > 16 * 1024)
+        {
+            cerr << "rs_index is not sparse: " << bc_arr.memory_used() << endl;
+            exit(1);
+        }
+        bvect::size_type pos;
+        bool found = bv1.select(2, pos, bc_arr);
+        assert(found && pos == bm::id_max / 2);
+        assert(bv1.count_to(bm::id_max / 2, bc_arr) == 2);
+    }}
 
-    assert(bv1.count() == 3);
-    assert(bv1.test(0));
-    assert(bv1.test(8));
+    cout << "check incremental rank-select index update" << endl;
+    {{
+        bvect bv1;
+        bvect::rs_index_type bc_arr;
+        bv1.running_count_blocks(&bc_arr);
+        const unsigned max_bit = 3 * bm::set_array_size * 65536 + 70000;
+        for (unsigned k = 0; k < 3000; ++k)
+        {
+            unsigned i = unsigned(rand()) % max_bit;
+            if (k & 1)
+                bv1.set_bit(i, true, bc_arr);
+            else
+                bv1.clear_bit((i & 1) ? i : unsigned(bv1.get_first()), bc_arr);
+            if (k % 250 == 0)
+            {
+                unsigned from = unsigned(rand()) % max_bit;
+                unsigned to = from + unsigned(rand()) % 200000;
+                bv1.set_range(from, to, bool(k & 2));
+                bv1.update_rs_index(bc_arr, from, to);
+            }
+            if (k % 500 == 0)
+            {
+                bv1.optimize(); // block types change, counts stay
+            }
+        }
+        bvect::rs_index_type bc_arr1;
+        bv1.running_count_blocks(&bc_arr1);
+        assert(bc_arr.count() == bv1.count());
+        assert(bc_arr1.count() == bv1.count());
+        for (unsigned nb = 0; nb < bm::set_total_blocks32; ++nb)
+        {
+            if (bc_arr.rcount(nb) != bc_arr1.rcount(nb))
+            {
+                cerr << "Incremental rs_index mismatch at block " << nb << endl;
+                exit(1);
+            }
+        }
+        for (unsigned k = 0; k < 2000; ++k)
+        {
+            unsigned i = unsigned(rand()) % max_bit;
+            if (bv1.count_to(i, bc_arr) != bv1.count_range(0, i))
+            {
+                cerr << "Incremental rs_index count_to() failed" << endl;
+                exit(1);
+            }
+        }
+        bvect::enumerator en = bv1.first();
+        for (bvect::size_type r = 1; en.valid(); ++en, ++r)
+        {
+            bvect::size_type pos;
+            bool found = bv1.select(r, pos, bc_arr);
+            if (!found || pos != *en)
+            {
+                cerr << "Incremental rs_index select() failed" << endl;
+                exit(1);
+            }
+        }
+        bvect::rs_index_type bc_arr2(bc_arr);
+        bc_arr1 = bc_arr2;
+        assert(bc_arr1.count() == bv1.count());
+    }}
+    
+    cout << "---------------------------- CountRangeTest OK" << endl;
+}
+
+static
+void ExportTest()
+{
+    cout << "---------------------------- ExportTest..." << endl;
+
+    {
+    char buf[20] = {0,};
+
+    buf[0] = 1;
+    buf[1] = 1;
+    buf[2]= (char)(1 << 1);
+
+    bvect bv1;
+    export_array(bv1, buf + 0, buf + 20);
+
+    assert(bv1.count() == 3);
+    assert(bv1.test(0));
+    assert(bv1.test(8));
     assert(bv1.test(17));
     }
 
@@ -12421,7 +15237,7 @@ void TestSparseVectorScan()
                          << " count = " << bv_control.count() << endl;
                     exit(1);
                 }
-                unsigned v1, v2;
+                bvect::size_type v1, v2;
                 bool b = bv_control.find_range(v1, v2);
                 assert(b);
                 if (v1 != v2)
@@ -12431,7 +15247,7 @@ void TestSparseVectorScan()
                     exit(1);
                 }
                 
-                bm::id_t pos;
+                sparse_vector_u32::size_type pos = 0;
                 bool found = scanner.find_eq(sv, j, pos);
                 if (!found)
                 {
@@ -12456,191 +15272,850 @@ void TestSparseVectorScan()
                 }
 
 
-                if (j % 1000 == 0)
-                    cout << "\r" << j << "/" << sv_size << "    " << flush;
-            } // for
-            cout << endl;
+                if (j % 1000 == 0)
+                    cout << "\r" << j << "/" << sv_size << "    " << flush;
+            } // for
+            cout << endl;
+        }
+ 
+        cout << "Unique search OK" << endl;
+    }
+
+    {
+        cout << "Find EQ test on flat data" << endl;
+        bvect::allocator_pool_type pool;
+        unsigned max_value = 128000;
+        for (unsigned value = 0; value < max_value; ++value)
+        {
+            sparse_vector_u32 sv;
+            sparse_vector_u64 sv_64;
+            rsc_sparse_vector_u32 csv;
+            
+            bvect bv_control, bv_control2;
+            bvect::mem_pool_guard(pool, bv_control);
+
+            unsigned sv_size = 67000;
+            
+            {
+                sparse_vector_u32::back_insert_iterator bi(sv.get_back_inserter());
+                sparse_vector_u64::back_insert_iterator bi_64(sv_64.get_back_inserter());
+                for (unsigned j = 0; j < 67000; ++j)
+                {
+                    *bi = value;
+                    bm::id64_t v64 = value;
+                    v64 <<= 32;
+                    *bi_64 = v64;
+                }
+            }
+            csv.load_from(sv);
+            
+            scanner.find_eq(sv, value, bv_control);
+            unsigned found = bv_control.count();
+            
+            if (found != sv_size)
+            {
+                cerr << "1. sparse_vector<>::find_eq() discrepancy for value=" << value
+                     << " count = " << found << endl;
+                exit(1);
+            }
+            
+            rsc_scanner.find_eq(csv, value, bv_control2);
+            int res = bv_control.compare(bv_control2);
+            if (res != 0)
+            {
+                cerr << "RSC scan comparison failed at value =" << value
+                << endl;
+                exit(1);
+            }
+
+            
+            {
+                bm::id64_t v64 = value;
+                v64 <<= 32;
+
+                scanner_64.find_eq(sv_64, v64, bv_control);
+                found = bv_control.count();
+                
+                if (found != sv_size)
+                {
+                    cerr << "1. (64) sparse_vector<>::find_eq() discrepancy for value=" << value
+                         << " count = " << found << endl;
+                    exit(1);
+                }
+            }
+            
+            // not found check
+            scanner.find_eq(sv, value+1, bv_control);
+            if (bv_control.any())
+            {
+                cerr << "1. sparse_vector<>::find_eq() (any) discrepancy for value=" << value+1
+                     << " count = " << bv_control.count() << endl;
+                exit(1);
+            }
+            rsc_scanner.find_eq(csv, value+1, bv_control2);
+            res = bv_control.compare(bv_control2);
+            if (res != 0)
+            {
+                cerr << "1. RSC scan comparison failed at value =" << value+1
+                << endl;
+                exit(1);
+            }
+
+            {
+            BM_DECLARE_TEMP_BLOCK(tb)
+            sv.optimize(tb);
+            }
+            
+            bv_control.clear();
+            
+            scanner.find_eq(sv, value, bv_control);
+            found = bv_control.count();
+            
+            if (found != sv_size)
+            {
+                cerr << "2. sparse_vector<>::find_eq() discrepancy for value=" << value
+                     << " count = " << found << endl;
+                exit(1);
+            }
+            
+            // not found check
+            scanner.find_eq(sv, value+1, bv_control);
+            if (bv_control.any())
+            {
+                cerr << "2. sparse_vector<>::find_eq() (any) discrepancy for value=" << value+1
+                     << " count = " << bv_control.count() << endl;
+                exit(1);
+            }
+
+            
+            if (value % 10 == 0)
+                cout << "\r" << value << "/" << max_value << "    " << flush;
+        }
+        
+        cout << endl << "Flat EQ ok" << endl;
+    }
+    
+
+    
+    cout << " \n--------------- Test sparse_vector<> scan algo OK" << endl;
+}
+
+static
+void TestCompressedSparseVectorScan()
+{
+    cout << " --------------- Test rsc_sparse_vector<> scan algo" << endl;
+    
+    bm::sparse_vector_scanner<rsc_sparse_vector_u32> scanner;
+    
+    {
+        rsc_sparse_vector_u32 csv(bm::use_null);
+        bvect bv_control;
+        scanner.find_eq(csv, 25, bv_control);
+        assert(!bv_control.any());
+        scanner.invert(csv, bv_control);
+        assert(!bv_control.any());
+    }
+    
+    {
+        rsc_sparse_vector_u32 csv(bm::use_null);
+        bvect bv_res;
+
+        csv.push_back(10, 10);
+        csv.push_back(11, 10);
+        csv.push_back(200, 0);
+        csv.push_back(300, 0);
+        
+        csv.sync();
+
+        bm::id_t idx;
+        for (unsigned i = 0; i < 2; ++i)
+        {
+            bool found = scanner.find_eq(csv, 10, idx);
+            assert(found);
+            assert(idx == 10);
+            
+            scanner.find_eq(csv, 10, bv_res);
+            assert(bv_res.count()==2);
+            assert(bv_res.test(10));
+            assert(bv_res.test(11));
+            
+            scanner.find_eq(csv, 0, bv_res);
+            assert(bv_res.count()==2);
+            assert(bv_res.test(200));
+            assert(bv_res.test(300));
+
+            found = scanner.find_eq(csv, 0, idx);
+            assert(found);
+            assert(idx == 200);
+            
+            csv.optimize();
+        } // for
+    }
+
+    cout << " --------------- Test rsc_sparse_vector<> scan algo OK" << endl;
+
+}
+
+
+template<class SV, class SVScanner, class V>
+void CheckSparseVectorCompare(SVScanner& scanner, const SV& sv,
+                              const std::vector<V>& values,
+                              const std::vector<bool>& nulls,
+                              V v1, V v2, const bvect* bv_mask)
+{
+    bvect bv_lt, bv_le, bv_gt, bv_ge, bv_range;
+    bvect c_lt, c_le, c_gt, c_ge, c_range;
+    scanner.find_lt(sv, v1, bv_lt, bv_mask);
+    scanner.find_le(sv, v1, bv_le, bv_mask);
+    scanner.find_gt(sv, v1, bv_gt, bv_mask);
+    scanner.find_ge(sv, v1, bv_ge, bv_mask);
+    scanner.find_range(sv, v1, v2, bv_range, bv_mask);
+    for (unsigned i = 0; i < values.size(); ++i)
+    {
+        if (nulls[i] || (bv_mask && !bv_mask->test(i)))
+            continue;
+        V v = values[i];
+        if (v < v1)  c_lt.set(i);
+        if (v <= v1) c_le.set(i);
+        if (v > v1)  c_gt.set(i);
+        if (v >= v1) c_ge.set(i);
+        if (v >= v1 && v <= v2) c_range.set(i);
+    }
+    if (bv_lt.compare(c_lt) != 0 || bv_le.compare(c_le) != 0 ||
+        bv_gt.compare(c_gt) != 0 || bv_ge.compare(c_ge) != 0)
+    {
+        cerr << "Error: sparse vector compare mismatch, value=" << v1
+             << " lt=" << bv_lt.count() << "/" << c_lt.count()
+             << " le=" << bv_le.count() << "/" << c_le.count()
+             << " gt=" << bv_gt.count() << "/" << c_gt.count()
+             << " ge=" << bv_ge.count() << "/" << c_ge.count() << endl;
+        exit(1);
+    }
+    if (bv_range.compare(c_range) != 0)
+    {
+        cerr << "Error: sparse vector range search mismatch ["
+             << v1 << ", " << v2 << "]" << endl;
+        exit(1);
+    }
+}
+
+static
+void TestSparseVectorRangeScan()
+{
+    cout << " --------------- Test sparse_vector<> range scan" << endl;
+
+    bm::sparse_vector_scanner<sparse_vector_u32> scanner;
+    bm::sparse_vector_scanner<sparse_vector_u64> scanner_64;
+    bm::sparse_vector_scanner<rsc_sparse_vector_u32> rsc_scanner;
+
+    {
+        sparse_vector_u32 sv(bm::use_null);
+        rsc_sparse_vector_u32 csv;
+        bvect bv;
+        scanner.find_gt(sv, 10, bv);
+        assert(!bv.any());
+        scanner.find_le(sv, 10, bv);
+        assert(!bv.any());
+        rsc_scanner.find_range(csv, 0, 10, bv);
+        assert(!bv.any());
+
+        sparse_vector_u32 sv2;
+        sv2.push_back(5);
+        sv2.push_back(0);
+        sv2.push_back(7);
+        scanner.find_lt(sv2, 100000, bv);
+        assert(bv.count() == 3);
+        scanner.find_ge(sv2, 0, bv);
+        assert(bv.count() == 3);
+        scanner.find_lt(sv2, 0, bv);
+        assert(!bv.any());
+        scanner.find_gt(sv2, 5, bv);
+        assert(bv.count() == 1 && bv.test(2));
+        scanner.find_range(sv2, 7, 5, bv);
+        assert(!bv.any());
+        scanner.find_le(sv2, ~0u, bv);
+        assert(bv.count() == 3);
+    }
+
+    const unsigned sv_size = 65536 * 5;
+    std::vector<unsigned> values(sv_size);
+    std::vector<unsigned long long> values64(sv_size);
+    std::vector<bool> nulls(sv_size), no_nulls(sv_size);
+
+    for (unsigned pass = 0; pass < 2; ++pass)
+    {
+        sparse_vector_u32 sv(bm::use_null), sv_nn;
+        sparse_vector_u64 sv_64;
+        rsc_sparse_vector_u32 csv;
+        for (unsigned i = 0; i < sv_size; ++i)
+        {
+            unsigned v;
+            switch ((i >> 12) % 4)
+            {
+            case 0:  v = unsigned(rand()) % 100; break;    // low cardinality
+            case 1:  v = i; break;                         // unique
+            case 2:  v = 0; break;
+            default: v = unsigned(rand()) * 7919u; break;  // wide values
+            }
+            values[i] = v;
+            values64[i] = (unsigned long long)(v) << (i & 31);
+            nulls[i] = (i % 5 == 0) || ((i >> 14) == 3);
+            if (!nulls[i])
+                sv.set(i, v);
+            sv_nn.set(i, v);
+            sv_64.set(i, values64[i]);
+        }
+        if (pass)
+        {
+            BM_DECLARE_TEMP_BLOCK(tb)
+            sv.optimize(tb);
+            sv_nn.optimize(tb);
+            sv_64.optimize(tb);
+        }
+        csv.load_from(sv);
+
+        bvect bv_mask;
+        for (unsigned i = 0; i < sv_size; i += 1 + unsigned(rand()) % 5)
+            bv_mask.set_range(i, i + unsigned(rand()) % 100);
+        bv_mask.resize(sv_size);
+
+        for (unsigned k = 0; k < 30; ++k)
+        {
+            unsigned v1, v2;
+            switch (k % 5)
+            {
+            case 0: v1 = 0; v2 = unsigned(rand()) % 100; break;
+            case 1: v1 = unsigned(rand()) % 100; v2 = v1 + 10; break;
+            case 2: v1 = values[unsigned(rand()) % sv_size]; v2 = ~0u; break;
+            case 3: v1 = unsigned(rand()) % sv_size;
+                    v2 = v1 + unsigned(rand()) % 10000; break;
+            default:
+                v1 = values[unsigned(rand()) % sv_size];
+                v2 = values[unsigned(rand()) % sv_size];
+                break;
+            }
+            const bvect* mask = (k & 1) ? &bv_mask : 0;
+            CheckSparseVectorCompare(scanner, sv, values, nulls, v1, v2, mask);
+            CheckSparseVectorCompare(scanner, sv_nn, values, no_nulls,
+                                     v1, v2, mask);
+            CheckSparseVectorCompare(rsc_scanner, csv, values, nulls,
+                                     v1, v2, mask);
+            unsigned long long v64_1 = values64[unsigned(rand()) % sv_size];
+            unsigned long long v64_2 = v64_1 + (unsigned long long)(rand()) * 65536;
+            CheckSparseVectorCompare(scanner_64, sv_64, values64, no_nulls,
+                                     v64_1, v64_2, mask);
+        } // for k
+        cout << "\rpass " << pass << flush;
+    } // for pass
+
+    cout << "\n --------------- Test sparse_vector<> range scan OK" << endl;
+}
+
+template<class SV, class V>
+void CheckSparseVectorAggregates(const SV& sv,
+                                 const std::vector<V>& values,
+                                 const std::vector<bool>& nulls,
+                                 const bvect* bv_mask)
+{
+    bm::sparse_vector_aggregates<SV> sv_agg;
+
+    typedef typename bm::sparse_vector_aggregates<SV>::sum_type sum_type;
+    sum_type c_sum = 0;
+    unsigned c_count = 0;
+    V c_min = 0, c_max = 0;
+    for (unsigned i = 0; i < values.size(); ++i)
+    {
+        if (nulls[i] || (bv_mask && !bv_mask->test(i)))
+            continue;
+        V v = values[i];
+        c_sum += v;
+        ++c_count;
+        if (c_count == 1 || v < c_min) c_min = v;
+        if (c_count == 1 || v > c_max) c_max = v;
+    }
+    typename SV::size_type cnt = sv_agg.count(sv, bv_mask);
+    sum_type s = sv_agg.sum(sv, bv_mask);
+    if (cnt != c_count || s != c_sum)
+    {
+        cerr << "Error: sparse vector COUNT/SUM mismatch " << cnt << "/"
+             << c_count << " " << s << "/" << c_sum << endl;
+        exit(1);
+    }
+    V v_min = V(0), v_max = V(0);
+    double v_avg = 0;
+    bool found_min = sv_agg.min_value(sv, v_min, bv_mask);
+    bool found_max = sv_agg.max_value(sv, v_max, bv_mask);
+    bool found_avg = sv_agg.avg(sv, v_avg, bv_mask);
+    if (found_min != (c_count != 0) || found_max != (c_count != 0) ||
+        found_avg != (c_count != 0))
+    {
+        cerr << "Error: sparse vector MIN/MAX/AVG found mismatch" << endl;
+        exit(1);
+    }
+    if (c_count)
+    {
+        if (v_min != c_min || v_max != c_max)
+        {
+            cerr << "Error: sparse vector MIN/MAX mismatch " << v_min << "/"
+                 << c_min << " " << v_max << "/" << c_max << endl;
+            exit(1);
+        }
+        double c_avg = double(c_sum) / double(c_count);
+        if (fabs(v_avg - c_avg) > 1e-9 * fabs(c_avg))
+        {
+            cerr << "Error: sparse vector AVG mismatch" << endl;
+            exit(1);
+        }
+    }
+}
+
+static
+void TestSparseVectorAggregates()
+{
+    cout << " --------------- Test sparse_vector<> aggregates" << endl;
+
+    {
+        sparse_vector_u32 sv(bm::use_null);
+        rsc_sparse_vector_u32 csv;
+        bm::sparse_vector_aggregates<sparse_vector_u32> sv_agg;
+        bm::sparse_vector_aggregates<rsc_sparse_vector_u32> csv_agg;
+        unsigned v;
+        double a;
+        assert(sv_agg.count(sv) == 0 && sv_agg.sum(sv) == 0);
+        assert(!sv_agg.min_value(sv, v) && !sv_agg.max_value(sv, v));
+        assert(!sv_agg.avg(sv, a));
+        assert(csv_agg.count(csv) == 0 && !csv_agg.max_value(csv, v));
+
+        sv.set(10, 0);
+        sv.set(20, 7);
+        sv.set(30, 5);
+        assert(sv_agg.count(sv) == 3 && sv_agg.sum(sv) == 12);
+        assert(sv_agg.min_value(sv, v) && v == 0);
+        assert(sv_agg.max_value(sv, v) && v == 7);
+        assert(sv_agg.avg(sv, a) && a == 4.0);
+        bvect bv_mask { 20, 30, 40 };
+        assert(sv_agg.count(sv, &bv_mask) == 2);
+        assert(sv_agg.min_value(sv, v, &bv_mask) && v == 5);
+        bvect bv_empty;
+        assert(!sv_agg.min_value(sv, v, &bv_empty));
+    }
+
+    const unsigned sv_size = 65536 * 4;
+    std::vector<unsigned> values(sv_size);
+    std::vector<unsigned long long> values64(sv_size);
+    std::vector<bool> nulls(sv_size), no_nulls(sv_size);
+
+    for (unsigned pass = 0; pass < 2; ++pass)
+    {
+        sparse_vector_u32 sv(bm::use_null), sv_nn;
+        sparse_vector_u64 sv_64;
+        rsc_sparse_vector_u32 csv;
+        for (unsigned i = 0; i < sv_size; ++i)
+        {
+            unsigned v;
+            switch ((i >> 12) % 4)
+            {
+            case 0:  v = 1000 + unsigned(rand()) % 100; break;
+            case 1:  v = i + 5; break;
+            case 2:  v = 0; break;
+            default: v = unsigned(rand()) * 7919u; break;
+            }
+            values[i] = v;
+            values64[i] = (unsigned long long)(v) << (i & 15);
+            nulls[i] = (i % 7 == 0) || ((i >> 14) == 2);
+            if (!nulls[i])
+                sv.set(i, v);
+            sv_nn.set(i, v);
+            sv_64.set(i, values64[i]);
+        }
+        if (pass)
+        {
+            BM_DECLARE_TEMP_BLOCK(tb)
+            sv.optimize(tb);
+            sv_nn.optimize(tb);
+            sv_64.optimize(tb);
+        }
+        csv.load_from(sv);
+
+        for (unsigned k = 0; k < 8; ++k)
+        {
+            bvect bv_mask;
+            switch (k % 4)
+            {
+            case 0: break; // no mask
+            case 1:
+                for (unsigned i = 0; i < sv_size; i += 1 + unsigned(rand()) % 5)
+                    bv_mask.set_range(i, i + unsigned(rand()) % 100);
+                break;
+            case 2: // one block of values (min/max from the block)
+                bv_mask.set_range(65536 * (k % 3), 65536 * (k % 3) + 4095);
+                break;
+            default: // beyond the vector
+                bv_mask.set_range(sv_size - 10, sv_size + 1000);
+                break;
+            }
+            const bvect* mask = (k % 4) ? &bv_mask : 0;
+            CheckSparseVectorAggregates(sv, values, nulls, mask);
+            CheckSparseVectorAggregates(sv_nn, values, no_nulls, mask);
+            CheckSparseVectorAggregates(csv, values, nulls, mask);
+            CheckSparseVectorAggregates(sv_64, values64, no_nulls, mask);
+        } // for k
+    } // for pass
+
+    cout << " --------------- Test sparse_vector<> aggregates OK" << endl;
+}
+
+template<class SV, class V>
+void CheckSparseVectorRanking(const SV& sv,
+                              const std::vector<V>& values,
+                              const std::vector<bool>& nulls,
+                              const bvect* bv_mask)
+{
+    bm::sparse_vector_aggregates<SV> sv_agg;
+
+    std::vector<std::pair<V, unsigned> > asc, desc; // (value, index)
+    for (unsigned i = 0; i < values.size(); ++i)
+    {
+        if (nulls[i] || (bv_mask && !bv_mask->test(i)))
+            continue;
+        asc.push_back(std::make_pair(values[i], i));
+        desc.push_back(std::make_pair(V(~values[i]), i)); // reverse order
+    }
+    std::sort(asc.begin(), asc.end());
+    std::sort(desc.begin(), desc.end());
+
+    const unsigned n = unsigned(asc.size());
+    unsigned ks[] = { 0, 1, 2, 10, 1000, n / 2, n - 1, n, n + 10 };
+    for (unsigned j = 0; j < sizeof(ks)/sizeof(ks[0]); ++j)
+    {
+        unsigned k = ks[j];
+        if (k > n + 10) // n - 1 wrapped (n == 0)
+            continue;
+        bvect bv_top, bv_bottom, c_top, c_bottom;
+        sv_agg.find_top_k(sv, k, bv_top, bv_mask);
+        sv_agg.find_bottom_k(sv, k, bv_bottom, bv_mask);
+        for (unsigned i = 0; i < k && i < n; ++i)
+        {
+            c_top.set(desc[i].second);
+            c_bottom.set(asc[i].second);
+        }
+        if (bv_top.compare(c_top) != 0 || bv_bottom.compare(c_bottom) != 0)
+        {
+            cerr << "Error: Top-K mismatch k=" << k
+                 << " top=" << bv_top.count() << "/" << c_top.count()
+                 << " bottom=" << bv_bottom.count() << "/" << c_bottom.count()
+                 << endl;
+            exit(1);
+        }
+    } // for j
+
+    double qs[] = { 0.0, 0.01, 0.25, 0.5, 0.75, 0.99, 1.0 };
+    for (unsigned j = 0; j < sizeof(qs)/sizeof(qs[0]); ++j)
+    {
+        V v;
+        bool found = sv_agg.find_quantile(sv, qs[j], v, bv_mask);
+        if (found != (n != 0))
+        {
+            cerr << "Error: quantile found mismatch" << endl;
+            exit(1);
+        }
+        if (n && v != asc[unsigned(qs[j] * (n - 1))].first)
+        {
+            cerr << "Error: quantile mismatch q=" << qs[j] << endl;
+            exit(1);
+        }
+    } // for j
+}
+
+static
+void TestSparseVectorTopK()
+{
+    cout << " --------------- Test sparse_vector<> Top-K and quantiles" << endl;
+
+    {
+        sparse_vector_u32 sv;
+        bm::sparse_vector_aggregates<sparse_vector_u32> sv_agg;
+        bvect bv;
+        unsigned v;
+        sv_agg.find_top_k(sv, 5, bv);
+        assert(!bv.any());
+        assert(!sv_agg.find_quantile(sv, 0.5, v));
+
+        // 3, 1, 4, 1, 5, 9, 2, 6
+        unsigned arr[] = { 3, 1, 4, 1, 5, 9, 2, 6 };
+        for (unsigned i = 0; i < 8; ++i)
+            sv.push_back(arr[i]);
+        sv_agg.find_top_k(sv, 3, bv);
+        assert(bv.count() == 3 && bv.test(5) && bv.test(7) && bv.test(4));
+        sv_agg.find_bottom_k(sv, 1, bv);
+        assert(bv.count() == 1 && bv.test(1)); // first of the ties
+        sv_agg.find_bottom_k(sv, 2, bv);
+        assert(bv.count() == 2 && bv.test(1) && bv.test(3));
+        assert(sv_agg.find_quantile(sv, 0.5, v) && v == 3); // lower median
+        assert(sv_agg.find_quantile(sv, 0.0, v) && v == 1);
+        assert(sv_agg.find_quantile(sv, 1.0, v) && v == 9);
+    }
+
+    const unsigned sv_size = 65536 * 3;
+    std::vector<unsigned> values(sv_size);
+    std::vector<unsigned long long> values64(sv_size);
+    std::vector<bool> nulls(sv_size), no_nulls(sv_size);
+
+    for (unsigned pass = 0; pass < 2; ++pass)
+    {
+        sparse_vector_u32 sv(bm::use_null);
+        sparse_vector_u64 sv_64;
+        rsc_sparse_vector_u32 csv;
+        for (unsigned i = 0; i < sv_size; ++i)
+        {
+            unsigned v;
+            switch ((i >> 12) % 3)
+            {
+            case 0:  v = unsigned(rand()) % 50; break; // many ties
+            case 1:  v = sv_size - i; break;
+            default: v = unsigned(rand()) * 7919u; break;
+            }
+            values[i] = v;
+            values64[i] = (unsigned long long)(v) << (i & 15);
+            nulls[i] = (i % 3 == 0) || ((i >> 14) == 5);
+            if (!nulls[i])
+                sv.set(i, v);
+            sv_64.set(i, values64[i]);
+        }
+        if (pass)
+        {
+            BM_DECLARE_TEMP_BLOCK(tb)
+            sv.optimize(tb);
+            sv_64.optimize(tb);
+        }
+        csv.load_from(sv);
+
+        bvect bv_mask, bv_empty;
+        for (unsigned i = 0; i < sv_size; i += 1 + unsigned(rand()) % 5)
+            bv_mask.set_range(i, i + unsigned(rand()) % 100);
+
+        CheckSparseVectorRanking(sv, values, nulls, (const bvect*)0);
+        CheckSparseVectorRanking(sv, values, nulls, &bv_mask);
+        CheckSparseVectorRanking(sv, values, nulls, &bv_empty);
+        CheckSparseVectorRanking(csv, values, nulls, (const bvect*)0);
+        CheckSparseVectorRanking(csv, values, nulls, &bv_mask);
+        CheckSparseVectorRanking(sv_64, values64, no_nulls, &bv_mask);
+    } // for pass
+
+    cout << " --------------- Test sparse_vector<> Top-K and quantiles OK" << endl;
+}
+
+static
+void TestSignedSparseVector()
+{
+    cout << " --------------- Test signed sparse_vector<>" << endl;
+
+    typedef bm::sparse_vector<int, bvect > sparse_vector_i32;
+    typedef bm::rsc_sparse_vector<int, sparse_vector_i32> rsc_sparse_vector_i32;
+
+    {
+        int arr[] = { 0, -1, 1, -2, 2, -100000, 100000,
+                      int(0x7FFFFFFF), -int(0x7FFFFFFF) - 1 };
+        const unsigned arr_size = sizeof(arr) / sizeof(arr[0]);
+        sparse_vector_i32 sv(bm::use_null);
+        for (unsigned i = 0; i < arr_size; ++i)
+            sv.push_back(arr[i]);
+        assert(sv.size() == arr_size);
+        for (unsigned i = 0; i < arr_size; ++i)
+        {
+            assert(sv.get(i) == arr[i]);
+            assert(sv[i] == arr[i]);
+        }
+        sv.set(1, -3);
+        assert(sv.get(1) == -3);
+        sv.inc(1);
+        assert(sv.get(1) == -2);
+        sv.inc(1); sv.inc(1);
+        assert(sv.get(1) == 0);
+        sv.set(1, -1);
+
+        int buf[arr_size];
+        unsigned idx[arr_size];
+        sv.decode(buf, 0, arr_size);
+        for (unsigned i = 0; i < arr_size; ++i)
+        {
+            assert(buf[i] == arr[i]);
+            idx[i] = arr_size - 1 - i;
+        }
+        sv.extract_range(buf, 2, 3);
+        assert(buf[0] == -2 && buf[1] == 2);
+        sv.extract_plains(buf, 3, 3);
+        assert(buf[0] == -2 && buf[2] == -100000);
+        sv.gather(buf, idx, arr_size, bm::BM_UNKNOWN);
+        for (unsigned i = 0; i < arr_size; ++i)
+            assert(buf[i] == arr[idx[i]]);
+
+        sparse_vector_i32 sv2(bm::use_null);
+        sv2.import(arr, arr_size);
+        assert(sv2.equal(sv));
+        {
+            sparse_vector_i32::back_insert_iterator bi = sv2.get_back_inserter();
+            for (unsigned i = 0; i < arr_size; ++i)
+                *bi = arr[i];
+            bi.flush();
+        }
+        sparse_vector_i32::const_iterator it = sv2.begin();
+        for (unsigned i = 0; i < arr_size * 2; ++i, ++it)
+            assert(*it == arr[i % arr_size]);
+
+        bm::sparse_vector<short, bvect > sv_s;
+        bm::sparse_vector<signed char, bvect > sv_c;
+        for (int v = -128; v < 128; ++v)
+        {
+            sv_s.push_back(short(v * 200));
+            sv_c.push_back((signed char)v);
+        }
+        for (int v = -128; v < 128; ++v)
+        {
+            assert(sv_s[unsigned(v + 128)] == short(v * 200));
+            assert(sv_c[unsigned(v + 128)] == (signed char)v);
         }
- 
-        cout << "Unique search OK" << endl;
     }
 
+    // small negative values take as many bit-plains as small positive ones
     {
-        cout << "Find EQ test on flat data" << endl;
-        bvect::allocator_pool_type pool;
-        unsigned max_value = 128000;
-        for (unsigned value = 0; value < max_value; ++value)
+        sparse_vector_i32 sv_neg, sv_pos;
+        for (unsigned i = 0; i < 65536 * 2; ++i)
         {
-            sparse_vector_u32 sv;
-            sparse_vector_u64 sv_64;
-            rsc_sparse_vector_u32 csv;
-            
-            bvect bv_control, bv_control2;
-            bvect::mem_pool_guard(pool, bv_control);
+            int v = int(rand() % 16);
+            sv_neg.push_back(-v);
+            sv_pos.push_back(v);
+        }
+        assert(sv_neg.effective_plains() <= 5);
+        assert(sv_neg.effective_plains() == sv_pos.effective_plains());
+        BM_DECLARE_TEMP_BLOCK(tb)
+        sv_neg.optimize(tb);
+        sv_pos.optimize(tb);
+        sparse_vector_i32::statistics st_neg, st_pos;
+        sv_neg.calc_stat(&st_neg);
+        sv_pos.calc_stat(&st_pos);
+        assert(st_neg.memory_used <= st_pos.memory_used + st_pos.memory_used / 4);
+    }
 
-            unsigned sv_size = 67000;
-            
-            {
-                sparse_vector_u32::back_insert_iterator bi(sv.get_back_inserter());
-                sparse_vector_u64::back_insert_iterator bi_64(sv_64.get_back_inserter());
-                for (unsigned j = 0; j < 67000; ++j)
-                {
-                    *bi = value;
-                    bm::id64_t v64 = value;
-                    v64 <<= 32;
-                    *bi_64 = v64;
-                }
-            }
-            csv.load_from(sv);
-            
-            scanner.find_eq(sv, value, bv_control);
-            unsigned found = bv_control.count();
-            
-            if (found != sv_size)
+    const unsigned sv_size = 65536 * 3;
+    std::vector<int> values(sv_size);
+    std::vector<bool> nulls(sv_size), no_nulls(sv_size);
+
+    for (unsigned pass = 0; pass < 2; ++pass)
+    {
+        sparse_vector_i32 sv(bm::use_null);
+        rsc_sparse_vector_i32 csv;
+        for (unsigned i = 0; i < sv_size; ++i)
+        {
+            int v;
+            switch ((i >> 12) % 4)
             {
-                cerr << "1. sparse_vector<>::find_eq() discrepancy for value=" << value
-                     << " count = " << found << endl;
-                exit(1);
+            case 0:  v = rand() % 64 - 32; break;
+            case 1:  v = int(i) - int(sv_size / 2); break;
+            case 2:  v = -(rand() % 1000); break;
+            default: v = int(unsigned(rand()) * 7919u); break;
             }
-            
-            rsc_scanner.find_eq(csv, value, bv_control2);
-            int res = bv_control.compare(bv_control2);
-            if (res != 0)
+            values[i] = v;
+            nulls[i] = (i % 5 == 0) || ((i >> 14) == 5);
+            if (!nulls[i])
+                sv.set(i, v);
+        }
+        if (pass)
+        {
+            BM_DECLARE_TEMP_BLOCK(tb)
+            sv.optimize(tb);
+        }
+        csv.load_from(sv);
+
+        for (unsigned i = 0; i < sv_size; ++i)
+        {
+            if (nulls[i])
+                continue;
+            if (sv.get(i) != values[i] || csv.get(i) != values[i])
             {
-                cerr << "RSC scan comparison failed at value =" << value
-                << endl;
+                cerr << "Error: signed sparse vector get() mismatch at "
+                     << i << endl;
                 exit(1);
             }
+        }
 
-            
-            {
-                bm::id64_t v64 = value;
-                v64 <<= 32;
+        // search
+        {
+            bm::sparse_vector_scanner<sparse_vector_i32> scanner;
+            bm::sparse_vector_scanner<rsc_sparse_vector_i32> cscanner;
+            bvect bv_mask;
+            for (unsigned i = 0; i < sv_size; i += 1 + unsigned(rand()) % 5)
+                bv_mask.set_range(i, i + unsigned(rand()) % 100);
 
-                scanner_64.find_eq(sv_64, v64, bv_control);
-                found = bv_control.count();
-                
-                if (found != sv_size)
+            int eq_vals[] = { 0, -1, 5, -17, -999, int(sv_size / 4), values[4097] };
+            for (unsigned j = 0; j < sizeof(eq_vals)/sizeof(eq_vals[0]); ++j)
+            {
+                bvect bv_res, bv_cres, c_res;
+                scanner.find_eq(sv, eq_vals[j], bv_res);
+                cscanner.find_eq(csv, eq_vals[j], bv_cres);
+                for (unsigned i = 0; i < sv_size; ++i)
+                    if (!nulls[i] && values[i] == eq_vals[j])
+                        c_res.set(i);
+                if (bv_res.compare(c_res) != 0 || bv_cres.compare(c_res) != 0)
                 {
-                    cerr << "1. (64) sparse_vector<>::find_eq() discrepancy for value=" << value
-                         << " count = " << found << endl;
+                    cerr << "Error: signed sparse vector find_eq mismatch "
+                         << eq_vals[j] << endl;
                     exit(1);
                 }
             }
-            
-            // not found check
-            scanner.find_eq(sv, value+1, bv_control);
-            if (bv_control.any())
-            {
-                cerr << "1. sparse_vector<>::find_eq() (any) discrepancy for value=" << value+1
-                     << " count = " << bv_control.count() << endl;
-                exit(1);
-            }
-            rsc_scanner.find_eq(csv, value+1, bv_control2);
-            res = bv_control.compare(bv_control2);
-            if (res != 0)
+
+            int cmp_vals[] = { 0, -1, 1, -32, 31, -500, 500,
+                               -int(sv_size), int(sv_size),
+                               -int(0x7FFFFFFF) - 1, int(0x7FFFFFFF) };
+            const unsigned cmp_size = sizeof(cmp_vals)/sizeof(cmp_vals[0]);
+            for (unsigned j = 0; j < cmp_size; ++j)
             {
-                cerr << "1. RSC scan comparison failed at value =" << value+1
-                << endl;
-                exit(1);
+                int v1 = cmp_vals[j];
+                int v2 = cmp_vals[(j + 3) % cmp_size];
+                CheckSparseVectorCompare(scanner, sv, values, nulls, v1, v2,
+                                         (const bvect*)0);
+                CheckSparseVectorCompare(scanner, sv, values, nulls, v1, v2,
+                                         &bv_mask);
+                CheckSparseVectorCompare(cscanner, csv, values, nulls, v1, v2,
+                                         &bv_mask);
             }
+            CheckSparseVectorAggregates(sv, values, nulls, (const bvect*)0);
+            CheckSparseVectorAggregates(sv, values, nulls, &bv_mask);
+            CheckSparseVectorAggregates(csv, values, nulls, &bv_mask);
+            CheckSparseVectorRanking(sv, values, nulls, (const bvect*)0);
+            CheckSparseVectorRanking(csv, values, nulls, &bv_mask);
+        }
 
-            {
+        // serialization round-trip
+        {
             BM_DECLARE_TEMP_BLOCK(tb)
-            sv.optimize(tb);
-            }
-            
-            bv_control.clear();
-            
-            scanner.find_eq(sv, value, bv_control);
-            found = bv_control.count();
-            
-            if (found != sv_size)
+            bm::sparse_vector_serial_layout<sparse_vector_i32> sv_lay;
+            bm::sparse_vector_serialize(sv, sv_lay, tb);
+            sparse_vector_i32 sv2;
+            int res = bm::sparse_vector_deserialize(sv2, sv_lay.buf(), tb);
+            if (res != 0 || !sv.equal(sv2))
             {
-                cerr << "2. sparse_vector<>::find_eq() discrepancy for value=" << value
-                     << " count = " << found << endl;
+                cerr << "Error: signed sparse vector serialization failed"
+                     << endl;
                 exit(1);
             }
-            
-            // not found check
-            scanner.find_eq(sv, value+1, bv_control);
-            if (bv_control.any())
+            bool thrown = false;
+            try
             {
-                cerr << "2. sparse_vector<>::find_eq() (any) discrepancy for value=" << value+1
-                     << " count = " << bv_control.count() << endl;
-                exit(1);
+                sparse_vector_u32 sv_u;
+                bm::sparse_vector_deserialize(sv_u, sv_lay.buf(), tb);
             }
-
-            
-            if (value % 10 == 0)
-                cout << "\r" << value << "/" << max_value << "    " << flush;
+            catch (std::logic_error&)
+            {
+                thrown = true;
+            }
+            assert(thrown); (void)thrown;
         }
-        
-        cout << endl << "Flat EQ ok" << endl;
-    }
-    
-
-    
-    cout << " \n--------------- Test sparse_vector<> scan algo OK" << endl;
-}
-
-static
-void TestCompressedSparseVectorScan()
-{
-    cout << " --------------- Test rsc_sparse_vector<> scan algo" << endl;
-    
-    bm::sparse_vector_scanner<rsc_sparse_vector_u32> scanner;
-    
-    {
-        rsc_sparse_vector_u32 csv(bm::use_null);
-        bvect bv_control;
-        scanner.find_eq(csv, 25, bv_control);
-        assert(!bv_control.any());
-        scanner.invert(csv, bv_control);
-        assert(!bv_control.any());
-    }
-    
-    {
-        rsc_sparse_vector_u32 csv(bm::use_null);
-        bvect bv_res;
-
-        csv.push_back(10, 10);
-        csv.push_back(11, 10);
-        csv.push_back(200, 0);
-        csv.push_back(300, 0);
-        
-        csv.sync();
-
-        bm::id_t idx;
-        for (unsigned i = 0; i < 2; ++i)
-        {
-            bool found = scanner.find_eq(csv, 10, idx);
-            assert(found);
-            assert(idx == 10);
-            
-            scanner.find_eq(csv, 10, bv_res);
-            assert(bv_res.count()==2);
-            assert(bv_res.test(10));
-            assert(bv_res.test(11));
-            
-            scanner.find_eq(csv, 0, bv_res);
-            assert(bv_res.count()==2);
-            assert(bv_res.test(200));
-            assert(bv_res.test(300));
-
-            found = scanner.find_eq(csv, 0, idx);
-            assert(found);
-            assert(idx == 200);
-            
-            csv.optimize();
-        } // for
-    }
-
-    cout << " --------------- Test rsc_sparse_vector<> scan algo OK" << endl;
+    } // for pass
 
+    cout << " --------------- Test signed sparse_vector<> OK" << endl;
 }
 
-
 // fill pseudo-random plato pattern into two vectors
 //
 template<class SV>
@@ -13932,6 +17407,26 @@ void AddressResolverTest()
         assert(same);
 
     }
+
+    // synced resolvers release rank-select index memory
+    {
+        bvps_addr_resolver<bvect>  ares;
+        for (unsigned i = 0; i < 10; ++i)
+            ares.set(i * 65536 * 300 + 5); // several super-blocks
+        ares.sync();
+        ares.set(7);
+        ares.sync(); // re-sync of the allocated index
+        found = ares.resolve(65536 * 300 + 5, &id_to);
+        assert(found && id_to == 3);
+
+        bvps_addr_resolver<bvect>  ares2(ares);
+        ares2.sync();
+        bvps_addr_resolver<bvect>  ares3;
+        ares3.sync();
+        ares3.move_from(ares2);
+        assert(ares.equal(ares3));
+    }
+    CheckAllocationBalance();
     
     {
         sv_addr_resolver<sparse_vector<bm::id_t, bvect> > ares;
@@ -15552,12 +19047,12 @@ void TestCompressSparseVector()
         {
         rsc_sparse_vector_u32 csv1;
         
-        csv1.push_back(bm::id_max-1, 10);
+        csv1.push_back(bm::id_max32-1, 10);
         csv1.sync();
 
         for (unsigned k = 0; k < 2; ++k)
         {
-            for (unsigned i = bm::id_max-20; i < csv1.size(); ++i)
+            for (unsigned i = bm::id_max32-20; i < csv1.size(); ++i)
             {
                 CheckCompressedDecode(csv1, i, 1);
                 CheckCompressedDecode(csv1, i, csv1.size()-i+10);
@@ -15688,6 +19183,7 @@ void TestCompressSparseVector()
 
 
 
+
 int main(void)
 {
     time_t      start_time = time(0);
@@ -15720,6 +19216,27 @@ int main(void)
     exit(1);
 */
  
+    if (bm::id_max != bm::id_max32) // 64-bit address mode (BM64ADDR)
+    {
+        // most of the suite uses 32-bit sized structures,
+        // run tests which cover the 48-bit address range
+        AddressRangeTest();
+#ifdef BM64ADDR
+        AddressRange64Test();
+#endif
+        BvectorShiftTest();
+        CopyOnWriteTest();
+        FreezeTest();
+        BulkSetTest();
+        DecodeTest();
+        ReverseEnumeratorTest();
+        IntervalsTest();
+        ExprTest();
+
+        CheckAllocationBalance();
+        return 0;
+    }
+
     TestRecomb();
 
     OptimGAPTest();
@@ -15787,6 +19304,7 @@ int main(void)
      MaxSTest();
 
      GetNextTest();
+     AddressRangeTest();
 
      SimpleRandomFillTest();
 
@@ -15796,6 +19314,18 @@ int main(void)
 
      OrOperationsTest();
 
+     BulkSetTest();
+
+     TestManyTest();
+
+     DecodeTest();
+
+     ReverseEnumeratorTest();
+
+     IntervalsTest();
+
+     ExprTest();
+
      XorOperationsTest();
 
      SubOperationsTest();
@@ -15806,6 +19336,12 @@ int main(void)
 
      ShiftRotateTest();
 
+     BvectorShiftTest();
+
+     CopyOnWriteTest();
+
+     FreezeTest();
+
      ComparisonTest();
 
      //BitBlockTransposeTest();
@@ -15822,8 +19358,28 @@ int main(void)
 
      BlockLevelTest();
 
+     ParallelOpsTest();
+
      AggregatorTest();
 
+     AggregatorCountTest();
+
+     ThresholdAggregatorTest();
+
+     VerticalCountTest();
+
+     AggregatorBatchTest();
+
+     SerialAggregatorTest();
+
+     AggregatorArgOrderTest();
+
+     RangeOperationsTest();
+
+     AggregatorCacheTest();
+
+     ParallelAggregatorTest();
+
      StressTestAggregatorOR(100);
  
      StressTestAggregatorAND(100);
@@ -15855,6 +19411,14 @@ int main(void)
 
      TestCompressedSparseVectorScan();
 
+     TestSparseVectorRangeScan();
+
+     TestSparseVectorAggregates();
+
+     TestSparseVectorTopK();
+
+     TestSignedSparseVector();
+
      TestSparseVector_Stress(2);
  
      TestCompressedCollection();
@@ -15866,26 +19430,7 @@ int main(void)
 
     cout << "Test execution time = " << finish_time - start_time << endl;
 
-#ifdef MEM_DEBUG
-    cout << "[--------------  Allocation digest -------------------]" << endl;
-    cout << "Number of BLOCK allocations = " <<  dbg_block_allocator::na_ << endl;
-    cout << "Number of PTR allocations = " <<  dbg_ptr_allocator::na_ << endl << endl;
-
-    if(dbg_block_allocator::balance() != 0)
-    {
-        cout << "ERROR! Block memory leak! " << endl;
-        cout << dbg_block_allocator::balance() << endl;
-        exit(1);
-    }
-
-    if(dbg_ptr_allocator::balance() != 0)
-    {
-        cout << "ERROR! Ptr memory leak! " << endl;
-        cout << dbg_ptr_allocator::balance() << endl;
-        exit(1);
-    }
-    cout << "[------------  Debug Allocation balance OK ----------]" << endl;
-#endif
+    CheckAllocationBalance();
 
     return 0;
 }